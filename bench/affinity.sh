@@ -0,0 +1,105 @@
+#!/bin/bash
+
+# =============================================================================
+# CPU-affine connection steering benchmark: CPU_AFFINITY off vs auto (make bench-affinity)
+#
+# Loads a small file with CPU_AFFINITY unset (the master accepts and hands
+# every connection to a worker) and with CPU_AFFINITY=auto (each worker pinned
+# to a CPU and accepting the connections the reuseport program steers to it),
+# and prints throughput, p99 latency and the share of connections whose packets
+# were processed on the CPU of the worker that took them (SO_INCOMING_CPU, from
+# bin/stats_reader).
+#
+# Usage: bench/affinity.sh
+#
+# Environment:
+#   AFF_PORT       port of the server under test (default 18089)
+#   AFF_DURATION   seconds of load per run (default 5)
+#   AFF_WORKERS    NUM_WORKERS of both runs (default: one per online CPU)
+#   AFF_HOST       host to load (default 127.0.0.1). Over loopback the SYN is
+#                  processed on the client's CPU: run loadgen on another machine
+#                  against a multi-queue NIC to measure RSS-driven steering.
+# =============================================================================
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+BOLD='\033[1m'
+
+cd "$(dirname "$0")/.." || exit 1
+
+PORT=${AFF_PORT:-18089}
+DURATION=${AFF_DURATION:-5}
+WORKERS=${AFF_WORKERS:-$(nproc)}
+HOST=${AFF_HOST:-127.0.0.1}
+LOADGEN_ARGS="-t 2 -c 32"
+
+for bin in ./bin/webserver ./bin/loadgen ./bin/stats_reader; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not built (run make)${NC}"
+        exit 2
+    fi
+done
+
+WORK=$(mktemp -d /tmp/affinity.XXXXXX)
+SERVER_PID=""
+
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=""
+    fi
+}
+
+cleanup() {
+    stop_server
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+mkdir -p "$WORK/www"
+head -c 4096 /dev/urandom > "$WORK/www/small.bin"
+echo ok > "$WORK/www/index.html"
+
+# run <label> <cpu_affinity or empty>
+run() {
+    sed -e "s/^PORT=.*/PORT=$PORT/" \
+        -e "s#^DOCUMENT_ROOT=.*#DOCUMENT_ROOT=$WORK/www#" \
+        -e "s#^LOG_FILE=.*#LOG_FILE=$WORK/access.log#" \
+        -e "s/^NUM_WORKERS=.*/NUM_WORKERS=$WORKERS/" \
+        -e "s/^LOG_LEVEL=.*/LOG_LEVEL=WARN/" \
+        server.conf > "$WORK/server.conf"
+    [ -n "$2" ] && printf "\nCPU_AFFINITY=%s\n" "$2" >> "$WORK/server.conf"
+
+    ./bin/webserver "$WORK/server.conf" > "$WORK/server.out" 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 50); do
+        curl -s -m 1 -o /dev/null "http://127.0.0.1:$PORT/index.html" && break
+        sleep 0.1
+    done
+
+    # shellcheck disable=SC2086
+    ./bin/loadgen -H "$HOST" -p "$PORT" $LOADGEN_ARGS -d "$DURATION" -u /small.bin -j "$WORK/result.json" \
+        > "$WORK/loadgen.out" 2>&1
+    ./bin/stats_reader "$PORT" > "$WORK/stats.txt" 2>/dev/null
+    stop_server
+
+    local rps p99 errors
+    rps=$(grep -o '"throughput_rps": [0-9.]*' "$WORK/result.json" | awk '{print $2}')
+    p99=$(grep -o '"p99": [0-9]*' "$WORK/result.json" | awk '{print $2}')
+    errors=$(grep -o '"5xx": [0-9]*' "$WORK/result.json" | awk '{print $2}')
+    awk -F= -v label="$1" -v rps="${rps:-0}" -v p99="${p99:-0}" -v errors="${errors:-0}" '
+        /_conn_local=/  { loc += $2 }
+        /_conn_remote=/ { rem += $2 }
+        END {
+            share = (loc + rem > 0) ? loc * 100 / (loc + rem) : 0
+            note = (errors > 0) ? "(" errors " errors)" : ""
+            printf "%-22s %10.0f req/s %8d us p99 %6.1f%% local %s\n", label, rps, p99, share, note
+        }' "$WORK/stats.txt"
+}
+
+echo -e "${BOLD}Connection steering${NC}: $WORKERS workers, loadgen $LOADGEN_ARGS -d $DURATION against $HOST"
+run "master accept" ""
+run "CPU_AFFINITY=auto" auto
+echo -e "${GREEN}Done${NC} (local = SO_INCOMING_CPU equals the accepting worker's CPU)"
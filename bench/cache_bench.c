@@ -0,0 +1,479 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "cache.h"
+#include "hdr_hist.h"
+
+// File cache microbenchmark
+//
+// Usage: cache_bench [options]
+//   -t list       thread counts to run, comma separated (default 1,2,4,8,16,32,64)
+//   -k keys       distinct files (default 1000)
+//   -s dist       file sizes: fixed:N, uniform:MIN-MAX or lognormal:MEDIAN (sigma 1); sizes take
+//                 k/m suffixes (default lognormal:8k)
+//   -z s          Zipf exponent of key popularity (default 0.99; 0 = uniform)
+//   -c MB         cache capacity (default 0: a quarter of the working set)
+//   -d seconds    duration of each run (default 2)
+//   -j file       write the results as JSON to file ("-" = stdout)
+//
+// Every operation is what a request thread does: cache_acquire(), cache_load_file() on a miss, then
+// cache_release(). Each run starts from a fresh cache filled once in reverse popularity order, so the
+// counters cover the steady state only. The latency of every operation is recorded in ns (p99 includes
+// the file read of the misses); lock wait comes from the -DCACHE_LOCK_STATS build of cache.c.
+
+#define MAX_RUNS 32
+#define MAX_KEY_LEN 64
+#define LOGNORMAL_SIGMA 1.0
+
+typedef struct {
+    char dist[64];
+    int keys;
+    double zipf;
+    size_t capacity;
+    int duration;
+    const char* json;
+} options_t;
+
+static options_t g_opt = { "lognormal:8k", 1000, 0.99, 0, 2, NULL };
+static char g_dir[] = "/tmp/cache_bench.XXXXXX";
+static char (*g_keys)[MAX_KEY_LEN]; // Logical keys ("/kN")
+static char** g_paths; // Backing files
+static size_t* g_sizes;
+static double* g_cdf; // Cumulative popularity of the keys
+static size_t g_working_set;
+
+static atomic_int g_stop;
+
+typedef struct {
+    pthread_t tid;
+    int id;
+    file_cache_t* cache;
+    pthread_barrier_t* start;
+    unsigned long long rng;
+    hist_t hist;
+    unsigned long long ops;
+    unsigned long long hits;
+    unsigned long long load_errors;
+} bench_thread_t;
+
+typedef struct {
+    int threads;
+    double seconds;
+    unsigned long long ops;
+    double ops_per_sec;
+    long long p50_ns;
+    long long p99_ns;
+    long long max_ns;
+    double hit_ratio;
+    unsigned long evictions;
+    unsigned long lock_acquisitions;
+    unsigned long lock_contended;
+    unsigned long lock_wait_ns;
+    unsigned long long load_errors;
+} run_result_t;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// xorshift64*: per-thread, cheap
+static double rand_unit(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (double)((x * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static int pick_key(unsigned long long* rng) {
+    double u = rand_unit(rng);
+    int lo = 0, hi = g_opt.keys - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g_cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// ###############################################################################################################
+// Working set
+// ###############################################################################################################
+
+// "64", "8k", "2m" -> bytes (0 on error)
+static size_t parse_size(const char* s, const char** end) {
+    char* e;
+    double v = strtod(s, &e);
+    if (e == s || v < 0) {
+        return 0;
+    }
+    if (*e == 'k' || *e == 'K') {
+        v *= 1024;
+        e++;
+    } else if (*e == 'm' || *e == 'M') {
+        v *= 1024 * 1024;
+        e++;
+    }
+    if (end) {
+        *end = e;
+    }
+    return (size_t)v;
+}
+
+// Draw the size of every key from the -s distribution. Returns -1 on a bad specification.
+static int draw_sizes(const char* spec) {
+    unsigned long long rng = 0x9e3779b97f4a7c15ULL;
+    const char* rest;
+    size_t a, b = 0;
+    int kind;
+
+    if (strncmp(spec, "fixed:", 6) == 0) {
+        kind = 0;
+        a = parse_size(spec + 6, &rest);
+    } else if (strncmp(spec, "uniform:", 8) == 0) {
+        kind = 1;
+        a = parse_size(spec + 8, &rest);
+        if (*rest != '-') {
+            return -1;
+        }
+        b = parse_size(rest + 1, &rest);
+        if (b < a) {
+            return -1;
+        }
+    } else if (strncmp(spec, "lognormal:", 10) == 0) {
+        kind = 2;
+        a = parse_size(spec + 10, &rest);
+    } else {
+        return -1;
+    }
+    if (a == 0 || *rest != '\0') {
+        return -1;
+    }
+
+    for (int i = 0; i < g_opt.keys; i++) {
+        double sz;
+        if (kind == 0) {
+            sz = (double)a;
+        } else if (kind == 1) {
+            sz = (double)a + rand_unit(&rng) * (double)(b - a + 1);
+        } else {
+            // Box-Muller
+            double u1 = rand_unit(&rng), u2 = rand_unit(&rng);
+            double n = sqrt(-2.0 * log(u1 > 0 ? u1 : 1e-12)) * cos(2 * M_PI * u2);
+            sz = (double)a * exp(LOGNORMAL_SIGMA * n);
+        }
+        g_sizes[i] = (sz < 1) ? 1 : (size_t)sz;
+        g_working_set += g_sizes[i];
+    }
+    return 0;
+}
+
+static void remove_files(void) {
+    for (int i = 0; g_paths && i < g_opt.keys; i++) {
+        if (g_paths[i]) {
+            unlink(g_paths[i]);
+        }
+    }
+    rmdir(g_dir);
+}
+
+static int create_files(void) {
+    if (!mkdtemp(g_dir)) {
+        perror("mkdtemp");
+        return -1;
+    }
+    g_keys = calloc((size_t)g_opt.keys, sizeof(*g_keys));
+    g_paths = calloc((size_t)g_opt.keys, sizeof(char*));
+    g_sizes = calloc((size_t)g_opt.keys, sizeof(size_t));
+    g_cdf = calloc((size_t)g_opt.keys, sizeof(double));
+    if (!g_keys || !g_paths || !g_sizes || !g_cdf) {
+        return -1;
+    }
+    if (draw_sizes(g_opt.dist) < 0) {
+        fprintf(stderr, "Error: bad size distribution '%s'\n", g_opt.dist);
+        return -1;
+    }
+
+    char block[65536];
+    memset(block, 'x', sizeof(block));
+    for (int i = 0; i < g_opt.keys; i++) {
+        snprintf(g_keys[i], MAX_KEY_LEN, "/k%d", i);
+        if (asprintf(&g_paths[i], "%s/k%d", g_dir, i) < 0) {
+            g_paths[i] = NULL;
+            return -1;
+        }
+        int fd = open(g_paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror(g_paths[i]);
+            return -1;
+        }
+        for (size_t left = g_sizes[i]; left > 0;) {
+            size_t n = left < sizeof(block) ? left : sizeof(block);
+            ssize_t w = write(fd, block, n);
+            if (w <= 0) {
+                perror("write");
+                close(fd);
+                return -1;
+            }
+            left -= (size_t)w;
+        }
+        close(fd);
+    }
+
+    // Zipf: rank r (1-based) has weight 1 / r^s
+    double total = 0;
+    for (int i = 0; i < g_opt.keys; i++) {
+        total += 1.0 / pow((double)(i + 1), g_opt.zipf);
+        g_cdf[i] = total;
+    }
+    for (int i = 0; i < g_opt.keys; i++) {
+        g_cdf[i] /= total;
+    }
+    return 0;
+}
+
+// ###############################################################################################################
+// Runs
+// ###############################################################################################################
+
+static void* bench_thread(void* arg) {
+    bench_thread_t* t = arg;
+    cache_handle_t h;
+
+    pthread_barrier_wait(t->start);
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        int k = pick_key(&t->rng);
+        long long t0 = now_ns();
+        if (cache_acquire(t->cache, g_keys[k], &h)) {
+            t->hits++;
+        } else if (!cache_load_file(t->cache, g_keys[k], g_paths[k], &h)) {
+            t->load_errors++;
+            continue;
+        }
+        cache_release(t->cache, &h);
+        hist_record(&t->hist, now_ns() - t0);
+        t->ops++;
+    }
+    return NULL;
+}
+
+static int run(int threads, run_result_t* r) {
+    file_cache_t* cache = cache_create(g_opt.capacity);
+    if (!cache) {
+        fprintf(stderr, "Error: cache_create failed\n");
+        return -1;
+    }
+
+    // Steady state: the hottest keys end up most recently used
+    cache_handle_t h;
+    for (int k = g_opt.keys - 1; k >= 0; k--) {
+        if (cache_load_file(cache, g_keys[k], g_paths[k], &h)) {
+            cache_release(cache, &h);
+        }
+    }
+    size_t ev0;
+    unsigned long acq0, cont0, wait0;
+    cache_stats(cache, NULL, NULL, NULL, NULL, NULL, &ev0);
+    cache_lock_stats(cache, &acq0, &cont0, &wait0);
+
+    bench_thread_t* ts = calloc((size_t)threads, sizeof(bench_thread_t));
+    pthread_barrier_t start;
+    if (!ts || pthread_barrier_init(&start, NULL, (unsigned)threads + 1) != 0) {
+        free(ts);
+        cache_destroy(cache);
+        return -1;
+    }
+    atomic_store(&g_stop, 0);
+    for (int i = 0; i < threads; i++) {
+        ts[i].id = i;
+        ts[i].cache = cache;
+        ts[i].start = &start;
+        ts[i].rng = 0x2545F4914F6CDD1DULL * (unsigned long long)(i + 1);
+        hist_init(&ts[i].hist);
+        if (pthread_create(&ts[i].tid, NULL, bench_thread, &ts[i]) != 0) {
+            fprintf(stderr, "Error: pthread_create failed at %d threads\n", i);
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start);
+    long long t0 = now_ns();
+    struct timespec d = { g_opt.duration, 0 };
+    nanosleep(&d, NULL);
+    atomic_store(&g_stop, 1);
+
+    hist_t all;
+    hist_init(&all);
+    memset(r, 0, sizeof(*r));
+    unsigned long long hits = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ts[i].tid, NULL);
+        hist_merge(&all, &ts[i].hist);
+        r->ops += ts[i].ops;
+        r->load_errors += ts[i].load_errors;
+        hits += ts[i].hits;
+    }
+    long long elapsed = now_ns() - t0;
+
+    size_t ev1;
+    unsigned long acq1, cont1, wait1;
+    cache_stats(cache, NULL, NULL, NULL, NULL, NULL, &ev1);
+    cache_lock_stats(cache, &acq1, &cont1, &wait1);
+
+    r->threads = threads;
+    r->seconds = (double)elapsed / 1e9;
+    r->ops_per_sec = (double)r->ops / r->seconds;
+    r->p50_ns = hist_percentile(&all, 50.0);
+    r->p99_ns = hist_percentile(&all, 99.0);
+    r->max_ns = (all.max < 0) ? 0 : all.max;
+    r->hit_ratio = r->ops ? (double)hits / (double)r->ops : 0.0;
+    r->evictions = (unsigned long)(ev1 - ev0);
+    r->lock_acquisitions = acq1 - acq0;
+    r->lock_contended = cont1 - cont0;
+    r->lock_wait_ns = wait1 - wait0;
+
+    pthread_barrier_destroy(&start);
+    free(ts);
+    cache_destroy(cache);
+    return 0;
+}
+
+static void print_header(FILE* out) {
+    fprintf(out, "%7s %12s %9s %9s %9s %7s %10s %9s %12s\n", "threads", "ops/s", "p50(ns)", "p99(ns)", "max(us)",
+           "hit%", "evictions", "contend%", "wait/op(ns)");
+}
+
+static void print_run(FILE* out, const run_result_t* r) {
+    double contended = r->lock_acquisitions ? 100.0 * (double)r->lock_contended / (double)r->lock_acquisitions : 0;
+    double wait_per_op = r->ops ? (double)r->lock_wait_ns / (double)r->ops : 0;
+    fprintf(out, "%7d %12.0f %9lld %9lld %9lld %7.2f %10lu %9.2f %12.1f\n", r->threads, r->ops_per_sec, r->p50_ns,
+           r->p99_ns, r->max_ns / 1000, 100.0 * r->hit_ratio, r->evictions, contended, wait_per_op);
+}
+
+static int write_json(const char* file, const run_result_t* runs, int n) {
+    FILE* fp = (strcmp(file, "-") == 0) ? stdout : fopen(file, "w");
+    if (!fp) {
+        perror(file);
+        return -1;
+    }
+    fprintf(fp, "{\n  \"config\": {\"keys\": %d, \"sizes\": \"%s\", \"working_set_bytes\": %zu, "
+                "\"capacity_bytes\": %zu, \"zipf\": %.3f, \"duration_s\": %d},\n  \"runs\": [\n",
+            g_opt.keys, g_opt.dist, g_working_set, g_opt.capacity, g_opt.zipf, g_opt.duration);
+    for (int i = 0; i < n; i++) {
+        const run_result_t* r = &runs[i];
+        fprintf(fp, "    {\"threads\": %d, \"seconds\": %.3f, \"ops\": %llu, \"ops_per_sec\": %.1f, "
+                    "\"p50_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld, \"hit_ratio\": %.4f, "
+                    "\"evictions\": %lu, \"lock_acquisitions\": %lu, \"lock_contended\": %lu, "
+                    "\"lock_wait_ns\": %lu, \"load_errors\": %llu}%s\n",
+                r->threads, r->seconds, r->ops, r->ops_per_sec, r->p50_ns, r->p99_ns, r->max_ns, r->hit_ratio,
+                r->evictions, r->lock_acquisitions, r->lock_contended, r->lock_wait_ns, r->load_errors,
+                (i + 1 < n) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-t threads,...] [-k keys] [-s fixed:N|uniform:MIN-MAX|lognormal:MEDIAN] "
+                    "[-z zipf] [-c MB] [-d seconds] [-j file]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    int thread_counts[MAX_RUNS] = { 1, 2, 4, 8, 16, 32, 64 };
+    int num_runs = 7;
+    double capacity_mb = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:k:s:z:c:d:j:")) != -1) {
+        switch (opt) {
+        case 't': {
+            num_runs = 0;
+            char* save = NULL;
+            for (char* tok = strtok_r(optarg, ",", &save); tok && num_runs < MAX_RUNS;
+                 tok = strtok_r(NULL, ",", &save)) {
+                thread_counts[num_runs++] = atoi(tok);
+            }
+            break;
+        }
+        case 'k':
+            g_opt.keys = atoi(optarg);
+            break;
+        case 's':
+            snprintf(g_opt.dist, sizeof(g_opt.dist), "%s", optarg);
+            break;
+        case 'z':
+            g_opt.zipf = atof(optarg);
+            break;
+        case 'c':
+            capacity_mb = atof(optarg);
+            break;
+        case 'd':
+            g_opt.duration = atoi(optarg);
+            break;
+        case 'j':
+            g_opt.json = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (int i = 0; i < num_runs; i++) {
+        if (thread_counts[i] < 1) {
+            fprintf(stderr, "Error: thread counts must be positive\n");
+            return 1;
+        }
+    }
+    if (num_runs == 0 || g_opt.keys < 1 || g_opt.duration < 1 || g_opt.zipf < 0 || capacity_mb < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (create_files() < 0) {
+        remove_files();
+        return 1;
+    }
+    g_opt.capacity = (capacity_mb > 0) ? (size_t)(capacity_mb * 1024 * 1024) : g_working_set / 4;
+    if (g_opt.capacity == 0) {
+        g_opt.capacity = 1;
+    }
+
+    // With -j - the table goes to stderr so stdout stays valid JSON
+    FILE* out = (g_opt.json && strcmp(g_opt.json, "-") == 0) ? stderr : stdout;
+    fprintf(out, "keys: %d, sizes: %s, working set: %.1f MB, capacity: %.1f MB, zipf: %.2f, %d s per run, "
+                 "CPUs online: %ld\n", g_opt.keys, g_opt.dist, (double)g_working_set / 1048576.0,
+            (double)g_opt.capacity / 1048576.0, g_opt.zipf, g_opt.duration, sysconf(_SC_NPROCESSORS_ONLN));
+    print_header(out);
+
+    run_result_t runs[MAX_RUNS];
+    int done = 0;
+    for (int i = 0; i < num_runs; i++) {
+        if (run(thread_counts[i], &runs[done]) < 0) {
+            break;
+        }
+        print_run(out, &runs[done]);
+        fflush(out);
+        done++;
+    }
+
+    remove_files();
+    if (g_opt.json) {
+        write_json(g_opt.json, runs, done);
+    }
+    return (done == num_runs) ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/awk -f
+# Renders folded stacks ("root;caller;leaf count" per line) as a flame graph SVG.
+#
+# Usage: sort stacks.folded | awk -f bench/flamegraph.awk -v title="worker0" > worker0.svg
+#
+# Input must be sorted so that stacks sharing a prefix are adjacent. Frame width is proportional to the
+# samples below it; hover a frame for its name, sample count and share. Frames narrower than minwidth
+# pixels are left out.
+
+BEGIN {
+    if (width == "") width = 1200
+    if (minwidth == "") minwidth = 0.3
+    if (title == "") title = "Flame Graph"
+    frameh = 16
+    pad = 10
+    top = 40
+    depth = 0
+    total = 0
+    nrect = 0
+    maxdepth = 0
+}
+
+function xml(s) {
+    gsub(/&/, "\\&amp;", s)
+    gsub(/</, "\\&lt;", s)
+    gsub(/>/, "\\&gt;", s)
+    gsub(/"/, "\\&quot;", s)
+    return s
+}
+
+# Close the open frames from depth d up
+function close_from(d, at,    i) {
+    for (i = depth; i >= d; i--) {
+        nrect++
+        rname[nrect] = open_name[i]
+        rdepth[nrect] = i
+        rstart[nrect] = open_start[i]
+        rend[nrect] = at
+        if (i > maxdepth) maxdepth = i
+    }
+    depth = d - 1
+}
+
+{
+    count = $NF
+    stack = $0
+    sub(/[ \t]+[0-9]+[ \t]*$/, "", stack)
+    if (count !~ /^[0-9]+$/ || stack == "") next
+
+    n = split(stack, f, ";")
+    same = 0
+    while (same < n && same < depth && f[same + 1] == open_name[same + 1]) same++
+    if (same < depth) close_from(same + 1, total)
+    for (i = same + 1; i <= n; i++) {
+        open_name[i] = f[i]
+        open_start[i] = total
+    }
+    depth = n
+    total += count
+}
+
+END {
+    if (depth > 0) close_from(1, total)
+    if (total == 0) {
+        print "flamegraph.awk: no samples" > "/dev/stderr"
+        exit 1
+    }
+
+    height = top + (maxdepth + 1) * frameh + pad
+    scale = (width - 2 * pad) / total
+    printf "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+    printf "<svg version=\"1.1\" width=\"%d\" height=\"%d\" xmlns=\"http://www.w3.org/2000/svg\" " \
+           "font-family=\"Verdana, sans-serif\" font-size=\"12\">\n", width, height
+    printf "<rect x=\"0\" y=\"0\" width=\"100%%\" height=\"100%%\" fill=\"#f8f8f0\"/>\n"
+    printf "<text x=\"%d\" y=\"24\" text-anchor=\"middle\" font-size=\"17\">%s</text>\n", width / 2, xml(title)
+    printf "<text x=\"%d\" y=\"24\" text-anchor=\"end\" fill=\"#666\">%d samples</text>\n", width - pad, total
+
+    # Root frame spanning every sample
+    nrect++
+    rname[nrect] = "all"
+    rdepth[nrect] = 0
+    rstart[nrect] = 0
+    rend[nrect] = total
+
+    for (r = 1; r <= nrect; r++) {
+        w = (rend[r] - rstart[r]) * scale
+        if (w < minwidth) continue
+        x = pad + rstart[r] * scale
+        y = height - pad - (rdepth[r] + 1) * frameh
+        name = rname[r]
+
+        # Warm colours, stable per function name
+        h = 0
+        for (i = 1; i <= length(name) && i <= 24; i++) h = (h * 31 + index("abcdefghijklmnopqrstuvwxyz_0123456789", tolower(substr(name, i, 1)))) % 1000
+        red = 205 + h % 50
+        green = 80 + int(h / 4) % 150
+        blue = 40 + h % 40
+        samples = rend[r] - rstart[r]
+
+        printf "<g><title>%s (%d samples, %.2f%%)</title>", xml(name), samples, 100 * samples / total
+        printf "<rect x=\"%.1f\" y=\"%d\" width=\"%.1f\" height=\"%d\" fill=\"rgb(%d,%d,%d)\" rx=\"2\"/>",
+               x, y, w, frameh - 1, red, green, blue
+        chars = int((w - 6) / 7)
+        if (chars >= 3) {
+            label = name
+            if (length(label) > chars) label = substr(label, 1, chars - 2) ".."
+            printf "<text x=\"%.1f\" y=\"%d\">%s</text>", x + 3, y + 12, xml(label)
+        }
+        printf "</g>\n"
+    }
+    printf "</svg>\n"
+}
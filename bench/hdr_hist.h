@@ -0,0 +1,99 @@
+#ifndef HDR_HIST_H
+#define HDR_HIST_H
+
+#include <math.h>
+#include <string.h>
+
+// HDR-style latency histogram shared by the benchmarks: exact below 128, then 64 linear sub-buckets per
+// power of two (~1.6% precision) up to 2^40. The unit is up to the caller (loadgen: us, cache_bench: ns).
+// Not thread-safe: keep one per thread and hist_merge() them.
+
+#define HIST_SUB 64 // Linear sub-buckets per power of two
+#define HIST_DIRECT 128 // Values below this are exact
+#define HIST_MAX_MSB 40 // Values up to 2^40
+#define HIST_SIZE (HIST_DIRECT + (HIST_MAX_MSB - 6) * HIST_SUB)
+
+typedef struct {
+    unsigned long long counts[HIST_SIZE];
+    unsigned long long total;
+    long long min;
+    long long max;
+    double sum;
+} hist_t;
+
+static inline void hist_init(hist_t* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = -1;
+}
+
+static inline int hist_index(long long v) {
+    if (v < HIST_DIRECT) {
+        return (v < 0) ? 0 : (int)v;
+    }
+    int msb = 63 - __builtin_clzll((unsigned long long)v);
+    if (msb > HIST_MAX_MSB) {
+        return HIST_SIZE - 1;
+    }
+    int shift = msb - 6;
+    int sub = (int)(v >> shift) - HIST_SUB;
+    return HIST_DIRECT + (msb - 7) * HIST_SUB + sub;
+}
+
+// Highest value that maps to bucket idx
+static inline long long hist_value(int idx) {
+    if (idx < HIST_DIRECT) {
+        return idx;
+    }
+    int k = idx - HIST_DIRECT;
+    int msb = 7 + k / HIST_SUB;
+    int shift = msb - 6;
+    long long low = (long long)(HIST_SUB + k % HIST_SUB) << shift;
+    return low + (1LL << shift) - 1;
+}
+
+static inline void hist_record(hist_t* h, long long v) {
+    h->counts[hist_index(v)]++;
+    h->total++;
+    h->sum += (double)v;
+    if (h->min < 0 || v < h->min) {
+        h->min = v;
+    }
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+static inline void hist_merge(hist_t* dst, const hist_t* src) {
+    for (int i = 0; i < HIST_SIZE; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->total && (dst->min < 0 || src->min < dst->min)) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+static inline long long hist_percentile(const hist_t* h, double p) {
+    if (h->total == 0) {
+        return 0;
+    }
+    unsigned long long rank = (unsigned long long)ceil(p / 100.0 * (double)h->total);
+    if (rank == 0) {
+        rank = 1;
+    }
+    unsigned long long seen = 0;
+    for (int i = 0; i < HIST_SIZE; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            long long v = hist_value(i);
+            return (v > h->max) ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+#endif // HDR_HIST_H
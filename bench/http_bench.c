@@ -0,0 +1,331 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "http_parser.h"
+#include "http_builder.h"
+
+// HTTP parser and response builder microbenchmark
+//
+// Usage: http_bench [-c corpus_dir] [-n parse_iterations] [-b build_iterations] [-s body_size] [-j file]
+//
+// Every file of the corpus (default bench/corpus/http) is one raw request. For each one it reports:
+//   parse    parse_http_request() on the raw bytes
+//   build    the response path of a cached file: mime_type_from_path() and send_content() (200, 206, 416
+//            or headers only for HEAD, depending on the request) with a body of -s bytes (default 4096)
+// plus the 404 error page (send_error_response()). Responses are written to one end of a socketpair and
+// drained from the other outside the timed region. The status column is the response status (parse: 0 =
+// accepted, 400 = rejected). Results are ns and user-space instructions per call; instructions need
+// perf_event_open() (kernel.perf_event_paranoid <= 2) and show "-" without it.
+
+#define MAX_CASES 256
+#define MAX_REQUEST 16384
+#define DRAIN_BUF 65536
+
+typedef struct {
+    char name[64];
+    char* raw; // NUL-terminated request
+    size_t len;
+} corpus_case_t;
+
+typedef struct {
+    const char* name;
+    const char* kind;
+    int status;
+    double ns;
+    double instructions; // < 0: not available
+} result_t;
+
+static corpus_case_t g_cases[MAX_CASES];
+static int g_num_cases;
+static int g_perf_fd = -1;
+static int g_out[2]; // [0] written by the builder, [1] drained
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// User-space instruction counter of this thread, disabled until counter_start()
+static void counter_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    g_perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counter_start(void) {
+    if (g_perf_fd >= 0) {
+        ioctl(g_perf_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(g_perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+// Instructions since counter_start() (-1 without a counter)
+static long long counter_stop(void) {
+    long long count = -1;
+    if (g_perf_fd >= 0) {
+        ioctl(g_perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(g_perf_fd, &count, sizeof(count)) != sizeof(count)) {
+            count = -1;
+        }
+    }
+    return count;
+}
+
+static void drain(void) {
+    static char buf[DRAIN_BUF];
+    while (recv(g_out[1], buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+    }
+}
+
+static int case_cmp(const void* a, const void* b) {
+    return strcmp(((const corpus_case_t*)a)->name, ((const corpus_case_t*)b)->name);
+}
+
+static int load_corpus(const char* dir) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return -1;
+    }
+    struct dirent* de;
+    while ((de = readdir(d)) && g_num_cases < MAX_CASES) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        FILE* fp = fopen(path, "rb");
+        if (!fp) {
+            continue;
+        }
+        corpus_case_t* c = &g_cases[g_num_cases];
+        c->raw = malloc(MAX_REQUEST + 1);
+        c->len = c->raw ? fread(c->raw, 1, MAX_REQUEST, fp) : 0;
+        fclose(fp);
+        if (c->len == 0) {
+            free(c->raw);
+            continue;
+        }
+        c->raw[c->len] = '\0';
+        snprintf(c->name, sizeof(c->name), "%.*s", (int)strcspn(de->d_name, "."), de->d_name);
+        g_num_cases++;
+    }
+    closedir(d);
+    qsort(g_cases, (size_t)g_num_cases, sizeof(corpus_case_t), case_cmp);
+    return g_num_cases > 0 ? 0 : -1;
+}
+
+static result_t bench_parse(const corpus_case_t* c, long iters) {
+    http_request_t req;
+    result_t r = { c->name, "parse", 0, 0, -1 };
+
+    r.status = (parse_http_request(c->raw, &req) == 0) ? 0 : 400;
+    long long t0 = now_ns();
+    counter_start();
+    for (long i = 0; i < iters; i++) {
+        parse_http_request(c->raw, &req);
+        __asm__ volatile("" ::: "memory");
+    }
+    long long instr = counter_stop();
+    r.ns = (double)(now_ns() - t0) / (double)iters;
+    if (instr >= 0) {
+        r.instructions = (double)instr / (double)iters;
+    }
+    return r;
+}
+
+// Builder timings exclude the drain, so every call is timed on its own
+static result_t bench_build(const corpus_case_t* c, const char* body, size_t body_size, long iters) {
+    http_request_t req;
+    result_t r = { c->name, "build", 0, 0, -1 };
+    if (parse_http_request(c->raw, &req) != 0) {
+        r.status = 400;
+        return r;
+    }
+    int is_head = (strcmp(req.method, "HEAD") == 0);
+
+    long long total_ns = 0, total_instr = 0;
+    for (long i = 0; i < iters; i++) {
+        int status = 0, bytes = 0;
+        long long t0 = now_ns();
+        counter_start();
+        const char* type = mime_type_from_path(req.path);
+        send_content(g_out[0], type, body, body_size, &req, 0, is_head, &status, &bytes);
+        long long instr = counter_stop();
+        total_ns += now_ns() - t0;
+        total_instr += instr;
+        r.status = status;
+        drain();
+    }
+    r.ns = (double)total_ns / (double)iters;
+    if (g_perf_fd >= 0) {
+        r.instructions = (double)total_instr / (double)iters;
+    }
+    return r;
+}
+
+static result_t bench_error_page(long iters) {
+    result_t r = { "error_404", "build", 404, 0, -1 };
+    long long total_ns = 0, total_instr = 0;
+    for (long i = 0; i < iters; i++) {
+        long long t0 = now_ns();
+        counter_start();
+        send_error_response(g_out[0], 404, "Not Found", 0);
+        long long instr = counter_stop();
+        total_ns += now_ns() - t0;
+        total_instr += instr;
+        drain();
+    }
+    r.ns = (double)total_ns / (double)iters;
+    if (g_perf_fd >= 0) {
+        r.instructions = (double)total_instr / (double)iters;
+    }
+    return r;
+}
+
+static void print_result(const result_t* r) {
+    char instr[32] = "-";
+    if (r->instructions >= 0) {
+        snprintf(instr, sizeof(instr), "%.0f", r->instructions);
+    }
+    printf("%-20s %-6s %6d %10.1f %12s\n", r->name, r->kind, r->status, r->ns, instr);
+}
+
+static int write_json(const char* file, const result_t* res, int n, size_t body_size) {
+    FILE* fp = (strcmp(file, "-") == 0) ? stdout : fopen(file, "w");
+    if (!fp) {
+        perror(file);
+        return -1;
+    }
+    fprintf(fp, "{\n  \"body_size\": %zu,\n  \"instructions_available\": %s,\n  \"results\": [\n", body_size,
+            g_perf_fd >= 0 ? "true" : "false");
+    for (int i = 0; i < n; i++) {
+        fprintf(fp, "    {\"case\": \"%s\", \"kind\": \"%s\", \"status\": %d, \"ns\": %.1f", res[i].name, res[i].kind,
+                res[i].status, res[i].ns);
+        if (res[i].instructions >= 0) {
+            fprintf(fp, ", \"instructions\": %.1f", res[i].instructions);
+        }
+        fprintf(fp, "}%s\n", (i + 1 < n) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* corpus = "bench/corpus/http";
+    const char* json = NULL;
+    long parse_iters = 200000;
+    long build_iters = 20000;
+    size_t body_size = 4096;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:b:s:j:")) != -1) {
+        switch (opt) {
+        case 'c':
+            corpus = optarg;
+            break;
+        case 'n':
+            parse_iters = atol(optarg);
+            break;
+        case 'b':
+            build_iters = atol(optarg);
+            break;
+        case 's':
+            body_size = (size_t)atol(optarg);
+            break;
+        case 'j':
+            json = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-c corpus_dir] [-n parse_iterations] [-b build_iterations] "
+                            "[-s body_size] [-j file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (parse_iters < 1 || build_iters < 1 || body_size < 1) {
+        fprintf(stderr, "Error: iterations and body size must be positive\n");
+        return 1;
+    }
+    if (load_corpus(corpus) < 0) {
+        fprintf(stderr, "Error: no requests in %s\n", corpus);
+        return 1;
+    }
+
+    // Large enough for one response, so a send never blocks between drains
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, g_out) < 0) {
+        perror("socketpair");
+        return 1;
+    }
+    int sndbuf = (int)body_size + 65536;
+    setsockopt(g_out[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    setsockopt(g_out[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof(sndbuf));
+
+    char* body = malloc(body_size);
+    if (!body) {
+        return 1;
+    }
+    memset(body, 'x', body_size);
+
+    counter_open();
+    if (g_perf_fd < 0) {
+        fprintf(stderr, "Note: instruction counter unavailable (%s)\n", strerror(errno));
+    }
+
+    result_t results[2 * MAX_CASES + 1];
+    int n = 0;
+    FILE* table = stdout;
+    if (json && strcmp(json, "-") == 0) {
+        table = NULL; // stdout carries the JSON
+    }
+    if (table) {
+        printf("%-20s %-6s %6s %10s %12s\n", "case", "kind", "status", "ns/call", "instr/call");
+    }
+    for (int i = 0; i < g_num_cases; i++) {
+        results[n] = bench_parse(&g_cases[i], parse_iters);
+        if (table) {
+            print_result(&results[n]);
+        }
+        n++;
+        results[n] = bench_build(&g_cases[i], body, body_size, build_iters);
+        if (results[n].status == 400) {
+            continue; // Rejected by the parser: nothing to build
+        }
+        if (table) {
+            print_result(&results[n]);
+        }
+        n++;
+    }
+    results[n] = bench_error_page(build_iters);
+    if (table) {
+        print_result(&results[n]);
+    }
+    n++;
+
+    if (json) {
+        write_json(json, results, n, body_size);
+    }
+    free(body);
+    for (int i = 0; i < g_num_cases; i++) {
+        free(g_cases[i].raw);
+    }
+    return 0;
+}
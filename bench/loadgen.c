@@ -0,0 +1,772 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "hdr_hist.h"
+
+// HTTP load generator
+//
+// Usage: loadgen [options]
+//   -H host       server address (default 127.0.0.1)
+//   -p port       server port (default 8080)
+//   -U path       connect to the server's Unix-domain socket instead (LISTEN=unix:path); -H still names
+//                 the Host header. Leaves the loopback TCP stack out of the measurement
+//   -t threads    generator threads, each with its own epoll loop (default 2)
+//   -c conns      connections in total (default 16)
+//   -d seconds    test duration (default 10)
+//   -R rate       open loop: requests per second in total, sent on schedule whatever the latency
+//                 (default 0: closed loop, every connection keeps -P requests outstanding)
+//   -P depth      requests pipelined per connection (default 1)
+//   -K            ask for Connection: close instead of keep-alive
+//   -u path       request this path (default /)
+//   -f file       replay the paths in file (one per line, most popular first)
+//   -z s          Zipf exponent for -f popularity (default 1.0; 0 = uniform)
+//   -j file       write the results as JSON to file ("-" = stdout)
+//
+// Latency is recorded in an HDR-style histogram (64 linear sub-buckets per power of two, ~1.6%
+// precision). In open-loop mode it is measured from the time the request was scheduled, not from when
+// it could be sent, so a stalled server shows up in the percentiles (no coordinated omission).
+// Requests still in flight when the server closes a connection (it answers Connection: close, or
+// pipelined requests after such a response) are sent again on a new connection and counted as "resent".
+
+#define MAX_PIPELINE 64
+#define OUT_BUF 16384 // Pending request bytes per connection
+#define IN_BUF 16384 // Response header buffer per connection
+#define MAX_PATH_LEN 1024
+#define BACKLOG_MAX (1 << 20) // Open loop: scheduled requests waiting for a free connection, per thread
+#define RECONNECT_DELAY_NS 10000000LL // After a failed connect
+
+// ###############################################################################################################
+// Options, URL popularity
+// ###############################################################################################################
+
+typedef struct {
+    const char* host;
+    int port;
+    int threads;
+    int conns;
+    int duration;
+    double rate;
+    int pipeline;
+    int keep_alive;
+    const char* path;
+    const char* url_file;
+    double zipf;
+    const char* json;
+    const char* unix_path;
+} options_t;
+
+static options_t g_opt = { "127.0.0.1", 8080, 2, 16, 10, 0.0, 1, 1, "/", NULL, 1.0, NULL, NULL };
+static struct sockaddr_storage g_addr;
+static socklen_t g_addr_len;
+
+static char** g_paths; // Request paths, most popular first
+static double* g_cdf; // Cumulative popularity of g_paths
+static int g_num_paths;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// xorshift64*: per-thread, cheap
+static double rand_unit(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (double)((x * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static int load_paths(const char* file, double s) {
+    FILE* fp = fopen(file, "r");
+    if (!fp) {
+        perror(file);
+        return -1;
+    }
+
+    char line[MAX_PATH_LEN + 2];
+    int cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (g_num_paths == cap) {
+            cap = cap ? cap * 2 : 64;
+            g_paths = realloc(g_paths, (size_t)cap * sizeof(char*));
+            if (!g_paths) {
+                fclose(fp);
+                return -1;
+            }
+        }
+        g_paths[g_num_paths++] = strdup(line);
+    }
+    fclose(fp);
+
+    if (g_num_paths == 0) {
+        fprintf(stderr, "Error: %s has no paths\n", file);
+        return -1;
+    }
+
+    // Zipf: rank r (1-based) has weight 1 / r^s
+    g_cdf = malloc((size_t)g_num_paths * sizeof(double));
+    if (!g_cdf) {
+        return -1;
+    }
+    double total = 0;
+    for (int i = 0; i < g_num_paths; i++) {
+        total += 1.0 / pow((double)(i + 1), s);
+        g_cdf[i] = total;
+    }
+    for (int i = 0; i < g_num_paths; i++) {
+        g_cdf[i] /= total;
+    }
+    return 0;
+}
+
+static const char* pick_path(unsigned long long* rng) {
+    if (g_num_paths == 0) {
+        return g_opt.path;
+    }
+    double u = rand_unit(rng);
+    int lo = 0, hi = g_num_paths - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g_cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return g_paths[lo];
+}
+
+// ###############################################################################################################
+// Connections
+// ###############################################################################################################
+
+typedef struct {
+    int fd; // -1 = not open
+    int connecting; // Non-blocking connect in progress
+    long long retry_at; // Do not reconnect before this time (after a failure)
+
+    char out[OUT_BUF]; // Requests not yet written
+    size_t out_len;
+    size_t out_off;
+
+    long long starts[MAX_PIPELINE]; // Start time of each request in flight (oldest first)
+    int inflight;
+
+    char in[IN_BUF]; // Response header being received
+    size_t in_len;
+    int in_body; // Header parsed, skipping the body
+    long long body_left;
+    int status;
+    int close_after; // Server said Connection: close
+} conn_t;
+
+typedef struct {
+    int id;
+    int num_conns;
+    conn_t* conns;
+    int epfd;
+    unsigned long long rng;
+
+    // Open loop
+    double interval_ns; // Between scheduled requests of this thread
+    long long* backlog; // Scheduled start times waiting for a connection (ring)
+    size_t bl_head;
+    size_t bl_count;
+
+    // Results
+    hist_t hist;
+    unsigned long long completed;
+    unsigned long long status_class[6]; // [1..5] = 1xx..5xx
+    unsigned long long bytes;
+    unsigned long long connects;
+    unsigned long long connect_errors;
+    unsigned long long io_errors;
+    unsigned long long parse_errors;
+    unsigned long long resent;
+    unsigned long long backlog_overflow;
+    unsigned long long unfinished; // Still in flight or scheduled at the end
+} worker_t;
+
+static void backlog_push(worker_t* w, long long start) {
+    if (w->bl_count == BACKLOG_MAX) {
+        w->backlog_overflow++;
+        return;
+    }
+    w->backlog[(w->bl_head + w->bl_count) % BACKLOG_MAX] = start;
+    w->bl_count++;
+}
+
+static long long backlog_pop(worker_t* w) {
+    long long v = w->backlog[w->bl_head];
+    w->bl_head = (w->bl_head + 1) % BACKLOG_MAX;
+    w->bl_count--;
+    return v;
+}
+
+// Push a request back to the front (resend with its original start time)
+static void backlog_unshift(worker_t* w, long long start) {
+    if (w->bl_count == BACKLOG_MAX) {
+        w->backlog_overflow++;
+        return;
+    }
+    w->bl_head = (w->bl_head + BACKLOG_MAX - 1) % BACKLOG_MAX;
+    w->backlog[w->bl_head] = start;
+    w->bl_count++;
+}
+
+static void conn_update_events(worker_t* w, conn_t* c) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | ((c->connecting || c->out_off < c->out_len) ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void conn_open(worker_t* w, conn_t* c, long long now) {
+    c->out_len = c->out_off = 0;
+    c->in_len = 0;
+    c->in_body = 0;
+    c->inflight = 0;
+    c->close_after = 0;
+
+    c->fd = socket(g_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) {
+        w->connect_errors++;
+        c->retry_at = now + RECONNECT_DELAY_NS;
+        return;
+    }
+    if (g_addr.ss_family != AF_UNIX) {
+        int one = 1;
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    w->connects++;
+    c->connecting = 1;
+    if (connect(c->fd, (struct sockaddr*)&g_addr, g_addr_len) == 0) {
+        c->connecting = 0;
+    } else if (errno != EINPROGRESS) {
+        w->connect_errors++;
+        close(c->fd);
+        c->fd = -1;
+        c->retry_at = now + RECONNECT_DELAY_NS;
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = c;
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+// Close a connection; its requests in flight are resent (open loop: with their original start time)
+static void conn_close(worker_t* w, conn_t* c, long long now) {
+    if (c->fd >= 0) {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        c->fd = -1;
+    }
+    if (g_opt.rate > 0) {
+        for (int i = c->inflight - 1; i >= 0; i--) {
+            backlog_unshift(w, c->starts[i]);
+        }
+    }
+    w->resent += (unsigned long long)c->inflight;
+    c->inflight = 0;
+    c->out_len = c->out_off = 0;
+    c->retry_at = now;
+}
+
+static int conn_issue(worker_t* w, conn_t* c, long long start) {
+    const char* path = pick_path(&w->rng);
+    size_t room = sizeof(c->out) - c->out_len;
+    int n = snprintf(c->out + c->out_len, room,
+                     "GET %s HTTP/1.1\r\nHost: %s:%d\r\nConnection: %s\r\n\r\n",
+                     path, g_opt.host, g_opt.port, g_opt.keep_alive ? "keep-alive" : "close");
+    if (n < 0 || (size_t)n >= room) {
+        return -1;
+    }
+    c->out_len += (size_t)n;
+    c->starts[c->inflight++] = start;
+    return 0;
+}
+
+static void conn_flush(worker_t* w, conn_t* c, long long now) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            w->io_errors++;
+            conn_close(w, c, now);
+            return;
+        }
+        c->out_off += (size_t)n;
+    }
+    if (c->out_off == c->out_len) {
+        c->out_off = c->out_len = 0;
+    }
+    conn_update_events(w, c);
+}
+
+// A full response arrived for the oldest request in flight
+static void response_done(worker_t* w, conn_t* c, long long now) {
+    long long start = c->starts[0];
+    memmove(c->starts, c->starts + 1, (size_t)(c->inflight - 1) * sizeof(long long));
+    c->inflight--;
+
+    hist_record(&w->hist, (now - start) / 1000);
+    w->completed++;
+    int cls = c->status / 100;
+    if (cls >= 1 && cls <= 5) {
+        w->status_class[cls]++;
+    }
+}
+
+// Parse one response header at the start of c->in. Returns its length, 0 if incomplete, -1 if invalid.
+static int parse_header(conn_t* c) {
+    char* end = memmem(c->in, c->in_len, "\r\n\r\n", 4);
+    if (!end) {
+        return (c->in_len == sizeof(c->in)) ? -1 : 0;
+    }
+    size_t hlen = (size_t)(end - c->in) + 4;
+
+    if (c->in_len < 12 || strncmp(c->in, "HTTP/1.", 7) != 0) {
+        return -1;
+    }
+    c->status = atoi(c->in + 9);
+    c->body_left = 0;
+    c->close_after = 0;
+
+    // Walk the header lines for Content-Length and Connection
+    char* line = memchr(c->in, '\n', hlen) + 1;
+    while (line < c->in + hlen - 2) {
+        char* eol = memchr(line, '\n', (size_t)(c->in + hlen - line));
+        if (!eol) {
+            break;
+        }
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            c->body_left = atoll(line + 15);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            char* v = line + 11;
+            while (*v == ' ') {
+                v++;
+            }
+            c->close_after = (strncasecmp(v, "close", 5) == 0);
+        }
+        line = eol + 1;
+    }
+    return (int)hlen;
+}
+
+static void conn_read(worker_t* w, conn_t* c, long long now) {
+    char buf[65536];
+
+    while (c->fd >= 0) {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            w->io_errors++;
+            conn_close(w, c, now);
+            return;
+        }
+        if (n == 0) {
+            // Closed by the server: anything still in flight goes out again
+            conn_close(w, c, now);
+            return;
+        }
+        w->bytes += (unsigned long long)n;
+
+        size_t off = 0;
+        while (off < (size_t)n && c->fd >= 0) {
+            if (c->in_body) {
+                long long take = (long long)n - (long long)off;
+                if (take > c->body_left) {
+                    take = c->body_left;
+                }
+                c->body_left -= take;
+                off += (size_t)take;
+            } else {
+                size_t room = sizeof(c->in) - c->in_len;
+                size_t take = (size_t)n - off;
+                if (take > room) {
+                    take = room;
+                }
+                memcpy(c->in + c->in_len, buf + off, take);
+                c->in_len += take;
+
+                int hlen = parse_header(c);
+                if (hlen < 0) {
+                    w->parse_errors++;
+                    conn_close(w, c, now);
+                    return;
+                }
+                if (hlen == 0) {
+                    off += take;
+                    continue;
+                }
+                // Bytes of this chunk past the header belong to the body (or the next response)
+                off += take - (c->in_len - (size_t)hlen);
+                c->in_len = 0;
+                c->in_body = 1;
+            }
+
+            if (c->in_body && c->body_left == 0) {
+                c->in_body = 0;
+                if (c->inflight == 0) {
+                    w->parse_errors++; // Response nobody asked for
+                    conn_close(w, c, now);
+                    return;
+                }
+                response_done(w, c, now);
+                if (c->close_after) {
+                    conn_close(w, c, now);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// Hand requests to connections with room in their pipeline
+static void dispatch(worker_t* w, long long now) {
+    for (int i = 0; i < w->num_conns; i++) {
+        conn_t* c = &w->conns[i];
+        if (c->fd < 0) {
+            if (now >= c->retry_at) {
+                conn_open(w, c, now);
+            }
+            if (c->fd < 0) {
+                continue;
+            }
+        }
+        int issued = 0;
+        while (c->inflight < g_opt.pipeline) {
+            if (g_opt.rate > 0) {
+                if (w->bl_count == 0) {
+                    break;
+                }
+                if (conn_issue(w, c, w->backlog[w->bl_head]) != 0) {
+                    break;
+                }
+                backlog_pop(w);
+            } else if (conn_issue(w, c, now) != 0) {
+                break;
+            }
+            issued = 1;
+        }
+        if (issued && !c->connecting) {
+            conn_flush(w, c, now);
+        }
+        if (g_opt.rate > 0 && w->bl_count == 0) {
+            break;
+        }
+    }
+}
+
+static void* worker_run(void* arg) {
+    worker_t* w = arg;
+    struct epoll_event events[256];
+
+    long long start = now_ns();
+    long long end = start + (long long)g_opt.duration * 1000000000LL;
+    double next_due = (double)start; // Open loop: next scheduled request
+
+    for (int i = 0; i < w->num_conns; i++) {
+        w->conns[i].fd = -1;
+        w->conns[i].retry_at = 0;
+    }
+
+    while (!g_stop) {
+        long long now = now_ns();
+        if (now >= end) {
+            break;
+        }
+
+        // Open loop: everything scheduled until now is due, whether or not a connection is free
+        if (g_opt.rate > 0) {
+            while (next_due <= (double)now) {
+                backlog_push(w, (long long)next_due);
+                next_due += w->interval_ns;
+            }
+        }
+
+        dispatch(w, now);
+
+        int timeout_ms = 100;
+        if (g_opt.rate > 0) {
+            long long wait = (long long)next_due - now_ns();
+            timeout_ms = (wait <= 0) ? 0 : (int)((wait + 999999) / 1000000);
+        }
+
+        int n = epoll_wait(w->epfd, events, 256, timeout_ms);
+        now = now_ns();
+        for (int i = 0; i < n; i++) {
+            conn_t* c = events[i].data.ptr;
+            if (c->fd < 0) {
+                continue;
+            }
+            if (c->connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) {
+                    w->connect_errors++;
+                    conn_close(w, c, now);
+                    c->retry_at = now + RECONNECT_DELAY_NS;
+                    continue;
+                }
+                c->connecting = 0;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                conn_read(w, c, now);
+            }
+            if (c->fd >= 0 && !c->connecting) {
+                conn_flush(w, c, now);
+            }
+        }
+    }
+
+    for (int i = 0; i < w->num_conns; i++) {
+        conn_t* c = &w->conns[i];
+        w->unfinished += (unsigned long long)c->inflight;
+        c->inflight = 0;
+        if (c->fd >= 0) {
+            close(c->fd);
+        }
+    }
+    w->unfinished += w->bl_count;
+    return NULL;
+}
+
+// ###############################################################################################################
+// Report
+// ###############################################################################################################
+
+static void write_json(FILE* fp, const worker_t* total, const hist_t* h, double elapsed) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"config\": {\"host\": \"%s\", \"port\": %d, \"unix\": \"%s\", \"threads\": %d, "
+                "\"connections\": %d, \"duration_s\": %d, \"mode\": \"%s\", \"rate\": %.1f, \"pipeline\": %d, "
+                "\"keep_alive\": %s, \"paths\": %d, \"zipf\": %.2f},\n",
+            g_opt.host, g_opt.port, g_opt.unix_path ? g_opt.unix_path : "", g_opt.threads, g_opt.conns, g_opt.duration,
+            g_opt.rate > 0 ? "open" : "closed", g_opt.rate, g_opt.pipeline, g_opt.keep_alive ? "true" : "false",
+            g_num_paths ? g_num_paths : 1, g_opt.zipf);
+    fprintf(fp, "  \"elapsed_s\": %.3f,\n", elapsed);
+    fprintf(fp, "  \"requests\": %llu,\n", total->completed);
+    fprintf(fp, "  \"throughput_rps\": %.1f,\n", elapsed > 0 ? (double)total->completed / elapsed : 0.0);
+    fprintf(fp, "  \"bytes_received\": %llu,\n", total->bytes);
+    fprintf(fp, "  \"status\": {\"1xx\": %llu, \"2xx\": %llu, \"3xx\": %llu, \"4xx\": %llu, \"5xx\": %llu},\n",
+            total->status_class[1], total->status_class[2], total->status_class[3],
+            total->status_class[4], total->status_class[5]);
+    fprintf(fp, "  \"connections_opened\": %llu,\n", total->connects);
+    fprintf(fp, "  \"errors\": {\"connect\": %llu, \"io\": %llu, \"parse\": %llu, \"backlog_overflow\": %llu},\n",
+            total->connect_errors, total->io_errors, total->parse_errors, total->backlog_overflow);
+    fprintf(fp, "  \"resent\": %llu,\n", total->resent);
+    fprintf(fp, "  \"unfinished\": %llu,\n", total->unfinished);
+    fprintf(fp, "  \"latency_us\": {\"min\": %lld, \"mean\": %.1f, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, "
+                "\"p99_9\": %lld, \"p99_99\": %lld, \"max\": %lld}\n",
+            h->total ? h->min : 0, h->total ? h->sum / (double)h->total : 0.0,
+            hist_percentile(h, 50), hist_percentile(h, 90), hist_percentile(h, 99),
+            hist_percentile(h, 99.9), hist_percentile(h, 99.99), h->max);
+    fprintf(fp, "}\n");
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-H host] [-p port | -U path] [-t threads] [-c conns] [-d seconds] [-R rate] [-P depth]\n"
+                    "          [-K] [-u path | -f file [-z s]] [-j file|-]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:U:t:c:d:R:P:Ku:f:z:j:")) != -1) {
+        switch (opt) {
+            case 'H': g_opt.host = optarg; break;
+            case 'p': g_opt.port = atoi(optarg); break;
+            case 'U': g_opt.unix_path = optarg; break;
+            case 't': g_opt.threads = atoi(optarg); break;
+            case 'c': g_opt.conns = atoi(optarg); break;
+            case 'd': g_opt.duration = atoi(optarg); break;
+            case 'R': g_opt.rate = atof(optarg); break;
+            case 'P': g_opt.pipeline = atoi(optarg); break;
+            case 'K': g_opt.keep_alive = 0; break;
+            case 'u': g_opt.path = optarg; break;
+            case 'f': g_opt.url_file = optarg; break;
+            case 'z': g_opt.zipf = atof(optarg); break;
+            case 'j': g_opt.json = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (g_opt.threads < 1 || g_opt.conns < 1 || g_opt.duration < 1 || g_opt.rate < 0 ||
+        g_opt.pipeline < 1 || g_opt.pipeline > MAX_PIPELINE || g_opt.port <= 0 || g_opt.zipf < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (g_opt.threads > g_opt.conns) {
+        g_opt.threads = g_opt.conns;
+    }
+    if (g_opt.url_file && load_paths(g_opt.url_file, g_opt.zipf) != 0) {
+        return 1;
+    }
+
+    // Resolve once
+    if (g_opt.unix_path) {
+        struct sockaddr_un* un = (struct sockaddr_un*)&g_addr;
+        if (strlen(g_opt.unix_path) >= sizeof(un->sun_path)) {
+            fprintf(stderr, "Error: %s: path too long\n", g_opt.unix_path);
+            return 1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, g_opt.unix_path);
+        g_addr_len = sizeof(*un);
+    } else {
+        char port_str[16];
+        snprintf(port_str, sizeof(port_str), "%d", g_opt.port);
+        struct addrinfo hints = {0}, *res;
+        hints.ai_socktype = SOCK_STREAM;
+        int gai = getaddrinfo(g_opt.host, port_str, &hints, &res);
+        if (gai != 0) {
+            fprintf(stderr, "Error: %s: %s\n", g_opt.host, gai_strerror(gai));
+            return 1;
+        }
+        memcpy(&g_addr, res->ai_addr, res->ai_addrlen);
+        g_addr_len = res->ai_addrlen;
+        freeaddrinfo(res);
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    worker_t* workers = calloc((size_t)g_opt.threads, sizeof(worker_t));
+    pthread_t* tids = calloc((size_t)g_opt.threads, sizeof(pthread_t));
+    if (!workers || !tids) {
+        perror("calloc");
+        return 1;
+    }
+
+    for (int i = 0; i < g_opt.threads; i++) {
+        worker_t* w = &workers[i];
+        w->id = i;
+        w->num_conns = g_opt.conns / g_opt.threads + (i < g_opt.conns % g_opt.threads ? 1 : 0);
+        w->conns = calloc((size_t)w->num_conns, sizeof(conn_t));
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        w->rng = 0x9E3779B97F4A7C15ULL * (unsigned long long)(i + 1);
+        hist_init(&w->hist);
+        if (g_opt.rate > 0) {
+            w->interval_ns = 1e9 * g_opt.threads / g_opt.rate;
+            w->backlog = malloc(BACKLOG_MAX * sizeof(long long));
+        }
+        if (!w->conns || w->epfd < 0 || (g_opt.rate > 0 && !w->backlog)) {
+            perror("loadgen: setup");
+            return 1;
+        }
+    }
+
+    if (g_opt.unix_path) {
+        fprintf(stderr, "loadgen: unix:%s", g_opt.unix_path);
+    } else {
+        fprintf(stderr, "loadgen: %s:%d", g_opt.host, g_opt.port);
+    }
+    fprintf(stderr, ", %d threads, %d connections, %ds, %s loop",
+            g_opt.threads, g_opt.conns, g_opt.duration, g_opt.rate > 0 ? "open" : "closed");
+    if (g_opt.rate > 0) {
+        fprintf(stderr, " at %.0f req/s", g_opt.rate);
+    }
+    fprintf(stderr, ", pipeline %d\n", g_opt.pipeline);
+
+    long long t0 = now_ns();
+    for (int i = 0; i < g_opt.threads; i++) {
+        pthread_create(&tids[i], NULL, worker_run, &workers[i]);
+    }
+    for (int i = 0; i < g_opt.threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = (double)(now_ns() - t0) / 1e9;
+
+    // Merge the per-thread results
+    worker_t total;
+    memset(&total, 0, sizeof(total));
+    hist_t* h = malloc(sizeof(hist_t));
+    if (!h) {
+        return 1;
+    }
+    hist_init(h);
+    for (int i = 0; i < g_opt.threads; i++) {
+        worker_t* w = &workers[i];
+        hist_merge(h, &w->hist);
+        total.completed += w->completed;
+        total.bytes += w->bytes;
+        total.connects += w->connects;
+        total.connect_errors += w->connect_errors;
+        total.io_errors += w->io_errors;
+        total.parse_errors += w->parse_errors;
+        total.resent += w->resent;
+        total.backlog_overflow += w->backlog_overflow;
+        total.unfinished += w->unfinished;
+        for (int k = 0; k < 6; k++) {
+            total.status_class[k] += w->status_class[k];
+        }
+    }
+
+    printf("Requests:    %llu in %.2fs (%.1f req/s), %llu connections opened\n", total.completed, elapsed,
+           elapsed > 0 ? (double)total.completed / elapsed : 0.0, total.connects);
+    printf("Status:      2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu\n", total.status_class[2], total.status_class[3],
+           total.status_class[4], total.status_class[5]);
+    printf("Errors:      connect %llu, io %llu, parse %llu; resent %llu, unfinished %llu\n", total.connect_errors,
+           total.io_errors, total.parse_errors, total.resent, total.unfinished);
+    printf("Latency us:  min %lld  p50 %lld  p90 %lld  p99 %lld  p99.9 %lld  max %lld\n", h->total ? h->min : 0,
+           hist_percentile(h, 50), hist_percentile(h, 90), hist_percentile(h, 99), hist_percentile(h, 99.9), h->max);
+
+    if (g_opt.json) {
+        FILE* fp = (strcmp(g_opt.json, "-") == 0) ? stdout : fopen(g_opt.json, "w");
+        if (!fp) {
+            perror(g_opt.json);
+            return 1;
+        }
+        write_json(fp, &total, h, elapsed);
+        if (fp != stdout) {
+            fclose(fp);
+        }
+    }
+
+    for (int i = 0; i < g_opt.threads; i++) {
+        free(workers[i].conns);
+        free(workers[i].backlog);
+        close(workers[i].epfd);
+    }
+    free(workers);
+    free(tids);
+    free(h);
+    return 0;
+}
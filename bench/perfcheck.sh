@@ -0,0 +1,248 @@
+#!/bin/bash
+
+# =============================================================================
+# Performance regression gate (make perfcheck)
+#
+# Starts bin/webserver on a generated document root, runs a fixed bin/loadgen
+# profile against it and compares throughput, p50/p99 latency, server CPU per
+# request and server RSS with a committed baseline. Exits 1 when a metric is
+# worse than the baseline by more than its tolerance.
+#
+# Usage: bench/perfcheck.sh [--update]
+#   --update   record the current results as the new baseline
+#
+# Environment:
+#   PERFCHECK_BASELINE   baseline file (default bench/baseline.json)
+#   PERFCHECK_PORT       port of the server under test (default 18089)
+#   PERFCHECK_DURATION   seconds of measured load (default 10)
+#   PERFCHECK_OUT        also keep the raw loadgen JSON here
+#   PERFCHECK_BIN        server binary under test (default ./bin/webserver)
+#
+# Baselines are machine-specific: record one on the machine that runs the gate.
+# =============================================================================
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+BOLD='\033[1m'
+
+cd "$(dirname "$0")/.." || exit 1
+
+BASELINE=${PERFCHECK_BASELINE:-bench/baseline.json}
+PORT=${PERFCHECK_PORT:-18089}
+DURATION=${PERFCHECK_DURATION:-10}
+WARMUP=2
+SERVER_BIN=${PERFCHECK_BIN:-./bin/webserver}
+NUM_FILES=64
+# Fixed load profile: closed loop, Connection: close (the server answers one request per connection)
+LOADGEN_ARGS="-t 2 -c 32 -K -z 1.0"
+PROFILE="loadgen $LOADGEN_ARGS -d $DURATION, $NUM_FILES files of 512 B - 128 KB, 4 workers x 10 threads"
+
+UPDATE=0
+if [ "${1:-}" = "--update" ]; then
+    UPDATE=1
+elif [ $# -gt 0 ]; then
+    echo "Usage: $0 [--update]"
+    exit 2
+fi
+
+for bin in "$SERVER_BIN" ./bin/loadgen; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not built (run make)${NC}"
+        exit 2
+    fi
+done
+if [ $UPDATE -eq 0 ] && [ ! -f "$BASELINE" ]; then
+    echo -e "${RED}Error: no baseline at $BASELINE (record one with --update)${NC}"
+    exit 2
+fi
+
+WORK=$(mktemp -d /tmp/perfcheck.XXXXXX)
+SERVER_PID=""
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# -----------------------------------------------------------------------------
+# Document root and server configuration
+# -----------------------------------------------------------------------------
+
+mkdir -p "$WORK/www"
+SIZES=(512 2048 8192 32768 131072)
+: > "$WORK/urls.txt"
+for i in $(seq 0 $((NUM_FILES - 1))); do
+    size=${SIZES[$((i % ${#SIZES[@]}))]}
+    head -c "$size" /dev/zero | tr '\0' 'a' > "$WORK/www/file$i.html"
+    echo "/file$i.html" >> "$WORK/urls.txt" # Listed most popular first
+done
+cp "$WORK/www/file0.html" "$WORK/www/index.html"
+
+sed -e "s/^PORT=.*/PORT=$PORT/" \
+    -e "s#^DOCUMENT_ROOT=.*#DOCUMENT_ROOT=$WORK/www#" \
+    -e "s#^LOG_FILE=.*#LOG_FILE=$WORK/access.log#" \
+    -e "s/^NUM_WORKERS=.*/NUM_WORKERS=4/" \
+    -e "s/^THREADS_PER_WORKER=.*/THREADS_PER_WORKER=10/" \
+    -e "s/^CACHE_SIZE_MB=.*/CACHE_SIZE_MB=10/" \
+    server.conf > "$WORK/server.conf"
+
+"$SERVER_BIN" "$WORK/server.conf" > "$WORK/server.out" 2>&1 &
+SERVER_PID=$!
+
+for _ in $(seq 50); do
+    if curl -s -m 1 -o /dev/null "http://127.0.0.1:$PORT/index.html"; then
+        break
+    fi
+    sleep 0.1
+done
+if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+    echo -e "${RED}Error: server did not start${NC}"
+    cat "$WORK/server.out"
+    exit 2
+fi
+
+# -----------------------------------------------------------------------------
+# Server CPU and memory (master + workers, from /proc)
+# -----------------------------------------------------------------------------
+
+server_pids() {
+    echo "$SERVER_PID"
+    pgrep -P "$SERVER_PID"
+}
+
+# utime + stime of every server process, in clock ticks
+cpu_ticks() {
+    for pid in $(server_pids); do
+        awk '{ sub(/^.*\) /, ""); print $12 + $13 }' "/proc/$pid/stat" 2>/dev/null
+    done | awk '{ s += $1 } END { print s + 0 }'
+}
+
+rss_kb() {
+    for pid in $(server_pids); do
+        awk '/^VmRSS:/ { print $2 }' "/proc/$pid/status" 2>/dev/null
+    done | awk '{ s += $1 } END { print s + 0 }'
+}
+
+# -----------------------------------------------------------------------------
+# Load
+# -----------------------------------------------------------------------------
+
+echo -e "${BOLD}Performance check${NC}: $PROFILE"
+
+# shellcheck disable=SC2086
+./bin/loadgen -p "$PORT" $LOADGEN_ARGS -d "$WARMUP" -f "$WORK/urls.txt" > /dev/null 2>&1
+
+TICKS0=$(cpu_ticks)
+# shellcheck disable=SC2086
+if ! ./bin/loadgen -p "$PORT" $LOADGEN_ARGS -d "$DURATION" -f "$WORK/urls.txt" -j "$WORK/result.json" \
+        > "$WORK/loadgen.out" 2>&1; then
+    echo -e "${RED}Error: loadgen failed${NC}"
+    cat "$WORK/loadgen.out"
+    exit 2
+fi
+TICKS1=$(cpu_ticks)
+RSS=$(rss_kb)
+[ -n "${PERFCHECK_OUT:-}" ] && cp "$WORK/result.json" "$PERFCHECK_OUT"
+
+json_num() { grep -o "\"$1\": [0-9.]*" "$WORK/result.json" | head -1 | awk '{print $2}'; }
+REQUESTS=$(json_num requests)
+ERRORS=$(( $(json_num connect) + $(json_num io) + $(json_num parse) + $(json_num 4xx) + $(json_num 5xx) ))
+
+if [ "${REQUESTS:-0}" -eq 0 ]; then
+    echo -e "${RED}Error: no request completed${NC}"
+    cat "$WORK/loadgen.out"
+    exit 2
+fi
+
+awk -v rps="$(json_num throughput_rps)" -v p50="$(json_num p50)" -v p99="$(json_num p99)" \
+    -v ticks=$((TICKS1 - TICKS0)) -v hz="$(getconf CLK_TCK)" -v req="$REQUESTS" -v rss="$RSS" 'BEGIN {
+    printf "throughput_rps %.1f\n", rps
+    printf "p50_ms %.3f\n", p50 / 1000
+    printf "p99_ms %.3f\n", p99 / 1000
+    printf "cpu_us_per_req %.1f\n", ticks * 1000000 / hz / req
+    printf "rss_mb %.1f\n", rss / 1024
+}' > "$WORK/current.txt"
+
+if [ "$ERRORS" -gt 0 ]; then
+    echo -e "${RED}$ERRORS of $REQUESTS requests failed${NC}"
+    cat "$WORK/loadgen.out"
+    exit 1
+fi
+
+# -----------------------------------------------------------------------------
+# Baseline
+# -----------------------------------------------------------------------------
+
+# Default tolerances (%) and direction, used when recording a baseline
+DEFAULTS="throughput_rps 20 higher
+p50_ms 30 lower
+p99_ms 50 lower
+cpu_us_per_req 25 lower
+rss_mb 30 lower"
+
+if [ $UPDATE -eq 1 ]; then
+    awk -v profile="$PROFILE" -v defaults="$DEFAULTS" '
+        BEGIN {
+            n = split(defaults, lines, "\n")
+            for (i = 1; i <= n; i++) { split(lines[i], f, " "); tol[f[1]] = f[2]; dir[f[1]] = f[3] }
+        }
+        { name[NR] = $1; value[NR] = $2 }
+        END {
+            printf "{\n  \"profile\": \"%s\",\n  \"metrics\": {\n", profile
+            for (i = 1; i <= NR; i++) {
+                printf "    \"%s\": {\"value\": %s, \"tolerance_pct\": %s, \"better\": \"%s\"}%s\n",
+                       name[i], value[i], tol[name[i]], dir[name[i]], (i < NR) ? "," : ""
+            }
+            printf "  }\n}\n"
+        }' "$WORK/current.txt" > "$BASELINE"
+    echo "Baseline written to $BASELINE:"
+    cat "$BASELINE"
+    exit 0
+fi
+
+# One metric per line: "name": {"value": V, "tolerance_pct": T, "better": "higher|lower"}
+awk '
+    FNR == NR {
+        if (match($0, /"[a-z0-9_]+": \{"value"/)) {
+            key = substr($0, RSTART + 1, index(substr($0, RSTART + 1), "\"") - 1)
+            line = $0
+            gsub(/[{}",:]/, " ", line)
+            n = split(line, f, " ")
+            for (i = 1; i < n; i++) {
+                if (f[i] == "value") base[key] = f[i + 1]
+                if (f[i] == "tolerance_pct") tol[key] = f[i + 1]
+                if (f[i] == "better") dir[key] = f[i + 1]
+            }
+            order[++count] = key
+        }
+        next
+    }
+    { cur[$1] = $2 }
+    END {
+        printf "%-16s %12s %12s %9s %9s  %s\n", "metric", "baseline", "current", "change", "allowed", "result"
+        failed = 0
+        for (i = 1; i <= count; i++) {
+            k = order[i]
+            if (!(k in cur)) continue
+            change = (base[k] != 0) ? (cur[k] - base[k]) * 100 / base[k] : 0
+            worse = (dir[k] == "higher") ? -change : change
+            result = (worse > tol[k]) ? "REGRESSION" : "ok"
+            if (result != "ok") failed++
+            printf "%-16s %12.3f %12.3f %+8.1f%% %8s%%  %s\n", k, base[k], cur[k], change,
+                   ((dir[k] == "higher") ? "-" : "+") tol[k], result
+        }
+        exit failed ? 1 : 0
+    }' "$BASELINE" "$WORK/current.txt"
+STATUS=$?
+
+if [ $STATUS -eq 0 ]; then
+    echo -e "${GREEN}No performance regression${NC} ($REQUESTS requests)"
+else
+    echo -e "${RED}Performance regression against $BASELINE${NC}"
+fi
+exit $STATUS
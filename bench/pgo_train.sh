@@ -0,0 +1,125 @@
+#!/bin/bash
+
+# =============================================================================
+# Training workload for the profile-guided release build (make release)
+#
+# Runs an instrumented (-fprofile-generate) server on a generated document root
+# and drives the paths a production server spends its time in:
+#   - cache hits      Zipf-popular small files (bin/loadgen)
+#   - cache misses    a long tail of files larger than the 1 MB cache
+#   - 404s            one request in ten names a missing file
+#   - ranges / HEAD   curl: bytes=a-b, bytes=a-, bytes=-n, unsatisfiable, HEAD
+#   - errors          bad method, malformed request, path traversal
+# Stopping the server with SIGTERM makes every process write its .gcda counters.
+#
+# Usage: bench/pgo_train.sh SERVER_BIN
+# Environment:
+#   PGO_TRAIN_DURATION   seconds of loadgen traffic (default 5)
+#   PGO_TRAIN_PORT       port of the instrumented server (default 18092)
+# =============================================================================
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+cd "$(dirname "$0")/.." || exit 1
+
+SERVER_BIN=${1:?usage: $0 SERVER_BIN}
+DURATION=${PGO_TRAIN_DURATION:-5}
+PORT=${PGO_TRAIN_PORT:-18092}
+
+for bin in "$SERVER_BIN" ./bin/loadgen; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not built${NC}"
+        exit 2
+    fi
+done
+
+WORK=$(mktemp -d /tmp/pgo_train.XXXXXX)
+SERVER_PID=""
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# -----------------------------------------------------------------------------
+# Document root: popular small files first, then a tail that overflows the cache
+# -----------------------------------------------------------------------------
+
+mkdir -p "$WORK/www/static"
+EXTS=(html css js png json txt)
+SIZES=(512 2048 8192 32768)
+: > "$WORK/urls.txt"
+for i in $(seq 0 47); do
+    ext=${EXTS[$((i % ${#EXTS[@]}))]}
+    head -c "${SIZES[$((i % ${#SIZES[@]}))]}" /dev/urandom > "$WORK/www/static/f$i.$ext"
+    echo "/static/f$i.$ext" >> "$WORK/urls.txt"
+    if [ $((i % 10)) -eq 9 ]; then
+        echo "/static/missing$i.html" >> "$WORK/urls.txt"
+    fi
+done
+for i in $(seq 0 15); do
+    head -c $((256 * 1024)) /dev/urandom > "$WORK/www/big$i.bin"
+    echo "/big$i.bin" >> "$WORK/urls.txt"
+done
+echo "<html><body>index</body></html>" > "$WORK/www/index.html"
+
+sed -e "s/^PORT=.*/PORT=$PORT/" \
+    -e "s#^DOCUMENT_ROOT=.*#DOCUMENT_ROOT=$WORK/www#" \
+    -e "s#^LOG_FILE=.*#LOG_FILE=$WORK/access.log#" \
+    -e "s/^CACHE_SIZE_MB=.*/CACHE_SIZE_MB=1/" \
+    server.conf > "$WORK/server.conf"
+
+"$SERVER_BIN" "$WORK/server.conf" > "$WORK/server.out" 2>&1 &
+SERVER_PID=$!
+
+for _ in $(seq 50); do
+    curl -s -m 1 -o /dev/null "http://127.0.0.1:$PORT/index.html" && break
+    sleep 0.1
+done
+if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+    echo -e "${RED}Error: server did not start${NC}"
+    cat "$WORK/server.out"
+    exit 2
+fi
+
+# -----------------------------------------------------------------------------
+# Workload
+# -----------------------------------------------------------------------------
+
+echo "Training: loadgen -t 2 -c 16 -K -z 1.0 -d $DURATION, ranges, HEAD and errors"
+
+# Ranges, HEAD and error paths first (small share of the samples, but every branch gets counts)
+URL="http://127.0.0.1:$PORT"
+for round in $(seq 20); do
+    f="/static/f$((round % 48)).${EXTS[$((round % ${#EXTS[@]}))]}"
+    curl -s -o /dev/null -H "Range: bytes=0-99" "$URL$f"
+    curl -s -o /dev/null -H "Range: bytes=100-" "$URL$f"
+    curl -s -o /dev/null -H "Range: bytes=-64" "$URL$f"
+    curl -s -o /dev/null -H "Range: bytes=999999-" "$URL$f"
+    curl -s -o /dev/null -I "$URL$f"
+    curl -s -o /dev/null -I "$URL/big$((round % 16)).bin"
+    curl -s -o /dev/null "$URL/"
+    curl -s -o /dev/null "$URL/nope$round.html"
+    curl -s -o /dev/null -X DELETE "$URL$f"
+    curl -s -o /dev/null --path-as-is "$URL/../etc/passwd"
+    printf 'BOGUS\r\n\r\n' | timeout 1 bash -c "cat > /dev/tcp/127.0.0.1/$PORT" 2>/dev/null
+done
+
+if ! ./bin/loadgen -p "$PORT" -t 2 -c 16 -K -z 1.0 -d "$DURATION" -f "$WORK/urls.txt" > "$WORK/loadgen.out" 2>&1; then
+    echo -e "${RED}Error: loadgen failed${NC}"
+    cat "$WORK/loadgen.out"
+    exit 2
+fi
+grep -E "^(Requests|Status)" "$WORK/loadgen.out"
+
+# Workers dump their counters on the way out (see PGO_TRAINING in master.c), the master at exit
+kill -TERM "$SERVER_PID"
+wait "$SERVER_PID" 2>/dev/null
+SERVER_PID=""
+echo -e "${GREEN}Training run complete${NC}"
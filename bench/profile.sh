@@ -0,0 +1,211 @@
+#!/bin/bash
+
+# =============================================================================
+# Profile the server under load and render flame graphs (make profile)
+#
+# Runs the profiling build (frame pointers, built-in SIGPROF sampler) on a
+# generated document root, drives it with bin/loadgen and writes, per process:
+#   <out>/<process>.folded   folded stacks ("root;...;leaf count")
+#   <out>/<process>.svg      flame graph
+# where <process> is master or workerN.
+#
+# With a working `perf` (perf_event_paranoid permitting), every process is
+# recorded with `perf record -g` instead; otherwise the built-in sampler
+# (src/profiler.c) is used.
+#
+# Usage: bench/profile.sh BIN_DIR [OUT_DIR]
+# Environment:
+#   PROFILE_DURATION   seconds of load (default 10)
+#   PROFILE_PORT       port of the server under test (default 18091)
+#   PROFILE_HZ         samples per second of CPU time (default 997)
+#   PROFILE_LOAD       loadgen options (default "-t 2 -c 32 -K -z 1.0")
+#   PROFILE_SAMPLER    "builtin" to skip perf even when it is available
+# =============================================================================
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+cd "$(dirname "$0")/.." || exit 1
+
+BIN=${1:?usage: $0 BIN_DIR [OUT_DIR]}
+OUT=${2:-build/profile/flamegraphs}
+DURATION=${PROFILE_DURATION:-10}
+PORT=${PROFILE_PORT:-18091}
+HZ=${PROFILE_HZ:-997}
+LOAD=${PROFILE_LOAD:-"-t 2 -c 32 -K -z 1.0"}
+NUM_FILES=64
+
+for bin in "$BIN/webserver" ./bin/loadgen; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not built${NC}"
+        exit 2
+    fi
+done
+
+WORK=$(mktemp -d /tmp/profile.XXXXXX)
+SERVER_PID=""
+PERF_PIDS=()
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+mkdir -p "$OUT" "$WORK/www" "$WORK/stacks"
+rm -f "$OUT"/*.folded "$OUT"/*.svg
+
+# Same document root shape as make perfcheck
+SIZES=(512 2048 8192 32768 131072)
+for i in $(seq 0 $((NUM_FILES - 1))); do
+    head -c "${SIZES[$((i % ${#SIZES[@]}))]}" /dev/zero | tr '\0' 'a' > "$WORK/www/file$i.html"
+    echo "/file$i.html" >> "$WORK/urls.txt"
+done
+cp "$WORK/www/file0.html" "$WORK/www/index.html"
+
+sed -e "s/^PORT=.*/PORT=$PORT/" \
+    -e "s#^DOCUMENT_ROOT=.*#DOCUMENT_ROOT=$WORK/www#" \
+    -e "s#^LOG_FILE=.*#LOG_FILE=$WORK/access.log#" \
+    server.conf > "$WORK/server.conf"
+
+USE_PERF=0
+if [ "${PROFILE_SAMPLER:-}" != "builtin" ] && command -v perf > /dev/null 2>&1 \
+        && perf record -q -o /dev/null -- true > /dev/null 2>&1; then
+    USE_PERF=1
+fi
+
+# -----------------------------------------------------------------------------
+# Run
+# -----------------------------------------------------------------------------
+
+if [ $USE_PERF -eq 1 ]; then
+    echo "Sampler: perf record -g ($HZ Hz)"
+    "$BIN/webserver" "$WORK/server.conf" > "$WORK/server.out" 2>&1 &
+else
+    echo "Sampler: built-in SIGPROF ($HZ Hz; perf not available)"
+    PROFILE_DIR="$WORK/stacks" PROFILE_HZ="$HZ" "$BIN/webserver" "$WORK/server.conf" > "$WORK/server.out" 2>&1 &
+fi
+SERVER_PID=$!
+
+for _ in $(seq 50); do
+    curl -s -m 1 -o /dev/null "http://127.0.0.1:$PORT/index.html" && break
+    sleep 0.1
+done
+if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+    echo -e "${RED}Error: server did not start${NC}"
+    cat "$WORK/server.out"
+    exit 2
+fi
+
+if [ $USE_PERF -eq 1 ]; then
+    perf record -q -F "$HZ" -g -p "$SERVER_PID" -o "$WORK/master.perf" -- sleep "$((DURATION + 1))" \
+        > /dev/null 2>&1 &
+    PERF_PIDS+=($!)
+    i=0
+    for pid in $(pgrep -P "$SERVER_PID" | sort -n); do
+        perf record -q -F "$HZ" -g -p "$pid" -o "$WORK/worker$i.perf" -- sleep "$((DURATION + 1))" \
+            > /dev/null 2>&1 &
+        PERF_PIDS+=($!)
+        i=$((i + 1))
+    done
+fi
+
+echo "Load: loadgen $LOAD -d $DURATION"
+# shellcheck disable=SC2086
+./bin/loadgen -p "$PORT" $LOAD -d "$DURATION" -f "$WORK/urls.txt" | grep -E "^(Requests|Latency)" || true
+
+[ ${#PERF_PIDS[@]} -gt 0 ] && wait "${PERF_PIDS[@]}"
+
+# Stopping the server makes every process write its samples (built-in sampler)
+kill -TERM "$SERVER_PID"
+wait "$SERVER_PID" 2>/dev/null
+SERVER_PID=""
+
+# -----------------------------------------------------------------------------
+# Fold and render
+# -----------------------------------------------------------------------------
+
+# perf script output -> folded stacks (frames are printed leaf first, one per line)
+collapse_perf() {
+    perf script -i "$1" 2> /dev/null | awk '
+        /^[^ \t]/ { n = 0; next }
+        /^[ \t]*$/ {
+            if (n > 0) {
+                s = f[n]
+                for (i = n - 1; i >= 1; i--) s = s ";" f[i]
+                count[s]++
+            }
+            n = 0
+            next
+        }
+        {
+            sym = $2
+            sub(/\+0x[0-9a-f]+$/, "", sym)
+            if (sym == "[unknown]" && $3 != "") { sym = $3; gsub(/[()]/, "", sym); sub(/.*\//, "", sym); sym = "[" sym "]" }
+            f[++n] = sym
+        }
+        END { for (s in count) print s, count[s] }'
+}
+
+# Built-in sampler output -> folded stacks, resolving "@0x<offset>" frames with addr2line
+collapse_builtin() {
+    local stacks=$1
+    grep -v '^#' "$stacks" | tr ';' '\n' | grep '^@0x' | sort -u | sed 's/^@//' > "$WORK/addrs"
+    : > "$WORK/syms"
+    if [ -s "$WORK/addrs" ]; then
+        addr2line -f -e "$BIN/webserver" < "$WORK/addrs" | awk 'NR % 2 == 1' | paste -d' ' "$WORK/addrs" - \
+            > "$WORK/syms"
+    fi
+    awk 'FNR == NR { sym["@" $1] = $2; next }
+         /^#/ { next }
+         {
+             n = split($0, f, ";")
+             s = ""
+             for (i = 1; i <= n; i++) {
+                 name = (f[i] in sym) ? sym[f[i]] : f[i]
+                 if (name == "??") name = "[webserver]"
+                 s = (i == 1) ? name : s ";" name
+             }
+             count[s]++
+         }
+         END { for (s in count) print s, count[s] }' "$WORK/syms" "$stacks"
+}
+
+if [ $USE_PERF -eq 1 ]; then
+    for data in "$WORK"/*.perf; do
+        [ -f "$data" ] || continue
+        name=$(basename "$data" .perf)
+        collapse_perf "$data" | sort > "$OUT/$name.folded"
+    done
+else
+    for stacks in "$WORK"/stacks/*.stacks; do
+        [ -f "$stacks" ] || continue
+        name=$(basename "$stacks" .stacks)
+        name=${name%.*} # Drop the pid
+        collapse_builtin "$stacks" | sort > "$OUT/$name.folded"
+    done
+fi
+
+rendered=0
+for folded in "$OUT"/*.folded; do
+    [ -f "$folded" ] || continue
+    name=$(basename "$folded" .folded)
+    samples=$(awk '{ s += $NF } END { print s + 0 }' "$folded")
+    if [ "$samples" -eq 0 ]; then
+        echo "  $name: no samples"
+        continue
+    fi
+    awk -f bench/flamegraph.awk -v title="webserver $name ($samples samples)" "$folded" > "$OUT/$name.svg"
+    echo "  $OUT/$name.svg ($samples samples)"
+    rendered=$((rendered + 1))
+done
+
+if [ $rendered -eq 0 ]; then
+    echo -e "${RED}No samples collected${NC}"
+    exit 1
+fi
+echo -e "${GREEN}Flame graphs written to $OUT${NC}"
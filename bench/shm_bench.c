@@ -0,0 +1,218 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "shared_mem.h"
+
+// False-sharing benchmark for the shared memory layout
+//
+// Usage: shm_bench [-p writers] [-n iterations]
+//
+// Each scenario runs its writers as separate processes on a MAP_SHARED anonymous mapping, like the
+// master and the workers, and reports the wall time per operation:
+//
+//   stats/locked   every writer updates one server_stats_t under a shared mutex (the old layout)
+//   stats/packed   every writer has its own counters, but they are adjacent (8 bytes apart)
+//   stats/slots    every writer has its own stats_slot_t (the current layout)
+//   queue/packed   master-style producer and worker-style consumer on adjacent head/tail
+//   queue/slots    the same on connection_queue_t, head and tail on separate cache lines
+//
+// The numbers only differ where writers run on different cores; with a single CPU every variant
+// measures the same thing. For per-line attribution run it under "perf c2c record" and look at the
+// HITM counts of the packed variants.
+
+#define DEFAULT_ITERS 2000000L
+#define QUEUE_SLOTS 1024 // Ring used by the queue scenarios (power of two)
+
+// Old layout: one counter block shared by every writer
+typedef struct {
+    pthread_mutex_t lock;
+    server_stats_t stats;
+} locked_stats_t;
+
+// Queue indices without padding
+typedef struct {
+    unsigned int head;
+    unsigned int tail;
+} packed_queue_t;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void* map_shared(size_t size) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+// Fork one process per writer running fn(arg, index), wait for all of them and return the elapsed ns
+static long long run_writers(int writers, void (*fn)(void*, int, long), void* arg, long iters) {
+    long long start = now_ns();
+    for (int i = 0; i < writers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            fn(arg, i, iters);
+            _exit(0);
+        }
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+    return now_ns() - start;
+}
+
+// ###############################################################################################################
+// Statistics scenarios
+// ###############################################################################################################
+
+static void stats_locked(void* arg, int idx, long iters) {
+    (void)idx;
+    locked_stats_t* ls = arg;
+    for (long i = 0; i < iters; i++) {
+        pthread_mutex_lock(&ls->lock);
+        ls->stats.total_requests++;
+        ls->stats.bytes_transferred += 512;
+        ls->stats.total_response_time_ms += 1;
+        ls->stats.status_200++;
+        pthread_mutex_unlock(&ls->lock);
+    }
+}
+
+static void stats_packed(void* arg, int idx, long iters) {
+    atomic_long* counters = arg; // 4 counters per writer, back to back
+    atomic_long* mine = counters + idx * 4;
+    for (long i = 0; i < iters; i++) {
+        atomic_fetch_add_explicit(&mine[0], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&mine[1], 512, memory_order_relaxed);
+        atomic_fetch_add_explicit(&mine[2], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&mine[3], 1, memory_order_relaxed);
+    }
+}
+
+static void stats_slots(void* arg, int idx, long iters) {
+    stats_slot_t* st = (stats_slot_t*)arg + idx;
+    for (long i = 0; i < iters; i++) {
+        atomic_fetch_add_explicit(&st->total_requests, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&st->bytes_transferred, 512, memory_order_relaxed);
+        atomic_fetch_add_explicit(&st->total_response_time_ms, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&st->status_200, 1, memory_order_relaxed);
+    }
+}
+
+// ###############################################################################################################
+// Queue scenarios: writer 0 produces (tail), writer 1 consumes (head)
+// ###############################################################################################################
+
+static void spsc(unsigned int* head, unsigned int* tail, unsigned int* items, int idx, long iters) {
+    for (long i = 0; i < iters; i++) {
+        if (idx == 0) {
+            unsigned int t = __atomic_load_n(tail, __ATOMIC_RELAXED);
+            while (t - __atomic_load_n(head, __ATOMIC_ACQUIRE) >= QUEUE_SLOTS) {
+                sched_yield(); // Full
+            }
+            items[t & (QUEUE_SLOTS - 1)] = (unsigned int)i;
+            __atomic_store_n(tail, t + 1, __ATOMIC_RELEASE);
+        } else {
+            unsigned int h = __atomic_load_n(head, __ATOMIC_RELAXED);
+            while (__atomic_load_n(tail, __ATOMIC_ACQUIRE) == h) {
+                sched_yield(); // Empty
+            }
+            (void)items[h & (QUEUE_SLOTS - 1)];
+            __atomic_store_n(head, h + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void queue_packed(void* arg, int idx, long iters) {
+    packed_queue_t* q = arg;
+    spsc(&q->head, &q->tail, (unsigned int*)(q + 1), idx, iters);
+}
+
+static void queue_slots(void* arg, int idx, long iters) {
+    connection_queue_t* q = arg;
+    spsc(&q->head, &q->tail, (unsigned int*)q->items, idx, iters);
+}
+
+static void report(const char* name, int writers, long iters, long long ns, long long base_ns) {
+    double per_op = (double)ns / (double)iters;
+    printf("%-14s %8d %12ld %10.2f %8.2fx\n", name, writers, iters, per_op, (double)base_ns / (double)ns);
+}
+
+int main(int argc, char* argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int writers = (cpus > 1) ? (int)cpus : 2;
+    long iters = DEFAULT_ITERS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:")) != -1) {
+        if (opt == 'p') {
+            writers = atoi(optarg);
+        } else if (opt == 'n') {
+            iters = atol(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-p writers] [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (writers < 1 || iters < 1) {
+        fprintf(stderr, "Error: writers and iterations must be positive\n");
+        return 1;
+    }
+
+    printf("CPUs online: %ld%s\n", cpus, cpus < 2 ? " (writers cannot run in parallel: expect no difference)" : "");
+    printf("%-14s %8s %12s %10s %9s\n", "scenario", "writers", "ops/writer", "ns/op", "speedup");
+
+    // Stats: old layout as the baseline
+    locked_stats_t* ls = map_shared(sizeof(*ls));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&ls->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    long long base = run_writers(writers, stats_locked, ls, iters);
+    report("stats/locked", writers, iters, base, base);
+    if (ls->stats.total_requests != (long)writers * iters) {
+        fprintf(stderr, "Error: lost updates in stats/locked\n");
+        return 1;
+    }
+
+    size_t packed_size = (size_t)writers * 4 * sizeof(atomic_long);
+    void* packed = map_shared(packed_size);
+    report("stats/packed", writers, iters, run_writers(writers, stats_packed, packed, iters), base);
+
+    size_t slots_size = (size_t)writers * sizeof(stats_slot_t);
+    stats_slot_t* slots = map_shared(slots_size);
+    report("stats/slots", writers, iters, run_writers(writers, stats_slots, slots, iters), base);
+
+    // Queue: one producer, one consumer
+    size_t ring = QUEUE_SLOTS * sizeof(unsigned int);
+    packed_queue_t* pq = map_shared(sizeof(*pq) + ring);
+    long long qbase = run_writers(2, queue_packed, pq, iters);
+    report("queue/packed", 2, iters, qbase, qbase);
+
+    connection_queue_t* cq = map_shared(sizeof(*cq) + ring);
+    report("queue/slots", 2, iters, run_writers(2, queue_slots, cq, iters), qbase);
+
+    munmap(ls, sizeof(*ls));
+    munmap(packed, packed_size);
+    munmap(slots, slots_size);
+    munmap(pq, sizeof(*pq) + ring);
+    munmap(cq, sizeof(*cq) + ring);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# =============================================================================
+# Large-response benchmark: copy vs MSG_ZEROCOPY (make bench-zerocopy)
+#
+# Serves multi-megabyte responses with ZEROCOPY_MIN_KB=0 (send() copies) and
+# ZEROCOPY_MIN_KB=<threshold>, and prints throughput and server CPU per GB sent
+# for each body source:
+#   cache   1 MB file from the per-worker cache (pinned cache_handle_t)
+#   pack    16 MB file from a DOCPACK bundle (mmap'd)
+#
+# Usage: bench/zerocopy.sh
+#
+# Environment:
+#   ZC_PORT        port of the server under test (default 18088)
+#   ZC_DURATION    seconds of load per run (default 5)
+#   ZC_MIN_KB      zero-copy threshold of the zero-copy runs (default 256)
+#   ZC_HOST        host to load (default 127.0.0.1). Over loopback the kernel copies
+#                  zero-copy sends anyway: run the server on a real NIC to see the gain.
+# =============================================================================
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+BOLD='\033[1m'
+
+cd "$(dirname "$0")/.." || exit 1
+
+PORT=${ZC_PORT:-18088}
+DURATION=${ZC_DURATION:-5}
+MIN_KB=${ZC_MIN_KB:-256}
+HOST=${ZC_HOST:-127.0.0.1}
+LOADGEN_ARGS="-t 2 -c 8"
+
+for bin in ./bin/webserver ./bin/loadgen ./bin/docpack_build; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not built (run make)${NC}"
+        exit 2
+    fi
+done
+
+WORK=$(mktemp -d /tmp/zerocopy.XXXXXX)
+SERVER_PID=""
+
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=""
+    fi
+}
+
+cleanup() {
+    stop_server
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+mkdir -p "$WORK/www"
+head -c $((1024 * 1024)) /dev/urandom > "$WORK/www/cached.bin"
+head -c $((16 * 1024 * 1024)) /dev/urandom > "$WORK/www/large.bin"
+echo ok > "$WORK/www/index.html"
+./bin/docpack_build -q "$WORK/www" "$WORK/www.pack" > /dev/null || exit 2
+
+# utime + stime of every server process, in clock ticks
+cpu_ticks() {
+    for pid in "$SERVER_PID" $(pgrep -P "$SERVER_PID"); do
+        awk '{ sub(/^.*\) /, ""); print $12 + $13 }' "/proc/$pid/stat" 2>/dev/null
+    done | awk '{ s += $1 } END { print s + 0 }'
+}
+
+# run <label> <zerocopy_min_kb> <docpack or empty> <url>
+run() {
+    sed -e "s/^PORT=.*/PORT=$PORT/" \
+        -e "s#^DOCUMENT_ROOT=.*#DOCUMENT_ROOT=$WORK/www#" \
+        -e "s#^LOG_FILE=.*#LOG_FILE=$WORK/access.log#" \
+        -e "s/^CACHE_SIZE_MB=.*/CACHE_SIZE_MB=64/" \
+        server.conf > "$WORK/server.conf"
+    printf "\nZEROCOPY_MIN_KB=%s\n" "$2" >> "$WORK/server.conf"
+    [ -n "$3" ] && echo "DOCPACK=$3" >> "$WORK/server.conf"
+
+    ./bin/webserver "$WORK/server.conf" > "$WORK/server.out" 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 50); do
+        curl -s -m 1 -o /dev/null "http://127.0.0.1:$PORT/index.html" && break
+        sleep 0.1
+    done
+
+    # shellcheck disable=SC2086
+    ./bin/loadgen -H "$HOST" -p "$PORT" $LOADGEN_ARGS -d 1 -u "$4" > /dev/null 2>&1 # Warm the caches
+    local t0 t1
+    t0=$(cpu_ticks)
+    # shellcheck disable=SC2086
+    ./bin/loadgen -H "$HOST" -p "$PORT" $LOADGEN_ARGS -d "$DURATION" -u "$4" -j "$WORK/result.json" \
+        > "$WORK/loadgen.out" 2>&1
+    t1=$(cpu_ticks)
+    stop_server
+
+    local bytes errors
+    bytes=$(grep -o '"bytes_received": [0-9]*' "$WORK/result.json" | awk '{print $2}')
+    errors=$(grep -o '"5xx": [0-9]*' "$WORK/result.json" | awk '{print $2}')
+    awk -v label="$1" -v bytes="${bytes:-0}" -v ticks=$((t1 - t0)) -v hz="$(getconf CLK_TCK)" \
+        -v secs="$DURATION" -v errors="${errors:-0}" 'BEGIN {
+        gb = bytes / 1e9
+        ms_per_gb = (gb > 0) ? ticks * 1000 / hz / gb : 0
+        note = (errors > 0) ? "(" errors " errors)" : ""
+        printf "%-24s %10.1f MB/s %10.1f ms CPU/GB %s\n", label, bytes / 1e6 / secs, ms_per_gb, note
+    }'
+}
+
+echo -e "${BOLD}Large responses${NC}: loadgen $LOADGEN_ARGS -d $DURATION against $HOST, zero-copy from $MIN_KB KB"
+run "cache 1 MB, copy" 0 "" /cached.bin
+run "cache 1 MB, zerocopy" "$MIN_KB" "" /cached.bin
+run "pack 16 MB, copy" 0 "$WORK/www.pack" /large.bin
+run "pack 16 MB, zerocopy" "$MIN_KB" "$WORK/www.pack" /large.bin
+echo -e "${GREEN}Done${NC} (server CPU = master + workers, from /proc)"
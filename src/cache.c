@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200809L // To pthread_mutexattr_settype; L -> long
+#define _GNU_SOURCE // preadv2 and RWF_NOWAIT (also gives pthread_mutexattr_settype)
 #include "cache.h"
 #include <pthread.h>
 #include <string.h>
@@ -6,6 +6,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef CACHE_LOCK_STATS
+#include <stdatomic.h>
+#include <time.h>
+#endif
 
 // =============================================================================
 // FILE CACHE IMPLEMENTATION WITH HASH TABLE AND LRU
@@ -22,6 +29,7 @@
 // - cache_acquire: Retrieves file data from cache (if exists).
 // - cache_release: Releases a cache reference.
 // - cache_load_file: Loads a file into the cache.
+// - cache_load_file_nowait: Same, only from the page cache (never waits for the disk).
 // - cache_invalidate: Removes an entry from the cache.
 // - cache_stats: Retrieves cache statistics.
 
@@ -56,8 +64,67 @@ struct file_cache {
     
     /* Statistics */
     size_t hits, misses, evictions; // Hits, misses, evictions
+
+#ifdef CACHE_LOCK_STATS
+    /* Lock accounting (see cache_lock_stats) */
+    atomic_ulong lock_acquisitions; // rwlock acquisitions
+    atomic_ulong lock_contended; // Acquisitions that had to wait
+    atomic_ulong lock_wait_ns; // Total time spent waiting
+#endif
 };
 
+// =============================================================================
+// LOCKING
+// =============================================================================
+// With -DCACHE_LOCK_STATS every acquisition first tries the lock; only when that
+// fails is the blocking wait timed, so the uncontended path costs one extra atomic.
+
+#ifdef CACHE_LOCK_STATS
+
+static unsigned long lock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+static void cache_wrlock(file_cache_t *c) {
+    atomic_fetch_add_explicit(&c->lock_acquisitions, 1, memory_order_relaxed);
+    if (pthread_rwlock_trywrlock(&c->rwlock) == 0) {
+        return;
+    }
+    unsigned long t0 = lock_now_ns();
+    pthread_rwlock_wrlock(&c->rwlock);
+    atomic_fetch_add_explicit(&c->lock_contended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->lock_wait_ns, lock_now_ns() - t0, memory_order_relaxed);
+}
+
+static void cache_rdlock(file_cache_t *c) {
+    atomic_fetch_add_explicit(&c->lock_acquisitions, 1, memory_order_relaxed);
+    if (pthread_rwlock_tryrdlock(&c->rwlock) == 0) {
+        return;
+    }
+    unsigned long t0 = lock_now_ns();
+    pthread_rwlock_rdlock(&c->rwlock);
+    atomic_fetch_add_explicit(&c->lock_contended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->lock_wait_ns, lock_now_ns() - t0, memory_order_relaxed);
+}
+
+void cache_lock_stats(file_cache_t *c, unsigned long *acquisitions, unsigned long *contended, unsigned long *wait_ns) {
+    if (acquisitions)
+        *acquisitions = atomic_load_explicit(&c->lock_acquisitions, memory_order_relaxed);
+    if (contended)
+        *contended = atomic_load_explicit(&c->lock_contended, memory_order_relaxed);
+    if (wait_ns)
+        *wait_ns = atomic_load_explicit(&c->lock_wait_ns, memory_order_relaxed);
+}
+
+#else
+
+#define cache_wrlock(c) pthread_rwlock_wrlock(&(c)->rwlock)
+#define cache_rdlock(c) pthread_rwlock_rdlock(&(c)->rwlock)
+
+#endif
+
 // =============================================================================
 // INTERNAL HELPER FUNCTIONS
 // =============================================================================
@@ -289,7 +356,7 @@ void cache_destroy(file_cache_t *c) {
         return;
     }
 
-    pthread_rwlock_wrlock(&c->rwlock); // Lock for writing (cleanup modifies)
+    cache_wrlock(c); // Lock for writing (cleanup modifies)
 
     // Free all entries in all buckets
     for (size_t i = 0; i < c->nbuckets; ++i) { // For each bucket
@@ -335,7 +402,7 @@ bool cache_acquire(file_cache_t *c, const char *key, cache_handle_t *out) {
         return false;
     }
 
-    pthread_rwlock_wrlock(&c->rwlock); // Lock for writing (updates LRU)
+    cache_wrlock(c); // Lock for writing (updates LRU)
 
     // Compute hash bucket index for the key
     unsigned long h = hash_key(key) % c->nbuckets;
@@ -360,6 +427,8 @@ bool cache_acquire(file_cache_t *c, const char *key, cache_handle_t *out) {
     out->data = e->data;
     out->size = e->size;
     out->_entry = e;
+    out->fd = -1; // Memory only
+    out->offset = 0;
 
     // Increment hit counter
     c->hits++;
@@ -383,7 +452,7 @@ void cache_release(file_cache_t *c, cache_handle_t *h) {
     if (!c || !h || !h->_entry)
         return;
 
-    pthread_rwlock_wrlock(&c->rwlock); // Lock for writing (updates refcnt and may evict)
+    cache_wrlock(c); // Lock for writing (updates refcnt and may evict)
 
     cache_entry_t *e = (cache_entry_t*)h->_entry; // Get entry from handle
 
@@ -409,106 +478,129 @@ void cache_release(file_cache_t *c, cache_handle_t *h) {
 /*
   Reads the entire file at abs_path into memory.
   Allocates a buffer, reads the file, and sets data and size.
-  Returns true on success, false on failure (file not found, read error, etc.).
+  With nowait, the file is only read if it is already in the page cache: preadv2(RWF_NOWAIT)
+  fails with EAGAIN instead of waiting for the disk.
+  Returns 1 on success, 0 on failure with errno set (ENOENT, EACCES, EFBIG for a file
+  too large to cache, ...), -1 when the read would have to wait for the disk (nowait only).
  */
-static bool read_file_into_memory(const char *abs_path, uint8_t **data, size_t *size) {
+int cache_read_file(const char *abs_path, uint8_t **data, size_t *size, bool nowait) {
     *data = NULL; // Initialize output data pointer
     *size = 0; // Initialize output size
 
-    // Open file for reading in binary mode
-    FILE *f = fopen(abs_path, "rb");
+#ifndef RWF_NOWAIT
+    // No way to ask for page-cache-only reads: every read may block
+    if (nowait)
+        return -1;
+#endif
+
+    // Open file for reading
+    int fd = open(abs_path, O_RDONLY | O_CLOEXEC);
 
     // Check if file opened successfully
-    if (!f)
-        return false;
+    if (fd < 0)
+        return 0;
 
-    // Determine file size
-    // fseek -> Move to end of file
-    if (fseek(f, 0, SEEK_END) != 0) {
-        fclose(f);
-        return false;
+    // Determine file size (only regular files are cached)
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return 0;
     }
-
-    // Get current position (file size)
-    // ftell -> Get current file position
-    long len = ftell(f);
-
-    // Check for errors
-    if (len < 0) {
-        fclose(f); // Close file
-        return false;
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        return 0;
     }
+    size_t len = (size_t)st.st_size;
 
-    // Security: Reject files larger than 1MB to prevent memory exhaustion
-    // Only cache small files as per FAQ requirements
-    #define MAX_CACHE_FILE_SIZE (1024 * 1024) // 1MB
     if (len > MAX_CACHE_FILE_SIZE) {
-        fclose(f);
-        return false; // File too large for caching
-    }
-
-    // Rewind to beginning of file
-    if (fseek(f, 0, SEEK_SET) != 0) {
-        fclose(f);
-        return false;
+        close(fd);
+        errno = EFBIG;
+        return 0; // File too large for caching
     }
 
-
-    // Allocate buffer for file data with size len
-    uint8_t *buf = (uint8_t*)malloc((size_t)len);
+    // Allocate buffer for file data with size len (at least 1 byte, for empty files)
+    uint8_t *buf = (uint8_t*)malloc(len ? len : 1);
 
     // Check for allocation failure
     if (!buf) {
-        fclose(f);
-        return false;
+        close(fd);
+        errno = ENOMEM;
+        return 0;
+    }
+
+    // Read file data into buffer. With RWF_NOWAIT a read stops short at the first page that is
+    // not cached; the next call then fails with EAGAIN.
+    size_t off = 0;
+    while (off < len) {
+        ssize_t rd;
+#ifdef RWF_NOWAIT
+        if (nowait) {
+            struct iovec iov = { buf + off, len - off };
+            rd = preadv2(fd, &iov, 1, (off_t)off, RWF_NOWAIT);
+            // EOPNOTSUPP/ENOSYS: the filesystem or kernel cannot tell, so assume the disk
+            if (rd < 0 && (errno == EAGAIN || errno == EOPNOTSUPP || errno == ENOSYS)) {
+                close(fd);
+                free(buf);
+                return -1;
+            }
+        } else
+#endif
+        rd = pread(fd, buf + off, len - off, (off_t)off);
+        if (rd < 0 && errno == EINTR)
+            continue;
+        if (rd <= 0) { // Read error, or the file shrank under us
+            int err = rd < 0 ? errno : EIO;
+            close(fd);
+            free(buf);
+            errno = err;
+            return 0;
+        }
+        off += (size_t)rd;
     }
 
-    // Read file data into buffer
-    // fread -> Read data from file
-    size_t rd = fread(buf, 1, (size_t)len, f);
-
-    fclose(f);
-
-    // Check if read size matches expected length
-    if (rd != (size_t)len) {
-        free(buf);
-        return false;
-    }
+    close(fd);
 
     // Set output parameters
     *data = buf; // Set data pointer
-    *size = (size_t)len; // Set size
+    *size = len; // Set size
 
-    return true; // Success
+    return 1; // Success
 }
 
 /*
 Loads a file into the cache if not already present.
-First checks if the key is already in cache (via cache_acquire).
+First checks if the key is already in cache (via cache_acquire), unless the caller just did (nowait).
 If not, reads the file from disk, creates a new entry, inserts into hash and LRU,
 and evicts if necessary. Increments refcnt and fills output handle.
 Thread-safe with mutex.
+Returns 1 when loaded, 0 on failure (errno set), -1 when a nowait read would block.
 */
-bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cache_handle_t *out) {
+static int cache_load(file_cache_t *c, const char *key, const char *abs_path, cache_handle_t *out, bool nowait) {
 
     // Validate input parameters
-    if (!c || !key || !abs_path || !out)
-        return false;
+    if (!c || !key || !abs_path || !out) {
+        errno = EINVAL;
+        return 0;
+    }
 
     // Try to acquire from cache first (fast path)
     // cache_acquire will handle locking
-    if (cache_acquire(c, key, out))
-        return true;
+    if (!nowait && cache_acquire(c, key, out))
+        return 1;
 
     // Not in cache: read file from disk
     uint8_t *buf = NULL; // Buffer for file data
     size_t sz = 0; // Size of file data
 
     // Read file into memory
-    if (!read_file_into_memory(abs_path, &buf, &sz))
-        return false;
+    int rd = cache_read_file(abs_path, &buf, &sz, nowait);
+    if (rd != 1)
+        return rd;
 
-    pthread_rwlock_wrlock(&c->rwlock); // Lock for writing (inserts new entry)
+    cache_wrlock(c); // Lock for writing (inserts new entry)
 
     // Double-check if another thread loaded it while we were reading
     unsigned long h = hash_key(key) % c->nbuckets; // Hash bucket index
@@ -526,7 +618,9 @@ bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cac
         // Fill output handle
         out->data = e->data; 
         out->size = e->size; 
-        out->_entry = e; 
+        out->_entry = e;
+        out->fd = -1;
+        out->offset = 0;
 
         c->hits++; // Increment hit counter
 
@@ -534,7 +628,7 @@ bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cac
 
         free(buf);  // Free the buffer we read
 
-        return true;
+        return 1;
     }
 
     // Create new entry for this file
@@ -544,7 +638,8 @@ bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cac
     if (!e) {
         pthread_rwlock_unlock(&c->rwlock); // Unlock cache
         free(buf); // Free file buffer
-        return false;
+        errno = ENOMEM;
+        return 0;
     }
 
     // strdup duplicates the string (allocates memory and copies)
@@ -556,8 +651,8 @@ bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cac
 
         free(buf); // Free file buffer
         free(e); // Free entry
-        
-        return false; // Return failure
+        errno = ENOMEM;
+        return 0; // Return failure
     }
 
     e->data = buf; // Set file data
@@ -578,10 +673,20 @@ bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cac
     out->data = e->data;
     out->size = e->size;
     out->_entry = e;
+    out->fd = -1; // Memory only
+    out->offset = 0;
 
     pthread_rwlock_unlock(&c->rwlock); // Unlock cache
 
-    return true;
+    return 1;
+}
+
+bool cache_load_file(file_cache_t *c, const char *key, const char *abs_path, cache_handle_t *out) {
+    return cache_load(c, key, abs_path, out, false) == 1;
+}
+
+int cache_load_file_nowait(file_cache_t *c, const char *key, const char *abs_path, cache_handle_t *out) {
+    return cache_load(c, key, abs_path, out, true);
 }
 
 /*
@@ -596,7 +701,7 @@ bool cache_invalidate(file_cache_t *c, const char *key) {
     if (!c || !key)
         return false;
 
-    pthread_rwlock_wrlock(&c->rwlock); // Lock for writing (removes entry)
+    cache_wrlock(c); // Lock for writing (removes entry)
 
     // Find the entry in the hash bucket
     unsigned long h = hash_key(key) % c->nbuckets; // Hash bucket index
@@ -651,7 +756,7 @@ void cache_stats(
     if (!c)
         return;
 
-    pthread_rwlock_rdlock(&c->rwlock); // Read Lock (stats only read)
+    cache_rdlock(c); // Read Lock (stats only read)
 
 
     // Copy statistics to output parameters if not NULL
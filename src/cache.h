@@ -4,6 +4,10 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/types.h>
+
+/* Security: files larger than this are never cached (served from disk), to prevent memory exhaustion */
+#define MAX_CACHE_FILE_SIZE (1024 * 1024) // 1MB
 
 /* Opaque types */
 typedef struct file_cache file_cache_t; // File cache structure
@@ -14,6 +18,9 @@ typedef struct {
     const uint8_t *data;    /* Read-only pointer to file contents */
     size_t size;            /* File size in bytes */
     cache_entry_t *_entry;  /* Internal use only */
+    int fd;                 /* Descriptor holding the contents (shared cache, see shcache.h), -1 = memory only */
+    off_t offset;           /* Offset of the contents in fd */
+    int _slot;              /* Internal use only (shared cache) */
 } cache_handle_t;
 
 /* Create an LRU cache with a maximum capacity in bytes */
@@ -34,6 +41,17 @@ abs_path: absolute filesystem path
  */
 bool cache_load_file(file_cache_t *cache, const char *key, const char *abs_path, cache_handle_t *out);
 
+/* Same, for a caller that just missed with cache_acquire, but only if the whole file is in the page
+   cache (preadv2 RWF_NOWAIT): never waits for the disk.
+   Returns 1 when loaded, -1 when reading would block, 0 on failure with errno set
+   (ENOENT, EACCES, EFBIG when the file is too large to cache, ...) */
+int cache_load_file_nowait(file_cache_t *cache, const char *key, const char *abs_path, cache_handle_t *out);
+
+/* Read a whole file (at most 1MB) into a malloc'd buffer, as the cache does on a miss.
+   With nowait only from the page cache. Returns 1, -1 when reading would block (nowait),
+   or 0 with errno set (see cache_load_file_nowait) */
+int cache_read_file(const char *abs_path, uint8_t **data, size_t *size, bool nowait);
+
 /* Invalidate an entry (if not in use). Returns true if invalidated */
 bool cache_invalidate(file_cache_t *cache, const char *key);
 
@@ -48,4 +66,10 @@ void cache_stats(
     size_t *out_evictions // Cache evictions
 );
 
+#ifdef CACHE_LOCK_STATS
+/* Lock accounting, only in builds with -DCACHE_LOCK_STATS (make bench-cache):
+   acquisitions of the cache lock, how many had to wait, and the total wait in ns */
+void cache_lock_stats(file_cache_t *cache, unsigned long *acquisitions, unsigned long *contended, unsigned long *wait_ns);
+#endif
+
 #endif 
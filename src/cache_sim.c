@@ -0,0 +1,556 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "log_format.h"
+#include "cache.h" // MAX_CACHE_FILE_SIZE
+
+// Offline file cache simulator
+//
+// Usage: cache_sim [-r docroot] [-c MB,...] [-w workers,...] [-p lru,fifo,clock] [-d rr,hash] [-o table|csv]
+//                  file...
+//
+// Replays access logs (LOG_FORMAT=text or extended lines, or binary logs, detected per file) through a model
+// of the per-worker file_cache_t and prints hit ratio and byte hit ratio for every combination of capacity
+// (CACHE_SIZE_MB), worker count (NUM_WORKERS), eviction policy and dispatch:
+//   lru    the current file_cache_t policy (least recently used first)
+//   fifo   oldest insertion first
+//   clock  second chance: a hit sets a reference bit that spares the entry once
+//   rr     the master's round-robin dispatch: request i goes to worker i % workers, so every worker ends
+//          up with its own copy of the popular files ("dup" = resident bytes / distinct resident bytes)
+//   hash   path affinity (each path always on the same worker), for comparison
+// Like file_cache_t, a file over MAX_CACHE_FILE_SIZE is never cached (every request for it is a miss), and a
+// file larger than the capacity empties the cache and is then not kept. Only file
+// requests are replayed (GET/HEAD answered 200, 206 or 416; "/" is /index.html). Sizes come from the
+// files under -r; without it, or for files that no longer exist, from the largest 200 response logged.
+// Pass rotated generations oldest first (e.g. access.log.2 access.log.1 access.log).
+
+#define MAX_LIST 32
+#define PATH_TABLE_INIT 4096 // Initial slots of the path table (power of two)
+
+#define POLICY_LRU 0
+#define POLICY_FIFO 1
+#define POLICY_CLOCK 2
+
+#define DISPATCH_RR 0
+#define DISPATCH_HASH 1
+
+static const char* const g_policy_names[] = { "lru", "fifo", "clock" };
+static const char* const g_dispatch_names[] = { "rr", "hash" };
+
+// Distinct paths of the trace
+typedef struct {
+    char* path;
+    uint32_t hash;
+    size_t size; // Bytes cached for the file
+    size_t logged_size; // Largest 200 response seen (fallback size)
+} object_t;
+
+static object_t* g_objects;
+static uint32_t g_num_objects;
+static uint32_t* g_slots; // Path table: object id + 1 (0 = empty)
+static uint32_t g_slot_mask;
+
+static uint32_t* g_trace; // Object id of every request, in log order
+static size_t g_trace_len;
+static size_t g_trace_cap;
+
+// ###############################################################################################################
+// Trace loading
+// ###############################################################################################################
+
+// FNV-1a
+static uint32_t hash_str(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void grow_table(void) {
+    uint32_t slots = g_slot_mask ? (g_slot_mask + 1) * 2 : PATH_TABLE_INIT;
+    uint32_t* table = calloc(slots, sizeof(uint32_t));
+    if (!table) {
+        perror("calloc");
+        exit(1);
+    }
+    for (uint32_t id = 0; id < g_num_objects; id++) {
+        uint32_t i = g_objects[id].hash & (slots - 1);
+        while (table[i]) {
+            i = (i + 1) & (slots - 1);
+        }
+        table[i] = id + 1;
+    }
+    free(g_slots);
+    g_slots = table;
+    g_slot_mask = slots - 1;
+}
+
+static uint32_t intern_path(const char* path) {
+    if ((size_t)g_num_objects * 2 >= (size_t)g_slot_mask) {
+        grow_table();
+    }
+    uint32_t h = hash_str(path);
+    uint32_t i = h & g_slot_mask;
+    while (g_slots[i]) {
+        object_t* o = &g_objects[g_slots[i] - 1];
+        if (o->hash == h && strcmp(o->path, path) == 0) {
+            return g_slots[i] - 1;
+        }
+        i = (i + 1) & g_slot_mask;
+    }
+
+    if ((g_num_objects & (g_num_objects - 1)) == 0) { // Power of two: double the array
+        object_t* grown = realloc(g_objects, (size_t)(g_num_objects ? g_num_objects * 2 : 1) * sizeof(object_t));
+        if (!grown) {
+            perror("realloc");
+            exit(1);
+        }
+        g_objects = grown;
+    }
+    object_t* o = &g_objects[g_num_objects];
+    o->path = strdup(path);
+    o->hash = h;
+    o->size = 0;
+    o->logged_size = 0;
+    g_slots[i] = g_num_objects + 1;
+    return g_num_objects++;
+}
+
+// Add one logged request to the trace if it went through the cache
+static void add_request(const char* method, const char* path, int status, size_t bytes) {
+    if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) {
+        return;
+    }
+    if (status != 200 && status != 206 && status != 416) {
+        return;
+    }
+    if (strncmp(path, "/api/", 5) == 0) {
+        return; // Generated, not a file
+    }
+    uint32_t id = intern_path(strcmp(path, "/") == 0 ? "/index.html" : path);
+    if (status == 200 && strcmp(method, "GET") == 0 && bytes > g_objects[id].logged_size) {
+        g_objects[id].logged_size = bytes;
+    }
+
+    if (g_trace_len == g_trace_cap) {
+        g_trace_cap = g_trace_cap ? g_trace_cap * 2 : 65536;
+        g_trace = realloc(g_trace, g_trace_cap * sizeof(uint32_t));
+        if (!g_trace) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    g_trace[g_trace_len++] = id;
+}
+
+// ip [date] "METHOD path" status bytes ...
+static int parse_text_line(char* line) {
+    char* q = strchr(line, '"');
+    if (!q) {
+        return -1;
+    }
+    char* method = q + 1;
+    char* sp = strchr(method, ' ');
+    if (!sp) {
+        return -1;
+    }
+    *sp = '\0';
+    char* path = sp + 1;
+    char* end = strchr(path, '"');
+    if (!end) {
+        return -1;
+    }
+    *end = '\0';
+
+    int status;
+    size_t bytes;
+    if (sscanf(end + 1, " %d %zu", &status, &bytes) != 2) {
+        return -1;
+    }
+    add_request(method, path, status, bytes);
+    return 0;
+}
+
+static int load_file(const char* file) {
+    FILE* fp = fopen(file, "rb");
+    if (!fp) {
+        perror(file);
+        return -1;
+    }
+
+    log_decoder_t* dec = log_decoder_open(fp);
+    if (dec) {
+        log_record_t rec;
+        int ret;
+        while ((ret = log_decoder_next(dec, &rec)) == 1) {
+            add_request(rec.method, rec.path, rec.status, rec.bytes_sent);
+        }
+        if (ret < 0) {
+            fprintf(stderr, "Warning: %s: corrupt or truncated frame at offset %ld\n", file, ftell(fp));
+        }
+        log_decoder_close(dec);
+        fclose(fp);
+        return 0;
+    }
+
+    rewind(fp);
+    char line[LOG_LINE_MAX + 1024];
+    size_t bad = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (parse_text_line(line) < 0) {
+            bad++;
+        }
+    }
+    if (bad) {
+        fprintf(stderr, "Warning: %s: %zu lines not in the access log format\n", file, bad);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void resolve_sizes(const char* docroot) {
+    char abs_path[2048];
+    size_t from_disk = 0;
+    for (uint32_t id = 0; id < g_num_objects; id++) {
+        object_t* o = &g_objects[id];
+        struct stat st;
+        o->size = o->logged_size;
+        if (docroot) {
+            snprintf(abs_path, sizeof(abs_path), "%s%s", docroot, o->path);
+            if (stat(abs_path, &st) == 0 && S_ISREG(st.st_mode)) {
+                o->size = (size_t)st.st_size;
+                from_disk++;
+            }
+        }
+    }
+    if (docroot && from_disk < g_num_objects) {
+        fprintf(stderr, "Note: %u of %u files not found under %s, sized from the log\n",
+                g_num_objects - (uint32_t)from_disk, g_num_objects, docroot);
+    }
+}
+
+// ###############################################################################################################
+// Cache model
+// ###############################################################################################################
+
+// One worker's cache: an intrusive list over the object ids (head = next to survive, tail = next victim)
+typedef struct {
+    size_t capacity;
+    size_t bytes_used;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t* prev;
+    uint32_t* next;
+    uint8_t* present;
+    uint8_t* referenced; // CLOCK reference bits
+    unsigned long long evictions;
+} sim_cache_t;
+
+#define NIL UINT32_MAX
+
+typedef struct {
+    int policy;
+    int dispatch;
+    int workers;
+    double capacity_mb;
+    unsigned long long requests;
+    unsigned long long hits;
+    unsigned long long bytes_requested;
+    unsigned long long bytes_hit;
+    unsigned long long evictions;
+    double resident_mb; // Sum over workers at the end
+    double distinct_mb; // Union over workers at the end
+} sim_result_t;
+
+static int cache_init(sim_cache_t* c, size_t capacity) {
+    memset(c, 0, sizeof(*c));
+    c->capacity = capacity;
+    c->head = c->tail = NIL;
+    c->prev = malloc(g_num_objects * sizeof(uint32_t));
+    c->next = malloc(g_num_objects * sizeof(uint32_t));
+    c->present = calloc(g_num_objects, 1);
+    c->referenced = calloc(g_num_objects, 1);
+    return (c->prev && c->next && c->present && c->referenced) ? 0 : -1;
+}
+
+static void cache_free(sim_cache_t* c) {
+    free(c->prev);
+    free(c->next);
+    free(c->present);
+    free(c->referenced);
+}
+
+static void list_unlink(sim_cache_t* c, uint32_t id) {
+    if (c->prev[id] != NIL) c->next[c->prev[id]] = c->next[id];
+    else c->head = c->next[id];
+    if (c->next[id] != NIL) c->prev[c->next[id]] = c->prev[id];
+    else c->tail = c->prev[id];
+}
+
+static void list_push_front(sim_cache_t* c, uint32_t id) {
+    c->prev[id] = NIL;
+    c->next[id] = c->head;
+    if (c->head != NIL) c->prev[c->head] = id;
+    c->head = id;
+    if (c->tail == NIL) c->tail = id;
+}
+
+static void drop(sim_cache_t* c, uint32_t id) {
+    list_unlink(c, id);
+    c->present[id] = 0;
+    c->bytes_used -= g_objects[id].size;
+    c->evictions++;
+}
+
+// Evict until within capacity, sparing keep (the entry being inserted, pinned like refcnt > 0)
+static void evict(sim_cache_t* c, int policy, uint32_t keep) {
+    while (c->bytes_used > c->capacity) {
+        uint32_t victim = c->tail;
+        if (victim == keep) {
+            victim = c->prev[victim];
+        }
+        if (victim == NIL) {
+            break;
+        }
+        if (policy == POLICY_CLOCK && c->referenced[victim]) {
+            c->referenced[victim] = 0; // Second chance: back to the head
+            list_unlink(c, victim);
+            list_push_front(c, victim);
+            continue;
+        }
+        drop(c, victim);
+    }
+}
+
+// One request. Returns 1 on a hit.
+static int cache_access(sim_cache_t* c, int policy, uint32_t id) {
+    if (c->present[id]) {
+        if (policy == POLICY_LRU) {
+            list_unlink(c, id);
+            list_push_front(c, id);
+        } else if (policy == POLICY_CLOCK) {
+            c->referenced[id] = 1;
+        }
+        return 1;
+    }
+    if (g_objects[id].size > MAX_CACHE_FILE_SIZE) {
+        return 0; // Uncacheable: read from disk every time
+    }
+
+    c->present[id] = 1;
+    c->referenced[id] = 0;
+    c->bytes_used += g_objects[id].size;
+    list_push_front(c, id);
+    evict(c, policy, id);
+    if (c->bytes_used > c->capacity) {
+        drop(c, id); // Larger than the whole cache: evicted on release (the others are gone already)
+    }
+    return 0;
+}
+
+static int simulate(int policy, int dispatch, int workers, double capacity_mb, sim_result_t* r) {
+    sim_cache_t* caches = calloc((size_t)workers, sizeof(sim_cache_t));
+    if (!caches) {
+        return -1;
+    }
+    for (int w = 0; w < workers; w++) {
+        if (cache_init(&caches[w], (size_t)(capacity_mb * 1024 * 1024)) < 0) {
+            fprintf(stderr, "Error: out of memory\n");
+            exit(1);
+        }
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->policy = policy;
+    r->dispatch = dispatch;
+    r->workers = workers;
+    r->capacity_mb = capacity_mb;
+
+    for (size_t i = 0; i < g_trace_len; i++) {
+        uint32_t id = g_trace[i];
+        int w = (dispatch == DISPATCH_RR) ? (int)(i % (size_t)workers) : (int)(g_objects[id].hash % (uint32_t)workers);
+        size_t size = g_objects[id].size;
+        r->requests++;
+        r->bytes_requested += size;
+        if (cache_access(&caches[w], policy, id)) {
+            r->hits++;
+            r->bytes_hit += size;
+        }
+    }
+
+    for (uint32_t id = 0; id < g_num_objects; id++) {
+        int copies = 0;
+        for (int w = 0; w < workers; w++) {
+            copies += caches[w].present[id];
+        }
+        r->resident_mb += (double)copies * (double)g_objects[id].size / 1048576.0;
+        if (copies) {
+            r->distinct_mb += (double)g_objects[id].size / 1048576.0;
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        r->evictions += caches[w].evictions;
+        cache_free(&caches[w]);
+    }
+    free(caches);
+    return 0;
+}
+
+// ###############################################################################################################
+// Command line and output
+// ###############################################################################################################
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-r docroot] [-c MB,...] [-w workers,...] [-p lru,fifo,clock] [-d rr,hash] "
+                    "[-o table|csv] file...\n", prog);
+}
+
+// Comma-separated numbers. Returns the count, -1 on error.
+static int parse_numbers(char* arg, double* out) {
+    int n = 0;
+    char* save = NULL;
+    for (char* tok = strtok_r(arg, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char* end;
+        double v = strtod(tok, &end);
+        if (*end || v <= 0 || n == MAX_LIST) {
+            return -1;
+        }
+        out[n++] = v;
+    }
+    return n;
+}
+
+// Comma-separated names from names[]. Returns the count, -1 on error.
+static int parse_names(char* arg, const char* const* names, int num_names, int* out) {
+    int n = 0;
+    char* save = NULL;
+    for (char* tok = strtok_r(arg, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int found = -1;
+        for (int i = 0; i < num_names; i++) {
+            if (strcmp(tok, names[i]) == 0) {
+                found = i;
+            }
+        }
+        if (found < 0 || n == MAX_LIST) {
+            return -1;
+        }
+        out[n++] = found;
+    }
+    return n;
+}
+
+static void print_result(const sim_result_t* r, int csv) {
+    double hit = r->requests ? (double)r->hits / (double)r->requests : 0;
+    double byte_hit = r->bytes_requested ? (double)r->bytes_hit / (double)r->bytes_requested : 0;
+    double dup = (r->distinct_mb > 0) ? r->resident_mb / r->distinct_mb : 0;
+    if (csv) {
+        printf("%s,%s,%d,%g,%llu,%.4f,%.4f,%llu,%.2f,%.3f\n", g_policy_names[r->policy],
+               g_dispatch_names[r->dispatch], r->workers, r->capacity_mb, r->requests, hit, byte_hit, r->evictions,
+               r->resident_mb, dup);
+    } else {
+        printf("%-6s %-5s %7d %10g %8.2f%% %9.2f%% %10llu %11.2f %6.2f\n", g_policy_names[r->policy],
+               g_dispatch_names[r->dispatch], r->workers, r->capacity_mb, 100 * hit, 100 * byte_hit, r->evictions,
+               r->resident_mb, dup);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* docroot = NULL;
+    double capacities[MAX_LIST] = { 1, 2, 5, 10, 20, 50, 100 };
+    int num_capacities = 7;
+    double worker_counts[MAX_LIST] = { 1, 2, 4, 8 };
+    int num_workers = 4;
+    int policies[MAX_LIST] = { POLICY_LRU };
+    int num_policies = 1;
+    int dispatches[MAX_LIST] = { DISPATCH_RR };
+    int num_dispatches = 1;
+    int csv = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:c:w:p:d:o:")) != -1) {
+        int n = 0;
+        switch (opt) {
+        case 'r':
+            docroot = optarg;
+            break;
+        case 'c':
+            n = num_capacities = parse_numbers(optarg, capacities);
+            break;
+        case 'w':
+            n = num_workers = parse_numbers(optarg, worker_counts);
+            break;
+        case 'p':
+            n = num_policies = parse_names(optarg, g_policy_names, 3, policies);
+            break;
+        case 'd':
+            n = num_dispatches = parse_names(optarg, g_dispatch_names, 2, dispatches);
+            break;
+        case 'o':
+            if (strcmp(optarg, "csv") == 0) {
+                csv = 1;
+            } else if (strcmp(optarg, "table") != 0) {
+                n = -1;
+            }
+            break;
+        default:
+            n = -1;
+        }
+        if (n < 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (load_file(argv[i]) < 0) {
+            return 1;
+        }
+    }
+    if (g_trace_len == 0) {
+        fprintf(stderr, "Error: no file requests in the logs\n");
+        return 1;
+    }
+    resolve_sizes(docroot);
+
+    double distinct_mb = 0;
+    for (uint32_t id = 0; id < g_num_objects; id++) {
+        distinct_mb += (double)g_objects[id].size / 1048576.0;
+    }
+    size_t uncacheable = 0; // Requests for files over MAX_CACHE_FILE_SIZE: misses under every configuration
+    for (size_t i = 0; i < g_trace_len; i++) {
+        uncacheable += g_objects[g_trace[i]].size > MAX_CACHE_FILE_SIZE;
+    }
+
+    if (csv) {
+        printf("policy,dispatch,workers,capacity_mb,requests,hit_ratio,byte_hit_ratio,evictions,resident_mb,dup\n");
+    } else {
+        printf("%zu requests, %u files, %.2f MB working set, %zu requests for files over %d KB (never cached)\n",
+               g_trace_len, g_num_objects, distinct_mb, uncacheable, MAX_CACHE_FILE_SIZE / 1024);
+        printf("%-6s %-5s %7s %10s %9s %10s %10s %11s %6s\n", "policy", "disp", "workers", "cache(MB)", "hit",
+               "byte-hit", "evictions", "resident(MB)", "dup");
+    }
+    for (int p = 0; p < num_policies; p++) {
+        for (int d = 0; d < num_dispatches; d++) {
+            for (int w = 0; w < num_workers; w++) {
+                for (int c = 0; c < num_capacities; c++) {
+                    sim_result_t r;
+                    if (simulate(policies[p], dispatches[d], (int)worker_counts[w], capacities[c], &r) < 0) {
+                        return 1;
+                    }
+                    print_result(&r, csv);
+                }
+            }
+        }
+    }
+    return 0;
+}
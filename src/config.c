@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 
 // Function to load server configuration from a file
@@ -58,6 +59,34 @@ int load_config(const char* filename, server_config_t* config) {
             
                 config->port = atoi(value);
 
+            } else if (strcmp(key, "LISTEN") == 0) {
+
+                // One more listening address (repeatable; parsed by the master when it binds)
+                if (config->num_listen >= MAX_LISTENERS || strlen(value) >= LISTEN_ADDR_MAX) {
+                    fprintf(stderr, "Config: ignoring LISTEN=%s (at most %d entries of %d characters)\n",
+                            value, MAX_LISTENERS, LISTEN_ADDR_MAX - 1);
+                } else {
+                    strcpy(config->listen[config->num_listen++], value);
+                }
+
+            } else if (strcmp(key, "BUSY_POLL_US") == 0) {
+
+                // Low-latency mode: spin this long before blocking
+                config->busy_poll_us = atoi(value);
+
+            } else if (strcmp(key, "CPU_AFFINITY") == 0) {
+
+                // CPU-affine connection steering: "auto", a CPU list such as 0-3,8, or "off"
+                size_t len = strlen(value);
+                if (len > sizeof(config->cpu_affinity) - 1){
+                    len = sizeof(config->cpu_affinity) - 1;
+                };
+                memcpy(config->cpu_affinity, value, len);
+                config->cpu_affinity[len] = '\0';
+                if (strcasecmp(config->cpu_affinity, "off") == 0) {
+                    config->cpu_affinity[0] = '\0';
+                }
+
             } else if (strcmp(key, "NUM_WORKERS") == 0) {
 
                 // Convert the number of workers from string to integer
@@ -88,6 +117,19 @@ int load_config(const char* filename, server_config_t* config) {
 
                 config->document_root[len] = '\0';
 
+            } else if (strcmp(key, "DOCPACK") == 0) {
+
+                // Docroot bundle built by bin/docpack_build (mapped by the master at startup)
+                size_t len = strlen(value);
+
+                // Ensure the string does not exceed the buffer size
+                if (len > sizeof(config->docpack) - 1){
+                    len = sizeof(config->docpack) - 1;
+                };
+
+                memcpy(config->docpack, value, len);
+                config->docpack[len] = '\0';
+
             } else if (strcmp(key, "LOG_FILE") == 0) {
 
                 // Copy the log file path into the configuration structure
@@ -102,6 +144,19 @@ int load_config(const char* filename, server_config_t* config) {
                 memcpy(config->log_file, value, len);
                 config->log_file[len] = '\0';
 
+            } else if (strcmp(key, "INSTANCE_NAME") == 0) {
+
+                // Name of the shared memory segment (validated by shm_instance_name())
+                size_t len = strlen(value);
+
+                // Ensure the string does not exceed the buffer size
+                if (len > sizeof(config->instance_name) - 1){
+                    len = sizeof(config->instance_name) - 1;
+                };
+
+                memcpy(config->instance_name, value, len);
+                config->instance_name[len] = '\0';
+
             } else if (strcmp(key, "MAX_QUEUE_SIZE") == 0) {
 
                 // Convert the max queue size from string to integer
@@ -112,10 +167,109 @@ int load_config(const char* filename, server_config_t* config) {
                 // Convert the cache size from string to integer
                 config->cache_size_mb = atoi(value);
 
+            } else if (strcmp(key, "SHARED_CACHE_MB") == 0) {
+
+                // One cache for all workers instead of CACHE_SIZE_MB per worker
+                config->shared_cache_mb = atoi(value);
+
+            } else if (strcmp(key, "DISK_IO_THREADS") == 0) {
+
+                // Threads per worker that read files not in the page cache
+                config->disk_io_threads = atoi(value);
+
+            } else if (strcmp(key, "DISK_IO_QUEUE") == 0) {
+
+                // Bound of the disk I/O queue of each worker
+                config->disk_io_queue = atoi(value);
+
+            } else if (strcmp(key, "ZEROCOPY_MIN_KB") == 0) {
+
+                // Zero-copy threshold for response bodies
+                config->zerocopy_min_kb = atoi(value);
+
+            } else if (strcmp(key, "TCP_NOTSENT_LOWAT_KB") == 0) {
+
+                // Unsent bytes queued per connection before send() blocks
+                config->notsent_lowat_kb = atoi(value);
+
+            } else if (strcmp(key, "SNDBUF_MAX_KB") == 0) {
+
+                // Cap of the per-response send buffer
+                config->sndbuf_max_kb = atoi(value);
+
             } else if (strcmp(key, "TIMEOUT_SECONDS") == 0) {
 
                 // Convert the timeout duration from string to integer
                 config->timeout_seconds = atoi(value);
+
+            } else if (strcmp(key, "LOG_RING_SIZE") == 0) {
+
+                // Number of pending log records each process can buffer
+                config->log_ring_size = atoi(value);
+
+            } else if (strcmp(key, "LOG_OVERFLOW") == 0) {
+
+                // "drop" discards records when the ring is full, anything else blocks
+                if (strcasecmp(value, "drop") == 0) {
+                    config->log_overflow_policy = LOG_OVERFLOW_DROP;
+                } else {
+                    config->log_overflow_policy = LOG_OVERFLOW_BLOCK;
+                }
+
+            } else if (strcmp(key, "LOG_FORMAT") == 0) {
+
+                // "binary" selects the compact binary format, "extended" adds timings to text lines
+                if (strcasecmp(value, "binary") == 0) {
+                    config->log_format = LOG_FORMAT_BINARY;
+                } else if (strcasecmp(value, "extended") == 0) {
+                    config->log_format = LOG_FORMAT_EXTENDED;
+                } else {
+                    config->log_format = LOG_FORMAT_TEXT;
+                }
+
+            } else if (strcmp(key, "LOG_LEVEL") == 0) {
+
+                // Minimum level for diagnostics and access log entries
+                if (strcasecmp(value, "DEBUG") == 0) {
+                    config->log_level = LOG_LEVEL_DEBUG;
+                } else if (strcasecmp(value, "WARN") == 0 || strcasecmp(value, "WARNING") == 0) {
+                    config->log_level = LOG_LEVEL_WARN;
+                } else if (strcasecmp(value, "ERROR") == 0) {
+                    config->log_level = LOG_LEVEL_ERROR;
+                } else {
+                    config->log_level = LOG_LEVEL_INFO;
+                }
+
+            } else if (strcmp(key, "ACCESS_LOG_SAMPLE") == 0) {
+
+                // Sampling rate for normal requests (1 = log every request)
+                config->access_log_sample = atoi(value);
+
+            } else if (strcmp(key, "ACCESS_LOG_SLOW_MS") == 0) {
+
+                // Latency threshold above which requests are always logged
+                config->access_log_slow_ms = atoi(value);
+
+            } else if (strcmp(key, "LOG_MAX_SIZE_MB") == 0) {
+
+                // Size at which the access log is rotated
+                config->log_max_size_mb = atoi(value);
+
+            } else if (strcmp(key, "LOG_ROTATE_INTERVAL_SEC") == 0) {
+
+                // Age at which the access log is rotated
+                config->log_rotate_interval_sec = atoi(value);
+
+            } else if (strcmp(key, "LOG_MAX_FILES") == 0) {
+
+                // Number of rotated generations to keep
+                config->log_max_files = atoi(value);
+
+            } else if (strcmp(key, "LOG_COMPRESS") == 0) {
+
+                // "1"/"yes"/"true" compresses rotated generations in the background
+                config->log_compress = (atoi(value) > 0 || strcasecmp(value, "yes") == 0 ||
+                                        strcasecmp(value, "true") == 0);
             }
         }
     }
@@ -1,17 +1,58 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// Access log overflow policies (what a request thread does when the log ring is full)
+#define LOG_OVERFLOW_DROP  0 // Discard the record and count it as dropped
+#define LOG_OVERFLOW_BLOCK 1 // Wait for the writer thread to free a slot
+
+// Access log formats
+#define LOG_FORMAT_TEXT   0 // One text line per request
+#define LOG_FORMAT_BINARY 1 // Compact binary frames (see log_format.h, decoded by bin/log_reader)
+#define LOG_FORMAT_EXTENDED 2 // Text line plus microsecond timings, cache outcome, worker/thread and wire bytes
+
+// Log levels (LOG_LEVEL in server.conf). Access log entries are INFO for normal requests,
+// WARN for 4xx and slow requests and ERROR for 5xx, so LOG_LEVEL=WARN is an error-only access log.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+
+#define MAX_LISTENERS 8 // LISTEN= entries in server.conf
+#define LISTEN_ADDR_MAX 128 // Longest LISTEN= value + 1
+
 // Configuration structure for the server
 typedef struct {
     
-    int port; // Port number the server listens on
+    int port; // Port number the server listens on (when there are no LISTEN= entries)
+    char listen[MAX_LISTENERS][LISTEN_ADDR_MAX]; // Listening addresses: "host:port", "[ipv6]:port", "port" or "unix:/path"
+    int num_listen; // Number of LISTEN= entries (0 = listen on 0.0.0.0:port)
+    char instance_name[64]; // Names this instance's IPC objects (empty = use the port)
     char document_root[256]; // Root directory for serving files
+    char docpack[256]; // Docroot bundle served instead of document_root (empty = serve files)
     int num_workers; // Number of worker processes
     int threads_per_worker; // Number of threads per worker process
     int max_queue_size; // Maximum size of the request queue
     char log_file[256]; // Path to the log file
     int cache_size_mb; // Cache size in megabytes
+    int shared_cache_mb; // Size of one cache shared by all workers in megabytes (0 = a cache per worker)
+    int disk_io_threads; // Disk I/O threads per worker for cache misses that wait for the disk (0 = read on the request thread)
+    int disk_io_queue; // Cache misses that may wait for a disk I/O thread before requests get 503
+    int zerocopy_min_kb; // Response bodies of at least this many KB are sent with MSG_ZEROCOPY (0 = never)
+    int notsent_lowat_kb; // TCP_NOTSENT_LOWAT of client connections in KB (0 = kernel default)
+    int sndbuf_max_kb; // Largest SO_SNDBUF sized per response in KB (0 = kernel autotuning)
+    int busy_poll_us; // Spin budget of the accept and dispatch loops, and SO_BUSY_POLL of the sockets (0 = block)
+    char cpu_affinity[128]; // Workers pinned to CPUs, accepting TCP connections steered by CPU: "auto" or a list (empty = off)
     int timeout_seconds; // Timeout duration in seconds
+    int log_ring_size; // Number of records in each process's log ring (rounded up to a power of two)
+    int log_overflow_policy; // LOG_OVERFLOW_DROP or LOG_OVERFLOW_BLOCK
+    int log_format; // LOG_FORMAT_TEXT, LOG_FORMAT_BINARY or LOG_FORMAT_EXTENDED
+    int log_level; // Minimum level written (LOG_LEVEL_*)
+    int access_log_sample; // Log 1 in N normal (INFO) requests; errors and slow requests are always logged
+    int access_log_slow_ms; // Requests taking at least this long are logged as slow (0 = disabled)
+    int log_max_size_mb; // Rotate the access log once it reaches this size (0 = no size limit)
+    int log_rotate_interval_sec; // Rotate the access log once it is this old (0 = no age limit)
+    int log_max_files; // Rotated generations kept (access.log.1 ... access.log.N)
+    int log_compress; // Compress rotated generations with gzip (1 = yes)
 
 } server_config_t; // Server configuration structure
 
@@ -0,0 +1,131 @@
+#include "disk_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+struct disk_pool {
+    pthread_t* threads;
+    int num_threads;
+
+    pthread_mutex_t mutex; // Protects the queue and shutdown
+    pthread_cond_t cond; // Signalled when a job is queued or on shutdown
+    int shutdown;
+
+    disk_job_t* head; // FIFO of pending jobs
+    disk_job_t* tail;
+    int count;
+    int capacity;
+
+    worker_health_t* health; // disk_queued (NULL = not reported)
+};
+
+static void publish_count(disk_pool_t* pool) {
+    if (pool->health) {
+        atomic_store_explicit(&pool->health->disk_queued, pool->count, memory_order_relaxed);
+    }
+}
+
+// Disk thread: runs jobs until shutdown and an empty queue
+static void* disk_thread(void* arg) {
+    disk_pool_t* pool = arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->head && !pool->shutdown) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+        disk_job_t* job = pool->head;
+        if (!job) {
+            pthread_mutex_unlock(&pool->mutex); // Shutdown, nothing left
+            break;
+        }
+        pool->head = job->next;
+        if (!pool->head) {
+            pool->tail = NULL;
+        }
+        pool->count--;
+        publish_count(pool);
+        pthread_mutex_unlock(&pool->mutex);
+
+        job->next = NULL;
+        job->run(job);
+    }
+    return NULL;
+}
+
+disk_pool_t* disk_pool_create(int num_threads, int capacity, worker_health_t* health) {
+    disk_pool_t* pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->threads = calloc((size_t)num_threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+    pool->capacity = capacity;
+    pool->health = health;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    publish_count(pool);
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, disk_thread, pool) != 0) {
+            perror("disk_pool_create: pthread_create");
+            break;
+        }
+        pool->num_threads++;
+    }
+    if (pool->num_threads == 0) {
+        disk_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int disk_pool_submit(disk_pool_t* pool, disk_job_t* job) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->shutdown || pool->count >= pool->capacity) {
+        int rc = pool->shutdown ? -2 : -1;
+        pthread_mutex_unlock(&pool->mutex);
+        return rc;
+    }
+    job->next = NULL;
+    if (pool->tail) {
+        pool->tail->next = job;
+    } else {
+        pool->head = job;
+    }
+    pool->tail = job;
+    pool->count++;
+    publish_count(pool);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+void disk_pool_stop(disk_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    // The threads empty the queue before they exit
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->num_threads = 0;
+}
+
+void disk_pool_destroy(disk_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    disk_pool_stop(pool);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,37 @@
+#ifndef DISK_IO_H
+#define DISK_IO_H
+
+#include "shared_mem.h" // worker_health_t
+
+// ###################################################################################################################
+// Disk I/O pool: a few threads, separate from the request threads, for cache misses that have to wait for the disk
+//
+// A request thread that misses the cache first tries to read the file from the page cache only
+// (cache_load_file_nowait()). When that would block, it hands the request to this pool and goes back to serving
+// other connections; the disk thread reads the file and passes the request back to the request threads to send.
+// The queue is bounded (DISK_IO_QUEUE): when it is full the caller answers 503 instead of blocking.
+// ###################################################################################################################
+
+// A unit of work. Embed it as the first member of the caller's own structure.
+typedef struct disk_job {
+    struct disk_job* next; // Queue link (owned by the pool while queued)
+    void (*run)(struct disk_job* job); // Called on a disk I/O thread; takes ownership of the job
+} disk_job_t;
+
+typedef struct disk_pool disk_pool_t;
+
+// Starts num_threads threads with room for capacity queued jobs. health (may be NULL) receives the
+// disk_queued count. Returns NULL on failure.
+disk_pool_t* disk_pool_create(int num_threads, int capacity, worker_health_t* health);
+
+// Queues job. Returns 0; -1 when the queue is full (the caller sheds the request); -2 once the pool is
+// stopping (the caller does the work itself). The job is untouched on failure.
+int disk_pool_submit(disk_pool_t* pool, disk_job_t* job);
+
+// Refuses new jobs, runs the ones still queued and joins the threads. Safe to call twice.
+void disk_pool_stop(disk_pool_t* pool);
+
+// Stops the pool and frees it.
+void disk_pool_destroy(disk_pool_t* pool);
+
+#endif // DISK_IO_H
@@ -0,0 +1,161 @@
+#include "docpack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct docpack {
+    const uint8_t* base; // Read-only mapping of the whole bundle
+    size_t size;
+    const docpack_header_t* header;
+    const uint32_t* disp; // Displacement per bucket
+    const docpack_entry_t* entries; // Entry per slot
+    const char* strings; // String table
+};
+
+uint64_t docpack_hash(const char* key, size_t len, uint32_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ ((uint64_t)seed * 0x9e3779b97f4a7c15ULL);
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 0x100000001b3ULL;
+    }
+    // fmix64 (MurmurHash3): FNV alone leaves the low bits too regular for "% count"
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// (offset, length) inside the region [0, limit)
+static int in_range(uint64_t off, uint64_t len, uint64_t limit) {
+    return off <= limit && len <= limit - off;
+}
+
+// Every reference of every entry must stay inside the mapping: lookups do no bounds checks
+static int docpack_validate(const docpack_t* p, const char* path) {
+    const docpack_header_t* h = p->header;
+    if (memcmp(h->magic, DOCPACK_MAGIC, sizeof(h->magic)) != 0) {
+        fprintf(stderr, "docpack: %s is not a docroot bundle\n", path);
+        return -1;
+    }
+    if (h->version != DOCPACK_VERSION) {
+        fprintf(stderr, "docpack: %s has format version %u, expected %u\n", path, h->version, DOCPACK_VERSION);
+        return -1;
+    }
+    if (h->file_size != p->size) {
+        fprintf(stderr, "docpack: %s is truncated (%zu of %llu bytes)\n", path, p->size,
+                (unsigned long long)h->file_size);
+        return -1;
+    }
+    if ((h->count > 0 && h->buckets == 0) ||
+        !in_range(h->disp_off, (uint64_t)h->buckets * sizeof(uint32_t), p->size) ||
+        !in_range(h->entries_off, (uint64_t)h->count * sizeof(docpack_entry_t), p->size) ||
+        !in_range(h->strings_off, h->strings_len, p->size) ||
+        h->disp_off % sizeof(uint32_t) != 0 || h->entries_off % sizeof(uint64_t) != 0) {
+        fprintf(stderr, "docpack: %s has a corrupt header\n", path);
+        return -1;
+    }
+    for (uint32_t i = 0; i < h->count; i++) {
+        const docpack_entry_t* e = &p->entries[i];
+        if (!in_range(e->path_off, e->path_len, h->strings_len) ||
+            !in_range(e->type_off, (uint64_t)e->type_len + 1, h->strings_len) ||
+            p->strings[e->type_off + e->type_len] != '\0' ||
+            !in_range(e->etag_off, e->etag_len, h->strings_len) ||
+            !in_range(e->gz_etag_off, e->gz_etag_len, h->strings_len) ||
+            !in_range(e->hdr_off, e->hdr_len, h->strings_len) ||
+            !in_range(e->gz_hdr_off, e->gz_hdr_len, h->strings_len) ||
+            !in_range(e->body_off, e->body_len, p->size) ||
+            !in_range(e->gz_off, e->gz_len, p->size)) {
+            fprintf(stderr, "docpack: %s has a corrupt entry (slot %u)\n", path, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+docpack_t* docpack_open(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(docpack_header_t)) {
+        fprintf(stderr, "docpack: %s is too small to be a docroot bundle\n", path);
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file
+    if (base == MAP_FAILED) {
+        perror("docpack: mmap");
+        return NULL;
+    }
+
+    docpack_t* p = calloc(1, sizeof(*p));
+    if (!p) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    p->base = base;
+    p->size = (size_t)st.st_size;
+    p->header = (const docpack_header_t*)p->base;
+    p->disp = (const uint32_t*)(p->base + p->header->disp_off);
+    p->entries = (const docpack_entry_t*)(p->base + p->header->entries_off);
+    p->strings = (const char*)(p->base + p->header->strings_off);
+    if (docpack_validate(p, path) != 0) {
+        docpack_close(p);
+        return NULL;
+    }
+    return p;
+}
+
+void docpack_close(docpack_t* pack) {
+    if (!pack) {
+        return;
+    }
+    munmap((void*)pack->base, pack->size);
+    free(pack);
+}
+
+size_t docpack_count(const docpack_t* pack) {
+    return pack ? pack->header->count : 0;
+}
+
+int docpack_lookup(const docpack_t* pack, const char* path, int want_gzip, docpack_file_t* out) {
+    const docpack_header_t* h = pack->header;
+    if (h->count == 0) {
+        return 0;
+    }
+    size_t len = strlen(path);
+    uint32_t bucket = (uint32_t)(docpack_hash(path, len, 0) % h->buckets);
+    uint32_t slot = (uint32_t)(docpack_hash(path, len, pack->disp[bucket]) % h->count);
+    const docpack_entry_t* e = &pack->entries[slot];
+    if (e->path_len != len || memcmp(pack->strings + e->path_off, path, len) != 0) {
+        return 0;
+    }
+
+    out->content_type = pack->strings + e->type_off;
+    out->gzip = want_gzip && e->gz_len > 0;
+    if (out->gzip) {
+        out->body = (const char*)pack->base + e->gz_off;
+        out->body_len = e->gz_len;
+        out->headers = pack->strings + e->gz_hdr_off;
+        out->headers_len = e->gz_hdr_len;
+        out->etag = pack->strings + e->gz_etag_off;
+        out->etag_len = e->gz_etag_len;
+    } else {
+        out->body = (const char*)pack->base + e->body_off;
+        out->body_len = e->body_len;
+        out->headers = pack->strings + e->hdr_off;
+        out->headers_len = e->hdr_len;
+        out->etag = pack->strings + e->etag_off;
+        out->etag_len = e->etag_len;
+    }
+    return 1;
+}
@@ -0,0 +1,86 @@
+#ifndef DOCPACK_H
+#define DOCPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ###############################################################################################################
+// Document root bundle (DOCPACK=<file> in server.conf, built by bin/docpack_build)
+//
+// One read-only file holding a whole document root, mapped once by the master and shared by every worker
+// through the page cache: a lookup is a perfect-hash probe and a response a writev() from the mapping, with
+// no open/stat/read per request and no per-worker cache.
+//
+//   header       docpack_header_t
+//   displacement uint32_t[buckets]           second-level seed of each first-level bucket
+//   entries      docpack_entry_t[count]      one per file, at the slot the hash assigns to its path
+//   strings      paths, Content-Type values, ETags and precomputed header blocks
+//   bodies       file contents, each starting on a DOCPACK_ALIGN boundary, optionally followed by a
+//                gzip-compressed variant
+//
+// The index is a minimal perfect hash (hash and displace): bucket = hash(path, 0) % buckets,
+// slot = hash(path, displacement[bucket]) % count. The path stored at the slot is compared to reject names
+// that are not in the bundle. All integers are native endian: bundles are built on the serving machine.
+// ###############################################################################################################
+
+#define DOCPACK_MAGIC "WSDPACK1" // 8 bytes, no terminator in the file
+#define DOCPACK_VERSION 1 // Format version
+#define DOCPACK_ALIGN 4096 // Alignment of file bodies
+
+typedef struct {
+    char magic[8]; // DOCPACK_MAGIC
+    uint32_t version; // DOCPACK_VERSION
+    uint32_t count; // Files (= index slots)
+    uint32_t buckets; // First-level buckets
+    uint32_t reserved;
+    uint64_t disp_off; // Displacement table
+    uint64_t entries_off; // Entry table
+    uint64_t strings_off; // String table
+    uint64_t strings_len;
+    uint64_t file_size; // Size of the whole bundle (truncation check)
+} docpack_header_t;
+
+// String table references are (offset, length) pairs relative to strings_off; bodies are file offsets.
+typedef struct {
+    uint32_t path_off, path_len; // Request path ("/css/site.css")
+    uint32_t type_off, type_len; // Content-Type value (followed by a NUL)
+    uint32_t etag_off, etag_len; // Quoted ETag of the identity body
+    uint32_t gz_etag_off, gz_etag_len; // Quoted ETag of the gzip variant
+    uint32_t hdr_off, hdr_len; // Content-Type, ETag (and Vary) header lines, ending with the blank line
+    uint32_t gz_hdr_off, gz_hdr_len; // Same for the gzip variant, with Content-Encoding: gzip
+    uint64_t body_off, body_len; // Identity body
+    uint64_t gz_off, gz_len; // gzip variant (gz_len = 0: none)
+} docpack_entry_t;
+
+// Opaque handle of a mapped bundle
+typedef struct docpack docpack_t;
+
+// One representation of a file, pointing into the mapping
+typedef struct {
+    const char* body; // Response body
+    size_t body_len;
+    const char* headers; // Header lines after the status line, Content-Length, Server, Date and Connection
+    size_t headers_len; // (ends with the blank line that closes the header)
+    const char* content_type; // Content-Type value (NUL-terminated)
+    const char* etag; // Quoted, not terminated
+    size_t etag_len;
+    int gzip; // body is the gzip variant
+} docpack_file_t;
+
+// Maps a bundle read-only and checks its header and tables. Returns NULL (reason on stderr) on failure.
+docpack_t* docpack_open(const char* path);
+
+// Unmaps the bundle.
+void docpack_close(docpack_t* pack);
+
+// Number of files in the bundle
+size_t docpack_count(const docpack_t* pack);
+
+// Looks a request path up. want_gzip selects the gzip variant when the file has one.
+// Returns 1 and fills out when the path is in the bundle, 0 otherwise.
+int docpack_lookup(const docpack_t* pack, const char* path, int want_gzip, docpack_file_t* out);
+
+// Index hash (also used by bin/docpack_build): 64-bit FNV-1a of key, seeded, with a final avalanche
+uint64_t docpack_hash(const char* key, size_t len, uint32_t seed);
+
+#endif // DOCPACK_H
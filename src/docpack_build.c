@@ -0,0 +1,511 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "docpack.h"
+#include "http_builder.h" // mime_type_from_path
+
+// Document root bundle builder
+//
+// Usage: docpack_build [-z] [-l level] [-m min] [-q] docroot out.pack
+//
+// Packs every regular file under docroot into one bundle for DOCPACK=out.pack (format in docpack.h):
+// a minimal perfect hash index over the request paths, page-aligned bodies and, per file, the
+// Content-Type, a strong ETag (FNV-1a of the contents) and the header lines the server sends with it.
+//   -z   also store a gzip variant of compressible files (text/*, JavaScript, JSON, SVG, XML) when it
+//        is at least 10% smaller; the server sends it to clients with "Accept-Encoding: gzip"
+//   -l   gzip level (default 9)
+//   -m   smallest file compressed, in bytes (default 256)
+//   -q   no per-file listing
+// The bundle is written to out.pack.tmp and renamed, so a running server keeps its old mapping.
+// Rebuild after changing the docroot and restart the server to pick the new bundle up.
+
+#define MAX_DEPTH 32 // Directory nesting followed
+#define BUCKET_LOAD 4 // Average paths per first-level bucket
+#define MAX_DISPLACEMENT 100000000u // Give up on a bucket after this many seeds
+
+typedef struct {
+    char* path; // Request path ("/css/site.css")
+    char* fs_path; // File on disk
+    size_t size;
+    const char* type; // Content-Type
+    uint8_t* gz; // gzip variant (NULL = none)
+    size_t gz_len;
+    uint32_t slot; // Index slot assigned by the perfect hash
+    uint32_t bucket;
+} pack_file_t;
+
+static pack_file_t* g_files;
+static size_t g_num_files;
+static size_t g_cap_files;
+
+// Growable string table
+static char* g_strings;
+static size_t g_strings_len;
+static size_t g_strings_cap;
+
+static int g_gzip = 0;
+static int g_level = 9;
+static size_t g_min_gzip = 256;
+static int g_quiet = 0;
+
+// ###############################################################################################################
+// Collecting files
+// ###############################################################################################################
+
+static int add_file(const char* path, const char* fs_path, size_t size) {
+    if (g_num_files == g_cap_files) {
+        size_t cap = g_cap_files ? g_cap_files * 2 : 256;
+        pack_file_t* files = realloc(g_files, cap * sizeof(*files));
+        if (!files) {
+            return -1;
+        }
+        g_files = files;
+        g_cap_files = cap;
+    }
+    pack_file_t* f = &g_files[g_num_files];
+    memset(f, 0, sizeof(*f));
+    f->path = strdup(path);
+    f->fs_path = strdup(fs_path);
+    if (!f->path || !f->fs_path) {
+        return -1;
+    }
+    f->size = size;
+    f->type = mime_type_from_path(path);
+    g_num_files++;
+    return 0;
+}
+
+// Walks dir (request path prefix rel) depth first. Hidden entries are left out.
+static int scan_dir(const char* dir, const char* rel, int depth) {
+    if (depth > MAX_DEPTH) {
+        fprintf(stderr, "Error: %s: directories nested too deep\n", dir);
+        return -1;
+    }
+    DIR* d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return -1;
+    }
+    struct dirent* de;
+    int rc = 0;
+    while (rc == 0 && (de = readdir(d))) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        char fs_path[4096], path[4096];
+        if (snprintf(fs_path, sizeof(fs_path), "%s/%s", dir, de->d_name) >= (int)sizeof(fs_path) ||
+            snprintf(path, sizeof(path), "%s/%s", rel, de->d_name) >= 512) { // http_request_t.path
+            fprintf(stderr, "Warning: %s/%s: path too long, skipped\n", dir, de->d_name);
+            continue;
+        }
+        struct stat st;
+        if (stat(fs_path, &st) != 0) {
+            perror(fs_path);
+            rc = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            rc = scan_dir(fs_path, path, depth + 1);
+        } else if (S_ISREG(st.st_mode)) {
+            rc = add_file(path, fs_path, (size_t)st.st_size);
+        }
+    }
+    closedir(d);
+    return rc;
+}
+
+static uint8_t* read_file(const pack_file_t* f) {
+    uint8_t* buf = malloc(f->size ? f->size : 1);
+    FILE* fp = fopen(f->fs_path, "rb");
+    if (!buf || !fp || fread(buf, 1, f->size, fp) != f->size) {
+        fprintf(stderr, "Error: cannot read %s (changed while packing?)\n", f->fs_path);
+        free(buf);
+        buf = NULL;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    return buf;
+}
+
+static int compressible(const char* type) {
+    return strncmp(type, "text/", 5) == 0 || strstr(type, "javascript") || strstr(type, "json") ||
+           strstr(type, "xml") || strstr(type, "svg");
+}
+
+// gzip (RFC 1952, mtime 0, so bundles are reproducible). Returns 0 and sets f->gz when worthwhile.
+static int gzip_file(pack_file_t* f, const uint8_t* data) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, g_level, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    size_t bound = deflateBound(&zs, f->size);
+    uint8_t* out = malloc(bound);
+    if (!out) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = (uInt)f->size;
+    zs.next_out = out;
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t len = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END || len >= f->size - f->size / 10) {
+        free(out);
+        return 0; // Not worth a second copy
+    }
+    f->gz = out;
+    f->gz_len = len;
+    return 0;
+}
+
+// ###############################################################################################################
+// Perfect hash (hash and displace)
+// ###############################################################################################################
+
+static uint32_t g_buckets;
+static uint32_t* g_disp;
+
+static int cmp_bucket_size(const void* a, const void* b, void* sizes) {
+    uint32_t sa = ((uint32_t*)sizes)[*(const uint32_t*)a];
+    uint32_t sb = ((uint32_t*)sizes)[*(const uint32_t*)b];
+    return (sa < sb) - (sa > sb); // Largest first
+}
+
+// Places buckets largest first, each with the first seed that maps all its paths to free, distinct slots
+static int build_index(void) {
+    uint32_t n = (uint32_t)g_num_files;
+    g_buckets = n / BUCKET_LOAD + 1;
+    g_disp = calloc(g_buckets, sizeof(uint32_t));
+    uint32_t* sizes = calloc(g_buckets, sizeof(uint32_t));
+    uint32_t* order = malloc(g_buckets * sizeof(uint32_t));
+    uint32_t* start = calloc(g_buckets + 1, sizeof(uint32_t));
+    uint32_t* members = malloc((n ? n : 1) * sizeof(uint32_t));
+    uint8_t* taken = calloc(n ? n : 1, 1);
+    uint32_t* trial = malloc((n ? n : 1) * sizeof(uint32_t));
+    int rc = -1;
+    if (!g_disp || !sizes || !order || !start || !members || !taken || !trial) {
+        goto out;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        g_files[i].bucket = (uint32_t)(docpack_hash(g_files[i].path, strlen(g_files[i].path), 0) % g_buckets);
+        sizes[g_files[i].bucket]++;
+    }
+    for (uint32_t b = 0; b < g_buckets; b++) {
+        start[b + 1] = start[b] + sizes[b];
+        order[b] = b;
+    }
+    uint32_t* fill = calloc(g_buckets, sizeof(uint32_t));
+    if (!fill) {
+        goto out;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = g_files[i].bucket;
+        members[start[b] + fill[b]++] = i;
+    }
+    free(fill);
+    qsort_r(order, g_buckets, sizeof(uint32_t), cmp_bucket_size, sizes);
+
+    for (uint32_t k = 0; k < g_buckets && sizes[order[k]] > 0; k++) {
+        uint32_t b = order[k];
+        uint32_t m = sizes[b];
+        uint32_t d;
+        for (d = 1; d < MAX_DISPLACEMENT; d++) {
+            uint32_t j;
+            for (j = 0; j < m; j++) {
+                const char* p = g_files[members[start[b] + j]].path;
+                uint32_t s = (uint32_t)(docpack_hash(p, strlen(p), d) % n);
+                int clash = taken[s];
+                for (uint32_t q = 0; q < j && !clash; q++) {
+                    clash = (trial[q] == s);
+                }
+                if (clash) {
+                    break;
+                }
+                trial[j] = s;
+            }
+            if (j == m) {
+                break;
+            }
+        }
+        if (d == MAX_DISPLACEMENT) {
+            fprintf(stderr, "Error: no perfect hash seed for bucket %u (duplicate paths?)\n", b);
+            goto out;
+        }
+        g_disp[b] = d;
+        for (uint32_t j = 0; j < m; j++) {
+            taken[trial[j]] = 1;
+            g_files[members[start[b] + j]].slot = trial[j];
+        }
+    }
+    rc = 0;
+
+out:
+    free(sizes);
+    free(order);
+    free(start);
+    free(members);
+    free(taken);
+    free(trial);
+    return rc;
+}
+
+// ###############################################################################################################
+// Writing the bundle
+// ###############################################################################################################
+
+// Appends s to the string table; returns its offset (UINT32_MAX on failure)
+static uint32_t add_string(const char* s, size_t len) {
+    if (g_strings_len + len > UINT32_MAX) {
+        return UINT32_MAX;
+    }
+    if (g_strings_len + len > g_strings_cap) {
+        size_t cap = g_strings_cap ? g_strings_cap : 65536;
+        while (cap < g_strings_len + len) {
+            cap *= 2;
+        }
+        char* p = realloc(g_strings, cap);
+        if (!p) {
+            return UINT32_MAX;
+        }
+        g_strings = p;
+        g_strings_cap = cap;
+    }
+    memcpy(g_strings + g_strings_len, s, len);
+    g_strings_len += len;
+    return (uint32_t)(g_strings_len - len);
+}
+
+static uint64_t fnv1a(const uint8_t* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t align_up(uint64_t v, uint64_t a) {
+    return (v + a - 1) / a * a;
+}
+
+static int write_at(FILE* fp, uint64_t off, const void* data, size_t len) {
+    return (fseeko(fp, (off_t)off, SEEK_SET) == 0 && fwrite(data, 1, len, fp) == len) ? 0 : -1;
+}
+
+// Writes the bodies first (reading each file once), then the tables at the front of the file
+static int write_pack(const char* out_path) {
+    uint32_t n = (uint32_t)g_num_files;
+    docpack_entry_t* entries = calloc(n ? n : 1, sizeof(docpack_entry_t));
+    if (!entries) {
+        return -1;
+    }
+
+    // Strings are added as bodies are read, so their size is only known at the end: bodies go after a
+    // generously sized table area, and the header records where everything ended up
+    uint64_t disp_off = sizeof(docpack_header_t);
+    uint64_t entries_off = align_up(disp_off + (uint64_t)g_buckets * sizeof(uint32_t), 8);
+    uint64_t strings_off = entries_off + (uint64_t)n * sizeof(docpack_entry_t);
+    uint64_t strings_room = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        // path, type, two ETags, two header blocks (each repeats type and ETag plus fixed text)
+        strings_room += 3 * strlen(g_files[i].path) + 3 * strlen(g_files[i].type) + 6 * 24 + 160;
+    }
+    uint64_t data_off = align_up(strings_off + strings_room, DOCPACK_ALIGN);
+
+    FILE* fp = fopen(out_path, "wb");
+    if (!fp) {
+        perror(out_path);
+        free(entries);
+        return -1;
+    }
+
+    int rc = 0;
+    uint64_t pos = data_off;
+    size_t total = 0, total_gz = 0, num_gz = 0;
+    for (uint32_t i = 0; i < n && rc == 0; i++) {
+        pack_file_t* f = &g_files[i];
+        uint8_t* data = read_file(f);
+        if (!data) {
+            rc = -1;
+            break;
+        }
+        if (g_gzip && f->size >= g_min_gzip && compressible(f->type) && gzip_file(f, data) != 0) {
+            fprintf(stderr, "Error: gzip failed for %s\n", f->fs_path);
+            rc = -1;
+        }
+
+        docpack_entry_t* e = &entries[f->slot];
+        char etag[32], gz_etag[40], hdr[1024], gz_hdr[1024];
+        uint64_t h = fnv1a(data, f->size);
+        int etag_len = snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)h);
+        int gz_etag_len = snprintf(gz_etag, sizeof(gz_etag), "\"%016llx-gz\"", (unsigned long long)h);
+        const char* vary = f->gz ? "Vary: Accept-Encoding\r\n" : "";
+        int hdr_len = snprintf(hdr, sizeof(hdr), "Content-Type: %s\r\nETag: %s\r\n%s\r\n", f->type, etag, vary);
+        int gz_hdr_len = snprintf(gz_hdr, sizeof(gz_hdr),
+                                  "Content-Type: %s\r\nETag: %s\r\nContent-Encoding: gzip\r\n%s\r\n",
+                                  f->type, gz_etag, vary);
+
+        e->path_len = (uint32_t)strlen(f->path);
+        e->path_off = add_string(f->path, e->path_len);
+        e->type_len = (uint32_t)strlen(f->type);
+        e->type_off = add_string(f->type, e->type_len + 1); // Terminated: usable as a C string
+        e->etag_len = (uint32_t)etag_len;
+        e->etag_off = add_string(etag, e->etag_len);
+        e->hdr_len = (uint32_t)hdr_len;
+        e->hdr_off = add_string(hdr, e->hdr_len);
+        if (f->gz) {
+            e->gz_etag_len = (uint32_t)gz_etag_len;
+            e->gz_etag_off = add_string(gz_etag, e->gz_etag_len);
+            e->gz_hdr_len = (uint32_t)gz_hdr_len;
+            e->gz_hdr_off = add_string(gz_hdr, e->gz_hdr_len);
+        }
+        if (g_strings_len > strings_room) {
+            fprintf(stderr, "Error: string table overflow\n");
+            rc = -1;
+        }
+
+        e->body_off = pos;
+        e->body_len = f->size;
+        if (rc == 0 && f->size > 0 && write_at(fp, pos, data, f->size) != 0) {
+            rc = -1;
+        }
+        pos += f->size;
+        if (f->gz) {
+            pos = align_up(pos, 16);
+            e->gz_off = pos;
+            e->gz_len = f->gz_len;
+            if (rc == 0 && write_at(fp, pos, f->gz, f->gz_len) != 0) {
+                rc = -1;
+            }
+            pos += f->gz_len;
+            total_gz += f->gz_len;
+            num_gz++;
+        }
+        pos = align_up(pos, DOCPACK_ALIGN);
+        total += f->size;
+
+        if (!g_quiet) {
+            if (f->gz) {
+                printf("  %-48s %10zu  %-24s gzip %zu\n", f->path, f->size, f->type, f->gz_len);
+            } else {
+                printf("  %-48s %10zu  %s\n", f->path, f->size, f->type);
+            }
+        }
+        free(data);
+        free(f->gz);
+        f->gz = NULL;
+    }
+
+    if (rc == 0) {
+        docpack_header_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, DOCPACK_MAGIC, sizeof(hdr.magic));
+        hdr.version = DOCPACK_VERSION;
+        hdr.count = n;
+        hdr.buckets = g_buckets;
+        hdr.disp_off = disp_off;
+        hdr.entries_off = entries_off;
+        hdr.strings_off = strings_off;
+        hdr.strings_len = g_strings_len;
+        hdr.file_size = pos;
+        if (write_at(fp, 0, &hdr, sizeof(hdr)) != 0 ||
+            write_at(fp, disp_off, g_disp, g_buckets * sizeof(uint32_t)) != 0 ||
+            write_at(fp, entries_off, entries, n * sizeof(docpack_entry_t)) != 0 ||
+            (g_strings_len > 0 && write_at(fp, strings_off, g_strings, g_strings_len) != 0) ||
+            ftruncate(fileno(fp), (off_t)pos) != 0) {
+            rc = -1;
+        }
+    }
+    if (fclose(fp) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        fprintf(stderr, "Error: failed to write %s\n", out_path);
+    } else {
+        printf("%u files, %zu bytes of content", n, total);
+        if (g_gzip) {
+            printf(", %zu gzip variants (%zu bytes)", num_gz, total_gz);
+        }
+        printf(", bundle %llu bytes\n", (unsigned long long)pos);
+    }
+    free(entries);
+    return rc;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-z] [-l level] [-m min_bytes] [-q] docroot out.pack\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "zl:m:q")) != -1) {
+        switch (opt) {
+        case 'z':
+            g_gzip = 1;
+            break;
+        case 'l':
+            g_level = atoi(optarg);
+            if (g_level < 1 || g_level > 9) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'm':
+            g_min_gzip = (size_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'q':
+            g_quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* docroot = argv[optind];
+    const char* out = argv[optind + 1];
+
+    // Request paths are relative to the docroot, without trailing slashes
+    char root[4096];
+    snprintf(root, sizeof(root), "%s", docroot);
+    size_t len = strlen(root);
+    while (len > 1 && root[len - 1] == '/') {
+        root[--len] = '\0';
+    }
+    if (scan_dir(root, "", 0) != 0) {
+        return 1;
+    }
+    if (g_num_files > UINT32_MAX / 2) {
+        fprintf(stderr, "Error: too many files\n");
+        return 1;
+    }
+    if (build_index() != 0) {
+        return 1;
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", out);
+    if (write_pack(tmp) != 0) {
+        unlink(tmp);
+        return 1;
+    }
+    if (rename(tmp, out) != 0) {
+        perror(out);
+        unlink(tmp);
+        return 1;
+    }
+    printf("Bundle written to %s (DOCPACK=%s in server.conf)\n", out, out);
+    return 0;
+}
@@ -1,9 +1,442 @@
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <sys/epoll.h> // Zero-copy reaper
+#include <pthread.h>
+#include <netinet/in.h> // IP_RECVERR, IPV6_RECVERR
+#include <linux/tcp.h> // TCP_NOTSENT_LOWAT, struct tcp_info with tcpi_delivery_rate
+#include <stddef.h> // offsetof
+#include <stdint.h>
+#include <limits.h> // INT_MAX
+#include <linux/errqueue.h> // sock_extended_err (MSG_ZEROCOPY completions)
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h> // strcasecmp
 #include <unistd.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
 #include "http_builder.h"
+#include "logger.h" // LOG_DIAG (rate-limited diagnostics)
+#include "stats.h" // get_time_us
+
+// Response accounting of the calling request thread (see http_response_begin)
+static __thread size_t t_wire_bytes = 0;
+static __thread long long t_first_byte_us = 0;
+static __thread int t_sndbuf = 0; // SO_SNDBUF set for this response (0 = kernel autotuning)
+static __thread long t_rtt_us = 0; // Smoothed RTT it was sized from
+static __thread uint32_t t_zc_issued = 0; // Zero-copy sends made (ZEROCOPY_MIN_KB)
+static __thread uint32_t t_zc_done = 0; // Zero-copy sends the kernel reported complete
+
+void http_response_begin(void) {
+    t_zc_issued = 0;
+    t_zc_done = 0;
+    t_wire_bytes = 0;
+    t_first_byte_us = 0;
+    t_sndbuf = 0;
+    t_rtt_us = 0;
+}
+
+size_t http_response_wire_bytes(void) {
+    return t_wire_bytes;
+}
+
+long long http_response_first_byte_us(void) {
+    return t_first_byte_us;
+}
+
+int http_response_sndbuf(long* rtt_us) {
+    if (rtt_us) {
+        *rtt_us = t_rtt_us;
+    }
+    return t_sndbuf;
+}
+
+// Account bytes accepted by send()
+static void account_sent(ssize_t sent) {
+    if (t_first_byte_us == 0) {
+        t_first_byte_us = get_time_us();
+    }
+    t_wire_bytes += (size_t)sent;
+}
+
+// ###################################################################################################################
+// Zero-copy sends (ZEROCOPY_MIN_KB)
+//
+// With MSG_ZEROCOPY the kernel sends straight from the caller's pages instead of copying them into the socket
+// buffer, and reports on the socket error queue when it no longer needs them. Completions arrive once the peer
+// acknowledged the data, so the request thread does not wait for them: http_response_finish() hands a
+// connection with sends still in flight to a reaper thread, which reads its completions and only then closes it
+// and releases the body (a pinned cache entry, a file buffer). A peer that acknowledges nothing for
+// ZEROCOPY_WAIT_MS gets a reset first, so the kernel drops its references before the body is released. Over
+// loopback the kernel copies anyway (SO_EE_CODE_ZEROCOPY_COPIED).
+// ###################################################################################################################
+
+#define ZEROCOPY_WAIT_MS 10000 // Longest wait for completions (a stalled peer) before the connection is reset
+
+// Bodies of at least this many bytes are sent with MSG_ZEROCOPY (0 = never)
+static size_t g_zerocopy_min = 0;
+
+// Set while send_content() runs: its body stays with the caller until http_response_finish(). Other bodies
+// (error pages, the stats JSON) live on the stack and are always copied.
+static __thread int t_body_pinned = 0;
+
+// A connection whose zero-copy sends are still in flight (owned by the reaper once queued)
+typedef struct zc_conn {
+    struct zc_conn* prev;
+    struct zc_conn* next;
+    int fd;
+    uint32_t issued; // Sends made on fd
+    uint32_t done; // Sends completed
+    long long deadline_us; // get_time_us() after which the connection is reset
+    void (*release)(void* pin); // Called with pin once the kernel no longer reads the body
+    max_align_t pin[]; // Copy of the caller's pin
+} zc_conn_t;
+
+static pthread_mutex_t g_zc_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects the list and g_zc_stop
+static zc_conn_t* g_zc_head = NULL; // Connections waiting for completions
+static int g_zc_stop = 0; // Reaper asked to exit once the list is empty
+static int g_zc_epoll = -1; // Reports completions queued on the waiting connections (-1 = no reaper)
+static pthread_t g_zc_thread;
+
+// Skip sent bytes of an iovec array
+static void iov_advance(struct iovec** iov, int* iovcnt, size_t sent) {
+    while (*iovcnt > 0 && sent >= (*iov)->iov_len) {
+        sent -= (*iov)->iov_len;
+        (*iov)++;
+        (*iovcnt)--;
+    }
+    if (*iovcnt > 0) {
+        (*iov)->iov_base = (char*)(*iov)->iov_base + sent;
+        (*iov)->iov_len -= sent;
+    }
+}
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+// Add the completions queued on the error queue of fd to *done. Never blocks. Returns 0, -1 on error.
+static int zerocopy_read(int fd, uint32_t* done) {
+    while (1) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        // An empty error queue gives EAGAIN
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            const struct sock_extended_err* ee = (const struct sock_extended_err*)CMSG_DATA(cm);
+            if (ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                *done += ee->ee_data - ee->ee_info + 1; // Sends [ee_info, ee_data] are complete
+            }
+        }
+    }
+}
+
+// Wait until *done reaches target, for up to ZEROCOPY_WAIT_MS. Returns 0, -1 on timeout or error.
+static int zerocopy_wait(int fd, uint32_t* done, uint32_t target) {
+    long long deadline_us = get_time_us() + ZEROCOPY_WAIT_MS * 1000LL;
+    while (1) {
+        if (zerocopy_read(fd, done) != 0) {
+            return -1;
+        }
+        if (*done >= target) {
+            return 0;
+        }
+        long long left_ms = (deadline_us - get_time_us()) / 1000;
+        if (left_ms <= 0) {
+            LOG_DIAG(LOG_LEVEL_WARN, "Zero-copy completion timed out (%u of %u)", *done, target);
+            return -1;
+        }
+        struct pollfd p = { .fd = fd, .events = 0 }; // POLLERR: something on the error queue
+        poll(&p, 1, left_ms < 100 ? (int)left_ms : 100);
+    }
+}
+
+// sendmsg(MSG_ZEROCOPY) until every iov is sent (iov is consumed). The completions are read later
+// (http_response_finish()). Returns 0, -1 on error, 1 when the socket has no zero-copy support (nothing sent).
+static int send_iov_zerocopy(int fd, struct iovec* iov, int iovcnt) {
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+        return 1; // Not TCP (AF_UNIX), or an old kernel
+    }
+
+    while (iovcnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)iovcnt;
+        ssize_t sent = sendmsg(fd, &msg, MSG_ZEROCOPY);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && errno == ENOBUFS && t_zc_done < t_zc_issued) {
+            // Too many pages pinned for this socket (optmem): let some complete first
+            if (zerocopy_wait(fd, &t_zc_done, t_zc_done + 1) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (sent <= 0) {
+            LOG_DIAG((sent < 0 && (errno == EPIPE || errno == ECONNRESET)) ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARN,
+                     "Failed to send body (zero-copy): %m");
+            return -1;
+        }
+        t_zc_issued++; // Completion ids are per socket, one per successful send
+        account_sent(sent);
+        iov_advance(&iov, &iovcnt, (size_t)sent);
+    }
+    return 0;
+}
+#else
+static int zerocopy_read(int fd, uint32_t* done) {
+    (void)fd; (void)done;
+    return 0;
+}
+
+static int send_iov_zerocopy(int fd, struct iovec* iov, int iovcnt) {
+    (void)fd; (void)iov; (void)iovcnt;
+    return 1;
+}
+#endif
+
+// Close the connection of a finished response and release its body. Sends still in flight mean the peer stalled
+// (or the reaper could not take it): reset the connection so the kernel drops the data it still holds first.
+static void zc_close(int fd, uint32_t issued, uint32_t done, void (*release)(void*), void* pin) {
+    if (done < issued) {
+        LOG_DIAG(LOG_LEVEL_WARN, "Zero-copy completion timed out (%u of %u), resetting the connection", done, issued);
+        struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    }
+    close(fd);
+    if (release) {
+        release(pin);
+    }
+}
+
+// Unlink c from the waiting list (g_zc_mutex held)
+static void zc_unlink(zc_conn_t* c) {
+    if (c->prev) c->prev->next = c->next; else g_zc_head = c->next;
+    if (c->next) c->next->prev = c->prev;
+}
+
+// Reaper thread: read the completions of the waiting connections and finish those that are complete or expired
+static void* zc_reaper(void* arg) {
+    (void)arg;
+    long long next_scan_us = 0;
+    while (1) {
+        struct epoll_event ev[64];
+        int n = epoll_wait(g_zc_epoll, ev, 64, 100);
+        for (int i = 0; i < n; i++) {
+            zc_conn_t* c = ev[i].data.ptr;
+            if (zerocopy_read(c->fd, &c->done) != 0) {
+                c->deadline_us = 0; // Broken socket: nothing more will be reported
+            }
+        }
+
+        // Finish the complete connections after events, and the expired ones every 100 ms
+        long long now = get_time_us();
+        int scan_all = now >= next_scan_us;
+        if (n <= 0 && !scan_all) {
+            continue;
+        }
+        if (scan_all) {
+            next_scan_us = now + 100000;
+        }
+        zc_conn_t* finished = NULL;
+        pthread_mutex_lock(&g_zc_mutex);
+        for (int i = 0; i < n && !scan_all; i++) {
+            zc_conn_t* c = ev[i].data.ptr;
+            if (c->done >= c->issued || c->deadline_us == 0) {
+                zc_unlink(c);
+                c->next = finished;
+                finished = c;
+            }
+        }
+        for (zc_conn_t* c = scan_all ? g_zc_head : NULL; c;) {
+            zc_conn_t* next = c->next;
+            if (c->done >= c->issued || now >= c->deadline_us) {
+                zc_unlink(c);
+                c->next = finished;
+                finished = c;
+            }
+            c = next;
+        }
+        int stop = g_zc_stop && !g_zc_head;
+        pthread_mutex_unlock(&g_zc_mutex);
+
+        while (finished) {
+            zc_conn_t* c = finished;
+            finished = c->next;
+            zc_close(c->fd, c->issued, c->done, c->release, c->pin); // close() also leaves the epoll set
+            free(c);
+        }
+        if (stop) {
+            return NULL;
+        }
+    }
+}
+
+void http_set_zerocopy_min(size_t bytes) {
+    g_zerocopy_min = bytes;
+    if (bytes == 0 || g_zc_epoll >= 0) {
+        return;
+    }
+    // The reaper runs in the process that sends (a worker), so it is started here rather than before fork()
+    g_zc_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (g_zc_epoll < 0 || pthread_create(&g_zc_thread, NULL, zc_reaper, NULL) != 0) {
+        LOG_DIAG(LOG_LEVEL_WARN, "No zero-copy reaper thread, responses wait for their completions: %m");
+        if (g_zc_epoll >= 0) {
+            close(g_zc_epoll);
+        }
+        g_zc_epoll = -1;
+    }
+}
+
+void http_zerocopy_stop(void) {
+    if (g_zc_epoll < 0) {
+        return;
+    }
+    pthread_mutex_lock(&g_zc_mutex);
+    g_zc_stop = 1;
+    pthread_mutex_unlock(&g_zc_mutex);
+    pthread_join(g_zc_thread, NULL);
+    close(g_zc_epoll);
+    g_zc_epoll = -1;
+}
+
+void http_response_finish(int fd, void (*release)(void* pin), const void* pin, size_t pin_size) {
+    if (t_zc_done < t_zc_issued) {
+        zerocopy_read(fd, &t_zc_done); // Often complete already (loopback, small bodies)
+    }
+    if (t_zc_done >= t_zc_issued) {
+        zc_close(fd, 0, 0, release, (void*)pin);
+        return;
+    }
+
+    zc_conn_t* c = (g_zc_epoll >= 0) ? malloc(sizeof(*c) + pin_size) : NULL;
+    if (!c) {
+        // No reaper: wait here, like a send would
+        zerocopy_wait(fd, &t_zc_done, t_zc_issued);
+        zc_close(fd, t_zc_issued, t_zc_done, release, (void*)pin);
+        return;
+    }
+    c->prev = NULL;
+    c->fd = fd;
+    c->issued = t_zc_issued;
+    c->done = t_zc_done;
+    c->deadline_us = get_time_us() + ZEROCOPY_WAIT_MS * 1000LL;
+    c->release = release;
+    if (pin_size > 0) {
+        memcpy(c->pin, pin, pin_size);
+    }
+
+    // Edge-triggered: every completion queued after this wakes the reaper once (and one queued before it, too)
+    struct epoll_event ev = { .events = EPOLLET, .data.ptr = c };
+    pthread_mutex_lock(&g_zc_mutex);
+    c->next = g_zc_head;
+    if (g_zc_head) g_zc_head->prev = c;
+    g_zc_head = c;
+    int rc = epoll_ctl(g_zc_epoll, EPOLL_CTL_ADD, fd, &ev);
+    if (rc != 0) {
+        zc_unlink(c);
+    }
+    pthread_mutex_unlock(&g_zc_mutex);
+    if (rc != 0) {
+        zc_close(fd, c->issued, c->done, release, c->pin);
+        free(c);
+    }
+}
+
+// Zero-copy send of a body at or above the threshold. Returns 1 when handled (sent or failed), 0 when the
+// caller should send it the usual way.
+static int send_body_zerocopy(int fd, const char* body, size_t body_len) {
+    if (g_zerocopy_min == 0 || body_len < g_zerocopy_min || !t_body_pinned) {
+        return 0;
+    }
+    struct iovec iov = { (void*)body, body_len };
+    return send_iov_zerocopy(fd, &iov, 1) <= 0;
+}
+
+// ###################################################################################################################
+// Per-connection TCP tuning (TCP_NOTSENT_LOWAT_KB, SNDBUF_MAX_KB)
+//
+// Every connection gets TCP_NODELAY, so the last segment of a response leaves as soon as it is written instead
+// of waiting for the ACK of the previous one; the headers go out with MSG_MORE (TCP_CORK for one send) so they
+// still share a segment with the start of the body. TCP_NOTSENT_LOWAT bounds the unsent part of the send queue:
+// a thread blocked in send() is woken when the queue drained to the mark, not as soon as a little space frees.
+// With SNDBUF_MAX_KB, a response larger than SNDBUF_MIN gets an SO_SNDBUF sized from its length and the
+// bandwidth-delay product TCP_INFO reports, so a slow client does not pin megabytes of kernel memory.
+// ###################################################################################################################
+
+#define SNDBUF_MIN (64 * 1024) // Responses up to this size keep the kernel's buffer; tuned buffers are never smaller
+
+static int g_notsent_lowat = 0; // TCP_NOTSENT_LOWAT in bytes (0 = kernel default)
+static size_t g_sndbuf_max = 0; // Largest SO_SNDBUF set per response (0 = kernel autotuning)
+
+void http_set_tcp_tuning(size_t notsent_lowat, size_t sndbuf_max) {
+    g_notsent_lowat = notsent_lowat > INT_MAX ? INT_MAX : (int)notsent_lowat;
+    g_sndbuf_max = sndbuf_max > INT_MAX ? INT_MAX : sndbuf_max;
+}
+
+void http_tune_connection(int fd) {
+    // Both fail with EOPNOTSUPP on sockets that are not TCP, which then keep their defaults
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (g_notsent_lowat > 0) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &g_notsent_lowat, sizeof(g_notsent_lowat));
+    }
+}
+
+// Size the send buffer for a response of bytes (headers included), before its first send
+static void tune_for_response(int fd, size_t bytes) {
+    if (g_sndbuf_max == 0 || bytes <= SNDBUF_MIN) {
+        return;
+    }
+    struct tcp_info ti;
+    socklen_t len = sizeof(ti);
+    memset(&ti, 0, sizeof(ti));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0 || ti.tcpi_rtt == 0) {
+        return; // Not TCP, or no RTT sample yet
+    }
+
+    // Bandwidth-delay product: one congestion window, or the measured delivery rate over one RTT
+    uint64_t bdp = (uint64_t)ti.tcpi_snd_cwnd * ti.tcpi_snd_mss;
+    if (len >= offsetof(struct tcp_info, tcpi_delivery_rate) + sizeof(ti.tcpi_delivery_rate)) {
+        uint64_t rate_bdp = ti.tcpi_delivery_rate * ti.tcpi_rtt / 1000000;
+        if (rate_bdp > bdp) {
+            bdp = rate_bdp;
+        }
+    }
+
+    // Room for the window to double twice (slow start) between two wakeups of the sending thread,
+    // but never more than the response itself or the configured cap
+    uint64_t want = bdp * 4;
+    if (want < SNDBUF_MIN) want = SNDBUF_MIN;
+    if (want > bytes) want = bytes;
+    if (want > g_sndbuf_max) want = g_sndbuf_max;
+
+    int val = (int)want;
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val)) != 0) {
+        return;
+    }
+    // The kernel doubles the value for its bookkeeping and caps it at net.core.wmem_max
+    socklen_t vlen = sizeof(val);
+    if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &val, &vlen) == 0) {
+        t_sndbuf = val / 2;
+        t_rtt_us = (long)ti.tcpi_rtt;
+    }
+}
 
 // Forward declaration for send_http_response_with_body_flag
 void send_http_response_with_body_flag(int fd, int status, const char* status_msg, const char* content_type, const char* body, size_t body_len, int send_body, int keep_alive);
@@ -81,8 +514,17 @@ void send_http_response(int fd, int status, const char* status_msg, const char*
     send_http_response_with_body_flag(fd, status, status_msg, content_type, body, body_len, 1, keep_alive);
 }
 
+// Headers and in-memory body; header_flags are passed to the send() of the headers
+static void send_response(int fd, int status, const char* status_msg, const char* content_type, const char* body,
+                          size_t body_len, int send_body, int keep_alive, int header_flags);
+
 // Internal function that supports body flag for HEAD requests
 void send_http_response_with_body_flag(int fd, int status, const char* status_msg, const char* content_type, const char* body, size_t body_len, int send_body, int keep_alive) {
+    send_response(fd, status, status_msg, content_type, body, body_len, send_body, keep_alive, 0);
+}
+
+static void send_response(int fd, int status, const char* status_msg, const char* content_type, const char* body,
+                          size_t body_len, int send_body, int keep_alive, int header_flags) {
 
     // Validate input parameters
     // Ensure file descriptor is valid and required strings are not NULL
@@ -133,10 +575,17 @@ void send_http_response_with_body_flag(int fd, int status, const char* status_ms
     // header_len >= sizeof(header) --> Header truncated
 
     if (header_len < 0 || header_len >= (int)sizeof(header)) {
-        perror("Header formatting failed");
+        LOG_DIAG(LOG_LEVEL_ERROR, "Header formatting failed");
         return;
     }
 
+    // A body follows the headers (in this call, or from the caller with MSG_MORE): send them corked
+    int has_body = (send_body && body && body_len > 0) || (header_flags & MSG_MORE);
+    tune_for_response(fd, (size_t)header_len + (has_body ? body_len : 0));
+    if (has_body) {
+        header_flags |= MSG_MORE;
+    }
+
     // Send headers with loop to handle partial sends
     // ssize_t -> Signed size type for number of bytes sent
     // send --> Send data over the socket
@@ -145,10 +594,12 @@ void send_http_response_with_body_flag(int fd, int status, const char* status_ms
 
     // Send headers with loop to handle partial sends
     while (total_sent < header_len) {
-        ssize_t sent = send(fd, header + total_sent, header_len - total_sent, 0);
+        ssize_t sent = send(fd, header + total_sent, header_len - total_sent, header_flags);
         
         if (sent < 0) {
-            perror("Failed to send header");
+            // Clients closing early (EPIPE/ECONNRESET) are routine: only visible at DEBUG
+            LOG_DIAG((errno == EPIPE || errno == ECONNRESET) ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARN,
+                     "Failed to send header: %m");
             return;
         }
         
@@ -157,6 +608,7 @@ void send_http_response_with_body_flag(int fd, int status, const char* status_ms
             return;
         }
         
+        account_sent(sent);
         total_sent += sent;
     }
 
@@ -165,7 +617,7 @@ void send_http_response_with_body_flag(int fd, int status, const char* status_ms
     // body_len --> Length of the response body in bytes
     // send_body --> Flag indicating if body should be sent (0 for HEAD requests, 1 for GET)
 
-    if (send_body && body && body_len > 0) {
+    if (send_body && body && body_len > 0 && !send_body_zerocopy(fd, body, body_len)) {
 
         // Send the body with loop to handle partial sends (FAQ Q15)
         total_sent = 0;
@@ -173,7 +625,8 @@ void send_http_response_with_body_flag(int fd, int status, const char* status_ms
             ssize_t sent = send(fd, body + total_sent, body_len - total_sent, 0);
             
             if (sent < 0) {
-                perror("Failed to send body");
+                LOG_DIAG((errno == EPIPE || errno == ECONNRESET) ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARN,
+                         "Failed to send body: %m");
                 return;
             }
             
@@ -182,6 +635,7 @@ void send_http_response_with_body_flag(int fd, int status, const char* status_ms
                 return;
             }
             
+            account_sent(sent);
             total_sent += sent;
         }
     }
@@ -227,28 +681,31 @@ void send_http_partial_response(int fd, const char* content_type, const char* bo
 
     // Check for formatting errors
     if (header_len < 0 || header_len >= (int)sizeof(header)) {
-        perror("Header formatting failed");
+        LOG_DIAG(LOG_LEVEL_ERROR, "Header formatting failed");
         return;
     }
 
-    // Send headers
+    // Send headers (corked when a body follows)
+    int has_body = body && body_len > 0;
+    tune_for_response(fd, (size_t)header_len + (has_body ? body_len : 0));
     ssize_t total_sent = 0;
 
     // Send headers with loop to handle partial sends
     while (total_sent < header_len) {
 
         // Send data over the socket
-        ssize_t sent = send(fd, header + total_sent, header_len - total_sent, 0);
+        ssize_t sent = send(fd, header + total_sent, header_len - total_sent, has_body ? MSG_MORE : 0);
         
         if (sent <= 0){
             return;
         } // Error handling
 
+        account_sent(sent);
         total_sent += sent; // Update total sent bytes
     }
 
     // Send body
-    if (body && body_len > 0) {
+    if (body && body_len > 0 && !send_body_zerocopy(fd, body, body_len)) {
 
         // Send body with loop to handle partial sends
         total_sent = 0;
@@ -263,7 +720,239 @@ void send_http_partial_response(int fd, const char* content_type, const char* bo
                 return;
             } // Error handling
             
+            account_sent(sent);
             total_sent += sent; // Update total sent bytes
         }
     }
 }
+
+// Determine MIME type based on file extension for HTTP responses
+const char* mime_type_from_path(const char* path) {
+    const char* ext = strrchr(path, '.');
+    if (!ext) return "application/octet-stream";
+    ext++;
+    if (!strcasecmp(ext, "html")) return "text/html";
+    if (!strcasecmp(ext, "htm")) return "text/html";
+    if (!strcasecmp(ext, "css")) return "text/css";
+    if (!strcasecmp(ext, "js")) return "application/javascript";
+    if (!strcasecmp(ext, "png")) return "image/png";
+    if (!strcasecmp(ext, "jpg")) return "image/jpeg";
+    if (!strcasecmp(ext, "jpeg")) return "image/jpeg";
+    if (!strcasecmp(ext, "gif")) return "image/gif";
+    if (!strcasecmp(ext, "svg")) return "image/svg+xml";
+    if (!strcasecmp(ext, "json")) return "application/json";
+    return "application/octet-stream";
+}
+
+// Send content held in memory (full or partial)
+void send_content(int fd, const char* content_type, const char* data, size_t total_size,
+                  const http_request_t* req, int keep_alive, int is_head_request,
+                  int* status_code, int* bytes_sent) {
+
+    long start = 0;
+    long end = (long)total_size - 1;
+    t_body_pinned = 1; // data stays with the caller until http_response_finish(): it may go out zero-copy
+    int is_partial = 0;
+
+    // Parse Range header if present (req is left untouched)
+    if (req->range[0] != '\0' && strncasecmp(req->range, "bytes=", 6) == 0) {
+        const char* start_str = req->range + 6;
+        const char* dash = strchr(start_str, '-');
+        if (dash) {
+            const char* end_str = dash + 1;
+
+            long req_start = -1, req_end = -1;
+            if (start_str != dash) req_start = strtol(start_str, NULL, 10);
+            if (*end_str) req_end = strtol(end_str, NULL, 10);
+
+            if (req_start != -1 && req_end != -1) {
+                start = req_start;
+                end = req_end;
+            } else if (req_start != -1) {
+                start = req_start;
+                end = (long)total_size - 1;
+            } else if (req_end != -1) {
+                // A negative suffix ("bytes=--N") is unsatisfiable; subtracting it could overflow
+                start = (req_end < 0) ? -1 : (long)total_size - req_end;
+                end = (long)total_size - 1;
+            }
+            is_partial = 1;
+        }
+    }
+
+    // Validate range
+    if (is_partial && (start < 0 || end >= (long)total_size || start > end)) {
+        t_body_pinned = 0;
+        send_error_response(fd, 416, "Range Not Satisfiable", keep_alive);
+        *status_code = 416;
+        *bytes_sent = 0;
+        return;
+    }
+
+    if (is_partial) {
+        size_t chunk_len = (size_t)(end - start + 1);
+        // For HEAD partial, we still send 206 headers but no body
+        send_http_partial_response(fd, content_type, is_head_request ? NULL : data + start, chunk_len,
+                                   (size_t)start, (size_t)end, total_size, keep_alive);
+        *status_code = 206;
+        *bytes_sent = (int)chunk_len;
+    } else {
+        send_http_response_with_body_flag(fd, 200, "OK", content_type, data, total_size, !is_head_request, keep_alive);
+        *status_code = 200;
+        *bytes_sent = (int)total_size;
+    }
+    t_body_pinned = 0;
+}
+
+// Send a whole file from a descriptor
+void send_file_response(int fd, const char* content_type, int file_fd, off_t offset, size_t size,
+                        int keep_alive, int is_head_request) {
+    // Headers only; MSG_MORE holds them back so they leave in the same segment as the start of the body
+    send_response(fd, 200, "OK", content_type, NULL, size, 0, keep_alive,
+                  (is_head_request || size == 0) ? 0 : MSG_MORE);
+    if (is_head_request || http_response_wire_bytes() == 0) {
+        return; // HEAD, or the headers could not be sent
+    }
+
+    size_t left = size;
+    while (left > 0) {
+        ssize_t sent = sendfile(fd, file_fd, &offset, left);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            LOG_DIAG((sent < 0 && (errno == EPIPE || errno == ECONNRESET)) ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARN,
+                     "Failed to send file: %m");
+            return;
+        }
+        account_sent(sent);
+        left -= (size_t)sent;
+    }
+}
+
+// writev() until every iov is sent (iov is consumed). At or above the threshold the bundle's part (every iov
+// but the first, which is on the caller's stack) goes out with MSG_ZEROCOPY.
+static int send_iov(int fd, struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    tune_for_response(fd, total);
+    if (g_zerocopy_min > 0 && total >= g_zerocopy_min && iovcnt > 1) {
+        while (iov[0].iov_len > 0) {
+            ssize_t sent = send(fd, iov[0].iov_base, iov[0].iov_len, MSG_MORE);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                LOG_DIAG((sent < 0 && (errno == EPIPE || errno == ECONNRESET)) ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARN,
+                         "Failed to send packed file: %m");
+                return -1;
+            }
+            account_sent(sent);
+            iov[0].iov_base = (char*)iov[0].iov_base + sent;
+            iov[0].iov_len -= (size_t)sent;
+        }
+        int rc = send_iov_zerocopy(fd, iov + 1, iovcnt - 1);
+        if (rc <= 0) {
+            return rc;
+        }
+    }
+
+    while (iovcnt > 0) {
+        ssize_t sent = writev(fd, iov, iovcnt);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            LOG_DIAG((sent < 0 && (errno == EPIPE || errno == ECONNRESET)) ? LOG_LEVEL_DEBUG : LOG_LEVEL_WARN,
+                     "Failed to send packed file: %m");
+            return -1;
+        }
+        account_sent(sent);
+        iov_advance(&iov, &iovcnt, (size_t)sent);
+    }
+    return 0;
+}
+
+// If-None-Match lists the ETag (weak comparison: a W/ prefix still matches) or is "*"
+static int etag_matches(const char* if_none_match, const char* etag, size_t etag_len) {
+    if (strcmp(if_none_match, "*") == 0) {
+        return 1;
+    }
+    for (const char* p = if_none_match; (p = strstr(p, "\"")) != NULL;) {
+        if (strncmp(p, etag, etag_len) == 0) {
+            return 1;
+        }
+        const char* close = strchr(p + 1, '"');
+        if (!close) {
+            break;
+        }
+        p = close + 1;
+    }
+    return 0;
+}
+
+// Send a file from the docroot bundle
+void send_packed_file(int fd, const docpack_file_t* file, const http_request_t* req, int keep_alive,
+                      int is_head_request, int* status_code, int* bytes_sent) {
+
+    if (req->if_none_match[0] != '\0' && etag_matches(req->if_none_match, file->etag, file->etag_len)) {
+        *status_code = 304;
+        *bytes_sent = 0;
+    } else if (req->range[0] != '\0' && !file->gzip) {
+        // Ranges are served from the identity body (the caller does not select gzip for them)
+        send_content(fd, file->content_type, file->body, file->body_len, req, keep_alive, is_head_request,
+                     status_code, bytes_sent);
+        return;
+    } else {
+        *status_code = 200;
+        *bytes_sent = (int)file->body_len;
+    }
+
+    time_t now = time(NULL);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    char date_str[64];
+    strftime(date_str, sizeof(date_str), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    // Status line and the per-response headers; the bundle supplies the rest (ending with the blank line)
+    char header[512];
+    int header_len;
+    if (*status_code == 304) {
+        header_len = snprintf(header, sizeof(header),
+            "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %.*s\r\n"
+            "Server: ConcurrentHTTP/1.0\r\n"
+            "Date: %s\r\n"
+            "Connection: %s\r\n"
+            "\r\n",
+            (int)file->etag_len, file->etag, date_str, keep_alive ? "keep-alive" : "close");
+    } else {
+        header_len = snprintf(header, sizeof(header),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Length: %zu\r\n"
+            "Server: ConcurrentHTTP/1.0\r\n"
+            "Date: %s\r\n"
+            "Connection: %s\r\n",
+            file->body_len, date_str, keep_alive ? "keep-alive" : "close");
+    }
+    if (header_len < 0 || header_len >= (int)sizeof(header)) {
+        LOG_DIAG(LOG_LEVEL_ERROR, "Header formatting failed");
+        return;
+    }
+
+    struct iovec iov[3];
+    int iovcnt = 0;
+    iov[iovcnt].iov_base = header;
+    iov[iovcnt++].iov_len = (size_t)header_len;
+    if (*status_code == 200) {
+        iov[iovcnt].iov_base = (void*)file->headers;
+        iov[iovcnt++].iov_len = file->headers_len;
+        if (!is_head_request && file->body_len > 0) {
+            iov[iovcnt].iov_base = (void*)file->body;
+            iov[iovcnt++].iov_len = file->body_len;
+        }
+    }
+    send_iov(fd, iov, iovcnt);
+}
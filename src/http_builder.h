@@ -2,6 +2,9 @@
 #define HTTP_BUILDER_H
 
 #include <stddef.h> // size_t
+#include <sys/types.h> // off_t
+#include "http_parser.h" // http_request_t
+#include "docpack.h" // docpack_file_t
 
 // Sends an HTTP response.
 // The keep_alive parameter (1 or 0) sets the header to "Connection: keep-alive" or "close".
@@ -21,4 +24,62 @@ void send_http_partial_response(int fd, const char* content_type, const char* bo
 // Sends an nginx-style error page response (400, 403, 404, 405, 416, 500, 503, etc.)
 void send_error_response(int fd, int status, const char* status_msg, int keep_alive);
 
+// Sends a file held in memory: 200 with the whole body, or 206 / 416 when req has a Range header
+// ("bytes=start-end", "bytes=start-" or "bytes=-suffix"). HEAD requests get the headers only.
+// status_code and bytes_sent receive the outcome for the statistics and the access log.
+void send_content(int fd, const char* content_type, const char* data, size_t total_size,
+                  const http_request_t* req, int keep_alive, int is_head_request,
+                  int* status_code, int* bytes_sent);
+
+// Sends a whole file as 200 with sendfile() from file_fd at offset (no copy through user space).
+// HEAD requests get the headers only.
+void send_file_response(int fd, const char* content_type, int file_fd, off_t offset, size_t size,
+                        int keep_alive, int is_head_request);
+
+// Bodies of at least bytes (0 = none) that send_content() and send_packed_file() send from memory go out with
+// MSG_ZEROCOPY (send_file_response() never copies). The kernel may read them after the call returned: end such
+// a response with http_response_finish(), and keep the body unchanged until it is released. Starts the reaper
+// thread of the calling process (a worker).
+void http_set_zerocopy_min(size_t bytes);
+
+// Ends the response on fd: closes the connection and calls release(pin) once the kernel no longer reads the body
+// (release may be NULL). pin_size bytes at pin are copied, so pin can be a local (a cache handle). Without
+// zero-copy sends in flight that happens now; otherwise the reaper thread does it when their completions
+// arrive, resetting the connection first if the peer acknowledges nothing for ZEROCOPY_WAIT_MS.
+void http_response_finish(int fd, void (*release)(void* pin), const void* pin, size_t pin_size);
+
+// Waits for the reaper to finish every connection handed to it (worker shutdown, before the caches go away)
+void http_zerocopy_stop(void);
+
+// Per-connection TCP tuning: notsent_lowat (bytes, 0 = kernel default) for TCP_NOTSENT_LOWAT, and the largest
+// SO_SNDBUF a response is given (0 = leave the buffer to kernel autotuning). Call once per process.
+void http_set_tcp_tuning(size_t notsent_lowat, size_t sndbuf_max);
+
+// Applies TCP_NODELAY and TCP_NOTSENT_LOWAT to a new connection (no-op for sockets that are not TCP)
+void http_tune_connection(int fd);
+
+// Sends a file from the docroot bundle (DOCPACK): 304 when If-None-Match names its ETag, 206 / 416 for ranges
+// (through send_content), otherwise 200 with the bundle's precomputed headers and the body in one writev()
+// straight from the mapping. Same outcome reporting as send_content().
+void send_packed_file(int fd, const docpack_file_t* file, const http_request_t* req, int keep_alive,
+                      int is_head_request, int* status_code, int* bytes_sent);
+
+// MIME type of a file from its extension (application/octet-stream when unknown)
+const char* mime_type_from_path(const char* path);
+
+// Per-thread accounting of the response being sent (extended access log).
+// http_response_begin() resets it; every successful send() adds to the wire bytes and the first one
+// records the time to first byte.
+void http_response_begin(void);
+
+// Header and body bytes written to the socket since http_response_begin()
+size_t http_response_wire_bytes(void);
+
+// get_time_us() when the first byte was sent since http_response_begin() (0 = nothing sent yet)
+long long http_response_first_byte_us(void);
+
+// SO_SNDBUF (bytes) given to the socket for this response and the smoothed RTT (us) it was sized from;
+// 0 when the response kept the kernel's buffer
+int http_response_sndbuf(long* rtt_us);
+
 #endif
\ No newline at end of file
@@ -39,6 +39,40 @@ static char* trim_whitespace(char* str) {
     return str;
 }
 
+// Accept-Encoding value lists gzip (or *) without q=0
+static int accepts_gzip(const char* value) {
+    const char* p = value;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        const char* tok = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+        size_t len = (size_t)(p - tok);
+        int match = (len == 4 && strncasecmp(tok, "gzip", 4) == 0) || (len == 1 && *tok == '*');
+
+        // Parameters: only q=0 (also written 0.0, 0.000) refuses the coding
+        int refused = 0;
+        while (*p && *p != ',') {
+            if (*p == ';') {
+                p++;
+                while (*p == ' ' || *p == '\t') p++;
+                if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+                    const char* q = p + 2;
+                    refused = (*q == '0');
+                    for (q++; refused && *q && *q != ',' && *q != ';' && *q != ' '; q++) {
+                        refused = (*q == '.' || *q == '0');
+                    }
+                }
+            } else {
+                p++;
+            }
+        }
+        if (match && !refused) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 // Function to parse an HTTP request from a buffer
 // Arguments:
 // buffer - Pointer to the buffer containing the HTTP request
@@ -96,6 +130,11 @@ int parse_http_request(const char* buffer, http_request_t* req) {
             char* value = line + 6;  // Get range value
             value = trim_whitespace(value); // Trim whitespace from range value
             strncpy(req->range, value, sizeof(req->range) - 1); // Copy range value to request structure
+        } else if (strncasecmp(line, "If-None-Match:", 14) == 0) {
+            char* value = trim_whitespace(line + 14);
+            strncpy(req->if_none_match, value, sizeof(req->if_none_match) - 1);
+        } else if (strncasecmp(line, "Accept-Encoding:", 16) == 0) {
+            req->accept_gzip = accepts_gzip(line + 16);
         }
     }
 
@@ -9,6 +9,8 @@ typedef struct {
     char path[512];    // Request path 
     char version[16];  // HTTP version
     char range[64];    // Range header value, empty if not present
+    char if_none_match[128]; // If-None-Match header value, empty if not present
+    int accept_gzip;   // Accept-Encoding allows gzip
 } http_request_t;
 
 // Function to parse an HTTP request from a buffer
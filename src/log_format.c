@@ -0,0 +1,551 @@
+#include "log_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// #########################################################################################################
+// FRAME TAGS
+// #########################################################################################################
+
+#define FRAME_ACCESS 0 // Access record
+#define FRAME_DICT 1 // Dictionary definition
+#define FRAME_STREAM 2 // Start of a writer batch
+#define FRAME_ACCESS_EXT 3 // Access record with extended details
+#define FRAME_TYPE_MASK 0x03
+
+#define STATUS_EXPLICIT 15 // Status index meaning "varint status follows"
+#define METHOD_EXPLICIT 3 // Method code meaning "varint method id follows"
+
+// Status codes with a 4-bit shortcut (index = position in the table)
+static const int k_status_table[STATUS_EXPLICIT] = {
+    200, 206, 304, 400, 403, 404, 405, 416, 500, 503, 301, 302, 204, 201, 401
+};
+
+// Methods with a 2-bit shortcut
+static const char* k_method_table[METHOD_EXPLICIT] = { "GET", "HEAD", "POST" };
+
+// #########################################################################################################
+// VARINTS
+// #########################################################################################################
+
+// LEB128 unsigned varint
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// Signed values (timestamp deltas) are zigzag-encoded so small negatives stay short
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Read a varint from the file. Returns 0 on success, -1 on EOF/overflow.
+static int get_varint(FILE* fp, uint64_t* out) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(fp);
+        if (c == EOF) {
+            return -1;
+        }
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *out = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// #########################################################################################################
+// TEXT LINES
+// #########################################################################################################
+// Hand-rolled formatting: the writer thread formats every record, so fields are appended directly instead
+// of going through snprintf's format parsing. Every field is bounded (ip 45, method 15, path 511, integers 20 digits),
+// so a line always fits in LOG_LINE_MAX and the appends need no length checks.
+
+static char* put_str(char* p, const char* s) {
+    while (*s) {
+        *p++ = *s++;
+    }
+    return p;
+}
+
+static char* put_uint(char* p, unsigned long long v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n > 0) {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+static char* put_int(char* p, long long v) {
+    if (v < 0) {
+        *p++ = '-';
+        return put_uint(p, 0ULL - (unsigned long long)v);
+    }
+    return put_uint(p, (unsigned long long)v);
+}
+
+// Fixed-width zero-padded number (microseconds)
+static char* put_padded(char* p, unsigned long v, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        p[i] = (char)('0' + v % 10);
+        v /= 10;
+    }
+    return p + width;
+}
+
+const char* log_cache_name(int cache) {
+    switch (cache) {
+    case LOG_CACHE_HIT: return "hit";
+    case LOG_CACHE_MISS: return "miss";
+    case LOG_CACHE_BYPASS: return "bypass";
+    case LOG_CACHE_PACK: return "pack";
+    default: return "-";
+    }
+}
+
+size_t log_format_line(log_date_cache_t* dc, const log_record_t* r, int extended, char* out) {
+    // localtime_r/strftime only once per second
+    if (r->timestamp != dc->ts) {
+        struct tm tm_r;
+        localtime_r(&r->timestamp, &tm_r);
+        dc->len = strftime(dc->date, sizeof(dc->date), "%d/%b/%Y:%H:%M:%S", &tm_r);
+        dc->ts = r->timestamp;
+    }
+
+    // Text:     ip [date] "METHOD path" status bytes Nms
+    // Extended: ip [date.usec] "METHOD path" status bytes total=Nus wait=Nus ttfb=Nus cache=X wire=N worker=N tid=N
+    char* p = out;
+    p = put_str(p, r->ip);
+    *p++ = ' ';
+    *p++ = '[';
+    memcpy(p, dc->date, dc->len);
+    p += dc->len;
+    if (extended) {
+        *p++ = '.';
+        p = put_padded(p, (unsigned long)(r->usec % 1000000), 6);
+    }
+    p = put_str(p, "] \"");
+    p = put_str(p, r->method);
+    *p++ = ' ';
+    p = put_str(p, r->path);
+    p = put_str(p, "\" ");
+    p = put_int(p, r->status);
+    *p++ = ' ';
+    p = put_uint(p, r->bytes_sent);
+
+    if (!extended) {
+        *p++ = ' ';
+        p = put_int(p, r->duration_ms);
+        p = put_str(p, "ms\n");
+        return (size_t)(p - out);
+    }
+
+    const log_ext_t* x = &r->ext;
+    p = put_str(p, " total=");
+    p = put_int(p, x->total_us);
+    p = put_str(p, "us wait=");
+    p = put_int(p, x->wait_us);
+    p = put_str(p, "us ttfb=");
+    p = put_int(p, x->ttfb_us);
+    p = put_str(p, "us cache=");
+    p = put_str(p, log_cache_name(x->cache));
+    p = put_str(p, " wire=");
+    p = put_uint(p, x->wire_bytes);
+    p = put_str(p, " worker=");
+    p = put_int(p, x->worker_id);
+    p = put_str(p, " tid=");
+    p = put_int(p, x->tid);
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+// #########################################################################################################
+// ENCODER
+// #########################################################################################################
+
+// FNV-1a hash for dictionary lookups
+static uint32_t hash_str(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void dict_clear(log_dict_t* d) {
+    for (size_t i = 0; i < LOG_DICT_SLOTS; i++) {
+        free(d->str[i]);
+        d->str[i] = NULL;
+    }
+    d->count = 0;
+}
+
+void log_encoder_reset(log_encoder_t* enc) {
+    for (int k = 0; k < LOG_DICT_KINDS; k++) {
+        dict_clear(&enc->dicts[k]);
+    }
+    enc->last_ts = 0;
+}
+
+// Look up a string; when it is new, assign an id and emit a DICT frame into out.
+// Returns the id and advances *pos by the frame size.
+static uint32_t dict_ref(log_dict_t* d, int kind, const char* s, uint8_t* out, size_t* pos) {
+    uint32_t h = hash_str(s);
+    size_t mask = LOG_DICT_SLOTS - 1;
+
+    // Keep the table at most 3/4 full; restart it (ids are simply redefined) when exceeded
+    if (d->count >= LOG_DICT_SLOTS / 4 * 3) {
+        dict_clear(d);
+    }
+
+    size_t i = h & mask;
+    while (d->str[i]) {
+        if (d->hash[i] == h && strcmp(d->str[i], s) == 0) {
+            return d->id[i];
+        }
+        i = (i + 1) & mask;
+    }
+
+    size_t len = strlen(s);
+    uint32_t id = d->count++;
+
+    // On allocation failure the string is still defined, just not remembered
+    char* copy = malloc(len + 1);
+    if (copy) {
+        memcpy(copy, s, len + 1);
+        d->str[i] = copy;
+        d->hash[i] = h;
+        d->id[i] = id;
+    }
+
+    uint8_t* p = out + *pos;
+    size_t n = 0;
+    p[n++] = (uint8_t)(FRAME_DICT | (kind << 2));
+    n += put_varint(p + n, id);
+    n += put_varint(p + n, len);
+    memcpy(p + n, s, len);
+    n += len;
+    *pos += n;
+
+    return id;
+}
+
+size_t log_encode_header(uint8_t* out) {
+    memcpy(out, LOG_BINARY_MAGIC, 4);
+    out[4] = LOG_BINARY_VERSION;
+    out[5] = out[6] = out[7] = 0;
+    return LOG_BINARY_HEADER_SIZE;
+}
+
+size_t log_encode_stream(log_encoder_t* enc, uint8_t* out, uint32_t stream_id, time_t base_ts) {
+    size_t n = 0;
+    out[n++] = FRAME_STREAM;
+    n += put_varint(out + n, stream_id);
+    n += put_varint(out + n, (uint64_t)base_ts);
+    enc->last_ts = base_ts;
+    return n;
+}
+
+size_t log_encode_record(log_encoder_t* enc, uint8_t* out, const log_record_t* rec) {
+    size_t pos = 0;
+
+    // Strings first: DICT frames must precede the record that references them
+    uint32_t path_id = dict_ref(&enc->dicts[LOG_DICT_PATH], LOG_DICT_PATH, rec->path, out, &pos);
+    uint32_t ip_id = dict_ref(&enc->dicts[LOG_DICT_IP], LOG_DICT_IP, rec->ip, out, &pos);
+
+    int method_code = METHOD_EXPLICIT;
+    for (int i = 0; i < METHOD_EXPLICIT; i++) {
+        if (strcmp(rec->method, k_method_table[i]) == 0) {
+            method_code = i;
+            break;
+        }
+    }
+    uint32_t method_id = 0;
+    if (method_code == METHOD_EXPLICIT) {
+        method_id = dict_ref(&enc->dicts[LOG_DICT_METHOD], LOG_DICT_METHOD, rec->method, out, &pos);
+    }
+
+    int status_idx = STATUS_EXPLICIT;
+    for (int i = 0; i < STATUS_EXPLICIT; i++) {
+        if (rec->status == k_status_table[i]) {
+            status_idx = i;
+            break;
+        }
+    }
+
+    uint8_t* p = out + pos;
+    size_t n = 0;
+    int type = rec->has_ext ? FRAME_ACCESS_EXT : FRAME_ACCESS;
+    p[n++] = (uint8_t)(type | (status_idx << 2) | (method_code << 6));
+    n += put_varint(p + n, zigzag((int64_t)(rec->timestamp - enc->last_ts)));
+    n += put_varint(p + n, path_id);
+    n += put_varint(p + n, ip_id);
+    if (status_idx == STATUS_EXPLICIT) {
+        n += put_varint(p + n, (uint64_t)(uint32_t)rec->status);
+    }
+    if (method_code == METHOD_EXPLICIT) {
+        n += put_varint(p + n, method_id);
+    }
+    n += put_varint(p + n, rec->bytes_sent);
+    n += put_varint(p + n, (uint64_t)(rec->duration_ms > 0 ? rec->duration_ms : 0));
+
+    if (rec->has_ext) {
+        const log_ext_t* x = &rec->ext;
+        n += put_varint(p + n, (uint64_t)(rec->usec > 0 ? rec->usec : 0));
+        n += put_varint(p + n, (uint64_t)(x->total_us > 0 ? x->total_us : 0));
+        n += put_varint(p + n, (uint64_t)(x->wait_us > 0 ? x->wait_us : 0));
+        n += put_varint(p + n, (uint64_t)(x->ttfb_us > 0 ? x->ttfb_us : 0));
+        n += put_varint(p + n, x->wire_bytes);
+        n += put_varint(p + n, (uint64_t)(x->worker_id + 1));
+        n += put_varint(p + n, (uint64_t)(uint32_t)x->tid);
+        n += put_varint(p + n, (uint64_t)x->cache);
+    }
+
+    enc->last_ts = rec->timestamp;
+    return pos + n;
+}
+
+// #########################################################################################################
+// DECODER
+// #########################################################################################################
+
+#define DECODER_STREAMS 64 // Writer streams tracked at once (oldest is recycled)
+
+// Decoding state of one writer stream
+typedef struct {
+    int used; // Slot in use
+    uint32_t id; // Stream id (writer pid)
+    char** strs[LOG_DICT_KINDS]; // Strings by id
+    uint32_t cap[LOG_DICT_KINDS]; // Capacity of each strs array
+    time_t last_ts; // Timestamp of the previous record
+} decoder_stream_t;
+
+struct log_decoder {
+    FILE* fp; // Input file
+    decoder_stream_t streams[DECODER_STREAMS]; // Known streams
+    decoder_stream_t* cur; // Stream selected by the last STREAM frame
+    int next_victim; // Next slot to recycle when all are used
+};
+
+static void stream_clear(decoder_stream_t* s) {
+    for (int k = 0; k < LOG_DICT_KINDS; k++) {
+        for (uint32_t i = 0; i < s->cap[k]; i++) {
+            free(s->strs[k][i]);
+        }
+        free(s->strs[k]);
+        s->strs[k] = NULL;
+        s->cap[k] = 0;
+    }
+    s->used = 0;
+}
+
+static decoder_stream_t* stream_select(log_decoder_t* dec, uint32_t id) {
+    for (int i = 0; i < DECODER_STREAMS; i++) {
+        if (dec->streams[i].used && dec->streams[i].id == id) {
+            return &dec->streams[i];
+        }
+    }
+    for (int i = 0; i < DECODER_STREAMS; i++) {
+        if (!dec->streams[i].used) {
+            dec->streams[i].used = 1;
+            dec->streams[i].id = id;
+            return &dec->streams[i];
+        }
+    }
+    decoder_stream_t* s = &dec->streams[dec->next_victim];
+    dec->next_victim = (dec->next_victim + 1) % DECODER_STREAMS;
+    stream_clear(s);
+    s->used = 1;
+    s->id = id;
+    return s;
+}
+
+static const char* stream_lookup(decoder_stream_t* s, int kind, uint64_t id) {
+    if (id >= s->cap[kind] || !s->strs[kind][id]) {
+        return NULL;
+    }
+    return s->strs[kind][id];
+}
+
+log_decoder_t* log_decoder_open(FILE* fp) {
+    uint8_t hdr[LOG_BINARY_HEADER_SIZE];
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+        memcmp(hdr, LOG_BINARY_MAGIC, 4) != 0 || hdr[4] != LOG_BINARY_VERSION) {
+        return NULL;
+    }
+
+    log_decoder_t* dec = calloc(1, sizeof(*dec));
+    if (!dec) {
+        return NULL;
+    }
+    dec->fp = fp;
+    return dec;
+}
+
+void log_decoder_close(log_decoder_t* dec) {
+    if (!dec) {
+        return;
+    }
+    for (int i = 0; i < DECODER_STREAMS; i++) {
+        stream_clear(&dec->streams[i]);
+    }
+    free(dec);
+}
+
+// Handle a DICT frame
+static int decode_dict(log_decoder_t* dec, int tag) {
+    int kind = (tag >> 2) & 0x03;
+    uint64_t id, len;
+    if (kind >= LOG_DICT_KINDS || !dec->cur ||
+        get_varint(dec->fp, &id) != 0 || get_varint(dec->fp, &len) != 0 ||
+        id >= (1u << 24) || len > 4096) {
+        return -1;
+    }
+
+    decoder_stream_t* s = dec->cur;
+    if (id >= s->cap[kind]) {
+        uint32_t ncap = s->cap[kind] ? s->cap[kind] : 64;
+        while (ncap <= id) {
+            ncap *= 2;
+        }
+        char** grown = realloc(s->strs[kind], ncap * sizeof(char*));
+        if (!grown) {
+            return -1;
+        }
+        memset(grown + s->cap[kind], 0, (ncap - s->cap[kind]) * sizeof(char*));
+        s->strs[kind] = grown;
+        s->cap[kind] = ncap;
+    }
+
+    char* str = malloc(len + 1);
+    if (!str || fread(str, 1, len, dec->fp) != len) {
+        free(str);
+        return -1;
+    }
+    str[len] = '\0';
+
+    free(s->strs[kind][id]);
+    s->strs[kind][id] = str;
+    return 0;
+}
+
+// Copy a dictionary string into a record field
+static void set_field(char* dst, size_t cap, const char* src) {
+    size_t len = strlen(src);
+    if (len >= cap) {
+        len = cap - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+int log_decoder_next(log_decoder_t* dec, log_record_t* out) {
+    for (;;) {
+        int tag = getc(dec->fp);
+        if (tag == EOF) {
+            return 0;
+        }
+
+        uint64_t a, b;
+        switch (tag & FRAME_TYPE_MASK) {
+        case FRAME_STREAM:
+            if (get_varint(dec->fp, &a) != 0 || get_varint(dec->fp, &b) != 0) {
+                return -1;
+            }
+            dec->cur = stream_select(dec, (uint32_t)a);
+            dec->cur->last_ts = (time_t)b;
+            break;
+
+        case FRAME_DICT:
+            if (decode_dict(dec, tag) != 0) {
+                return -1;
+            }
+            break;
+
+        case FRAME_ACCESS:
+        case FRAME_ACCESS_EXT: {
+            decoder_stream_t* s = dec->cur;
+            uint64_t delta, path_id, ip_id, status, method_id = 0, bytes, duration;
+            int status_idx = (tag >> 2) & 0x0F;
+            int method_code = (tag >> 6) & 0x03;
+
+            if (!s || get_varint(dec->fp, &delta) != 0 ||
+                get_varint(dec->fp, &path_id) != 0 || get_varint(dec->fp, &ip_id) != 0) {
+                return -1;
+            }
+            if (status_idx == STATUS_EXPLICIT) {
+                if (get_varint(dec->fp, &status) != 0) {
+                    return -1;
+                }
+            } else {
+                status = (uint64_t)k_status_table[status_idx];
+            }
+            if (method_code == METHOD_EXPLICIT && get_varint(dec->fp, &method_id) != 0) {
+                return -1;
+            }
+            if (get_varint(dec->fp, &bytes) != 0 || get_varint(dec->fp, &duration) != 0) {
+                return -1;
+            }
+
+            const char* path = stream_lookup(s, LOG_DICT_PATH, path_id);
+            const char* ip = stream_lookup(s, LOG_DICT_IP, ip_id);
+            const char* method = (method_code == METHOD_EXPLICIT)
+                ? stream_lookup(s, LOG_DICT_METHOD, method_id)
+                : k_method_table[method_code];
+            if (!path || !ip || !method) {
+                return -1;
+            }
+
+            memset(out, 0, sizeof(*out));
+            s->last_ts += (time_t)unzigzag(delta);
+            out->timestamp = s->last_ts;
+            out->status = (int)status;
+            out->bytes_sent = (size_t)bytes;
+            out->duration_ms = (long)duration;
+            set_field(out->path, sizeof(out->path), path);
+            set_field(out->ip, sizeof(out->ip), ip);
+            set_field(out->method, sizeof(out->method), method);
+
+            if ((tag & FRAME_TYPE_MASK) == FRAME_ACCESS_EXT) {
+                uint64_t v[8];
+                for (int i = 0; i < 8; i++) {
+                    if (get_varint(dec->fp, &v[i]) != 0) {
+                        return -1;
+                    }
+                }
+                out->has_ext = 1;
+                out->usec = (long)v[0];
+                out->ext.total_us = (long long)v[1];
+                out->ext.wait_us = (long long)v[2];
+                out->ext.ttfb_us = (long long)v[3];
+                out->ext.wire_bytes = (size_t)v[4];
+                out->ext.worker_id = (int)v[5] - 1;
+                out->ext.tid = (int)v[6];
+                out->ext.cache = (int)v[7];
+            }
+            return 1;
+        }
+
+        default:
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// ###############################################################################################################
+// Access log records and the compact binary log format
+//
+// log_record_t is the fixed-size entry request threads hand to the logger. In binary mode (LOG_FORMAT=binary)
+// the writer thread encodes records as frames instead of text lines:
+//
+//   file header : "WSBL" + version byte + 3 reserved bytes (written once, at offset 0)
+//   STREAM frame: tag, varint stream id (writer pid), varint base timestamp (epoch seconds)
+//   DICT frame  : tag (kind in bits 2-3), varint id, varint length, bytes
+//   ACCESS frame: tag (status index in bits 2-5, method in bits 6-7), zigzag varint timestamp delta,
+//                 varint path id, varint ip id, [varint status], [varint method id], varint bytes,
+//                 varint duration_ms
+//   ACCESS_EXT  : an ACCESS frame followed by varint usec, total_us, wait_us, ttfb_us, wire_bytes,
+//                 worker_id + 1, tid, cache (records carrying log_ext_t details)
+//
+// Every batch starts with a STREAM frame, so the frames of one writer are self-contained even when several
+// worker processes append to the same file. Paths, IPs and uncommon methods are sent once per stream as DICT
+// frames and referenced by id afterwards; a typical record takes 6-8 bytes instead of ~60 bytes of text.
+// Dictionaries restart whenever the writer opens a new file, so each file decodes on its own.
+// ###############################################################################################################
+
+#define LOG_BINARY_MAGIC "WSBL" // File magic
+#define LOG_BINARY_VERSION 1 // Format version
+#define LOG_BINARY_HEADER_SIZE 8 // Magic + version + reserved
+
+#define LOG_FRAME_MAX 1024 // Upper bound of the bytes one record can encode to (including its DICT frames)
+#define LOG_LINE_MAX 1024 // Longest formatted text line
+
+// Cache outcome of a request (extended records)
+#define LOG_CACHE_NONE 0 // Not a file request (error, /api/stats)
+#define LOG_CACHE_HIT 1 // Served from the worker cache
+#define LOG_CACHE_MISS 2 // Loaded into the cache, then served
+#define LOG_CACHE_BYPASS 3 // Served from disk without caching (too large)
+#define LOG_CACHE_PACK 4 // Served from the docroot bundle (DOCPACK)
+
+// Extended request details (LOG_FORMAT=extended; ACCESS_EXT frames in binary logs).
+// All times are microseconds measured from the moment the master accepted the connection.
+typedef struct {
+    long long total_us; // Until the response was completely sent
+    long long wait_us; // Until a request thread picked the connection up (master + worker queues)
+    long long ttfb_us; // Until the first response byte was sent (0 = nothing sent)
+    size_t wire_bytes; // Header and body bytes actually written to the socket
+    int worker_id; // Worker process index (-1 = unknown)
+    int tid; // Kernel thread id of the request thread
+    int cache; // LOG_CACHE_*
+} log_ext_t;
+
+// Fixed-size log record (copied by value into the logger ring)
+typedef struct {
+    time_t timestamp; // Time the request completed
+    long usec; // Microseconds within that second
+    int status; // HTTP status code
+    size_t bytes_sent; // Number of bytes sent
+    long duration_ms; // Request duration in milliseconds
+    char ip[46]; // Client IP address (fits IPv6 text form)
+    char method[16]; // HTTP method
+    char path[512]; // Request path
+    int has_ext; // ext below is filled in
+    log_ext_t ext; // Extended details
+} log_record_t;
+
+// Per-second cache of the formatted date used by log_format_line()
+typedef struct {
+    time_t ts; // Second the date was formatted for ((time_t)-1 = empty)
+    char date[32]; // "%d/%b/%Y:%H:%M:%S" in local time
+    size_t len; // Length of date
+} log_date_cache_t;
+
+// Formats a record as one text line (LOG_FORMAT=text, or extended when extended != 0) without snprintf.
+// out must hold LOG_LINE_MAX bytes. Returns the line length including the trailing newline.
+size_t log_format_line(log_date_cache_t* dc, const log_record_t* rec, int extended, char* out);
+
+// Name of a LOG_CACHE_* value ("-", "hit", "miss", "bypass", "pack")
+const char* log_cache_name(int cache);
+
+// Dictionary kinds
+#define LOG_DICT_PATH 0
+#define LOG_DICT_IP 1
+#define LOG_DICT_METHOD 2
+#define LOG_DICT_KINDS 3
+
+#define LOG_DICT_SLOTS 4096 // Entries per dictionary before it restarts (power of two)
+
+// String -> id dictionary used by the encoder (open addressing)
+typedef struct {
+    uint32_t hash[LOG_DICT_SLOTS]; // Hash of the string in each slot
+    char* str[LOG_DICT_SLOTS]; // Owned copy of the string (NULL = empty slot)
+    uint32_t id[LOG_DICT_SLOTS]; // Id assigned to the string
+    uint32_t count; // Number of ids assigned
+} log_dict_t;
+
+// Encoder state for one writer stream (one process, one open file)
+typedef struct {
+    log_dict_t dicts[LOG_DICT_KINDS]; // Path / IP / method dictionaries
+    time_t last_ts; // Timestamp of the previous record in this stream
+} log_encoder_t;
+
+// Clears the dictionaries; the next records re-define every string they use.
+void log_encoder_reset(log_encoder_t* enc);
+
+// Writes the file header into out (LOG_BINARY_HEADER_SIZE bytes). Returns the number of bytes written.
+size_t log_encode_header(uint8_t* out);
+
+// Starts a batch. Returns the number of bytes written (at most 16).
+size_t log_encode_stream(log_encoder_t* enc, uint8_t* out, uint32_t stream_id, time_t base_ts);
+
+// Encodes one record (plus any DICT frames it needs). out must hold LOG_FRAME_MAX bytes.
+size_t log_encode_record(log_encoder_t* enc, uint8_t* out, const log_record_t* rec);
+
+// Opaque decoder over a binary log file
+typedef struct log_decoder log_decoder_t;
+
+// Checks the file header and prepares to decode. Returns NULL if fp is not a binary log.
+log_decoder_t* log_decoder_open(FILE* fp);
+
+// Reads the next record. Returns 1 on success, 0 at end of file, -1 on a corrupt frame.
+int log_decoder_next(log_decoder_t* dec, log_record_t* out);
+
+// Releases the decoder (does not close fp).
+void log_decoder_close(log_decoder_t* dec);
+
+#endif // LOG_FORMAT_H
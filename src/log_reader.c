@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "log_format.h"
+
+// Utility to convert binary access logs (LOG_FORMAT=binary) back to text
+//
+// Usage: log_reader [-f text|extended|clf|combined] [--from TIME] [--to TIME] file...
+//   text     -> same lines the server writes with LOG_FORMAT=text
+//   extended -> same lines as LOG_FORMAT=extended (timing fields are 0 for records written without them)
+//   clf      -> Common Log Format
+//   combined -> Combined Log Format (referer and user agent are not recorded: "-")
+// TIME is epoch seconds or local time as YYYY-MM-DDTHH:MM:SS. Files are read in the given order,
+// so pass rotated generations oldest first (e.g. access.log.2 access.log.1 access.log).
+
+#define OUT_TEXT 0
+#define OUT_CLF 1
+#define OUT_COMBINED 2
+#define OUT_EXTENDED 3
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-f text|extended|clf|combined] [--from TIME] [--to TIME] file...\n", prog);
+    fprintf(stderr, "TIME: epoch seconds or YYYY-MM-DDTHH:MM:SS (local time)\n");
+}
+
+// Parse epoch seconds or a local ISO-like timestamp. Returns -1 on error.
+static time_t parse_time(const char* s) {
+    char* end;
+    long long v = strtoll(s, &end, 10);
+    if (*s && *end == '\0') {
+        return (time_t)v;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* rest = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (!rest || *rest) {
+        rest = strptime(s, "%Y-%m-%d %H:%M:%S", &tm);
+    }
+    if (!rest || *rest) {
+        return (time_t)-1;
+    }
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// Print one record in the selected format
+static void print_record(const log_record_t* r, int format) {
+    static log_date_cache_t dc = { .ts = (time_t)-1 };
+    struct tm tm_r;
+    char date[64];
+
+    if (format == OUT_TEXT || format == OUT_EXTENDED) {
+        char line[LOG_LINE_MAX];
+        size_t len = log_format_line(&dc, r, format == OUT_EXTENDED, line);
+        fwrite(line, 1, len, stdout);
+        return;
+    }
+
+    localtime_r(&r->timestamp, &tm_r);
+
+    strftime(date, sizeof(date), "%d/%b/%Y:%H:%M:%S %z", &tm_r);
+    printf("%s - - [%s] \"%s %s HTTP/1.1\" %d ", r->ip, date, r->method, r->path, r->status);
+    if (r->bytes_sent > 0) {
+        printf("%zu", r->bytes_sent);
+    } else {
+        printf("-");
+    }
+    if (format == OUT_COMBINED) {
+        printf(" \"-\" \"-\"");
+    }
+    printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    int format = OUT_TEXT;
+    time_t from = 0; // Inclusive lower bound (0 = none)
+    time_t to = 0; // Inclusive upper bound (0 = none)
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char* f = argv[++i];
+            if (strcmp(f, "text") == 0) {
+                format = OUT_TEXT;
+            } else if (strcmp(f, "extended") == 0) {
+                format = OUT_EXTENDED;
+            } else if (strcmp(f, "clf") == 0 || strcmp(f, "common") == 0) {
+                format = OUT_CLF;
+            } else if (strcmp(f, "combined") == 0) {
+                format = OUT_COMBINED;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from = parse_time(argv[++i]);
+            if (from == (time_t)-1) {
+                fprintf(stderr, "Error: invalid time '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            to = parse_time(argv[++i]);
+            if (to == (time_t)-1) {
+                fprintf(stderr, "Error: invalid time '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+
+    if (first_file >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = first_file; i < argc; i++) {
+        FILE* fp = fopen(argv[i], "rb");
+        if (!fp) {
+            perror(argv[i]);
+            status = 1;
+            continue;
+        }
+
+        log_decoder_t* dec = log_decoder_open(fp);
+        if (!dec) {
+            fprintf(stderr, "Error: %s is not a binary access log\n", argv[i]);
+            fclose(fp);
+            status = 1;
+            continue;
+        }
+
+        log_record_t rec;
+        int ret;
+        while ((ret = log_decoder_next(dec, &rec)) == 1) {
+            if ((from && rec.timestamp < from) || (to && rec.timestamp > to)) {
+                continue;
+            }
+            print_record(&rec, format);
+        }
+
+        if (ret < 0) {
+            // A truncated last frame is expected if the server was killed mid-write
+            fprintf(stderr, "Warning: %s: corrupt or truncated frame at offset %ld\n", argv[i], ftell(fp));
+            status = 1;
+        }
+
+        log_decoder_close(dec);
+        fclose(fp);
+    }
+
+    return status;
+}
@@ -1,15 +1,23 @@
 #define _GNU_SOURCE
 #include "logger.h"
+#include "log_format.h"
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <errno.h>
-#include <semaphore.h>
+#include <spawn.h>
+#include <sys/wait.h>
 
 // #########################################################################################################
 // LOGGER INTERNAL STATE
@@ -18,166 +26,771 @@
 // Absolute path to the log file
 static char g_log_path[512];
 
-// File descriptor for writing
+// File descriptor for writing (only used by the writer thread once it is running)
 static int g_log_fd = -1;
 
-// Global POSIX semaphore for mutual exclusion between processes & threads
-static sem_t* g_sem = NULL;
+// Robust process-shared mutex (in the shared memory segment) for mutual exclusion between processes
+static pthread_mutex_t* g_file_lock = NULL;
+
+// Mutex serializing the generation chain (access.log.1 ... .N) between processes. It is only taken by
+// rotator threads, never while the log file lock is held.
+static pthread_mutex_t* g_rot_lock = NULL;
+
+// Stand-ins when the logger is used without shared memory (single process, e.g. tools)
+static pthread_mutex_t g_local_file_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_local_rot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Rotation limits (LOG_MAX_SIZE_MB, LOG_ROTATE_INTERVAL_SEC, LOG_MAX_FILES, LOG_COMPRESS)
+static off_t g_max_size = 0; // Rotate at this size (0 = never by size)
+static time_t g_rotate_interval = 0; // Rotate when the file is this old (0 = never by age)
+static int g_max_files = 5; // Generations kept
+static int g_compress = 0; // gzip generations before they enter the chain
+static time_t g_log_opened = 0; // When the writer started on the current file (age reference)
+
+// End-of-file offset observed after the last batch, and inode of the file g_log_fd points to.
+// Rotation decisions use the tracked offset instead of an fstat() per line; the inode is compared
+// with the path once per batch (under the file lock) to follow rotations done by other processes.
+static off_t g_log_offset = 0;
+static ino_t g_log_ino = 0;
+
+// Output format (LOG_FORMAT_TEXT or LOG_FORMAT_BINARY) and binary encoder state for the open file.
+// The encoder is only touched by the writer thread; it restarts whenever a new file is opened.
+static int g_log_format = LOG_FORMAT_TEXT;
+static log_encoder_t g_encoder;
+static int g_header_checked = 0; // Binary mode: file header presence verified for the open file
+
+// Filtering (LOG_LEVEL, ACCESS_LOG_SAMPLE, ACCESS_LOG_SLOW_MS)
+static int g_log_level = LOG_LEVEL_INFO;
+static int g_sample_rate = 1;
+static long g_slow_ms = 0;
+static __thread unsigned int t_sample_counter = 0; // Per-thread, so sampling needs no shared counter
 
-// Fixed name for the POSIX semaphore (must start with '/')
-static const char* LOG_SEM_NAME = "/ws_log_sem";
+// #########################################################################################################
+// RECORD RING (multi-producer / single-consumer, lock-free)
+// #########################################################################################################
+// Bounded ring with a sequence number per slot: a producer claims a position with one CAS on the head,
+// copies its record and publishes it by advancing the slot sequence. The writer thread is the only
+// consumer, so its tail needs no atomics.
+
+#define LOG_BATCH_MAX 64 // Records written per writev() call
+#define LOG_IDLE_WAIT_MS 20 // Writer sleep when the ring is empty
+#define LOG_DEFAULT_RING 1024 // Ring size when LOG_RING_SIZE is not set
+
+// Ring slot
+typedef struct {
+    atomic_size_t seq; // == position + 1 when the record is ready for the writer
+    log_record_t rec; // Record payload
+} log_slot_t;
+
+static log_slot_t* g_ring = NULL; // Ring storage
+static size_t g_ring_mask = 0; // Ring size - 1 (size is a power of two)
+static atomic_size_t g_ring_head; // Next position claimed by producers
+static size_t g_ring_tail = 0; // Next position consumed by the writer (writer thread only)
+static atomic_size_t g_ring_done; // Positions already written to disk (for logger_flush)
+static atomic_size_t g_dropped; // Records discarded because the ring was full
+static int g_overflow_policy = LOG_OVERFLOW_BLOCK; // What producers do on a full ring
+
+// Writer thread state
+#define WRITER_IDLE 0 // Not started yet
+#define WRITER_RUNNING 1 // Draining the ring
+#define WRITER_STOPPING 2 // Asked to drain and exit
+#define WRITER_FAILED 3 // Could not be started
+
+static pthread_t g_writer; // Writer thread
+static atomic_int g_writer_state; // One of WRITER_*
+static pthread_mutex_t g_wake_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects writer start and wakeups
+static pthread_cond_t g_wake_cond = PTHREAD_COND_INITIALIZER; // Signalled when the writer has work
+static pid_t g_owner_pid = 0; // Process that initialized the logger
+
+// Date cache for the writer (strftime only once per second)
+static log_date_cache_t g_date_cache = { .ts = (time_t)-1 };
+
+// Copy a string into a fixed-size field, truncating if needed
+static void copy_field(char* dst, size_t cap, const char* src) {
+    if (!src) {
+        src = "-";
+    }
+    size_t len = strnlen(src, cap - 1);
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
 
-// Maximum allowed log file size before rotation (10 MB)
-static const off_t LOG_MAX_SIZE = 10 * 1024 * 1024;
+// Round up to the next power of two (minimum 64 slots)
+static size_t ring_capacity(int requested) {
+    size_t want = (requested > 0) ? (size_t)requested : LOG_DEFAULT_RING;
+    size_t cap = 64;
+    while (cap < want) {
+        cap <<= 1;
+    }
+    return cap;
+}
 
-// Number of rotated log files to keep
-static const int LOG_MAX_ROTATIONS = 5;
+// Claim a free slot. Returns NULL when the ring is full.
+static log_slot_t* ring_claim(size_t* out_pos) {
+    size_t pos = atomic_load_explicit(&g_ring_head, memory_order_relaxed);
+
+    for (;;) {
+        log_slot_t* slot = &g_ring[pos & g_ring_mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // Slot is free for this position: try to take it
+            if (atomic_compare_exchange_weak_explicit(&g_ring_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *out_pos = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            // The writer has not consumed this slot from the previous lap yet
+            return NULL;
+        } else {
+            // Another producer took it; reload the head
+            pos = atomic_load_explicit(&g_ring_head, memory_order_relaxed);
+        }
+    }
+}
 
-// Log buffer (Feature 5: Buffering)
-#define LOG_BUFFER_SIZE 4096 // Buffer size (4KB)
-static char g_log_buffer[LOG_BUFFER_SIZE]; // Buffer for log entries
-static int g_buf_pos = 0; // Current position in the buffer
-static time_t g_last_flush = 0; // Last flush time
+// Wake the writer thread (used only on the slow paths: ring half full, full, flush, close)
+static void wake_writer(void) {
+    pthread_mutex_lock(&g_wake_mutex);
+    pthread_cond_signal(&g_wake_cond);
+    pthread_mutex_unlock(&g_wake_mutex);
+}
 
 // #########################################################################################################
-// Internal function: Get current file size
+// Internal function: (Re)open the log file and record its identity and size
 // #########################################################################################################
-static off_t get_file_size(int fd) { 
-    struct stat st; 
-    
-    // Get file size using fstat
-    if (fstat(fd, &st) == 0) {
-        return st.st_size;
+static int open_log_file(void) {
+    if (g_log_fd >= 0) {
+        close(g_log_fd);
     }
-    
-    return -1;
+
+    g_log_fd = open(g_log_path, O_CREAT | O_WRONLY | O_APPEND, 0644);
+    if (g_log_fd < 0) {
+        return -1;
+    }
+
+    // A new file starts new dictionaries (binary mode)
+    log_encoder_reset(&g_encoder);
+    g_header_checked = 0;
+
+    // One fstat per open: starting offset and inode for rotation checks
+    struct stat st;
+    if (fstat(g_log_fd, &st) == 0) {
+        g_log_offset = st.st_size;
+        g_log_ino = st.st_ino;
+    } else {
+        g_log_offset = 0;
+        g_log_ino = 0;
+    }
+    g_log_opened = time(NULL);
+    return 0;
 }
 
 
 // #########################################################################################################
-// Internal function: Perform automatic log rotation
-// access.log → access.log.1 → ... → access.log.5
+// Log rotation
+// access.log → access.log.<pid>.<n>.rot (under the lock) → [gzip] → access.log.1[.gz] → ... → .N[.gz]
 // #########################################################################################################
+// Under the log file lock the writer only renames the full file to a unique staging name and opens a fresh
+// one, which costs two syscalls. Shifting the generation chain and compressing happen later in a per-process
+// rotator thread, so neither the other writers nor request threads ever wait for them.
+
+#define ROT_QUEUE_MAX 8 // Staged files waiting for the rotator
+
+static char g_rot_queue[ROT_QUEUE_MAX][600]; // Staged file paths (FIFO)
+static int g_rot_first = 0; // Index of the oldest queued path
+static int g_rot_count = 0; // Number of queued paths
+static unsigned int g_rot_seq = 0; // Makes staging names unique within this process
+static int g_rot_stop = 0; // Rotator asked to finish the queue and exit
+static int g_rot_started = 0; // Rotator thread exists
+static pthread_t g_rotator; // Rotator thread
+static pthread_mutex_t g_rot_mutex = PTHREAD_MUTEX_INITIALIZER; // Protects the queue
+static pthread_cond_t g_rot_cond = PTHREAD_COND_INITIALIZER; // Signalled on queue changes
+
+// Compress path to path.gz with the gzip binary (the caller checks which of the two files is left)
+static void compress_file(const char* path) {
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    // The child must not inherit client sockets: a held socket would delay the connection close
+    posix_spawn_file_actions_addclosefrom_np(&fa, STDERR_FILENO + 1);
+
+    char* argv[] = {"gzip", "-f", "-q", (char*)path, NULL};
+    pid_t pid;
+    int rc = posix_spawnp(&pid, "gzip", &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if (rc != 0) {
+        errno = rc;
+        LOG_DIAG(LOG_LEVEL_WARN, "logger: cannot run gzip, keeping %s uncompressed: %m", path);
+        return;
+    }
 
-// Rotates log files when the main log file exceeds the maximum size.
-static void rotate_logs() {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        LOG_DIAG(LOG_LEVEL_WARN, "logger: gzip %s exited with status %d", path,
+                 WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    }
+}
 
-    // Close the log file descriptor
-    if (g_log_fd >= 0) {
-        close(g_log_fd);
-        g_log_fd = -1;
+// Shift access.log.i[suffix] → access.log.i+1[suffix], dropping generations beyond LOG_MAX_FILES.
+// Both suffixes are shifted so a chain mixing compressed and plain generations stays in order.
+static void shift_generations(void) {
+    static const char* suffixes[] = {"", ".gz"};
+    char oldpath[620];
+    char newpath[620];
+
+    for (int s = 0; s < 2; s++) {
+        snprintf(oldpath, sizeof(oldpath), "%s.%d%s", g_log_path, g_max_files, suffixes[s]);
+        unlink(oldpath);
+
+        for (int i = g_max_files - 1; i >= 1; i--) {
+            snprintf(oldpath, sizeof(oldpath), "%s.%d%s", g_log_path, i, suffixes[s]);
+            snprintf(newpath, sizeof(newpath), "%s.%d%s", g_log_path, i + 1, suffixes[s]);
+            rename(oldpath, newpath);
+        }
     }
+}
 
-    char oldpath[600]; // Path for the oldest rotated log file
-    char newpath[600]; // Path for the new rotated log file
+// Compress one staged file and insert it into the chain as generation 1 (rotator thread)
+static void finish_rotation(const char* staged) {
+    if (g_max_files <= 0) {
+        unlink(staged); // No generations kept
+        return;
+    }
 
-    // Remove the oldest rotated log file
-    snprintf(oldpath, sizeof(oldpath), "%s.%d", g_log_path, LOG_MAX_ROTATIONS);
-    unlink(oldpath);
+    char src[620];
+    char dst[620];
+    const char* suffix = "";
+    snprintf(src, sizeof(src), "%s", staged);
+    if (g_compress) {
+        // gzip reports warnings (exit status 2) and still replaces the file: whenever the source is gone,
+        // staged.gz holds the generation. With both present the .gz is a leftover of a failed run.
+        char gz[620];
+        snprintf(gz, sizeof(gz), "%s.gz", staged);
+        compress_file(staged);
+        if (access(gz, F_OK) == 0) {
+            if (access(staged, F_OK) != 0) {
+                snprintf(src, sizeof(src), "%s", gz);
+                suffix = ".gz";
+            } else {
+                unlink(gz);
+            }
+        }
+    }
 
-    // Shift rotated logs: N-1 → N, ..., 1 → 2
-    for (int i = LOG_MAX_ROTATIONS - 1; i >= 1; i--) {
-        snprintf(oldpath, sizeof(oldpath), "%s.%d", g_log_path, i);
-        snprintf(newpath, sizeof(newpath), "%s.%d", g_log_path, i + 1);
-        rename(oldpath, newpath);
+    sync_lock(g_rot_lock);
+    shift_generations();
+    snprintf(dst, sizeof(dst), "%s.1%s", g_log_path, suffix);
+    if (rename(src, dst) != 0) {
+        LOG_DIAG(LOG_LEVEL_ERROR, "logger: rename %s: %m", src);
     }
+    sync_unlock(g_rot_lock);
+}
 
-    // Move main log file to .1
-    snprintf(newpath, sizeof(newpath), "%s.1", g_log_path);
-    rename(g_log_path, newpath);
+// Rotator thread: finish staged rotations in order until asked to stop and the queue is empty
+static void* rotator_main(void* arg) {
+    (void)arg;
+
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    char staged[600];
+    pthread_mutex_lock(&g_rot_mutex);
+    while (1) {
+        while (g_rot_count == 0 && !g_rot_stop) {
+            pthread_cond_wait(&g_rot_cond, &g_rot_mutex);
+        }
+        if (g_rot_count == 0) {
+            break;
+        }
+        memcpy(staged, g_rot_queue[g_rot_first], sizeof(staged));
+        pthread_mutex_unlock(&g_rot_mutex);
+
+        finish_rotation(staged);
+
+        pthread_mutex_lock(&g_rot_mutex);
+        g_rot_first = (g_rot_first + 1) % ROT_QUEUE_MAX;
+        g_rot_count--;
+        pthread_cond_broadcast(&g_rot_cond); // A writer may wait for queue space
+    }
+    pthread_mutex_unlock(&g_rot_mutex);
+    return NULL;
+}
+
+// Hand a staged file to the rotator, starting it on first use (writer thread, file lock released: waiting for
+// queue space, or compressing here, must not stall the other processes' writers)
+static void queue_rotation(const char* staged) {
+    pthread_mutex_lock(&g_rot_mutex);
+    if (!g_rot_started) {
+        if (pthread_create(&g_rotator, NULL, rotator_main, NULL) != 0) {
+            pthread_mutex_unlock(&g_rot_mutex);
+            perror("logger: rotator pthread_create");
+            finish_rotation(staged); // Do it here rather than leave the file behind
+            return;
+        }
+        g_rot_started = 1;
+    }
+
+    // Only a burst of rotations can fill the queue; the writer (not a request thread) waits then
+    while (g_rot_count == ROT_QUEUE_MAX) {
+        pthread_cond_wait(&g_rot_cond, &g_rot_mutex);
+    }
+    snprintf(g_rot_queue[(g_rot_first + g_rot_count) % ROT_QUEUE_MAX], sizeof(g_rot_queue[0]), "%s", staged);
+    g_rot_count++;
+    pthread_cond_broadcast(&g_rot_cond);
+    pthread_mutex_unlock(&g_rot_mutex);
+}
+
+// Swap the full file for an empty one (called with the file lock held). The staged name embeds the pid,
+// so concurrent rotations in different processes never collide. Returns 1 when staged (of staged_size) holds
+// a file for queue_rotation(), 0 when nothing was staged.
+static int rotate_logs(char* staged, size_t staged_size) {
+    snprintf(staged, staged_size, "%s.%d.%u.rot", g_log_path, (int)g_owner_pid, g_rot_seq++);
+
+    if (rename(g_log_path, staged) != 0) {
+        LOG_DIAG(LOG_LEVEL_ERROR, "logger: rotate %s: %m", g_log_path);
+        g_log_opened = time(NULL); // Retry at the next age limit instead of every batch
+        return 0;
+    }
 
     // Reopen main log file (empty)
-    g_log_fd = open(g_log_path, O_CREAT | O_WRONLY | O_APPEND, 0644); // Reopen main log file (empty)
+    if (open_log_file() != 0) {
+        perror("logger: reopen after rotation");
+    }
+    return 1;
+}
+
+// Finish queued rotations and stop the rotator thread
+static void stop_rotator(void) {
+    pthread_mutex_lock(&g_rot_mutex);
+    int started = g_rot_started;
+    g_rot_stop = 1;
+    pthread_cond_broadcast(&g_rot_cond);
+    pthread_mutex_unlock(&g_rot_mutex);
+
+    if (started) {
+        pthread_join(g_rotator, NULL);
+    }
+    g_rot_started = 0;
+    g_rot_stop = 0;
 }
 
+// Rotation is due when the file is over the size limit or older than the rotation interval
+static int rotation_due(time_t now) {
+    if (g_max_size > 0 && g_log_offset >= g_max_size) {
+        return 1;
+    }
+    return g_rotate_interval > 0 && g_log_offset > 0 && now - g_log_opened >= g_rotate_interval;
+}
+
+// Decide whether to reopen (another process rotated) or rotate (file is full). Semaphore held.
+// The path is checked on every batch: once another process has staged the file for the rotator, no
+// process may append to it any more, or its lines would be lost when gzip replaces it.
+// Returns 1 when this process staged a file (in staged) to queue once the lock is released.
+static int check_rotation_locked(time_t now, char* staged, size_t staged_size) {
+    int due = rotation_due(now);
+
+    struct stat st;
+    if (stat(g_log_path, &st) != 0 || st.st_ino != g_log_ino) {
+        // Our descriptor points to a rotated generation: follow the path again
+        if (open_log_file() != 0) {
+            perror("logger: reopen logfile");
+        }
+    }
+
+    // Re-check: after following another process's rotation the new file may not be due at all
+    if (due && g_log_fd >= 0 && rotation_due(now)) {
+        return rotate_logs(staged, staged_size);
+    }
+    return 0;
+}
 
 // #########################################################################################################
-// Logger initialization
+// Writer thread
 // #########################################################################################################
-void logger_init(const char* logfile_path) {
-    strncpy(g_log_path, logfile_path, sizeof(g_log_path) - 1);
-    g_log_path[sizeof(g_log_path) - 1] = '\0';
 
-    g_sem = sem_open(LOG_SEM_NAME, O_CREAT, 0666, 1);
+// Move up to LOG_BATCH_MAX ready records from the ring into the batch (releasing their slots)
+static int drain_batch(log_record_t* batch) {
+    int n = 0;
 
-    if (g_sem == SEM_FAILED) {
-        perror("logger: sem_open");
-        exit(1);
+    while (n < LOG_BATCH_MAX) {
+        log_slot_t* slot = &g_ring[g_ring_tail & g_ring_mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        // Empty, or the producer of this position is still copying its record
+        if (seq != g_ring_tail + 1) {
+            break;
+        }
+
+        batch[n++] = slot->rec;
+
+        // Hand the slot back to producers for the next lap
+        atomic_store_explicit(&slot->seq, g_ring_tail + g_ring_mask + 1, memory_order_release);
+        g_ring_tail++;
+    }
+    return n;
+}
+
+// Encode the batch as binary frames (file lock held: dictionaries must match the file being written)
+static int encode_batch_locked(const log_record_t* batch, int n, char* arena, uint8_t* prefix, struct iovec* iov) {
+    int cnt = 0;
+    size_t h = 0;
+
+    // The first writer of an empty file writes the file header
+    if (!g_header_checked) {
+        if (lseek(g_log_fd, 0, SEEK_END) == 0) {
+            h += log_encode_header(prefix);
+        }
+        g_header_checked = 1;
+    }
+    h += log_encode_stream(&g_encoder, prefix + h, (uint32_t)g_owner_pid, batch[0].timestamp);
+    iov[cnt].iov_base = prefix;
+    iov[cnt].iov_len = h;
+    cnt++;
+
+    for (int i = 0; i < n; i++) {
+        char* frame = arena + (size_t)i * LOG_FRAME_MAX;
+        iov[cnt].iov_base = frame;
+        iov[cnt].iov_len = log_encode_record(&g_encoder, (uint8_t*)frame, &batch[i]);
+        cnt++;
+    }
+    return cnt;
+}
+
+// Append a batch to the log file under the inter-process lock
+static void write_batch(const log_record_t* batch, int n) {
+    static char arena[LOG_BATCH_MAX * LOG_LINE_MAX]; // Formatted lines / encoded frames of the batch
+    static uint8_t prefix[LOG_BINARY_HEADER_SIZE + 32]; // Binary file header and STREAM frame
+    struct iovec iov_buf[LOG_BATCH_MAX + 1]; // One iovec per line (plus the binary prefix)
+    struct iovec* iov = iov_buf;
+    int cnt = 0;
+
+    // Text lines do not depend on the file: format them before taking the lock
+    if (g_log_format != LOG_FORMAT_BINARY) {
+        int extended = (g_log_format == LOG_FORMAT_EXTENDED);
+        for (int i = 0; i < n; i++) {
+            char* line = arena + (size_t)i * LOG_LINE_MAX;
+            iov[cnt].iov_base = line;
+            iov[cnt].iov_len = log_format_line(&g_date_cache, &batch[i], extended, line);
+            cnt++;
+        }
+    }
+
+    // A process that died while appending (sync_lock() == 1) leaves no state to repair here: the file is
+    // re-checked below and the offset re-read after the write
+    sync_lock(g_file_lock);
+
+    char staged[600];
+    int rotated = check_rotation_locked(time(NULL), staged, sizeof(staged));
+
+    if (g_log_format == LOG_FORMAT_BINARY && g_log_fd >= 0) {
+        cnt = encode_batch_locked(batch, n, arena, prefix, iov);
+    }
+
+    while (cnt > 0 && g_log_fd >= 0) {
+        ssize_t w = writev(g_log_fd, iov, cnt);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_DIAG(LOG_LEVEL_ERROR, "logger: write failed: %m");
+            break;
+        }
+
+        // Skip fully written entries, then resume a partially written one
+        while (cnt > 0 && (size_t)w >= iov[0].iov_len) {
+            w -= (ssize_t)iov[0].iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov[0].iov_base = (char*)iov[0].iov_base + w;
+            iov[0].iov_len -= (size_t)w;
+        }
+    }
+
+    // With O_APPEND the offset after the write is the current end of file (all processes included)
+    off_t end = lseek(g_log_fd, 0, SEEK_CUR);
+    if (end >= 0) {
+        g_log_offset = end;
+    }
+
+    sync_unlock(g_file_lock);
+
+    // The staged file is out of every process's way already: compress it without holding them up
+    if (rotated) {
+        queue_rotation(staged);
+    }
+}
+
+// Writer thread: drain, format and write until asked to stop and the ring is empty
+static void* writer_main(void* arg) {
+    (void)arg;
+
+    // Signals are for the worker's main thread
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    static log_record_t batch[LOG_BATCH_MAX]; // Records of the current batch
+
+    while (1) {
+        int stopping = (atomic_load(&g_writer_state) == WRITER_STOPPING);
+
+        int n = drain_batch(batch);
+        if (n > 0) {
+            write_batch(batch, n);
+            atomic_store_explicit(&g_ring_done, g_ring_tail, memory_order_release);
+            continue;
+        }
+        atomic_store_explicit(&g_ring_done, g_ring_tail, memory_order_release);
+
+        if (stopping) {
+            break;
+        }
+
+        // Ring empty: sleep until woken or the idle timeout expires
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += LOG_IDLE_WAIT_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&g_wake_mutex);
+        if (atomic_load(&g_writer_state) == WRITER_RUNNING) {
+            pthread_cond_timedwait(&g_wake_cond, &g_wake_mutex, &ts);
+        }
+        pthread_mutex_unlock(&g_wake_mutex);
+    }
+
+    return NULL;
+}
+
+// Start the writer thread on first use (the master never logs requests, so it never starts one)
+static void ensure_writer_started(void) {
+    if (atomic_load_explicit(&g_writer_state, memory_order_acquire) != WRITER_IDLE) {
+        return;
     }
 
-    g_log_fd = open(g_log_path, O_CREAT | O_WRONLY | O_APPEND, 0644); // Open log file
+    pthread_mutex_lock(&g_wake_mutex);
+    if (atomic_load(&g_writer_state) == WRITER_IDLE) {
+        if (pthread_create(&g_writer, NULL, writer_main, NULL) == 0) {
+            atomic_store(&g_writer_state, WRITER_RUNNING);
+        } else {
+            // Nobody will drain the ring: never make request threads wait for it
+            perror("logger: pthread_create");
+            g_overflow_policy = LOG_OVERFLOW_DROP;
+            atomic_store(&g_writer_state, WRITER_FAILED);
+        }
+    }
+    pthread_mutex_unlock(&g_wake_mutex);
+}
+
+// Forget state copied from the parent by fork() (the writer thread does not exist in the child)
+static void discard_inherited_state(void) {
+    if (g_log_fd >= 0) {
+        close(g_log_fd);
+        g_log_fd = -1;
+    }
+    free(g_ring);
+    g_ring = NULL;
+
+    pthread_mutex_init(&g_wake_mutex, NULL);
+    pthread_cond_init(&g_wake_cond, NULL);
+    atomic_store(&g_writer_state, WRITER_IDLE);
+
+    // Staged files queued in the parent belong to the parent's rotator
+    pthread_mutex_init(&g_rot_mutex, NULL);
+    pthread_cond_init(&g_rot_cond, NULL);
+    g_rot_started = 0;
+    g_rot_stop = 0;
+    g_rot_first = 0;
+    g_rot_count = 0;
+}
+
+
+// #########################################################################################################
+// Logger initialization
+// #########################################################################################################
+void logger_init(const server_config_t* cfg, semaphores_t* sems) {
+    if (g_owner_pid != 0 && g_owner_pid != getpid()) {
+        discard_inherited_state();
+    } else if (g_ring) {
+        logger_close();
+    }
+    g_owner_pid = getpid();
+
+    strncpy(g_log_path, cfg->log_file, sizeof(g_log_path) - 1);
+    g_log_path[sizeof(g_log_path) - 1] = '\0';
+
+    // Locks shared by every process mapping the segment (process-local without one)
+    g_file_lock = sems ? &sems->log_mutex : &g_local_file_lock;
+    g_rot_lock = sems ? &sems->logrot_mutex : &g_local_rot_lock;
 
     // Check if log file was opened successfully
-    if (g_log_fd < 0) {
+    if (open_log_file() != 0) {
         perror("logger: open logfile");
         exit(1);
     }
-    
-    g_buf_pos = 0; // Initialize buffer position
-    g_last_flush = time(NULL); // Initialize last flush time
+
+    // Allocate the record ring; slot i starts with sequence i (free for position i)
+    size_t cap = ring_capacity(cfg->log_ring_size);
+    g_ring = calloc(cap, sizeof(log_slot_t));
+    if (!g_ring) {
+        perror("logger: ring allocation");
+        exit(1);
+    }
+    for (size_t i = 0; i < cap; i++) {
+        atomic_init(&g_ring[i].seq, i);
+    }
+    g_ring_mask = cap - 1;
+    atomic_init(&g_ring_head, 0);
+    atomic_init(&g_ring_done, 0);
+    atomic_init(&g_dropped, 0);
+    g_ring_tail = 0;
+    g_overflow_policy = cfg->log_overflow_policy;
+    g_log_format = cfg->log_format;
+    g_log_level = cfg->log_level;
+    g_sample_rate = (cfg->access_log_sample > 1) ? cfg->access_log_sample : 1;
+    g_slow_ms = (cfg->access_log_slow_ms > 0) ? cfg->access_log_slow_ms : 0;
+    g_max_size = (cfg->log_max_size_mb > 0) ? (off_t)cfg->log_max_size_mb * 1024 * 1024 : 0;
+    g_rotate_interval = (cfg->log_rotate_interval_sec > 0) ? cfg->log_rotate_interval_sec : 0;
+    g_max_files = (cfg->log_max_files > 0) ? cfg->log_max_files : 0;
+    g_compress = cfg->log_compress;
+    g_date_cache.ts = (time_t)-1;
 }
 
 
 // #########################################################################################################
-// Flush buffer to disk (Internal implementation, called with lock held)
+// Flush queued entries to disk
 // #########################################################################################################
-static void flush_buffer_locked() {
-    // Check if there is anything to flush and if the log file is open
-    if (g_buf_pos > 0 && g_log_fd >= 0) {
-        // Write buffer to log file
-        
-        if (write(g_log_fd, g_log_buffer, g_buf_pos) < 0) {
-            perror("logger: write failed");
-        }
+void logger_flush() {
+    if (!g_ring || atomic_load(&g_writer_state) != WRITER_RUNNING) {
+        return;
+    }
+
+    size_t target = atomic_load(&g_ring_head);
+    wake_writer();
 
-        g_buf_pos = 0; // Reset buffer position
-        g_last_flush = time(NULL); // Update last flush time
+    // Wait until the writer has written everything claimed before this call
+    while (atomic_load_explicit(&g_ring_done, memory_order_acquire) < target) {
+        struct timespec ts = {0, 1000000L}; // 1 ms
+        nanosleep(&ts, NULL);
     }
 }
 
-// Public flush function (Thread-safe)
-void logger_flush() {
-    // Check if logger is initialized
-    if (!g_sem || g_log_fd < 0){
+// Number of records discarded because the ring was full
+size_t logger_dropped(void) {
+    return atomic_load(&g_dropped);
+}
+
+// Minimum level configured with LOG_LEVEL
+int logger_level(void) {
+    return g_log_level;
+}
+
+// #########################################################################################################
+// Rate-limited diagnostics
+// #########################################################################################################
+static const char* level_name(int level) {
+    switch (level) {
+    case LOG_LEVEL_DEBUG: return "DEBUG";
+    case LOG_LEVEL_INFO: return "INFO";
+    case LOG_LEVEL_WARN: return "WARN";
+    default: return "ERROR";
+    }
+}
+
+void logger_diag(log_ratelimit_t* rl, int level, const char* fmt, ...) {
+    if (level < g_log_level) {
         return;
     }
-    
-    // Acquire semaphore
-    sem_wait(g_sem);
 
-    // Flush buffer to disk
-    flush_buffer_locked();
+    int saved_errno = errno; // Keep %m meaningful after the atomics below
+    long now = (long)time(NULL);
+    long window = atomic_load_explicit(&rl->window, memory_order_relaxed);
+    int suppressed = 0;
 
-    // Release semaphore
-    sem_post(g_sem);
+    // First message of a new second: reset the burst and collect the suppressed count
+    if (window != now && atomic_compare_exchange_strong(&rl->window, &window, now)) {
+        atomic_store_explicit(&rl->count, 0, memory_order_relaxed);
+        suppressed = atomic_exchange(&rl->suppressed, 0);
+    }
+
+    if (atomic_fetch_add_explicit(&rl->count, 1, memory_order_relaxed) >= LOG_DIAG_BURST) {
+        atomic_fetch_add_explicit(&rl->suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    char msg[512];
+    int len = snprintf(msg, sizeof(msg), "[%s] ", level_name(level));
+
+    va_list ap;
+    va_start(ap, fmt);
+    errno = saved_errno;
+    len += vsnprintf(msg + len, sizeof(msg) - (size_t)len, fmt, ap);
+    va_end(ap);
+
+    if (len < (int)sizeof(msg) && suppressed > 0) {
+        len += snprintf(msg + len, sizeof(msg) - (size_t)len, " (%d similar messages suppressed)", suppressed);
+    }
+    if (len >= (int)sizeof(msg) - 1) {
+        len = (int)sizeof(msg) - 2;
+    }
+    msg[len++] = '\n';
+
+    // One write() per message so lines from different threads do not interleave
+    if (write(STDERR_FILENO, msg, (size_t)len) < 0) { /* ignore */ }
+    errno = saved_errno;
 }
 
 // #########################################################################################################
 // Logger shutdown
 // #########################################################################################################
-void logger_close() { 
-    // Check if logger is initialized
-    if (g_sem) {
-        sem_wait(g_sem);
-        flush_buffer_locked(); // Ensure any remaining logs are written
-        sem_post(g_sem);
+void logger_close() {
+    // Stop the writer; it drains the ring before exiting
+    if (atomic_load(&g_writer_state) == WRITER_RUNNING) {
+        pthread_mutex_lock(&g_wake_mutex);
+        atomic_store(&g_writer_state, WRITER_STOPPING);
+        pthread_cond_signal(&g_wake_cond);
+        pthread_mutex_unlock(&g_wake_mutex);
+        pthread_join(g_writer, NULL);
+    }
+    atomic_store(&g_writer_state, WRITER_IDLE);
+
+    // The writer can no longer stage files: let the rotator finish compressing and exit
+    stop_rotator();
+
+    size_t dropped = atomic_load(&g_dropped);
+    if (dropped > 0) {
+        fprintf(stderr, "logger: %zu log records dropped (ring full)\n", dropped);
     }
 
     // Close log file
-    if (g_log_fd >= 0) { 
+    if (g_log_fd >= 0) {
         close(g_log_fd);
         g_log_fd = -1;
     }
 
-    // Close semaphore
-    if (g_sem) {
-        sem_close(g_sem);
-        g_sem = NULL;  // Clear pointer to avoid dangling reference
-    }
+    // Forget the locks (the shared ones belong to the segment)
+    g_file_lock = NULL;
+    g_rot_lock = NULL;
+
+    free(g_ring);
+    g_ring = NULL;
 }
 
 // #########################################################################################################
-// Write a log entry (with semaphore + buffer + automatic rotation)
+// Queue a log entry (lock-free; the writer thread formats and writes it)
 // #########################################################################################################
 void logger_write(
     const char* ip,  // Client IP address
@@ -187,59 +800,81 @@ void logger_write(
     size_t bytes_sent, // Number of bytes sent
     long duration_ms // Request duration in milliseconds
 ) {
-    if (!g_sem || g_log_fd < 0) {
+    logger_write_ext(ip, method, path, status, bytes_sent, duration_ms, NULL);
+}
+
+void logger_write_ext(
+    const char* ip,  // Client IP address
+    const char* method, // HTTP method
+    const char* path, // Request path
+    int status, // HTTP status code
+    size_t bytes_sent, // Number of bytes sent
+    long duration_ms, // Request duration in milliseconds
+    const log_ext_t* ext // Extended details (NULL = none)
+) {
+    if (!g_ring) {
         return;
     }
 
-    // Enter critical section
-    sem_wait(g_sem); 
-
-    // Rotate if needed (check size before writing)
-    off_t size_now = get_file_size(g_log_fd);
+    // Level of this entry: errors and slow requests outrank normal ones
+    int level = LOG_LEVEL_INFO;
+    if (status >= 500) {
+        level = LOG_LEVEL_ERROR;
+    } else if (status >= 400 || (g_slow_ms > 0 && duration_ms >= g_slow_ms)) {
+        level = LOG_LEVEL_WARN;
+    }
+    if (level < g_log_level) {
+        return;
+    }
 
-    if (size_now >= LOG_MAX_SIZE) {
-        flush_buffer_locked(); // Flush before rotating
-        rotate_logs(); // Rotate logs
+    // Sampling only applies to normal requests
+    if (level == LOG_LEVEL_INFO && g_sample_rate > 1 && (++t_sample_counter % (unsigned int)g_sample_rate) != 0) {
+        return;
     }
 
-    // Format log line
-    char datebuf[64];
-    time_t now = time(NULL);
-    struct tm tm_now;
-    localtime_r(&now, &tm_now);
-    strftime(datebuf, sizeof(datebuf), "%d/%b/%Y:%H:%M:%S", &tm_now);
+    ensure_writer_started();
 
-    char line[1024]; // Log line buffer
-    int len = snprintf( 
-        line,
-        sizeof(line),
-        "%s [%s] \"%s %s\" %d %zu %ldms\n",
-        ip,
-        datebuf,
-        method,
-        path,
-        status,
-        bytes_sent,
-        duration_ms
-    );
+    size_t pos;
+    log_slot_t* slot;
 
-    
-    if (len > 0 && (size_t)len < sizeof(line)) {
-        // If line is too big for buffer, flush first   
-        if (g_buf_pos + len >= LOG_BUFFER_SIZE) {
-             flush_buffer_locked();
+    // Claim a slot; on a full ring either drop or wait for the writer
+    while (!(slot = ring_claim(&pos))) {
+        wake_writer();
+        if (g_overflow_policy == LOG_OVERFLOW_DROP) {
+            atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+            return;
         }
+        struct timespec ts = {0, 100000L}; // 100 us
+        nanosleep(&ts, NULL);
+    }
 
-        // Append to buffer (will always fit after flush, since len < 1024 < 4096)
-        memcpy(g_log_buffer + g_buf_pos, line, (size_t)len);
-        g_buf_pos += len;
-        
-        // Time-based flush: Only flush if 5 seconds have passed since last flush
-        if (now - g_last_flush >= 5) {
-             flush_buffer_locked();
-        }
+    // Fill the record
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    log_record_t* r = &slot->rec;
+    r->timestamp = now.tv_sec;
+    r->usec = now.tv_nsec / 1000;
+    r->status = status;
+    r->bytes_sent = bytes_sent;
+    r->duration_ms = duration_ms;
+    copy_field(r->ip, sizeof(r->ip), ip);
+    copy_field(r->method, sizeof(r->method), method);
+    copy_field(r->path, sizeof(r->path), path);
+    if (ext) {
+        r->has_ext = 1;
+        r->ext = *ext;
+    } else {
+        r->has_ext = 0;
+        memset(&r->ext, 0, sizeof(r->ext));
+        r->ext.worker_id = -1;
     }
 
-    // Leave critical section
-    sem_post(g_sem);
-}
\ No newline at end of file
+    // Publish it to the writer
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    // Nudge the writer once when the ring reaches half capacity
+    size_t done = atomic_load_explicit(&g_ring_done, memory_order_relaxed);
+    if (pos - done == (g_ring_mask + 1) / 2) {
+        wake_writer();
+    }
+}
@@ -1,8 +1,11 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
-#include <semaphore.h>
 #include <stddef.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "log_format.h"
+#include "semaphores.h"
 
 // ###############################################################################################################
 // Thread-Safe & Process-Safe Logger (Feature 5)
@@ -10,40 +13,99 @@
 // This implements a logging system that is safe for use by multiple processes (master + workers)
 // and multiple threads (within each worker).
 //
-// Log file writing is protected by:
-//   - A named POSIX semaphore (sem_open) for inter-process synchronization
+// Request threads never touch the log file. logger_write() copies the entry into a fixed-size slot of a
+// per-process lock-free ring (multi-producer, single-consumer) and returns. A background writer thread
+// drains the ring, formats the lines and appends them in batches with writev().
+//
+// Log file writing (done only by the writer thread) is protected by:
+//   - A robust process-shared mutex in the shared memory segment for inter-process synchronization
 //   - File opened with O_APPEND for atomic append operations
 //
-// The logger also supports automatic log rotation when the file exceeds 10 MB.
+// The log is rotated when it exceeds LOG_MAX_SIZE_MB or is older than LOG_ROTATE_INTERVAL_SEC. The size is
+// tracked from the file offset after each batch, so there is no fstat() per line. Rotation only swaps the
+// file under the lock; a background rotator thread shifts the LOG_MAX_FILES generations and gzips them
+// (LOG_COMPRESS), serialized between processes by a second shared mutex.
+//
+// LOG_LEVEL filters both the access log (see LOG_LEVEL_* in config.h) and the diagnostics printed with
+// LOG_DIAG(), which are rate-limited per call site so a flood of failing sends cannot flood stderr.
 // ###############################################################################################################
 
+#define LOG_DIAG_BURST 5 // Diagnostics per call site per second before the rest are suppressed
+
+// Rate limiter state of one diagnostic call site (static, zero-initialized)
+typedef struct {
+    atomic_long window; // Second the current burst started in
+    atomic_int count; // Messages seen in the current second
+    atomic_int suppressed; // Messages dropped since the last one printed
+} log_ratelimit_t;
+
+// Print a diagnostic to stderr when level >= LOG_LEVEL, at most LOG_DIAG_BURST times per second
+// from this call site. "%m" expands to strerror(errno).
+#define LOG_DIAG(level, ...) do { \
+        static log_ratelimit_t log_diag_rl_; \
+        logger_diag(&log_diag_rl_, (level), __VA_ARGS__); \
+    } while (0)
+
 /**
  * Initializes the logger.
- * Opens the log file and the named semaphore for synchronization.
+ * Opens the log file, uses the log mutexes of sems (shared memory) for synchronization and allocates the
+ * record ring (LOG_RING_SIZE / LOG_OVERFLOW from the configuration). With sems == NULL the locks are
+ * process-local. The writer thread is started on first use.
+ * Calling it again in a forked child discards the state inherited from the parent.
  */
-void logger_init(const char* logfile_path);
+void logger_init(const server_config_t* cfg, semaphores_t* sems);
 
 /**
  * Closes the logger.
- * Releases all resources (closes file and semaphore).
+ * Drains the ring, stops the writer thread, waits for pending rotations to be compressed and
+ * releases all resources.
  */
 void logger_close();
 
 /**
- * Writes a log entry in a thread-safe and process-safe manner.
- * Automatically rotates the log file if it exceeds 10 MB.
+ * Queues a log entry. Lock-free; safe to call from any thread.
+ * Entries below LOG_LEVEL are skipped, and only 1 in ACCESS_LOG_SAMPLE normal (INFO) requests is kept;
+ * 4xx/5xx responses and requests slower than ACCESS_LOG_SLOW_MS are never sampled out.
+ * When the ring is full the entry is dropped or the caller waits, depending on LOG_OVERFLOW.
  */
 void logger_write(const char* ip, // Client IP address
                   const char* method, // HTTP method
                   const char* path, // Request path
                   int status, // HTTP status code
                   size_t bytes_sent, // Number of bytes sent
-                  long duration_ms); // Request duration in milliseconds  
+                  long duration_ms); // Request duration in milliseconds
 
 /**
- * Flushes any buffered log entries to disk.
+ * Same as logger_write() with the extended details of the request (peer timings, cache outcome, ...),
+ * written with LOG_FORMAT=extended and kept in binary logs. ext may be NULL.
+ */
+void logger_write_ext(const char* ip, // Client IP address
+                      const char* method, // HTTP method
+                      const char* path, // Request path
+                      int status, // HTTP status code
+                      size_t bytes_sent, // Number of bytes sent
+                      long duration_ms, // Request duration in milliseconds
+                      const log_ext_t* ext); // Extended details (NULL = none)
+
+/**
+ * Blocks until every entry queued so far has been written to disk.
  */
 void logger_flush(void);
-                  
+
+/**
+ * Returns the number of entries discarded because the ring was full (LOG_OVERFLOW=drop).
+ */
+size_t logger_dropped(void);
+
+/**
+ * Returns the configured minimum log level (LOG_LEVEL_*).
+ */
+int logger_level(void);
+
+/**
+ * Rate-limited diagnostic output; use through LOG_DIAG().
+ */
+void logger_diag(log_ratelimit_t* rl, int level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
 
 #endif // LOGGER_H
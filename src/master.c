@@ -3,15 +3,17 @@
 //
 // Responsibilities:
 //  - Read configuration (server.conf)
-//  - Create TCP listening socket (bind/listen)
+//  - Create the listening sockets (bind/listen): TCP over IPv4/IPv6 and Unix-domain (LISTEN=)
 //  - Create shared memory and semaphores (connection queue)
 //  - Create N worker processes and a UNIX channel (socketpair) per worker
-//  - Accept connections and distribute them (round-robin) by sending the real FD via SCM_RIGHTS
+//  - Accept connections (poll() across listeners) and distribute them (round-robin) by sending the real FD via SCM_RIGHTS
+//  - CPU_AFFINITY: pin the workers and hand each one its own SO_REUSEPORT member of every TCP listener instead
 //  - Graceful shutdown on SIGINT/SIGTERM
 // ###################################################################################################################
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <signal.h>
 #include <errno.h>
@@ -20,12 +22,13 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <semaphore.h>
 
 #include "config.h"       // server_config_t, load_config()
 #include "shared_mem.h"   // create_shared_memory(), destroy_shared_memory()
@@ -33,6 +36,10 @@
 #include "worker.h"       // worker_init_resources(), worker_main(), worker_shutdown_resources()
 #include "logger.h"       // logger_init/logger_close (Feature 5)
 #include "stats.h"        // print_stats() (Feature 1: statistics tracking)
+#include "profiler.h"     // Sampling profiler (make profile)
+#include "docpack.h"      // docpack_open() (DOCPACK docroot bundle)
+#include "shcache.h"      // shcache_create() (SHARED_CACHE_MB)
+#include "steering.h"     // steering_assign_cpus(), steering_attach() (CPU_AFFINITY)
 
 // ###################################################################################################################
 // Global state and signal handlers for the master process
@@ -40,6 +47,7 @@
 
 static volatile int master_running = 1; // Control variable for main loop
 static volatile sig_atomic_t should_print_stats = 0; // Flag for printing stats
+static volatile sig_atomic_t steering_dirty = 0; // CPU_AFFINITY: a worker exited, re-steer before the next accept
 
 static shared_data_t* g_shm = NULL; // Global shared memory pointer
 static semaphores_t* g_sems = NULL; // Global semaphores pointer
@@ -63,60 +71,160 @@ static void master_signal_handler(int signum) {
 static void sigchld_handler(int signum) {
     (void)signum;
     int saved_errno = errno;
-    // Reap all terminated child processes without blocking
-    while (waitpid(-1, NULL, WNOHANG) > 0);
+    // Reap all terminated child processes without blocking; a worker that died without clearing its
+    // health slot (crash, SIGKILL) is marked down so its queued connections can be reclaimed
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        for (unsigned int i = 0; g_shm && i < g_shm->config.num_workers; i++) {
+            int expected = (int)pid;
+            atomic_compare_exchange_strong(&shm_health(g_shm, i)->pid, &expected, 0);
+        }
+        steering_dirty = 1;
+    }
     errno = saved_errno;
 }
 
 // ###################################################################################################################
-// Utilities: TCP socket (listen) and UNIX channel (socketpair)
+// Utilities: listening sockets (LISTEN=) and UNIX channel (socketpair)
 // ###################################################################################################################
 
-// Create a TCP server socket (IPv4), bind and listen
+// Parse a LISTEN= address
 // Arguments:
-//  port -> TCP port
+//  spec -> "host:port" (IPv4, "*" = any), "[ipv6]:port", "port" (0.0.0.0) or "unix:/path"
+//  addr -> receives the socket address
+//  len  -> receives its length
 // Return:
-//  socket descriptor on success; -1 on error
-static int create_listen_socket(int port) {
+//  0 on success; -1 when spec is not a valid address
+static int parse_listen_addr(const char* spec, struct sockaddr_storage* addr, socklen_t* len) {
+    memset(addr, 0, sizeof(*addr));
+
+    // unix:/path -> Unix-domain stream socket
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un* un = (struct sockaddr_un*)addr;
+        const char* path = spec + 5;
+        if (path[0] == '\0' || strlen(path) >= sizeof(un->sun_path)) {
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path);
+        *len = (socklen_t)sizeof(*un);
+        return 0;
+    }
 
-    // socket(AF_INET, SOCK_STREAM, 0) -> TCP IPv4
-    int s = socket(AF_INET, SOCK_STREAM, 0);
+    // Split host and port ("[v6]:port", "v4:port" or just "port")
+    char host[64] = "";
+    const char* port_str = spec;
+    if (spec[0] == '[') {
+        const char* close = strchr(spec, ']');
+        if (!close || close[1] != ':' || (size_t)(close - spec - 1) >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, spec + 1, (size_t)(close - spec - 1));
+        host[close - spec - 1] = '\0';
+        port_str = close + 2;
+    } else if (strchr(spec, ':')) {
+        const char* colon = strrchr(spec, ':');
+        if ((size_t)(colon - spec) >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, spec, (size_t)(colon - spec));
+        host[colon - spec] = '\0';
+        port_str = colon + 1;
+    }
 
-    // Check for errors
-    if (s < 0) {
-        perror("socket");
+    char* end;
+    long port = strtol(port_str, &end, 10);
+    if (end == port_str || *end != '\0' || port <= 0 || port > 65535) {
         return -1;
     }
 
-    // SO_REUSEADDR -> allow quick reuse of the port after restart
-    int yes = 1; // option value
+    if (spec[0] == '[') {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons((uint16_t)port);
+        if (inet_pton(AF_INET6, host, &in6->sin6_addr) != 1) {
+            return -1;
+        }
+        *len = (socklen_t)sizeof(*in6);
+    } else {
+        struct sockaddr_in* in = (struct sockaddr_in*)addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)port);
+        if (host[0] == '\0' || strcmp(host, "*") == 0) {
+            in->sin_addr.s_addr = htonl(INADDR_ANY);
+        } else if (inet_pton(AF_INET, host, &in->sin_addr) != 1) {
+            return -1;
+        }
+        *len = (socklen_t)sizeof(*in);
+    }
+    return 0;
+}
 
-    // setsockopt -> Set socket options
-    // SOL_SOCKET: socket level 
-    //SO_REUSEADDR: option name
-    if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0) { 
+// Create a server socket for one LISTEN= address, bind and listen
+// Arguments:
+//  spec      -> address (see parse_listen_addr())
+//  reuseport -> join the SO_REUSEPORT group of the address (TCP only; one member per worker with CPU_AFFINITY)
+// Return:
+//  socket descriptor on success; -1 on error (reason on stderr)
+static int create_listen_socket(const char* spec, int reuseport) {
 
-        // Error setting option
-        perror("setsockopt(SO_REUSEADDR)");
-        close(s);
+    struct sockaddr_storage addr; // IPv4, IPv6 or Unix-domain address
+    socklen_t addr_len;
+    if (parse_listen_addr(spec, &addr, &addr_len) != 0) {
+        fprintf(stderr, "MASTER: Invalid listen address '%s'\n", spec);
         return -1;
+    }
 
+    // socket(family, SOCK_STREAM, 0) -> TCP over IPv4/IPv6, or a Unix-domain stream socket
+    int s = socket(addr.ss_family, SOCK_STREAM, 0);
+
+    // Check for errors
+    if (s < 0) {
+        perror("socket");
+        return -1;
     }
 
-    // bind to 0.0.0.0:port
-    struct sockaddr_in addr; // IPv4 address structure
+    int yes = 1; // option value
 
-    memset(&addr, 0, sizeof(addr)); // Zero out structure
+    if (addr.ss_family == AF_UNIX) {
+        // A socket file left by a previous run would make bind() fail: remove it (never anything else)
+        struct stat st;
+        const char* path = ((struct sockaddr_un*)&addr)->sun_path;
+        if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path);
+        }
+    } else {
+        // SO_REUSEADDR -> allow quick reuse of the port after restart
+        // setsockopt -> Set socket options
+        // SOL_SOCKET: socket level 
+        //SO_REUSEADDR: option name
+        if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0) { 
 
-    addr.sin_family      = AF_INET; // IPv4
-    addr.sin_addr.s_addr = htonl(INADDR_ANY); // htonl -> network byte order
-    addr.sin_port        = htons((uint16_t)port); // htons -> network byte order
+            // Error setting option
+            perror("setsockopt(SO_REUSEADDR)");
+            close(s);
+            return -1;
 
+        }
+
+        if (reuseport && setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+            perror("setsockopt(SO_REUSEPORT)");
+            close(s);
+            return -1;
+        }
+
+        // IPv6 sockets take IPv6 only, so [::]:port and 0.0.0.0:port can both be listed
+        if (addr.ss_family == AF_INET6 && setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &yes, sizeof(yes)) < 0) {
+            perror("setsockopt(IPV6_V6ONLY)");
+            close(s);
+            return -1;
+        }
+    }
 
     // bind -> Bind socket to address/port
     // socket descriptor, address, address length
-    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) < 0) { // Check for errors
-        perror("bind");
+    if (bind(s, (struct sockaddr*)&addr, addr_len) < 0) { // Check for errors
+        fprintf(stderr, "MASTER: bind %s: %s\n", spec, strerror(errno));
         close(s);
         return -1;
     }
@@ -133,6 +241,193 @@ static int create_listen_socket(int port) {
     return s;
 }
 
+// Busy-poll mode: try accept() on every (non-blocking) listener for up to spin_us before the caller sleeps
+// in poll(). Returns the client descriptor; -1 with errno EAGAIN when the budget ran out, EINTR when a signal
+// needs the main loop, or the accept() error.
+static int accept_spin(struct pollfd* lfds, int count, int* cursor, long spin_us, conn_info_t* info) {
+    spin_stats_t* spin = &g_shm->master_spin;
+    long long start = get_time_us(), now;
+    do {
+        for (int i = 0; i < count; i++) {
+            int l = (*cursor + i) % count;
+            info->peer_len = sizeof(info->peer);
+            int fd = accept(lfds[l].fd, (struct sockaddr*)&info->peer, &info->peer_len);
+            if (fd >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                *cursor = (l + 1) % count;
+                atomic_fetch_add_explicit(&spin->spin_us, get_time_us() - start, memory_order_relaxed);
+                atomic_fetch_add_explicit(&spin->spin_hits, fd >= 0, memory_order_relaxed);
+                return fd;
+            }
+        }
+        now = get_time_us();
+    } while (master_running && !should_print_stats && now - start < spin_us);
+
+    atomic_fetch_add_explicit(&spin->spin_us, now - start, memory_order_relaxed);
+    atomic_fetch_add_explicit(&spin->spin_misses, 1, memory_order_relaxed);
+    errno = (master_running && !should_print_stats) ? EAGAIN : EINTR;
+    return -1;
+}
+
+// Accept the next connection from any listener. One listener: a blocking accept(). Several (non-blocking):
+// poll() until one is readable, then take one connection from each readable listener in turn until all of them
+// are drained, so a busy listener neither costs a poll() per connection nor starves the others. With
+// BUSY_POLL_US (listeners non-blocking as well), accept_spin() runs before every poll().
+// Arguments:
+//  lfds       -> listening sockets (revents carries the last poll() result)
+//  count      -> number of listening sockets
+//  cursor     -> listener to try first, advanced past the one that produced the connection
+//  spin_us    -> busy-poll budget (0 = sleep at once)
+//  timeout_ms -> longest poll() (-1 = until a connection or a signal; listeners must be non-blocking otherwise)
+//  info       -> receives the peer address
+// Return:
+//  client descriptor; -1 with errno set (EINTR: interrupted by a signal, EAGAIN: timed out)
+static int accept_any(struct pollfd* lfds, int count, int* cursor, long spin_us, int timeout_ms,
+                      conn_info_t* info) {
+    if (count == 1 && spin_us == 0 && timeout_ms < 0) {
+        info->peer_len = sizeof(info->peer);
+        return accept(lfds[0].fd, (struct sockaddr*)&info->peer, &info->peer_len);
+    }
+    for (;;) {
+        for (int i = 0; i < count; i++) {
+            int l = (*cursor + i) % count;
+            if (!(lfds[l].revents & POLLIN)) {
+                continue;
+            }
+            info->peer_len = sizeof(info->peer);
+            int fd = accept(lfds[l].fd, (struct sockaddr*)&info->peer, &info->peer_len);
+            if (fd >= 0) {
+                *cursor = (l + 1) % count;
+                return fd;
+            }
+            lfds[l].revents = 0; // Drained, or failed: wait for poll() again
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                *cursor = (l + 1) % count;
+                return -1;
+            }
+        }
+        if (spin_us > 0 && count > 0) {
+            int fd = accept_spin(lfds, count, cursor, spin_us, info);
+            if (fd >= 0 || errno != EAGAIN) {
+                return fd;
+            }
+        }
+        // count == 0 (all steered to the workers): sleep until a signal or the timeout
+        int ready = poll(lfds, (nfds_t)count, timeout_ms);
+        if (ready <= 0) {
+            if (ready == 0) {
+                errno = EAGAIN;
+            }
+            return -1;
+        }
+    }
+}
+
+// Close the listening sockets and remove the Unix-domain socket files
+static void close_listen_sockets(struct pollfd* lfds, int count) {
+    for (int i = 0; i < count; i++) {
+        struct sockaddr_un addr;
+        socklen_t len = sizeof(addr);
+        if (getsockname(lfds[i].fd, (struct sockaddr*)&addr, &len) == 0 && addr.sun_family == AF_UNIX &&
+            len > offsetof(struct sockaddr_un, sun_path) && addr.sun_path[0] != '\0') {
+            unlink(addr.sun_path);
+        }
+        close(lfds[i].fd);
+    }
+}
+
+// Close the per-worker listening sockets (count of them) and free the CPU_AFFINITY arrays
+static void release_steering(int* worker_cpu, int* steered, int count) {
+    for (int k = 0; k < count; k++) {
+        close(steered[k]);
+    }
+    free(worker_cpu);
+    free(steered);
+}
+
+// CPU_AFFINITY: one listening socket per worker for a TCP address, in worker order, all in one SO_REUSEPORT
+// group with the steering program attached (without it the kernel spreads connections by flow hash)
+// Arguments:
+//  spec        -> TCP address (see parse_listen_addr())
+//  num_workers -> members to create
+//  worker_cpu  -> CPU of each worker (steering_assign_cpus())
+//  fds         -> receives the num_workers descriptors (non-blocking: workers accept until EAGAIN)
+// Return:
+//  0 on success; -1 on error (reason on stderr, nothing left open)
+static int create_steered_sockets(const char* spec, int num_workers, const int* worker_cpu, int* fds) {
+    for (int w = 0; w < num_workers; w++) {
+        fds[w] = create_listen_socket(spec, 1);
+        if (fds[w] < 0) {
+            while (w > 0) {
+                close(fds[--w]);
+            }
+            return -1;
+        }
+        fcntl(fds[w], F_SETFL, fcntl(fds[w], F_GETFL) | O_NONBLOCK);
+    }
+    if (steering_attach(fds[0], worker_cpu, NULL, num_workers) != 0) {
+        fprintf(stderr, "MASTER: SO_ATTACH_REUSEPORT_CBPF on %s: %s (connections spread by flow hash instead)\n",
+                spec, strerror(errno));
+    }
+    return 0;
+}
+
+// CPU_AFFINITY: whether worker w should get steered connections: the workers pick_worker() dispatches to
+// (WORKER_OK), and one still starting (no heartbeat yet, stale until its first one)
+static int steering_target(shared_data_t* shm, int w, long long now_us) {
+    worker_health_t* h = shm_health(shm, (unsigned int)w);
+    int state = worker_health_state(h, now_us);
+    return state == WORKER_OK ||
+           (state == WORKER_STALE && atomic_load_explicit(&h->heartbeat_us, memory_order_relaxed) == 0);
+}
+
+// CPU_AFFINITY: steer connections to the workers steering_target() accepts (to all of them when none is, as
+// pick_worker() falls back to plain round-robin), replacing the program of every group when that set changed.
+// The master holds every member, so the reuseport indices stay in worker order; the members of workers that
+// exited are added to its listeners and what was left in their backlogs is dispatched like any connection.
+// Arguments:
+//  shm         -> health slots
+//  num_workers -> number of workers
+//  worker_cpu  -> CPU of each worker
+//  steered     -> per-worker listening sockets (steered[l * num_workers + w])
+//  nsteered    -> number of steered groups
+//  targets     -> workers currently steered to (num_workers entries), followed by num_workers of scratch
+//  adopted     -> workers whose members are among the listeners already
+//  lfds        -> master's listeners (room for every member)
+//  nlisten     -> number of listeners, advanced past the members adopted
+static void refresh_steering(shared_data_t* shm, int num_workers, const int* worker_cpu, const int* steered,
+                             int nsteered, int* targets, int* adopted, struct pollfd* lfds, int* nlisten) {
+    long long now = get_time_us();
+    int* next = targets + num_workers;
+    int count = 0;
+    for (int w = 0; w < num_workers; w++) {
+        next[w] = steering_target(shm, w, now);
+        count += next[w];
+    }
+
+    int changed = 0;
+    for (int w = 0; w < num_workers; w++) {
+        next[w] |= (count == 0);
+        changed |= next[w] != targets[w];
+        targets[w] = next[w];
+
+        if (!adopted[w] && atomic_load_explicit(&shm_health(shm, (unsigned int)w)->pid, memory_order_relaxed) == 0) {
+            adopted[w] = 1;
+            for (int l = 0; l < nsteered; l++) {
+                lfds[*nlisten].fd = steered[l * num_workers + w];
+                lfds[*nlisten].events = POLLIN;
+                lfds[*nlisten].revents = POLLIN; // Try it at once: the backlog may be full already
+                (*nlisten)++;
+            }
+        }
+    }
+
+    for (int l = 0; changed && l < nsteered; l++) {
+        if (steering_attach(steered[l * num_workers], worker_cpu, targets, num_workers) != 0) {
+            LOG_DIAG(LOG_LEVEL_ERROR, "SO_ATTACH_REUSEPORT_CBPF: %m");
+        }
+    }
+}
+
 // Create a master<->worker channel using socketpair AF_UNIX (DGRAM)
 // Arguments:
 //  sv[2] -> returns the two descriptors (sv[0] stays in master, sv[1] goes to worker)
@@ -153,15 +448,15 @@ static int create_worker_channel(int sv[2]) { // Create socketpair
 // Arguments:
 //  socket -> master's end (sv[0])
 //  fd     -> client descriptor accepted on listen
+//  info   -> peer address and accept time (sent as the message payload)
 // Return:
 //  0 on success; -1 on error
 
 // Sends a file descriptor over a UNIX domain socket using SCM_RIGHTS.
-static int send_fd(int socket, int fd) {
+static int send_fd(int socket, int fd, const conn_info_t* info) {
 
     struct msghdr msg = {0}; // Message header
-    char buf[1] = {'F'}; // mandatory "dummy" payload
-    struct iovec io = { .iov_base = buf, .iov_len = 1 }; // I/O vector
+    struct iovec io = { .iov_base = (void*)info, .iov_len = sizeof(*info) }; // Payload: connection metadata
 
     union { // Control message buffer
         char buf[CMSG_SPACE(sizeof(int))]; // Space for one FD
@@ -186,7 +481,9 @@ static int send_fd(int socket, int fd) {
 
     // sendmsg -> Send message
     if (sendmsg(socket, &msg, 0) < 0) { // Check for errors
-        perror("sendmsg(SCM_RIGHTS)");
+        int err = errno; // Kept for the caller (worker health slot)
+        LOG_DIAG(LOG_LEVEL_ERROR, "sendmsg(SCM_RIGHTS): %m");
+        errno = err;
         return -1;
     }
 
@@ -200,45 +497,38 @@ static int send_fd(int socket, int fd) {
 /**
  * Initializes the shared memory segment for inter-process communication.
  *
- * This function creates and initializes a shared memory segment of the specified
- * queue size by calling create_shared_memory(). It returns a pointer to the
- * allocated shared_data_t structure on success, or NULL on failure.
+ * This function creates and initializes the shared memory segment of this instance
+ * by calling create_shared_memory(). It returns a pointer to the allocated
+ * shared_data_t structure on success, or NULL on failure.
  *
- * Real shared memory: create_shared_memory(queue_size)
+ * Real shared memory: create_shared_memory(name, queue_size, num_workers)
  *
- * queue_size -> The size of the queue to be allocated in shared memory.
+ * config -> Configuration (INSTANCE_NAME / PORT name the segment, MAX_QUEUE_SIZE, NUM_WORKERS size it).
  * return -> Pointer to the initialized shared_data_t structure, or NULL if creation fails.
  *
  * Steps:
- * 1. Calls create_shared_memory() with the given queue_size to allocate shared memory.
- * 2. Checks if the allocation was successful.
- *    - If not, prints an error message to stderr and returns NULL.
- * 3. Returns the pointer to the allocated shared memory structure.
+ * 1. Derives the segment name from INSTANCE_NAME, or from the port when it is not set.
+ * 2. Calls create_shared_memory() with the name, queue size and number of workers.
+ * 3. Checks if the allocation was successful.
+ *    - If not, returns NULL (create_shared_memory() prints the reason).
+ * 4. Returns the pointer to the allocated shared memory structure.
  */
-static shared_data_t* init_shared_memory(int queue_size) {
+static shared_data_t* init_shared_memory(const server_config_t* config) {
 
-    // It is expected that the shared_mem module handles shm_open/ftruncate/mmap/init of the queue (front=0,count=0)
-    shared_data_t* shm = create_shared_memory(queue_size);
-    if (!shm) {
-        return NULL;
-    }
-    return shm;
-}
-
-// Real Semaphores: init_semaphores(), destroy_semaphores()
-static semaphores_t* init_semaphore_system(int queue_size) {
-
-    semaphores_t* sems = (semaphores_t*)malloc(sizeof(semaphores_t));
-    if (!sems) {
+    char name[SHM_NAME_MAX];
+    if (shm_instance_name(name, sizeof(name), config->instance_name, config->port) != 0) {
+        fprintf(stderr, "MASTER: Invalid INSTANCE_NAME '%s' (up to %d characters of A-Z a-z 0-9 _ . -)\n",
+                config->instance_name, SHM_INSTANCE_MAX);
         return NULL;
     }
 
-    if (init_semaphores(sems, queue_size) != 0) {
-        free(sems);
+    // It is expected that the shared_mem module handles shm_open/ftruncate/mmap/init of the queue
+    shared_data_t* shm = create_shared_memory(name, config->max_queue_size, config->num_workers);
+    if (!shm) {
         return NULL;
     }
-
-    return sems;
+    fprintf(stderr, "MASTER: Shared memory %s\n", name);
+    return shm;
 }
 
 // ###################################################################################################################
@@ -246,69 +536,123 @@ static semaphores_t* init_semaphore_system(int queue_size) {
 // The worker ignores the stored value (since it receives the real FD via SCM_RIGHTS).
 // ###################################################################################################################
 
+// Answer a connection the master cannot hand to a worker (queue full, or no worker up) with a 503
+static void reject_connection(int client_fd) {
+    // Send 503 Service Unavailable with nginx-style page
+    const char* response = 
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Content-Type: text/html; charset=utf-8\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 583\r\n\r\n"
+        "<!DOCTYPE html>\n"
+        "<html>\n"
+        "<head>\n"
+        "<title>503 Service Unavailable</title>\n"
+        "<style>\n"
+        "    body { font-family: Tahoma, Verdana, Arial, sans-serif; background-color: #fff; color: #000; margin: 0; padding: 0; }\n"
+        "    .container { width: 100%; margin: 0 auto; text-align: center; padding-top: 10%; }\n"
+        "    h1 { font-size: 36px; font-weight: normal; margin-bottom: 10px; }\n"
+        "    hr { border: none; border-top: 1px solid #ccc; width: 50%; margin: 20px auto; }\n"
+        "    .footer { font-size: 12px; color: #333; }\n"
+        "</style>\n"
+        "</head>\n"
+        "<body>\n"
+        "<div class=\"container\">\n"
+        "    <h1>503 Service Unavailable</h1>\n"
+        "    <hr>\n"
+        "    <p class=\"footer\">ConcurrentHTTP/1.0</p>\n"
+        "</div>\n"
+        "</body>\n"
+        "</html>\n";
+    // Best effort write (ignore result)
+    if (write(client_fd, response, strlen(response)) < 0) { /* ignore */ }
+}
+
+// Next worker to dispatch to, starting at rr: the first one whose health slot reports WORKER_OK. When none
+// does, the first one that is not down (stuck or overloaded, it may still catch up); -1 when all are down.
+static int pick_worker(shared_data_t* shm, int rr, int num_workers, long long now_us) {
+    int fallback = -1;
+    for (int k = 0; k < num_workers; k++) {
+        int w = (rr + k) % num_workers;
+        int state = worker_health_state(shm_health(shm, (unsigned int)w), now_us);
+        if (state == WORKER_OK) {
+            return w;
+        }
+        if (state != WORKER_DOWN && fallback < 0) {
+            fallback = w;
+        }
+    }
+    return fallback;
+}
+
 // Returns 0 on success; -1 on error; -2 on queue full (rejection)
 static int enqueue_connection(shared_data_t* shm, semaphores_t* sems, int worker_id, int client_fd) {
 
-    // Non-blocking wait for a free slot to implement "Reject with 503" requirement
-    if (sem_trywait(sems->empty_slots) != 0) {
-        if (errno == EAGAIN) {
-             // Queue is full - Send 503 Service Unavailable with nginx-style page
-             const char* response = 
-                 "HTTP/1.1 503 Service Unavailable\r\n"
-                 "Content-Type: text/html; charset=utf-8\r\n"
-                 "Connection: close\r\n"
-                 "Content-Length: 583\r\n\r\n"
-                 "<!DOCTYPE html>\n"
-                 "<html>\n"
-                 "<head>\n"
-                 "<title>503 Service Unavailable</title>\n"
-                 "<style>\n"
-                 "    body { font-family: Tahoma, Verdana, Arial, sans-serif; background-color: #fff; color: #000; margin: 0; padding: 0; }\n"
-                 "    .container { width: 100%; margin: 0 auto; text-align: center; padding-top: 10%; }\n"
-                 "    h1 { font-size: 36px; font-weight: normal; margin-bottom: 10px; }\n"
-                 "    hr { border: none; border-top: 1px solid #ccc; width: 50%; margin: 20px auto; }\n"
-                 "    .footer { font-size: 12px; color: #333; }\n"
-                 "</style>\n"
-                 "</head>\n"
-                 "<body>\n"
-                 "<div class=\"container\">\n"
-                 "    <h1>503 Service Unavailable</h1>\n"
-                 "    <hr>\n"
-                 "    <p class=\"footer\">ConcurrentHTTP/1.0</p>\n"
-                 "</div>\n"
-                 "</body>\n"
-                 "</html>\n";
-             // Best effort write (ignore result)
-             if (write(client_fd, response, strlen(response)) < 0) { /* ignore */ }
-             return -2; // Indication of rejection
-        }
-        perror("sem_trywait(empty_slots)");
+    // Critical section for queue access (never contended for long: workers only copy one item)
+    int rc = sync_lock(&sems->queue_mutex);
+    if (rc < 0) {
+        perror("sync_lock(queue_mutex)");
         return -1;
     }
+    if (rc == 1) {
+        queue_repair(shm); // A worker died mid-dequeue
+    }
 
-    // Critical section for queue access
-    if (sem_wait(sems->queue_mutex) != 0) {
-        perror("sem_wait(queue_mutex)");
-        // Restore the free slot in case of failure
-        sem_post(sems->empty_slots);
-        return -1;
+    // Take back the slots of connections queued for workers that exited without taking them. Checked on every
+    // enqueue rather than once per SIGCHLD, so nothing left on a dead worker's ring is ever kept
+    for (unsigned int i = 0; i < shm->config.num_workers; i++) {
+        if (atomic_load_explicit(&shm_health(shm, i)->pid, memory_order_relaxed) == 0) {
+            queue_drop(shm, i);
+        }
     }
 
-    // Insert at position rear (front + count) % MAX_QUEUE_SIZE
-    int pos = (shm->queue.front + shm->queue.count) % MAX_QUEUE_SIZE;
-    shm->queue.items[pos].worker_id = worker_id;
-    shm->queue.items[pos].placeholder_fd = client_fd; // Storing it mostly for debug
-    shm->queue.count++;
+    // Never wait for a free slot: implements the "Reject with 503" requirement
+    // (nor queue for a worker that is down: nobody would take the connection)
+    int down = atomic_load_explicit(&shm_health(shm, (unsigned int)worker_id)->pid, memory_order_relaxed) == 0;
+    if (down || shm->queue_pending >= shm->queue_limit) {
+        sync_unlock(&sems->queue_mutex);
 
-    // Release critical section
-    sem_post(sems->queue_mutex);
+        reject_connection(client_fd);
+        return -2; // Indication of rejection
+    }
 
-    // Signal available item
-    sem_post(sems->filled_slots);
+    // Insert at the tail of the worker's ring
+    connection_queue_t* q = shm_queue(shm, (unsigned int)worker_id);
+    connection_item_t* item = &q->items[q->tail & q->mask];
+    item->worker_id = worker_id;
+    item->placeholder_fd = client_fd; // Storing it mostly for debug
+    q->tail++;
+    shm->queue_pending++;
+
+    // Wake the addressed worker only
+    sync_event_broadcast(&shm_health(shm, (unsigned int)worker_id)->queue_event);
+
+    // Release critical section
+    sync_unlock(&sems->queue_mutex);
 
     return 0;
 }
 
+// Take back the connection just queued for worker_id when its descriptor could not be sent. The master is the
+// only producer, so while the ring is not empty its tail is that connection; when it is empty the worker has
+// taken the item already (and gave its slot back).
+static void unqueue_connection(shared_data_t* shm, semaphores_t* sems, int worker_id) {
+    int rc = sync_lock(&sems->queue_mutex);
+    if (rc < 0) {
+        perror("sync_lock(queue_mutex)");
+        return;
+    }
+    if (rc == 1) {
+        queue_repair(shm); // A worker died mid-dequeue
+    }
+    connection_queue_t* q = shm_queue(shm, (unsigned int)worker_id);
+    if (queue_count(q) > 0) {
+        q->tail--;
+        shm->queue_pending--;
+    }
+    sync_unlock(&sems->queue_mutex);
+}
+
 // ###################################################################################################################
 // Main function of the master process
 // ###################################################################################################################
@@ -326,13 +670,33 @@ int main(int argc, char* argv[]) {
 
     // Set reasonable defaults in case config file loading fails
     config.port               = 8080; // Default port
+    config.instance_name[0]   = '\0'; // Default: IPC names derived from the port
     config.document_root[0]   = '\0'; // Will be set below
+    config.docpack[0]         = '\0'; // Default: serve files from the document root
     config.num_workers        = 2; // Default number of workers
     config.threads_per_worker = 10; // Default threads per worker
     config.max_queue_size     = MAX_QUEUE_SIZE; // Default max queue size
     config.log_file[0]        = '\0'; // Will be set below
     config.cache_size_mb      = 64; // Default cache size in MB
+    config.shared_cache_mb    = 0; // Default: a cache per worker
+    config.disk_io_threads    = 2; // Default: 2 disk I/O threads per worker
+    config.disk_io_queue      = 64; // Default: 64 cache misses waiting for the disk per worker
+    config.zerocopy_min_kb    = 0; // Default: bodies are copied into the socket
+    config.notsent_lowat_kb   = 0; // Default: the kernel's TCP_NOTSENT_LOWAT (net.ipv4.tcp_notsent_lowat)
+    config.sndbuf_max_kb      = 0; // Default: send buffers autotuned by the kernel
+    config.busy_poll_us       = 0; // Default: block in accept() / on the queue without spinning
+    config.cpu_affinity[0]    = '\0'; // Default: workers unpinned, every connection accepted by the master
     config.timeout_seconds    = 30; // Default timeout in seconds
+    config.log_ring_size      = 1024; // Default log ring size (records per process)
+    config.log_overflow_policy = LOG_OVERFLOW_BLOCK; // Default: never lose log records
+    config.log_format         = LOG_FORMAT_TEXT; // Default: text access log
+    config.log_level          = LOG_LEVEL_INFO; // Default: log every request
+    config.access_log_sample  = 1; // Default: no sampling
+    config.access_log_slow_ms = 1000; // Default: requests over 1 s count as slow
+    config.log_max_size_mb    = 10; // Default: rotate at 10 MB
+    config.log_rotate_interval_sec = 0; // Default: no time-based rotation
+    config.log_max_files      = 5; // Default: keep 5 rotated generations
+    config.log_compress       = 1; // Default: gzip rotated generations
 
 
     signal(SIGALRM, stats_timer_handler); // Set up alarm signal handler
@@ -351,9 +715,27 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "MASTER: Config loaded from %s\n", conf_path);
     }
 
-    // ADDED: initialize the global logger (Feature 5)
-    sem_unlink("/ws_log_sem"); // Ensure fresh semaphore
-    logger_init(config.log_file); // Initialize logger
+    // Docroot bundle: mapped once, here, so every worker inherits the same read-only mapping
+    docpack_t* pack = NULL;
+    if (config.docpack[0] != '\0') {
+        pack = docpack_open(config.docpack);
+        if (!pack) {
+            fprintf(stderr, "MASTER: Cannot serve DOCPACK=%s\n", config.docpack);
+            return 1;
+        }
+        fprintf(stderr, "MASTER: Serving %zu files from %s\n", docpack_count(pack), config.docpack);
+    }
+
+    // Shared cache: created here so every worker inherits the same memfd and mapping
+    shcache_t* shared = NULL;
+    if (!pack && config.shared_cache_mb > 0) {
+        shared = shcache_create((size_t)config.shared_cache_mb * 1024ULL * 1024ULL);
+        if (!shared) {
+            fprintf(stderr, "MASTER: Cannot create SHARED_CACHE_MB=%d\n", config.shared_cache_mb);
+            return 1;
+        }
+        fprintf(stderr, "MASTER: Shared cache of %d MB for all workers\n", config.shared_cache_mb);
+    }
 
     // ---------------------------------------------------------------------------------------------------------------
     // 2) Signal handlers (CTRL+C, kill, SIGCHLD for zombies, SIGPIPE for broken pipes)
@@ -383,51 +765,115 @@ int main(int argc, char* argv[]) {
     sa_pipe.sa_flags = 0;
     sigaction(SIGPIPE, &sa_pipe, NULL);
 
+    profiler_start("master", -1); // make profile builds only; workers start their own after fork
+
     // ---------------------------------------------------------------------------------------------------------------
-    // 3) Shared memory and semaphores
+    // 3) Shared memory and synchronization (the mutexes and the per-worker queue events live inside the segment)
     // ---------------------------------------------------------------------------------------------------------------
-    shared_data_t* shm = init_shared_memory(config.max_queue_size); // Initialize shared memory
+    shared_data_t* shm = init_shared_memory(&config); // Initialize shared memory
     
     // Check for errors
     if (!shm) {
         return 1;
     }
 
-    semaphores_t* sems = init_semaphore_system(config.max_queue_size); // Initialize semaphores
+    semaphores_t* sems = &shm->sync; // Shared synchronization primitives
 
     // Check for errors
-    if (!sems) {
+    if (init_semaphores(sems) != 0) {
         destroy_shared_memory(shm);
         return 1;
     }
 
     g_shm = shm; // For stats printing
     g_sems = sems; // For stats printing
+
+    // ADDED: initialize the global logger (Feature 5); its inter-process locks are in the segment
+    logger_init(&config, sems); // Initialize logger
     // ---------------------------------------------------------------------------------------------------------------
-    int listen_fd = create_listen_socket(config.port); // Create listen socket
+    // Without LISTEN= entries: 0.0.0.0:PORT
+    if (config.num_listen == 0) {
+        snprintf(config.listen[0], sizeof(config.listen[0]), "0.0.0.0:%d", config.port);
+        config.num_listen = 1;
+    }
 
-    if (listen_fd < 0) { // Check for errors
-        destroy_semaphores(sems); // Cleanup semaphores
-        free(sems);
-        destroy_shared_memory(shm); // Cleanup shared memory
+    int num_workers = (config.num_workers > 0) ? config.num_workers : 1; // Ensure at least 1 worker
+
+    // CPU_AFFINITY: a CPU per worker, and TCP listeners split into per-worker sockets (steered[l * num_workers + w])
+    int steer = config.cpu_affinity[0] != '\0';
+    int* worker_cpu = steer ? (int*)calloc((size_t)num_workers, sizeof(int)) : NULL;
+    int* steered    = steer ? (int*)calloc((size_t)num_workers * MAX_LISTENERS, sizeof(int)) : NULL;
+    int nsteered = 0; // TCP listeners split this way
+    if (steer && (!worker_cpu || !steered ||
+                  steering_assign_cpus(config.cpu_affinity, num_workers, worker_cpu) != 0)) {
+        release_steering(worker_cpu, steered, 0);
+        destroy_semaphores(sems);
+        destroy_shared_memory(shm);
         return 1;
     }
 
+    struct pollfd lfds[MAX_LISTENERS]; // Listening sockets the master accepts on, in LISTEN= order
+    int nlisten = 0;
+    int master_listeners = 0; // How many of them there will be
+    for (int l = 0; l < config.num_listen; l++) {
+        master_listeners += !steer || strncmp(config.listen[l], "unix:", 5) == 0;
+    }
+    for (int l = 0; l < config.num_listen; l++) {
+        if (steer && strncmp(config.listen[l], "unix:", 5) != 0) {
+            if (create_steered_sockets(config.listen[l], num_workers, worker_cpu,
+                                       &steered[nsteered * num_workers]) != 0) {
+                close_listen_sockets(lfds, nlisten);
+                release_steering(worker_cpu, steered, nsteered * num_workers);
+                destroy_semaphores(sems);
+                destroy_shared_memory(shm);
+                return 1;
+            }
+            nsteered++;
+            fprintf(stderr, "MASTER: Listening on %s (accepted by the workers, steered by CPU)\n", config.listen[l]);
+            continue;
+        }
+
+        int fd = create_listen_socket(config.listen[l], 0); // Create listen socket
+
+        if (fd < 0) { // Check for errors
+            close_listen_sockets(lfds, nlisten);
+            release_steering(worker_cpu, steered, nsteered * num_workers);
+            destroy_semaphores(sems); // Cleanup semaphores
+            destroy_shared_memory(shm); // Cleanup shared memory
+            return 1;
+        }
+
+        // With several listeners the accept loop polls them: accept() must not block on one that raced empty
+        // (CPU_AFFINITY: it polls with a timeout, and may add the steered sockets of workers that exit)
+        if (master_listeners > 1 || config.busy_poll_us > 0 || steer) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        socket_set_busy_poll(fd, config.busy_poll_us);
+        lfds[nlisten].fd = fd;
+        lfds[nlisten].events = POLLIN;
+        lfds[nlisten].revents = 0;
+        nlisten++;
+        fprintf(stderr, "MASTER: Listening on %s\n", config.listen[l]);
+    }
+    if (steer) {
+        for (int w = 0; w < num_workers; w++) {
+            fprintf(stderr, "MASTER: Worker %d on CPU %d\n", w, worker_cpu[w]);
+        }
+    }
+
     // ---------------------------------------------------------------------------------------------------------------
     // 5) Create N workers (fork) and a UNIX channel per worker
     // ---------------------------------------------------------------------------------------------------------------
-    int num_workers = (config.num_workers > 0) ? config.num_workers : 1; // Ensure at least 1 worker
-
     pid_t* pids       = (pid_t*)calloc((size_t)num_workers, sizeof(pid_t)); // Array of worker PIDs
     int*   parent_end = (int*)  calloc((size_t)num_workers, sizeof(int)); // Array of master's ends of channels
 
     // Check for allocation errors
     if (!pids || !parent_end) {
 
-        close(listen_fd); // Close listen socket
+        close_listen_sockets(lfds, nlisten); // Close listen sockets
+        release_steering(worker_cpu, steered, nsteered * num_workers);
 
         destroy_semaphores(sems); // Cleanup semaphores
-        free(sems);
 
         destroy_shared_memory(shm); // Cleanup shared memory
 
@@ -447,9 +893,9 @@ int main(int argc, char* argv[]) {
             // partial cleanup
             for (int k = 0; k < i; ++k) close(parent_end[k]); // close already created channels
 
-            close(listen_fd); // close listen socket
+            close_listen_sockets(lfds, nlisten); // close listen sockets
+            release_steering(worker_cpu, steered, nsteered * num_workers); // close per-worker listen sockets
             destroy_semaphores(sems); // destroy semaphores
-            free(sems);
             destroy_shared_memory(shm); // destroy shared memory
             
             // free allocated arrays
@@ -467,9 +913,9 @@ int main(int argc, char* argv[]) {
             close(sv[0]); // close both ends of the channel 
             close(sv[1]);  // close listen socket
             for (int k = 0; k < i; ++k) close(parent_end[k]); // close already created channels
-            close(listen_fd); // close listen socket
+            close_listen_sockets(lfds, nlisten); // close listen sockets
+            release_steering(worker_cpu, steered, nsteered * num_workers); // close per-worker listen sockets
             destroy_semaphores(sems); // destroy semaphores
-            free(sems);
             destroy_shared_memory(shm); // destroy shared memory
             free(pids); free(parent_end); // free allocated arrays
             return 1;
@@ -482,8 +928,10 @@ int main(int argc, char* argv[]) {
             // Close master's end in this process
             close(sv[0]);
 
-            // The worker does not need the listen_fd
-            close(listen_fd);
+            // The worker does not need the listening sockets (closed here; the files stay for the master)
+            for (int k = 0; k < nlisten; ++k) {
+                close(lfds[k].fd);
+            }
 
             // Free inherited allocations from parent (not needed in worker)
             // Close any parent_end channels inherited from earlier loop iterations
@@ -493,13 +941,28 @@ int main(int argc, char* argv[]) {
             free(pids);
             free(parent_end);
 
+            // CPU_AFFINITY: keep this worker's member of each steered group (the others belong to the other
+            // workers) and pin the process before it starts any thread
+            if (steer) {
+                int own[MAX_LISTENERS];
+                for (int l = 0; l < nsteered; ++l) {
+                    for (int w = 0; w < num_workers; ++w) {
+                        if (w != i) close(steered[l * num_workers + w]);
+                    }
+                    own[l] = steered[l * num_workers + i];
+                }
+                worker_set_steering(worker_cpu[i], own, nsteered);
+                release_steering(worker_cpu, steered, 0);
+            }
+
             // Initialize worker resources (e.g., per-worker cache)
-            worker_init_resources(&config);
+            worker_init_resources(&config, sems, pack, shared);
 
             // Enter the main loop of the worker
             worker_main(shm, sems, i, sv[1]);
 
             // Note: worker_main already calls worker_shutdown_resources() at the end
+            profiler_dump_pgo(); // _exit() skips the atexit handler that saves a training build's profile
             _exit(0);
         }
 
@@ -507,21 +970,59 @@ int main(int argc, char* argv[]) {
         // PARENT process (MASTER)
         // -----------------------------------------------------------------------------------------------------------
         pids[i] = pid;
+        // Until the worker announces itself it is stale (no heartbeat) rather than down: the ring
+        // reclaim in enqueue_connection() must not drop connections it has yet to take
+        int none = 0;
+        atomic_compare_exchange_strong(&shm_health(shm, (unsigned int)i)->pid, &none, (int)pid);
         parent_end[i] = sv[0]; // master keeps this end
         close(sv[1]);          // close the worker's end in the master
     }
 
+    // CPU_AFFINITY: a connection arriving on a CPU is accepted by its worker. The master keeps its copies of the
+    // steered sockets (so a worker that exits does not shift the others' reuseport indices) and re-steers around
+    // workers that exit, stall or overload (refresh_steering(), on SIGCHLD and every WORKER_HEARTBEAT_MS)
+    struct pollfd* afds = lfds; // Listeners accept_any() polls: lfds, then the members of workers that exited
+    int nafds = nlisten;
+    int* targets = NULL; // Workers steered to, then scratch (refresh_steering())
+    int* adopted = NULL; // Workers whose steered sockets the master accepts on
+    int resteer = 0;
+    long long next_resteer_us = 0;
+    if (steer) {
+        afds    = (struct pollfd*)calloc((size_t)(nlisten + nsteered * num_workers), sizeof(struct pollfd));
+        targets = (int*)calloc(2 * (size_t)num_workers, sizeof(int));
+        adopted = (int*)calloc((size_t)num_workers, sizeof(int));
+        if (afds && targets && adopted) {
+            memcpy(afds, lfds, (size_t)nlisten * sizeof(struct pollfd));
+            for (int w = 0; w < num_workers; w++) {
+                targets[w] = 1; // As attached by create_steered_sockets()
+            }
+            resteer = 1;
+        } else {
+            fprintf(stderr, "MASTER: Out of memory, connections stay steered to workers that exit\n");
+            free(afds);
+            afds = lfds;
+        }
+    }
+
 
     // ---------------------------------------------------------------------------------------------------------------
     // 6) Main event loop: Accept incoming connections and distribute them to workers in round-robin fashion
     // ---------------------------------------------------------------------------------------------------------------
     int rr = 0; // Round-robin index for worker selection
+    int next_listener = 0; // Listener accept_any() tries first
     while (master_running) {
 
-        // Accept a new client connection (blocking call)
-        struct sockaddr_in cli; // Client address structure
-        socklen_t cli_len = sizeof(cli); // Length of client address
-        int client_fd = accept(listen_fd, (struct sockaddr*)&cli, &cli_len); // Accept connection
+        // CPU_AFFINITY: keep the steering programs in line with the workers' health
+        if (resteer && (steering_dirty || get_time_us() >= next_resteer_us)) {
+            steering_dirty = 0;
+            refresh_steering(shm, num_workers, worker_cpu, steered, nsteered, targets, adopted, afds, &nafds);
+            next_resteer_us = get_time_us() + WORKER_HEARTBEAT_MS * 1000LL;
+        }
+
+        // Accept a new client connection on any listener (blocking call)
+        conn_info_t info; // Peer address and accept time, forwarded to the worker
+        int client_fd = accept_any(afds, nafds, &next_listener, config.busy_poll_us,
+                                   resteer ? WORKER_HEARTBEAT_MS : -1, &info); // Accept connection
 
         // Check for errors
         if (client_fd < 0) {
@@ -529,19 +1030,30 @@ int main(int argc, char* argv[]) {
                 if (!master_running) break; // interrupted by SIGINT/SIGTERM
                 if (should_print_stats) {
                     if(g_shm && g_sems) {
-                        print_stats(g_shm, g_sems);
+                        print_stats(g_shm);
                     }
                     should_print_stats = 0;
                 }
                 continue; // interrupted by SIGALRM or other
             }
-            perror("accept");
+            if (errno == EAGAIN) {
+                continue; // poll() timed out (CPU_AFFINITY)
+            }
+            LOG_DIAG(LOG_LEVEL_ERROR, "accept: %m");
             continue;
         }
 
-        // Choose worker by round-robin
-        int w = rr;
-        rr = (rr + 1) % num_workers;
+        info.accept_us = get_time_us();
+
+        // Choose worker by round-robin, skipping workers that are down, stuck or overloaded
+        // (if none is healthy, fall back to one that is not down; with all of them down, 503)
+        int w = pick_worker(shm, rr, num_workers, info.accept_us);
+        if (w < 0) {
+            reject_connection(client_fd);
+            close(client_fd);
+            continue;
+        }
+        rr = (w + 1) % num_workers;
 
         // Enqueue the connection in the shared queue for the chosen worker
         int ret = enqueue_connection(shm, sems, w, client_fd);
@@ -556,7 +1068,11 @@ int main(int argc, char* argv[]) {
 
         // Send the real FD to worker "w" via SCM_RIGHTS
         // Worker will dequeue the item and then receive the FD
-        if (send_fd(parent_end[w], client_fd) != 0) {
+        if (send_fd(parent_end[w], client_fd, &info) != 0) {
+            worker_health_t* h = shm_health(shm, (unsigned int)w);
+            atomic_store_explicit(&h->last_error, errno, memory_order_relaxed);
+            atomic_store_explicit(&h->last_error_us, get_time_us(), memory_order_relaxed);
+            unqueue_connection(shm, sems, w); // Or its slot would stay taken
             close(client_fd);
             continue;
         }
@@ -570,13 +1086,24 @@ int main(int argc, char* argv[]) {
     // 7) Graceful shutdown
     // ---------------------------------------------------------------------------------------------------------------
 
-    // Close listen socket
-    close(listen_fd);
+    // Close listen sockets (and the steered ones, which the workers still hold until they exit)
+    close_listen_sockets(lfds, nlisten);
+    if (steer) {
+        release_steering(worker_cpu, steered, nsteered * num_workers);
+        if (afds != lfds) {
+            free(afds);
+        }
+        free(targets);
+        free(adopted);
+    }
 
-    // Wake up all workers that might be blocked on sem_wait(filled_slots)
-    // by posting dummy items to the semaphore
-    for (int i = 0; i < num_workers; ++i) {
-        sem_post(sems->filled_slots);
+    // Wake up all workers waiting on their queue events
+    if (sync_lock(&sems->queue_mutex) >= 0) {
+        sems->shutdown = 1;
+        for (int i = 0; i < num_workers; ++i) {
+            sync_event_broadcast(&shm_health(shm, (unsigned int)i)->queue_event);
+        }
+        sync_unlock(&sems->queue_mutex);
     }
 
     // Close channels and signal workers
@@ -593,15 +1120,18 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // ADDED: close the global logger (before its locks go away with the segment)
+    logger_close();
+
     // Release master's resources
     destroy_semaphores(sems);
-    free(sems);
     destroy_shared_memory(shm);
     free(pids);
     free(parent_end);
 
-    // ADDED: close the global logger
-    logger_close();
+    docpack_close(pack);
+    shcache_destroy(shared);
 
+    profiler_stop();
     return 0;
 }
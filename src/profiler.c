@@ -0,0 +1,167 @@
+#define _GNU_SOURCE // dladdr
+#include "profiler.h"
+
+#ifdef PGO_TRAINING
+void __gcov_dump(void); // libgcov, linked by -fprofile-generate
+#endif
+
+// Not instrumented itself: its body differs between the training and the optimised build
+__attribute__((no_profile_instrument_function)) void profiler_dump_pgo(void) {
+#ifdef PGO_TRAINING
+    __gcov_dump();
+#endif
+}
+
+#ifdef PROFILE_SAMPLER
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#define PROFILE_MAX_SAMPLES (1 << 15) // Per process (~33 s of CPU time at 997 Hz)
+#define PROFILE_MAX_DEPTH 64 // Frames kept per sample (including the two skipped below)
+#define PROFILE_SKIP 2 // The handler itself and the signal trampoline
+#define PROFILE_DEFAULT_HZ 997 // Prime, so sampling does not lock step with periodic work
+
+typedef struct {
+    int depth;
+    void* frames[PROFILE_MAX_DEPTH];
+} profile_sample_t;
+
+static profile_sample_t* g_samples = NULL; // mmap'ed, touched only as it fills
+static atomic_uint g_next = 0; // Next free sample
+static atomic_uint g_dropped = 0; // Samples lost because the buffer was full
+static char g_path[512];
+static int g_active = 0;
+
+// SIGPROF: record the stack of the interrupted thread (no locks, no allocation)
+static void profiler_handler(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    unsigned int i = atomic_fetch_add_explicit(&g_next, 1, memory_order_relaxed);
+    if (i >= PROFILE_MAX_SAMPLES) {
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+    } else {
+        g_samples[i].depth = backtrace(g_samples[i].frames, PROFILE_MAX_DEPTH);
+    }
+    errno = saved_errno;
+}
+
+void profiler_start(const char* role, int id) {
+    const char* dir = getenv("PROFILE_DIR");
+    if (!dir || !*dir) {
+        return;
+    }
+    const char* hz_env = getenv("PROFILE_HZ");
+    long hz = hz_env ? atol(hz_env) : PROFILE_DEFAULT_HZ;
+    if (hz < 1 || hz > 100000) {
+        hz = PROFILE_DEFAULT_HZ;
+    }
+
+    if (id >= 0) {
+        snprintf(g_path, sizeof(g_path), "%s/%s%d.%d.stacks", dir, role, id, (int)getpid());
+    } else {
+        snprintf(g_path, sizeof(g_path), "%s/%s.%d.stacks", dir, role, (int)getpid());
+    }
+
+    // A forked child starts with an empty buffer of its own
+    if (!g_samples) {
+        void* p = mmap(NULL, sizeof(profile_sample_t) * PROFILE_MAX_SAMPLES, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            perror("profiler: mmap");
+            return;
+        }
+        g_samples = p;
+    }
+    atomic_store(&g_next, 0);
+    atomic_store(&g_dropped, 0);
+
+    // backtrace() loads the unwinder on first use: do it here, not in the handler
+    void* warm[4];
+    backtrace(warm, 4);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = profiler_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &sa, NULL);
+
+    struct itimerval it;
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = (hz == 1) ? 999999 : 1000000 / hz;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+    g_active = 1;
+}
+
+// One frame: "@0x<offset>" inside the executable, the symbol (or "[library]") elsewhere.
+// Return addresses point after the call; pc - 1 stays within the calling line.
+static void write_frame(FILE* fp, void* pc, int leaf, const char* exe) {
+    uintptr_t addr = (uintptr_t)pc - (leaf ? 0 : 1);
+    Dl_info info;
+    if (!dladdr((void*)addr, &info) || !info.dli_fname) {
+        fprintf(fp, "[unknown]");
+    } else if (exe && strcmp(info.dli_fname, exe) == 0) {
+        fprintf(fp, "@0x%lx", (unsigned long)(addr - (uintptr_t)info.dli_fbase));
+    } else if (info.dli_sname) {
+        fprintf(fp, "%s", info.dli_sname);
+    } else {
+        const char* base = strrchr(info.dli_fname, '/');
+        fprintf(fp, "[%s]", base ? base + 1 : info.dli_fname);
+    }
+}
+
+void profiler_stop(void) {
+    if (!g_active) {
+        return;
+    }
+    struct itimerval off;
+    memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, NULL);
+    signal(SIGPROF, SIG_IGN);
+    g_active = 0;
+
+    FILE* fp = fopen(g_path, "w");
+    if (!fp) {
+        perror(g_path);
+        return;
+    }
+
+    // dladdr() reports the main program under the name it was started with
+    char exe_buf[512];
+    const char* exe = NULL;
+    Dl_info self;
+    if (dladdr((void*)profiler_stop, &self) && self.dli_fname) {
+        snprintf(exe_buf, sizeof(exe_buf), "%s", self.dli_fname);
+        exe = exe_buf;
+    }
+
+    unsigned int n = atomic_load(&g_next);
+    if (n > PROFILE_MAX_SAMPLES) {
+        n = PROFILE_MAX_SAMPLES;
+    }
+    fprintf(fp, "# samples %u dropped %u\n", n, atomic_load(&g_dropped));
+    for (unsigned int i = 0; i < n; i++) {
+        const profile_sample_t* s = &g_samples[i];
+        if (s->depth <= PROFILE_SKIP) {
+            continue;
+        }
+        for (int f = s->depth - 1; f >= PROFILE_SKIP; f--) {
+            write_frame(fp, s->frames[f], f == PROFILE_SKIP, exe);
+            fputc(f > PROFILE_SKIP ? ';' : '\n', fp);
+        }
+    }
+    fclose(fp);
+}
+
+#endif // PROFILE_SAMPLER
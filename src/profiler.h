@@ -0,0 +1,42 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// ###############################################################################################################
+// Built-in sampling profiler (make profile)
+//
+// Compiled in only with -DPROFILE_SAMPLER; in regular builds the calls below are empty inlines.
+// When PROFILE_DIR is set in the environment, profiler_start() arms ITIMER_PROF (PROFILE_HZ samples per second
+// of CPU time, default 997) and the SIGPROF handler records the interrupted thread's call stack into a
+// preallocated buffer. profiler_stop() writes the samples to PROFILE_DIR/<role><id>.<pid>.stacks, one stack per
+// line, root first, frames separated by ';'. Frames in the executable are written as "@0x<offset>" for
+// addr2line, frames in shared libraries by symbol name (see bench/profile.sh).
+// The timer is not inherited across fork(): every process calls profiler_start() itself.
+// ###############################################################################################################
+
+// Write the -fprofile-generate counters of a process about to leave through _exit() (make release trains with
+// -DPGO_TRAINING); does nothing in other builds. Always a real call, so callers have the same control flow in
+// the training and the optimised build.
+void profiler_dump_pgo(void);
+
+#ifdef PROFILE_SAMPLER
+
+// Start sampling this process. role and id name the output file ("worker", 2 -> worker2.<pid>.stacks;
+// id < 0 is left out). Does nothing without PROFILE_DIR.
+void profiler_start(const char* role, int id);
+
+// Stop sampling and write the samples collected by this process.
+void profiler_stop(void);
+
+#else
+
+static inline void profiler_start(const char* role, int id) {
+    (void)role;
+    (void)id;
+}
+
+static inline void profiler_stop(void) {
+}
+
+#endif // PROFILE_SAMPLER
+
+#endif // PROFILER_H
@@ -1,67 +1,56 @@
 #include "semaphores.h"
-#include <fcntl.h>
-
-// Function to initialize semaphores for the server
-// Arguments:
-// sems - Pointer to the semaphores_t structure to be initialized
-// queue_size - Maximum size of the request queue
-
-int __attribute__((no_sanitize("thread"))) init_semaphores(semaphores_t* sems, int queue_size) {
-
-    // First, unlink any existing semaphores to ensure fresh values
-    // This prevents stale semaphore values from previous runs
-    sem_unlink("/ws_empty");
-    sem_unlink("/ws_filled");
-    sem_unlink("/ws_queue_mutex");
-    sem_unlink("/ws_stats_mutex");
-    sem_unlink("/ws_log_mutex");
-
-    // empty_slots -> Semaphore counting empty slots in the queue
-    // sem_open --> Create or open a named semaphore
-    // ws_empty --> Name of the semaphore
-    // O_CREAT | O_EXCL --> Create the semaphore exclusively (fail if exists)
-    // 0666 --> Permissions for the semaphore -> rw-rw-rw-
-    // queue_size --> Initial value of the semaphore
-
-    sems->empty_slots = sem_open("/ws_empty", O_CREAT | O_EXCL, 0666, queue_size);
-
-    // filled_slots -> Semaphore counting filled slots in the queue
-    // ws_filled --> Name of the semaphore
-    // 0 --> Initial value of the semaphore
-
-    sems->filled_slots = sem_open("/ws_filled", O_CREAT | O_EXCL, 0666, 0);
-    
-    // queue_mutex -> Mutex semaphore for protecting access to the queue
-    // ws_queue_mutex --> Name of the semaphore
-    // 1 --> Initial value of the semaphore -> binary semaphore 
-
-    sems->queue_mutex = sem_open("/ws_queue_mutex", O_CREAT | O_EXCL, 0666, 1);
+#include <errno.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// Initialize one robust, process-shared mutex
+int sync_mutex_init(pthread_mutex_t* mutex) {
+    pthread_mutexattr_t attr;
+
+    if (pthread_mutexattr_init(&attr) != 0) {
+        return -1;
+    }
 
-    // stats_mutex -> Mutex semaphore for protecting access to statistics
-    // ws_stats_mutex --> Name of the semaphore
-    // 1 --> Initial value of the semaphore
+    // PTHREAD_PROCESS_SHARED --> usable from every process that maps the segment
+    // PTHREAD_MUTEX_ROBUST --> a dead owner makes the next lock return EOWNERDEAD instead of blocking forever
+    int rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    if (rc == 0) {
+        rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    }
+    if (rc == 0) {
+        rc = pthread_mutex_init(mutex, &attr);
+    }
 
-    sems->stats_mutex = sem_open("/ws_stats_mutex", O_CREAT | O_EXCL, 0666, 1);
-    
-    // log_mutex -> Mutex semaphore for protecting access to the log file
-    // ws_log_mutex --> Name of the semaphore
-    // 1 --> Initial value of the semaphore
+    pthread_mutexattr_destroy(&attr);
+    return (rc == 0) ? 0 : -1;
+}
 
-    sems->log_mutex = sem_open("/ws_log_mutex", O_CREAT | O_EXCL, 0666, 1);
+// Function to initialize the synchronization primitives for the server
+// Arguments:
+// sems - Pointer to the semaphores_t structure (inside shared memory)
 
+int __attribute__((no_sanitize("thread"))) init_semaphores(semaphores_t* sems) {
 
-    // Check if any semaphore failed to initialize
-    // SEM_FAILED --> Constant indicating semaphore initialization failure
+    memset(sems, 0, sizeof(*sems));
 
-    if (sems->empty_slots == SEM_FAILED || sems->filled_slots == SEM_FAILED || sems->queue_mutex == SEM_FAILED || sems->stats_mutex == SEM_FAILED || sems->log_mutex == SEM_FAILED) {
+    if (sync_mutex_init(&sems->queue_mutex) != 0 ||
+        sync_mutex_init(&sems->log_mutex) != 0 ||
+        sync_mutex_init(&sems->logrot_mutex) != 0) {
+        perror("init_semaphores: mutex");
         return -1;
     }
 
+    sems->shutdown = 0;
     return 0; // Success
 }
 
 
-// Function to destroy semaphores and clean up resources
+// Function to destroy the synchronization primitives
 // Arguments:
 // sems - Pointer to the semaphores_t structure to be destroyed
 
@@ -72,55 +61,90 @@ void __attribute__((no_sanitize("thread"))) destroy_semaphores(semaphores_t* sem
         return;
     };
 
-    // Close each semaphore
-    // sem_close --> Close the named semaphore
-
-    sem_close(sems->empty_slots);
-    sem_close(sems->filled_slots);
-    sem_close(sems->queue_mutex);
-    sem_close(sems->stats_mutex);
-    sem_close(sems->log_mutex);
-
-    // Unlink each semaphore
-    // sem_unlink --> Remove the named semaphore
-    
-    sem_unlink("/ws_empty");
-    sem_unlink("/ws_filled");
-    sem_unlink("/ws_queue_mutex");
-    sem_unlink("/ws_stats_mutex");
-    sem_unlink("/ws_log_mutex");
+    pthread_mutex_destroy(&sems->queue_mutex);
+    pthread_mutex_destroy(&sems->log_mutex);
+    pthread_mutex_destroy(&sems->logrot_mutex);
 }
 
-// Function to close semaphores without unlinking (for worker processes)
-// Workers inherit semaphores from master via fork() and must close them
-// before exit to avoid memory leaks, but should NOT unlink them
-// Arguments:
-// sems - Pointer to the semaphores_t structure to be closed
+// Turn EOWNERDEAD into a usable lock
+static int recover(pthread_mutex_t* mutex, int rc) {
+    if (rc == 0) {
+        return 0;
+    }
+    if (rc == EOWNERDEAD) {
+        // The owner died inside its critical section: mark the mutex usable again
+        pthread_mutex_consistent(mutex);
+        return 1;
+    }
+    errno = rc;
+    return -1;
+}
 
-void __attribute__((no_sanitize("thread"))) close_semaphores(semaphores_t* sems) {
+int sync_lock(pthread_mutex_t* mutex) {
+    return recover(mutex, pthread_mutex_lock(mutex));
+}
 
-    // Validate input parameter -> Check if the pointer is NULL
-    if (!sems){
-        return;
-    };
+void sync_unlock(pthread_mutex_t* mutex) {
+    pthread_mutex_unlock(mutex);
+}
 
-    // Close each semaphore (do NOT unlink - only master should unlink)
-    // sem_close -> Close the named semaphore
+int sync_event_wait(sync_event_t* ev, pthread_mutex_t* mutex, long timeout_ms) {
+    // Read the counter while the condition is still locked: a broadcast after the unlock changes it,
+    // so FUTEX_WAIT returns at once instead of missing the wakeup
+    unsigned int seq = atomic_load_explicit(ev, memory_order_relaxed);
+    sync_unlock(mutex);
 
-    if (sems->empty_slots && sems->empty_slots != SEM_FAILED) {
-        sem_close(sems->empty_slots);
-    }
-    if (sems->filled_slots && sems->filled_slots != SEM_FAILED) {
-        sem_close(sems->filled_slots);
-    }
-    if (sems->queue_mutex && sems->queue_mutex != SEM_FAILED) {
-        sem_close(sems->queue_mutex);
+    struct timespec rel; // FUTEX_WAIT takes a relative CLOCK_MONOTONIC timeout
+    rel.tv_sec = timeout_ms / 1000;
+    rel.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+    // Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+    long r = syscall(SYS_futex, ev, FUTEX_WAIT, seq, (timeout_ms >= 0) ? &rel : NULL, NULL, 0);
+    int timed_out = (r == -1 && errno == ETIMEDOUT);
+
+    int rc = sync_lock(mutex);
+    if (rc == 0 && timed_out) {
+        return 2;
     }
-    if (sems->stats_mutex && sems->stats_mutex != SEM_FAILED) {
-        sem_close(sems->stats_mutex);
+    return rc;
+}
+
+// Tell the CPU this is a spin-wait loop (frees pipeline resources for the sibling hyperthread)
+static inline void spin_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+int sync_event_spin(sync_event_t* ev, pthread_mutex_t* mutex, long spin_us) {
+    unsigned int seq = atomic_load_explicit(ev, memory_order_relaxed);
+    sync_unlock(mutex);
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int fired = 0;
+    for (unsigned int i = 1; !fired; i++) {
+        spin_pause();
+        fired = atomic_load_explicit(ev, memory_order_relaxed) != seq;
+        if (!fired && (i & 63) == 0) { // Check the clock (vDSO, no system call) every 64 rounds
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long elapsed_us = (now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000;
+            if (elapsed_us >= spin_us) {
+                break;
+            }
+        }
     }
-    if (sems->log_mutex && sems->log_mutex != SEM_FAILED) {
-        sem_close(sems->log_mutex);
+
+    int rc = sync_lock(mutex);
+    if (rc == 0 && !fired) {
+        return 2;
     }
+    return rc;
 }
 
+void sync_event_broadcast(sync_event_t* ev) {
+    atomic_fetch_add_explicit(ev, 1, memory_order_relaxed);
+    syscall(SYS_futex, ev, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
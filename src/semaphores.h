@@ -1,33 +1,61 @@
 #ifndef SEMAPHORES_H
 #define SEMAPHORES_H
-#include <semaphore.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-// Structure to hold semaphores used for synchronization
+#define CACHE_LINE 64 // Cache line size assumed by the shared memory layout
+
+// Process-shared synchronization primitives. The structure lives inside the shared memory segment
+// (shared_data_t.sync) and every process uses it in place, so there are no named objects to open,
+// close or unlink. Mutexes are robust: if a process dies while holding one, the next locker recovers
+// it instead of deadlocking. Uncontended lock/unlock is a single atomic operation (futex fast path).
 typedef struct {
-    sem_t* empty_slots; // Semaphore counting empty slots in the queue
-    sem_t* filled_slots; // Semaphore counting filled slots in the queue
-    sem_t* queue_mutex; // Mutex semaphore for protecting access to the queue
-    sem_t* stats_mutex; // Mutex semaphore for protecting access to statistics
-    sem_t* log_mutex; // Mutex semaphore for protecting access to the log file
-} semaphores_t; // Semaphores structure
-
-// Function to initialize semaphores
-// Arguments:
-// sems - Pointer to the semaphores_t structure to be initialized
-// queue_size - Size of the connection queue
+    _Alignas(CACHE_LINE) pthread_mutex_t queue_mutex; // Protects the connection queue
+    int shutdown; // Set by the master (under queue_mutex) to release waiting workers
+    _Alignas(CACHE_LINE) pthread_mutex_t log_mutex; // Serializes appends to the access log between processes
+    pthread_mutex_t logrot_mutex; // Serializes the rotated access log generations between processes
+} semaphores_t; // Shared synchronization structure
 
-int init_semaphores(semaphores_t* sems, int queue_size);
+// Event counter waited on with a futex (see sync_event_wait()). Workers sleep on one rather than on a
+// process-shared condition variable: glibc's condvar makes the broadcaster wait for earlier waiters to leave,
+// so one stopped worker could stall the master.
+typedef atomic_uint sync_event_t;
 
-// Function to destroy semaphores and clean up resources
+// Function to initialize the primitives in place (master, before forking)
+// Arguments:
+// sems - Pointer to the semaphores_t structure inside shared memory
+// Returns 0 on success, -1 on error
+int init_semaphores(semaphores_t* sems);
+
+// Function to destroy the primitives (master, after all workers exited)
 // Arguments:
 // sems - Pointer to the semaphores_t structure to be destroyed
 void destroy_semaphores(semaphores_t* sems);
 
-// Function to close semaphores without unlinking (for worker processes)
-// Workers should call this before exit to properly release resources
-// Arguments:
-// sems - Pointer to the semaphores_t structure to be closed
-void close_semaphores(semaphores_t* sems);
+// Initialize a robust, process-shared mutex in place (in memory shared between the processes).
+// Returns 0 on success, -1 on error
+int sync_mutex_init(pthread_mutex_t* mutex);
+
+// Lock a shared mutex. If the previous owner died holding it, the mutex is made consistent again.
+// Returns 0 when locked normally, 1 when locked after recovering from a dead owner (the protected
+// data may be half-updated), -1 on error.
+int sync_lock(pthread_mutex_t* mutex);
+
+// Unlock a shared mutex
+void sync_unlock(pthread_mutex_t* mutex);
+
+// Release mutex (held), sleep until the event is broadcast or timeout_ms milliseconds pass (< 0: no limit),
+// then lock mutex again. Same return values as sync_lock(), plus 2 when the time ran out. Wakeups may be
+// spurious: recheck the condition.
+int sync_event_wait(sync_event_t* ev, pthread_mutex_t* mutex, long timeout_ms);
+
+// Same as sync_event_wait(), but spins on the event word for up to spin_us microseconds instead of sleeping
+// (BUSY_POLL_US): a broadcast is seen without a futex wakeup, at the cost of a busy CPU. Returns 2 when the
+// budget ran out without a broadcast.
+int sync_event_spin(sync_event_t* ev, pthread_mutex_t* mutex, long spin_us);
+
+// Wake every process waiting on the event (call with the mutex that guards the condition held).
+void sync_event_broadcast(sync_event_t* ev);
 
 
 #endif
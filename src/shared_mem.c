@@ -3,31 +3,116 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/file.h>
+
+// Prefix of the shared memory object names (webserver_shm.<instance>)
+#define SHM_PREFIX "/webserver_shm."
+
+// Function to build the shared memory name of an instance
+int shm_instance_name(char* out, size_t cap, const char* instance, int port) {
+    char id[SHM_INSTANCE_MAX + 1];
+
+    if (instance && instance[0]) {
+        size_t len = strlen(instance);
+        if (len > SHM_INSTANCE_MAX) {
+            return -1;
+        }
+        // Only characters that are safe in a POSIX object name (no '/')
+        for (size_t i = 0; i < len; i++) {
+            char c = instance[i];
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '_' || c == '-' || c == '.')) {
+                return -1;
+            }
+        }
+        memcpy(id, instance, len + 1);
+    } else {
+        snprintf(id, sizeof(id), "%d", port);
+    }
+
+    int n = snprintf(out, cap, "%s%s", SHM_PREFIX, id);
+    return (n > 0 && (size_t)n < cap) ? 0 : -1;
+}
+
+// Descriptor of the segment, kept open with an exclusive flock() for as long as the instance lives
+// (inherited by the workers, released by the kernel however the processes end)
+static int g_shm_fd = -1;
 
-// Name of the shared memory object
-// webserver_shm -> Shared memory for the web server
-#define SHM_NAME "/webserver_shm"
+// 1 if a live instance holds the lock on an existing segment, 0 if the segment is stale
+static int segment_in_use(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return 0;
+    }
+
+    int busy = (flock(fd, LOCK_SH | LOCK_NB) == -1 && errno == EWOULDBLOCK);
+    close(fd);
+    return busy;
+}
 
 // Function to create and initialize shared memory
-shared_data_t* __attribute__((no_sanitize("thread"))) create_shared_memory(int queue_size __attribute__((unused))) {
+shared_data_t* __attribute__((no_sanitize("thread"))) create_shared_memory(const char* name, int queue_size, int num_workers) {
+
+    if (strlen(name) >= sizeof(((shm_config_t*)0)->name)) {
+        fprintf(stderr, "Error: shared memory name too long: %s\n", name);
+        return NULL;
+    }
+
+    // Ring capacity: configured size rounded up to a power of two
+    unsigned int limit = (queue_size > 0) ? (unsigned int)queue_size : MAX_QUEUE_SIZE;
+    unsigned int capacity = 1;
+    while (capacity < limit) {
+        capacity <<= 1;
+    }
+
+    // The segment is the fixed header, one ring per worker, the stats slots (one per worker + the master) and
+    // the worker health slots, each ring and the slots starting on a fresh cache line
+    unsigned int workers = (unsigned int)((num_workers > 0) ? num_workers : 1);
+    unsigned int slots = workers + 1;
+    size_t queue_offset = (sizeof(shared_data_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    size_t ring_bytes = sizeof(connection_queue_t) + (size_t)capacity * sizeof(connection_item_t);
+    size_t queue_stride = (ring_bytes + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    size_t stats_offset = queue_offset + (size_t)workers * queue_stride;
+    size_t health_offset = stats_offset + (size_t)slots * sizeof(stats_slot_t);
+    size_t size = health_offset + (size_t)workers * sizeof(worker_health_t);
 
     // shm_fd -> File descriptor for the shared memory object
-    // shm_open -> Create or open a shared memory object
-    // O_CREAT | O_RDWR -> Create if it doesn't exist, open for reading and writing
+    // shm_open -> Create a shared memory object
+    // O_CREAT | O_EXCL | O_RDWR -> Create it (fail if it exists), open for reading and writing
     // 0666 -> Permissions for the shared memory -> rw-rw-rw- 
 
-    int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+    int shm_fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+
+    // An existing segment is either another running instance (refuse) or left by a crash (replace)
+    if (shm_fd == -1 && errno == EEXIST) {
+        if (segment_in_use(name)) {
+            fprintf(stderr, "Error: instance %s is already running (set INSTANCE_NAME or PORT)\n", name);
+            return NULL;
+        }
+        shm_unlink(name);
+        shm_fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    }
 
     // Check for errors in creating/opening shared memory
     if (shm_fd == -1){
+        perror("shm_open");
         return NULL;
     };
 
+    // Mark the segment as owned by a running instance
+    if (flock(shm_fd, LOCK_EX | LOCK_NB) == -1) {
+        perror("flock");
+        close(shm_fd);
+        return NULL;
+    }
+
     // Set the size of the shared memory object
     // ftruncate -> Set the size of the shared memory object
-    // sizeof(shared_data_t) -> Size of the shared data structure
+    // size -> Header, rings, stats and health slots
     // == -1 -> Check for errors
-    if (ftruncate(shm_fd, sizeof(shared_data_t)) == -1) {
+    if (ftruncate(shm_fd, (off_t)size) == -1) {
 
         // Close the shared memory file descriptor on error
         close(shm_fd);
@@ -39,18 +124,18 @@ shared_data_t* __attribute__((no_sanitize("thread"))) create_shared_memory(int q
     // data -> Pointer to the mapped shared memory region
     // mmap -> Map the shared memory object
     // NULL -> Let the system choose the address
-    // sizeof(shared_data_t) -> Size of the mapping
+    // size -> Size of the mapping
     // PROT_READ | PROT_WRITE -> Read and write permissions
     // MAP_SHARED -> Shared mapping
 
-    shared_data_t* data = mmap(NULL, sizeof(shared_data_t), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-
-    close(shm_fd); // Close the file descriptor as it's no longer needed
+    shared_data_t* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
 
+    // Keep the descriptor open: it holds the ownership lock
 
     // Check for errors in mapping shared memory
     // data == MAP_FAILED -> Check if the mapping failed
     if (data == MAP_FAILED){
+        close(shm_fd);
         return NULL;
     }
 
@@ -58,9 +143,25 @@ shared_data_t* __attribute__((no_sanitize("thread"))) create_shared_memory(int q
     // memset -> Set memory to a specific value
     // data -> Pointer to the shared data structure
     // 0 -> Value to set (zero)
-    // sizeof(shared_data_t) -> Size of the memory to set
-    memset(data, 0, sizeof(shared_data_t));
+    // size -> Size of the memory to set
+    memset(data, 0, size);
+
+    data->config.segment_size = size;
+    memcpy(data->config.name, name, strlen(name) + 1);
+    data->config.stats_offset = stats_offset;
+    data->config.stats_slots = slots;
+    data->config.health_offset = health_offset;
+    data->config.num_workers = workers;
+    data->config.queue_offset = queue_offset;
+    data->config.queue_stride = queue_stride;
+    data->queue_limit = limit;
+    for (unsigned int i = 0; i < workers; i++) {
+        connection_queue_t* q = shm_queue(data, i);
+        q->capacity = capacity;
+        q->mask = capacity - 1;
+    }
 
+    g_shm_fd = shm_fd;
     return data; // Return pointer to the shared data structure
 }
 
@@ -69,13 +170,21 @@ void __attribute__((no_sanitize("thread"))) destroy_shared_memory(shared_data_t*
 
     // Unmap the shared memory region and unlink the shared memory object
     if (data != NULL && data != MAP_FAILED) {
+        char name[sizeof(data->config.name)];
+        memcpy(name, data->config.name, sizeof(name)); // The name lives in the segment
+
         // munmap -> Unmap the shared memory region
         // data -> Pointer to the mapped shared memory region
-        // sizeof(shared_data_t) -> Size of the mapping
+        // segment_size -> Size of the whole mapping
+
+        munmap(data, data->config.segment_size);
+
+        // shm_unlink -> Remove the shared memory object
+        shm_unlink(name);
+    }
 
-        munmap(data, sizeof(shared_data_t));
+    if (g_shm_fd != -1) {
+        close(g_shm_fd); // Releases the ownership lock
+        g_shm_fd = -1;
     }
-    
-    // shm_unlink -> Remove the shared memory object
-    shm_unlink(SHM_NAME);
 }
\ No newline at end of file
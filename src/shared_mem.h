@@ -1,8 +1,24 @@
 #ifndef SHARED_MEM_H
 #define SHARED_MEM_H
-#define MAX_QUEUE_SIZE 100
+#include <stddef.h>
+#include <stdatomic.h>
+#include "semaphores.h" // semaphores_t (embedded in the segment), CACHE_LINE
+#define MAX_QUEUE_SIZE 100 // Default connection queue size (MAX_QUEUE_SIZE in server.conf)
+#define SHM_INSTANCE_MAX 32 // Longest INSTANCE_NAME
+#define SHM_NAME_MAX 64 // Buffer size for a shared memory object name
 
-// Structure to hold server statistics in shared memory
+// ###############################################################################################################
+// Segment layout (every section starts on its own cache line so writers never invalidate each other's lines):
+//
+//   shm_config_t    read-mostly: written once by the master before forking
+//   semaphores_t    queue mutex, log mutexes
+//   queue admission pending connections and their limit
+//   worker rings    one connection_queue_t per worker, at config.queue_offset (config.queue_stride apart)
+//   stats slots     one stats_slot_t per writer (workers + master), at config.stats_offset
+//   health slots    one worker_health_t per worker, at config.health_offset
+// ###############################################################################################################
+
+// Server statistics (summed over all writers, see stats_snapshot())
 typedef struct {
     long total_requests; // Total number of requests handled by the server
     long bytes_transferred; // Total bytes transferred by the server
@@ -13,7 +29,75 @@ typedef struct {
     long total_response_time_ms; // Total response time in milliseconds
 } server_stats_t; // Server statistics structure
 
-// FEATURE 1: Bounded circular buffer in shared memory (size: 100 connections)
+// Counters of one writer process. Each slot fills whole cache lines, so a worker's request threads only
+// contend with each other (relaxed atomic adds, no lock) and never with the other workers.
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_long total_requests;
+    atomic_long bytes_transferred;
+    atomic_long status_200;
+    atomic_long status_404;
+    atomic_long status_500;
+    atomic_int active_connections;
+    atomic_long total_response_time_ms;
+} stats_slot_t; // Per-writer statistics slot
+
+#define WORKER_HEARTBEAT_MS 1000 // An idle worker still refreshes its heartbeat this often
+#define WORKER_STALE_MS 5000 // The master skips a worker whose heartbeat is older than this
+
+// Health states reported by worker_health_state()
+#define WORKER_OK 0 // Beating and accepting work
+#define WORKER_DOWN 1 // Not started or exited
+#define WORKER_STALE 2 // Dispatch loop stuck (no heartbeat for WORKER_STALE_MS)
+#define WORKER_OVERLOADED 3 // Thread pool queue full
+
+// Busy-poll accounting of one dispatch loop (BUSY_POLL_US): time spent spinning for work instead of sleeping,
+// and how often the spin found work within its budget (hit) or ran out and went to sleep (miss)
+typedef struct {
+    atomic_llong spin_us; // Microseconds spent spinning
+    atomic_long spin_hits; // Spins that found work
+    atomic_long spin_misses; // Spins that ran out of budget
+} spin_stats_t;
+
+// Health of one worker. Written by the worker with relaxed atomic stores (the heartbeat by its dispatch
+// loop, the pool fields by its pool threads), read by the master before dispatching a connection.
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_int pid; // Worker process id (0 = not running)
+    atomic_llong heartbeat_us; // get_time_us() of the last pass through the dispatch loop
+    atomic_int inflight; // Requests being handled by pool threads
+    atomic_int pool_queued; // Connections waiting for a pool thread
+    atomic_int pool_capacity; // Pool queue size (pool_queued >= pool_capacity: overloaded)
+    atomic_int last_error; // errno of the last failure (0 = none)
+    atomic_llong last_error_us; // get_time_us() of the last failure
+    atomic_llong cache_bytes; // Bytes held by the worker's file cache (sampled with the heartbeat)
+    atomic_int disk_queued; // Cache misses waiting for a disk I/O thread
+    atomic_long disk_inline; // Cache misses read from the page cache by the request thread
+    atomic_long disk_deferred; // Cache misses handed to the disk I/O pool
+    atomic_long disk_rejected; // Cache misses answered 503 because the disk I/O queue was full
+    atomic_long sndbuf_tuned; // Responses sent with an SO_SNDBUF sized for them (SNDBUF_MAX_KB)
+    atomic_llong sndbuf_bytes; // Sum of those SO_SNDBUF sizes
+    atomic_llong sndbuf_rtt_us; // Sum of the smoothed RTTs they were sized from
+    spin_stats_t spin; // Dispatch loop busy polling (waiting for the queue and the descriptor)
+    atomic_int cpu; // CPU the worker is pinned to (CPU_AFFINITY; -1 = not pinned)
+    atomic_long conn_local; // Connections whose packets were processed on the CPU that took them (SO_INCOMING_CPU)
+    atomic_long conn_remote; // Connections whose packets were processed on another CPU
+    // Broadcast by the master (under queue_mutex) when it queues a connection for this worker or shuts down.
+    // On its own line: the master writes it on every dispatch.
+    _Alignas(CACHE_LINE) sync_event_t queue_event;
+} worker_health_t; // Per-worker health slot
+
+// Read-mostly configuration of the segment
+typedef struct {
+    char name[SHM_NAME_MAX]; // Object name (see shm_instance_name()), unlinked by destroy_shared_memory()
+    size_t segment_size; // Bytes in the segment, for processes that map it later
+    size_t queue_offset; // Offset of the first worker ring
+    size_t queue_stride; // Bytes from one worker ring to the next (whole cache lines)
+    size_t stats_offset; // Offset of the first stats slot from the start of the segment
+    size_t health_offset; // Offset of the first worker health slot
+    unsigned int stats_slots; // Number of stats slots (workers + 1)
+    unsigned int num_workers; // Number of worker health slots
+} shm_config_t;
+
+// FEATURE 1: Bounded circular buffer in shared memory (size: MAX_QUEUE_SIZE from server.conf)
 // Structure to hold the connection queue in shared memory
 // Circular buffer to hold connection items
 typedef struct {
@@ -21,20 +105,103 @@ typedef struct {
     int placeholder_fd; // Placeholder file descriptor (not the actual FD, since FDs can't be shared)
 } connection_item_t;
 
+// One ring per worker: the master stores a connection on the ring of the worker it dispatches it to, so a
+// worker takes the head of its own ring instead of searching a shared queue. Sized at startup: capacity is
+// the configured size rounded up to a power of two (one worker may hold every pending connection), so
+// positions are free-running counters and a slot is found with a mask instead of a modulo. head is advanced
+// by the worker and tail by the master, so each lives on its own cache line.
 typedef struct {
-    connection_item_t items[MAX_QUEUE_SIZE]; // Array to hold connection items
-    int front; // Index of the front of the queue
-    int rear; // Index of the rear of the queue
-    int count; // Number of elements in the queue
-} connection_queue_t; // Connection queue structure
+    _Alignas(CACHE_LINE) unsigned int head; // Position of the oldest item (worker)
+    _Alignas(CACHE_LINE) unsigned int tail; // Position the next item is stored at (master)
+    _Alignas(CACHE_LINE) unsigned int capacity; // Ring slots (power of two); read-only after creation
+    unsigned int mask; // capacity - 1
+    connection_item_t items[]; // Ring storage (capacity entries)
+} connection_queue_t; // Connection queue structure (one worker's ring)
+
+// Number of queued items
+static inline unsigned int queue_count(const connection_queue_t* q) {
+    return q->tail - q->head;
+}
+
+// i-th queued item (0 = oldest)
+static inline connection_item_t* queue_at(connection_queue_t* q, unsigned int i) {
+    return &q->items[(q->head + i) & q->mask];
+}
 
 // Combined shared data structure
 typedef struct {
-    connection_queue_t queue; // Connection queue
-    server_stats_t stats; // Server statistics
+    shm_config_t config; // Read-mostly section
+    _Alignas(CACHE_LINE) semaphores_t sync; // Process-shared mutexes
+    _Alignas(CACHE_LINE) spin_stats_t master_spin; // Accept loop busy polling (written by the master only)
+    _Alignas(CACHE_LINE) unsigned int queue_pending; // Connections on all the worker rings (queue_mutex)
+    unsigned int queue_limit; // Configured size: with this many pending connections new ones get a 503
 } shared_data_t; // Combined shared data structure
 
-shared_data_t* create_shared_memory(int queue_size); // Allocate and initialize the shared memory segment
+// Connection ring of worker i (i < config.num_workers)
+static inline connection_queue_t* shm_queue(shared_data_t* shm, unsigned int i) {
+    return (connection_queue_t*)((char*)shm + shm->config.queue_offset + (size_t)i * shm->config.queue_stride);
+}
+
+// Drop the connections queued for worker i, which exited without taking them (queue_mutex held)
+static inline void queue_drop(shared_data_t* shm, unsigned int i) {
+    connection_queue_t* q = shm_queue(shm, i);
+    shm->queue_pending -= queue_count(q);
+    q->head = q->tail;
+}
+
+// Repair the rings and the pending count after recovering queue_mutex from a process that died mid-update
+// (queue_mutex held)
+static inline void queue_repair(shared_data_t* shm) {
+    unsigned int pending = 0;
+    for (unsigned int i = 0; i < shm->config.num_workers; i++) {
+        connection_queue_t* q = shm_queue(shm, i);
+        if (queue_count(q) > q->capacity) {
+            q->head = q->tail; // Inconsistent: drop the pending items
+        }
+        pending += queue_count(q);
+    }
+    shm->queue_pending = pending;
+}
+
+// Statistics slot of writer i (worker id, or stats_slots - 1 for the master)
+static inline stats_slot_t* shm_stats_slot(shared_data_t* shm, unsigned int i) {
+    return (stats_slot_t*)((char*)shm + shm->config.stats_offset) + i;
+}
+
+// Health slot of worker i (i < config.num_workers)
+static inline worker_health_t* shm_health(shared_data_t* shm, unsigned int i) {
+    return (worker_health_t*)((char*)shm + shm->config.health_offset) + i;
+}
+
+// Classify a worker (WORKER_*) at time now_us (get_time_us())
+static inline int worker_health_state(worker_health_t* h, long long now_us) {
+    if (atomic_load_explicit(&h->pid, memory_order_relaxed) == 0) {
+        return WORKER_DOWN;
+    }
+    if (now_us - atomic_load_explicit(&h->heartbeat_us, memory_order_relaxed) > WORKER_STALE_MS * 1000LL) {
+        return WORKER_STALE;
+    }
+    int cap = atomic_load_explicit(&h->pool_capacity, memory_order_relaxed);
+    if (cap > 0 && atomic_load_explicit(&h->pool_queued, memory_order_relaxed) >= cap) {
+        return WORKER_OVERLOADED;
+    }
+    return WORKER_OK;
+}
+
+// Name of a WORKER_* state
+static inline const char* worker_health_name(int state) {
+    static const char* const names[] = { "ok", "down", "stale", "overloaded" };
+    return (state >= 0 && state <= WORKER_OVERLOADED) ? names[state] : "unknown";
+}
+
+// Name of the shared memory object of an instance: /webserver_shm.<instance>, or /webserver_shm.<port> when
+// instance is empty, so servers on different ports or with different INSTANCE_NAMEs never share a segment.
+// Returns 0, or -1 if instance is too long or has characters other than [A-Za-z0-9_.-].
+int shm_instance_name(char* out, size_t cap, const char* instance, int port);
+
+// Allocate and initialize the segment. Fails if a running instance already owns name (its processes hold
+// a flock() on the segment); a segment left by a crashed instance is replaced.
+shared_data_t* create_shared_memory(const char* name, int queue_size, int num_workers);
     
 void destroy_shared_memory(shared_data_t* data); // Clean up and release the shared memory
 
@@ -0,0 +1,424 @@
+#define _GNU_SOURCE // memfd_create, fallocate
+#include "shcache.h"
+#include "semaphores.h" // sync_mutex_init(), sync_lock(): robust process-shared mutex
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h> // fallocate, FALLOC_FL_*
+#include <sys/mman.h>
+
+// Index header, at the start of the memfd. Everything below is protected by lock.
+typedef struct {
+    pthread_mutex_t lock; // Robust, process-shared
+    uint32_t nentries; // Entry table size
+    uint32_t nbuckets; // Hash buckets (power of two)
+    uint32_t npages; // Data area size in pages
+    uint32_t pages_used; // Pages allocated in the bitmap (stored or reserved bodies)
+    int32_t free_head; // Unused entries, linked through hnext (-1 = none)
+    int32_t lru_head; // Most recently used entry (-1 = empty)
+    int32_t lru_tail; // Least recently used entry
+    size_t capacity; // npages * SHCACHE_PAGE
+    size_t bytes_used; // File bytes held
+    size_t items;
+    size_t hits, misses, evictions;
+} shcache_header_t;
+
+typedef struct {
+    char key[SHCACHE_KEY_MAX]; // Request path
+    uint64_t size; // File size in bytes
+    uint32_t first_page; // Body: pages [first_page, first_page + pages) of the data area
+    uint32_t pages;
+    int32_t hnext; // Next entry in the bucket (or in the free list)
+    int32_t prev, next; // LRU list
+    int32_t refcnt; // Handles pinning the entry
+} shcache_entry_t;
+
+// Process-local view; created by the master and inherited by the workers with the mapping
+struct shcache {
+    int fd; // memfd
+    uint8_t* base; // Mapping of the whole memfd
+    size_t map_size;
+    shcache_header_t* hdr;
+    shcache_entry_t* entries;
+    int32_t* buckets;
+    uint64_t* bitmap; // One bit per data page, 1 = allocated
+    size_t data_off; // Offset of the data area in the memfd (page aligned)
+};
+
+// djb2, as the per-worker cache
+static uint32_t bucket_of(const shcache_t* c, const char* key) {
+    unsigned long h = 5381UL;
+    int ch;
+    while ((ch = (unsigned char)*key++)) {
+        h = (h << 5) + h + (unsigned long)ch;
+    }
+    return (uint32_t)(h & (c->hdr->nbuckets - 1));
+}
+
+static size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) / a * a;
+}
+
+// ###############################################################################################################
+// Creation
+// ###############################################################################################################
+
+shcache_t* shcache_create(size_t capacity_bytes) {
+    uint32_t npages = (uint32_t)(capacity_bytes / SHCACHE_PAGE);
+    if (npages == 0) {
+        npages = 1;
+    }
+    // One entry per two pages covers caches of mostly small files; the LRU recycles entries when they run out
+    uint32_t nentries = npages / 2 < 256 ? 256 : npages / 2;
+    uint32_t nbuckets = 1;
+    while (nbuckets < nentries) {
+        nbuckets <<= 1;
+    }
+
+    size_t entries_off = align_up(sizeof(shcache_header_t), 64);
+    size_t buckets_off = entries_off + (size_t)nentries * sizeof(shcache_entry_t);
+    size_t bitmap_off = align_up(buckets_off + (size_t)nbuckets * sizeof(int32_t), sizeof(uint64_t));
+    size_t data_off = align_up(bitmap_off + (size_t)(npages + 63) / 64 * sizeof(uint64_t), SHCACHE_PAGE);
+    size_t map_size = data_off + (size_t)npages * SHCACHE_PAGE;
+
+    int fd = memfd_create("webserver-cache", MFD_CLOEXEC);
+    if (fd < 0) {
+        perror("shcache: memfd_create");
+        return NULL;
+    }
+    // Sparse: data pages take memory only once a file is stored in them
+    if (ftruncate(fd, (off_t)map_size) != 0) {
+        perror("shcache: ftruncate");
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("shcache: mmap");
+        close(fd);
+        return NULL;
+    }
+
+    shcache_t* c = calloc(1, sizeof(*c));
+    if (!c) {
+        munmap(base, map_size);
+        close(fd);
+        return NULL;
+    }
+    c->fd = fd;
+    c->base = base;
+    c->map_size = map_size;
+    c->hdr = (shcache_header_t*)c->base;
+    c->entries = (shcache_entry_t*)(c->base + entries_off);
+    c->buckets = (int32_t*)(c->base + buckets_off);
+    c->bitmap = (uint64_t*)(c->base + bitmap_off);
+    c->data_off = data_off;
+
+    // The memfd starts zeroed: bitmap empty, counters 0
+    shcache_header_t* h = c->hdr;
+    if (sync_mutex_init(&h->lock) != 0) {
+        perror("shcache: mutex");
+        shcache_destroy(c);
+        return NULL;
+    }
+    h->nentries = nentries;
+    h->nbuckets = nbuckets;
+    h->npages = npages;
+    h->capacity = (size_t)npages * SHCACHE_PAGE;
+    h->lru_head = h->lru_tail = -1;
+    for (uint32_t b = 0; b < nbuckets; b++) {
+        c->buckets[b] = -1;
+    }
+    for (uint32_t i = 0; i < nentries; i++) {
+        c->entries[i].hnext = (i + 1 < nentries) ? (int32_t)(i + 1) : -1;
+    }
+    h->free_head = 0;
+    return c;
+}
+
+void shcache_destroy(shcache_t* c) {
+    if (!c) {
+        return;
+    }
+    pthread_mutex_destroy(&c->hdr->lock);
+    munmap(c->base, c->map_size);
+    close(c->fd);
+    free(c);
+}
+
+// ###############################################################################################################
+// Index (lock held)
+// ###############################################################################################################
+
+static int32_t bucket_find(shcache_t* c, const char* key) {
+    for (int32_t i = c->buckets[bucket_of(c, key)]; i >= 0; i = c->entries[i].hnext) {
+        if (strcmp(c->entries[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void lru_unlink(shcache_t* c, int32_t i) {
+    shcache_entry_t* e = &c->entries[i];
+    if (e->prev >= 0) c->entries[e->prev].next = e->next; else c->hdr->lru_head = e->next;
+    if (e->next >= 0) c->entries[e->next].prev = e->prev; else c->hdr->lru_tail = e->prev;
+    e->prev = e->next = -1;
+}
+
+static void lru_push_front(shcache_t* c, int32_t i) {
+    shcache_entry_t* e = &c->entries[i];
+    e->prev = -1;
+    e->next = c->hdr->lru_head;
+    if (e->next >= 0) c->entries[e->next].prev = i; else c->hdr->lru_tail = i;
+    c->hdr->lru_head = i;
+}
+
+static void mark_pages(shcache_t* c, uint32_t first, uint32_t n, int used) {
+    for (uint32_t p = first; p < first + n; p++) {
+        if (used) c->bitmap[p >> 6] |= 1ULL << (p & 63);
+        else c->bitmap[p >> 6] &= ~(1ULL << (p & 63));
+    }
+    if (used) c->hdr->pages_used += n;
+    else c->hdr->pages_used -= n;
+}
+
+// First run of n free pages, or -1 (first fit; full words are skipped)
+static int64_t find_free_run(shcache_t* c, uint32_t n) {
+    uint32_t run = 0;
+    for (uint32_t p = 0; p < c->hdr->npages; p++) {
+        if ((p & 63) == 0 && c->bitmap[p >> 6] == ~0ULL) {
+            run = 0;
+            p += 63;
+            continue;
+        }
+        if (c->bitmap[p >> 6] & (1ULL << (p & 63))) {
+            run = 0;
+        } else if (++run == n) {
+            return (int64_t)p + 1 - n;
+        }
+    }
+    return -1;
+}
+
+// Drop the least recently used unpinned entry. Returns 0 when every entry is pinned.
+// Its pages are only marked free: the next owner punches them out of the memfd before writing (see
+// shcache_load()), since a response sent from them may still be queued in the kernel.
+static int evict_one(shcache_t* c) {
+    int32_t i = c->hdr->lru_tail;
+    while (i >= 0 && c->entries[i].refcnt > 0) {
+        i = c->entries[i].prev;
+    }
+    if (i < 0) {
+        return 0;
+    }
+    shcache_entry_t* e = &c->entries[i];
+
+    int32_t* link = &c->buckets[bucket_of(c, e->key)];
+    while (*link != i) {
+        link = &c->entries[*link].hnext;
+    }
+    *link = e->hnext;
+    lru_unlink(c, i);
+    mark_pages(c, e->first_page, e->pages, 0);
+
+    c->hdr->items--;
+    c->hdr->bytes_used -= e->size;
+    c->hdr->evictions++;
+    e->key[0] = '\0';
+    e->hnext = c->hdr->free_head;
+    c->hdr->free_head = i;
+    return 1;
+}
+
+static void fill_handle(shcache_t* c, int32_t i, cache_handle_t* out) {
+    shcache_entry_t* e = &c->entries[i];
+    size_t off = (size_t)e->first_page * SHCACHE_PAGE;
+    out->data = c->base + c->data_off + off;
+    out->size = e->size;
+    out->_entry = NULL;
+    out->fd = c->fd;
+    out->offset = (off_t)(c->data_off + off);
+    out->_slot = i;
+}
+
+// Pin the entry of key and fill out, counting a hit. Returns false when key is not cached (lock held).
+static bool acquire_locked(shcache_t* c, const char* key, cache_handle_t* out) {
+    int32_t i = bucket_find(c, key);
+    if (i < 0) {
+        return false;
+    }
+    c->entries[i].refcnt++;
+    lru_unlink(c, i);
+    lru_push_front(c, i);
+    c->hdr->hits++;
+    fill_handle(c, i, out);
+    return true;
+}
+
+// A robust lock recovered from a dead worker is used as is: every index update completes before the
+// next one starts, so at worst one entry or a few page bits are lost until the next restart
+static void shcache_lock(shcache_t* c) {
+    sync_lock(&c->hdr->lock);
+}
+
+// ###############################################################################################################
+// Public API
+// ###############################################################################################################
+
+bool shcache_acquire(shcache_t* c, const char* key, cache_handle_t* out) {
+    if (!c || !key || !out) {
+        return false;
+    }
+    shcache_lock(c);
+    bool hit = acquire_locked(c, key, out);
+    if (!hit) {
+        c->hdr->misses++;
+    }
+    sync_unlock(&c->hdr->lock);
+    return hit;
+}
+
+void shcache_release(shcache_t* c, cache_handle_t* handle) {
+    if (!c || !handle || handle->fd < 0) {
+        return;
+    }
+    shcache_lock(c);
+    shcache_entry_t* e = &c->entries[handle->_slot];
+    if (e->refcnt > 0) {
+        e->refcnt--;
+    }
+    sync_unlock(&c->hdr->lock);
+
+    handle->data = NULL;
+    handle->size = 0;
+    handle->fd = -1;
+    handle->offset = 0;
+    handle->_slot = -1;
+}
+
+// Returns 1 loaded, 0 failed (errno set), -1 a nowait read would block
+static int shcache_load(shcache_t* c, const char* key, const char* abs_path, cache_handle_t* out, bool nowait) {
+    if (!c || !key || !abs_path || !out) {
+        errno = EINVAL;
+        return 0;
+    }
+    if (strlen(key) >= SHCACHE_KEY_MAX) {
+        errno = ENAMETOOLONG;
+        return 0;
+    }
+    if (!nowait && shcache_acquire(c, key, out)) {
+        return 1;
+    }
+
+    // Read outside the lock (it is shared by every worker)
+    uint8_t* buf = NULL;
+    size_t sz = 0;
+    int rd = cache_read_file(abs_path, &buf, &sz, nowait);
+    if (rd != 1) {
+        return rd;
+    }
+    uint32_t pages = sz ? (uint32_t)((sz + SHCACHE_PAGE - 1) / SHCACHE_PAGE) : 1;
+
+    shcache_lock(c);
+    shcache_header_t* h = c->hdr;
+
+    // Another worker may have loaded it meanwhile
+    if (acquire_locked(c, key, out)) {
+        sync_unlock(&h->lock);
+        free(buf);
+        return 1;
+    }
+
+    // Reserve an entry and a run of pages: evict until there are enough free pages, then search once
+    // (again only if they are fragmented)
+    int64_t first = -1;
+    if (pages <= h->npages) {
+        while (h->free_head < 0 || h->npages - h->pages_used < pages) {
+            if (!evict_one(c)) {
+                break; // Everything left is pinned
+            }
+        }
+        if (h->free_head >= 0 && h->npages - h->pages_used >= pages) {
+            first = find_free_run(c, pages);
+            while (first < 0 && evict_one(c)) {
+                first = find_free_run(c, pages); // Free pages are fragmented
+            }
+        }
+    }
+    if (first < 0) {
+        sync_unlock(&h->lock);
+        free(buf);
+        errno = (pages > h->npages) ? EFBIG : ENOSPC;
+        return 0;
+    }
+    int32_t i = h->free_head;
+    shcache_entry_t* e = &c->entries[i];
+    h->free_head = e->hnext;
+    e->first_page = (uint32_t)first;
+    e->pages = pages;
+    mark_pages(c, e->first_page, pages, 1);
+    sync_unlock(&h->lock);
+
+    // Copy outside the lock: the reserved run is not indexed, so no one else reads or writes it. Punching it
+    // first gives the body fresh pages; the old ones stay with any response still being sent from them.
+    size_t off = c->data_off + (size_t)e->first_page * SHCACHE_PAGE;
+    if (fallocate(c->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)off,
+                  (off_t)pages * SHCACHE_PAGE) != 0) {
+        perror("shcache: fallocate(PUNCH_HOLE)");
+    }
+    memcpy(c->base + off, buf, sz);
+    free(buf);
+
+    shcache_lock(c);
+
+    // Lost the race to another worker loading the same file: give the reservation back
+    if (acquire_locked(c, key, out)) {
+        mark_pages(c, e->first_page, pages, 0);
+        e->hnext = h->free_head;
+        h->free_head = i;
+        sync_unlock(&h->lock);
+        return 1;
+    }
+
+    memcpy(e->key, key, strlen(key) + 1);
+    e->size = sz;
+    e->refcnt = 1;
+    uint32_t b = bucket_of(c, key);
+    e->hnext = c->buckets[b];
+    c->buckets[b] = i;
+    lru_push_front(c, i);
+    h->items++;
+    h->bytes_used += sz;
+
+    fill_handle(c, i, out);
+    sync_unlock(&h->lock);
+    return 1;
+}
+
+bool shcache_load_file(shcache_t* c, const char* key, const char* abs_path, cache_handle_t* out) {
+    return shcache_load(c, key, abs_path, out, false) == 1;
+}
+
+int shcache_load_file_nowait(shcache_t* c, const char* key, const char* abs_path, cache_handle_t* out) {
+    return shcache_load(c, key, abs_path, out, true);
+}
+
+void shcache_stats(shcache_t* c, size_t* out_items, size_t* out_bytes, size_t* out_capacity,
+                   size_t* out_hits, size_t* out_misses, size_t* out_evictions) {
+    if (!c) {
+        return;
+    }
+    shcache_lock(c);
+    shcache_header_t* h = c->hdr;
+    if (out_items) *out_items = h->items;
+    if (out_bytes) *out_bytes = h->bytes_used;
+    if (out_capacity) *out_capacity = h->capacity;
+    if (out_hits) *out_hits = h->hits;
+    if (out_misses) *out_misses = h->misses;
+    if (out_evictions) *out_evictions = h->evictions;
+    sync_unlock(&h->lock);
+}
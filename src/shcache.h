@@ -0,0 +1,56 @@
+#ifndef SHCACHE_H
+#define SHCACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "cache.h" // cache_handle_t
+
+// ###############################################################################################################
+// Shared file cache (SHARED_CACHE_MB=<n> in server.conf)
+//
+// One cache for all workers instead of one per worker. The master creates it before forking: a memfd holding
+// the index and the file bodies, mapped MAP_SHARED, so every worker sees the same entries and a hot file is
+// held once per host. A hit is sent with sendfile() from the memfd (handle.fd / handle.offset), without
+// copying the body through user space.
+//
+//   index   shcache_header_t (robust process-shared mutex, LRU ends, counters), entry table, hash buckets,
+//           page bitmap
+//   data    file bodies, each in a run of SHCACHE_PAGE-sized pages
+//
+// Handles pin entries exactly like the per-worker cache: a pinned entry is never evicted or reused until
+// shcache_release(). Pins of a worker that dies are not returned (the entries stay until the server restarts).
+// sendfile() may return before the kernel has sent the pages, so a run is punched out of the memfd before it
+// is reused: a response still queued keeps the old pages and the new body gets fresh ones.
+// ###############################################################################################################
+
+#define SHCACHE_PAGE 4096 // Allocation unit of the data area
+#define SHCACHE_KEY_MAX 256 // Longest key (request path) + 1; longer paths are not cached
+
+// Opaque handle of the shared cache (process-local view of the mapping)
+typedef struct shcache shcache_t;
+
+// Creates a shared cache holding up to capacity_bytes of file data. Call before fork().
+// Returns NULL (reason on stderr) on failure.
+shcache_t* shcache_create(size_t capacity_bytes);
+
+// Unmaps the cache and closes the memfd (master, after the workers exited).
+void shcache_destroy(shcache_t* cache);
+
+// Same contract as cache_acquire(): pins the entry and fills out (out->fd >= 0). Returns true on a hit.
+bool shcache_acquire(shcache_t* cache, const char* key, cache_handle_t* out);
+
+// Unpins an entry acquired or loaded through this cache.
+void shcache_release(shcache_t* cache, cache_handle_t* handle);
+
+// Same contract as cache_load_file(): loads abs_path under key (or reuses the entry) and pins it.
+bool shcache_load_file(shcache_t* cache, const char* key, const char* abs_path, cache_handle_t* out);
+
+// Same contract as cache_load_file_nowait(): 1 loaded, -1 would block on the disk, 0 failed (errno set;
+// also ENAMETOOLONG for keys of SHCACHE_KEY_MAX bytes or more, ENOSPC when everything is pinned).
+int shcache_load_file_nowait(shcache_t* cache, const char* key, const char* abs_path, cache_handle_t* out);
+
+// Same as cache_stats(), for the whole host (any pointer can be NULL)
+void shcache_stats(shcache_t* cache, size_t* out_items, size_t* out_bytes, size_t* out_capacity,
+                   size_t* out_hits, size_t* out_misses, size_t* out_evictions);
+
+#endif // SHCACHE_H
@@ -1,5 +1,6 @@
 #include "stats.h"
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 
 long get_time_ms(){
@@ -8,55 +9,87 @@ long get_time_ms(){
     return (tv.tv_sec * 1000) + (tv.tv_usec/1000);
 }
 
-void update_stats(shared_data_t* shm, semaphores_t* sems, int status_code, long bytes, long time_taken_ms){
+long long get_time_us(){
+    // Monotonic and system-wide: comparable between the master and the workers
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int g_slot = -1; // Stats slot of this process (-1 = master, the last slot)
+
+void stats_set_slot(int slot){
+    g_slot = slot;
+}
+
+// Slot of the calling process
+static stats_slot_t* my_slot(shared_data_t* shm){
+    unsigned int last = shm->config.stats_slots - 1;
+    if (g_slot < 0 || (unsigned int)g_slot >= last) {
+        return shm_stats_slot(shm, last);
+    }
+    return shm_stats_slot(shm, (unsigned int)g_slot);
+}
 
+void update_stats(shared_data_t* shm, int status_code, long bytes, long time_taken_ms){
 
-    // Lock the stats mutex
-    sem_wait(sems->stats_mutex);
-    
-    // Update total bytes transferred
-    shm->stats.total_requests++; // Increment total requests
-    shm->stats.bytes_transferred += bytes; // Add bytes transferred
-    shm->stats.total_response_time_ms += time_taken_ms; // Add response time
+    // Only the threads of this process write to this slot: relaxed adds, no lock
+    stats_slot_t* st = my_slot(shm);
+
+    atomic_fetch_add_explicit(&st->total_requests, 1, memory_order_relaxed); // Increment total requests
+    atomic_fetch_add_explicit(&st->bytes_transferred, bytes, memory_order_relaxed); // Add bytes transferred
+    atomic_fetch_add_explicit(&st->total_response_time_ms, time_taken_ms, memory_order_relaxed); // Add response time
 
 
     // Update status code counts
     if(status_code == 200){ // HTTP 200 OK
-        shm->stats.status_200++; // Increment 200 count
+        atomic_fetch_add_explicit(&st->status_200, 1, memory_order_relaxed); // Increment 200 count
     } else if(status_code == 404){ // HTTP 404 Not Found
-        shm->stats.status_404++; // Increment 404 count
+        atomic_fetch_add_explicit(&st->status_404, 1, memory_order_relaxed); // Increment 404 count
     } else if(status_code == 500){ // HTTP 500 Internal Server Error
-        shm->stats.status_500++; // Increment 500 count
+        atomic_fetch_add_explicit(&st->status_500, 1, memory_order_relaxed); // Increment 500 count
     }
 
-    // Unlock the stats mutex
-    sem_post(sems->stats_mutex); // Release the lock
+}
+
+void stats_snapshot(shared_data_t* shm, server_stats_t* out){
 
+    memset(out, 0, sizeof(*out));
+
+    for (unsigned int i = 0; i < shm->config.stats_slots; i++) {
+        stats_slot_t* st = shm_stats_slot(shm, i);
+        out->total_requests += atomic_load_explicit(&st->total_requests, memory_order_relaxed);
+        out->bytes_transferred += atomic_load_explicit(&st->bytes_transferred, memory_order_relaxed);
+        out->status_200 += atomic_load_explicit(&st->status_200, memory_order_relaxed);
+        out->status_404 += atomic_load_explicit(&st->status_404, memory_order_relaxed);
+        out->status_500 += atomic_load_explicit(&st->status_500, memory_order_relaxed);
+        out->active_connections += atomic_load_explicit(&st->active_connections, memory_order_relaxed);
+        out->total_response_time_ms += atomic_load_explicit(&st->total_response_time_ms, memory_order_relaxed);
+    }
 }
 
-void print_stats(shared_data_t* shm, semaphores_t* sems){
+void print_stats(shared_data_t* shm){
 
-    sem_wait(sems->stats_mutex); // Lock the stats mutex
+    server_stats_t stats;
+    stats_snapshot(shm, &stats);
 
     // Calculate average response time
     double avg_time = 0; // Initialize average time
 
     // Check if total requests is greater than 0
-    if(shm -> stats.total_requests >0) {
+    if(stats.total_requests >0) {
         // Calculate average response time
-        avg_time = (double)shm->stats.total_response_time_ms / shm->stats.total_requests;
+        avg_time = (double)stats.total_response_time_ms / stats.total_requests;
     }
 
     printf("\n--- Server Statistics ---\n");
-    printf("Total Requests: %ld\n", shm->stats.total_requests);
-    printf("Bytes Transferred: %ld\n", shm->stats.bytes_transferred);
+    printf("Total Requests: %ld\n", stats.total_requests);
+    printf("Bytes Transferred: %ld\n", stats.bytes_transferred);
     printf("Average Response Time: %.2f ms\n", avg_time);
     printf("Status Code: [200: %ld] [404: %ld] [500: %ld]\n",
-           shm->stats.status_200,
-           shm->stats.status_404,
-           shm->stats.status_500);
+           stats.status_200,
+           stats.status_404,
+           stats.status_500);
     printf("-------------------------\n");
 
-    sem_post(sems->stats_mutex); // Release the lock
-
 }
\ No newline at end of file
@@ -5,22 +5,35 @@
 #include "semaphores.h"
 #include <time.h>
 
-// Update statistics based on a completed request
+// Select the stats slot this process writes to (worker id; the master keeps the last slot)
+// Arguments:
+// slot - Index of the slot
+void stats_set_slot(int slot);
+
+// Update statistics based on a completed request (lock-free, in this process's slot)
 // Arguments:
 // shm - Pointer to the shared memory structure
-// sems - Pointer to the semaphores structure
 // status_code - HTTP status code of the completed request
 // bytes - Number of bytes transferred in the request
 // time_taken_ms - Time taken to process the request in milliseconds
-void update_stats(shared_data_t* shm, semaphores_t* sems, int status_code, long bytes, long time_taken_ms);
+void update_stats(shared_data_t* shm, int status_code, long bytes, long time_taken_ms);
+
+// Sum the slots of every writer. Counters are read one by one, so a snapshot taken under load
+// may be off by the requests completing meanwhile.
+// Arguments:
+// shm - Pointer to the shared memory structure
+// out - Totals
+void stats_snapshot(shared_data_t* shm, server_stats_t* out);
 
 // Print current statistics to the console
 // Arguments:
 // shm - Pointer to the shared memory structure
-// sems - Pointer to the semaphores structure
-void print_stats(shared_data_t* shm, semaphores_t* sems);
+void print_stats(shared_data_t* shm);
 
 // Get current time in milliseconds
 long get_time_ms();
 
+// Get a monotonic timestamp in microseconds (same clock in every process)
+long long get_time_us();
+
 #endif
\ No newline at end of file
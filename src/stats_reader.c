@@ -6,21 +6,46 @@
 #include <unistd.h>
 #include <string.h>
 #include "shared_mem.h"
+#include "stats.h"
 
 // Simple utility to read and print server statistics from shared memory
 // This allows test scripts to verify statistics accuracy
+//
+// Usage: stats_reader [INSTANCE]
+//   INSTANCE -> the server's INSTANCE_NAME, or its PORT when it has none (default: 8080)
 
-int main(void) {
-    // Open the shared memory object (same name as used by the server)
-    int shm_fd = shm_open("/webserver_shm", O_RDONLY, 0666);
+int main(int argc, char* argv[]) {
+    const char* instance = (argc >= 2) ? argv[1] : "8080";
+    if (argc > 2 || instance[0] == '-') {
+        fprintf(stderr, "Usage: %s [INSTANCE_NAME|PORT]\n", argv[0]);
+        return 1;
+    }
+
+    // Open the shared memory object (same name as used by the server: a port and an
+    // INSTANCE_NAME made of digits map to the same name)
+    char name[SHM_NAME_MAX];
+    if (shm_instance_name(name, sizeof(name), instance, 0) != 0) {
+        fprintf(stderr, "Error: Invalid instance name '%s'\n", instance);
+        return 1;
+    }
+    int shm_fd = shm_open(name, O_RDONLY, 0666);
     
     if (shm_fd == -1) {
-        fprintf(stderr, "Error: Could not open shared memory. Is the server running?\n");
+        fprintf(stderr, "Error: Could not open shared memory %s. Is the server running?\n", name);
         return 1;
     }
     
+    // The segment is sized at runtime (queue rings, stats slots): map all of it
+    struct stat st;
+    if (fstat(shm_fd, &st) != 0 || (size_t)st.st_size < sizeof(shared_data_t)) {
+        fprintf(stderr, "Error: Shared memory segment is too small\n");
+        close(shm_fd);
+        return 1;
+    }
+    size_t map_size = (size_t)st.st_size;
+
     // Map the shared memory into this process's address space
-    shared_data_t* shm = mmap(NULL, sizeof(shared_data_t), PROT_READ, MAP_SHARED, shm_fd, 0);
+    shared_data_t* shm = mmap(NULL, map_size, PROT_READ, MAP_SHARED, shm_fd, 0);
     
     if (shm == MAP_FAILED) {
         fprintf(stderr, "Error: Could not map shared memory\n");
@@ -28,25 +53,78 @@ int main(void) {
         return 1;
     }
     
+    if (shm->config.segment_size > map_size) {
+        fprintf(stderr, "Error: Shared memory segment is truncated\n");
+        munmap(shm, map_size);
+        close(shm_fd);
+        return 1;
+    }
+
+    // Sum the per-worker slots
+    server_stats_t stats;
+    stats_snapshot(shm, &stats);
+
     // Read and print statistics in a parseable format
-    printf("total_requests=%ld\n", shm->stats.total_requests);
-    printf("bytes_transferred=%ld\n", shm->stats.bytes_transferred);
-    printf("status_200=%ld\n", shm->stats.status_200);
-    printf("status_404=%ld\n", shm->stats.status_404);
-    printf("status_500=%ld\n", shm->stats.status_500);
-    printf("active_connections=%d\n", shm->stats.active_connections);
-    printf("total_response_time_ms=%ld\n", shm->stats.total_response_time_ms);
+    printf("total_requests=%ld\n", stats.total_requests);
+    printf("bytes_transferred=%ld\n", stats.bytes_transferred);
+    printf("status_200=%ld\n", stats.status_200);
+    printf("status_404=%ld\n", stats.status_404);
+    printf("status_500=%ld\n", stats.status_500);
+    printf("active_connections=%d\n", stats.active_connections);
+    printf("total_response_time_ms=%ld\n", stats.total_response_time_ms);
+    printf("queue_pending=%u\n", shm->queue_pending);
+    printf("queue_capacity=%u\n", shm->queue_limit);
     
     // Calculate average response time if there are requests
-    if (shm->stats.total_requests > 0) {
-        long avg_response_time = shm->stats.total_response_time_ms / shm->stats.total_requests;
+    if (stats.total_requests > 0) {
+        long avg_response_time = stats.total_response_time_ms / stats.total_requests;
         printf("avg_response_time_ms=%ld\n", avg_response_time);
     } else {
         printf("avg_response_time_ms=0\n");
     }
+
+    // Busy polling of the master's accept loop (BUSY_POLL_US)
+    printf("master_spin_ms=%lld\n", atomic_load_explicit(&shm->master_spin.spin_us, memory_order_relaxed) / 1000);
+    printf("master_spin_hits=%ld\n", atomic_load_explicit(&shm->master_spin.spin_hits, memory_order_relaxed));
+    printf("master_spin_misses=%ld\n", atomic_load_explicit(&shm->master_spin.spin_misses, memory_order_relaxed));
+
+    // Worker health table
+    long long now = get_time_us();
+    printf("workers=%u\n", shm->config.num_workers);
+    for (unsigned int i = 0; i < shm->config.num_workers; i++) {
+        worker_health_t* h = shm_health(shm, i);
+        long long beat = atomic_load_explicit(&h->heartbeat_us, memory_order_relaxed);
+        printf("worker%u_pid=%d\n", i, atomic_load_explicit(&h->pid, memory_order_relaxed));
+        printf("worker%u_state=%s\n", i, worker_health_name(worker_health_state(h, now)));
+        printf("worker%u_heartbeat_age_ms=%lld\n", i, beat ? (now - beat) / 1000 : -1);
+        printf("worker%u_inflight=%d\n", i, atomic_load_explicit(&h->inflight, memory_order_relaxed));
+        printf("worker%u_pool_queued=%d\n", i, atomic_load_explicit(&h->pool_queued, memory_order_relaxed));
+        printf("worker%u_disk_queued=%d\n", i, atomic_load_explicit(&h->disk_queued, memory_order_relaxed));
+        printf("worker%u_disk_inline=%ld\n", i, atomic_load_explicit(&h->disk_inline, memory_order_relaxed));
+        printf("worker%u_disk_deferred=%ld\n", i, atomic_load_explicit(&h->disk_deferred, memory_order_relaxed));
+        printf("worker%u_disk_rejected=%ld\n", i, atomic_load_explicit(&h->disk_rejected, memory_order_relaxed));
+        long tuned = atomic_load_explicit(&h->sndbuf_tuned, memory_order_relaxed);
+        printf("worker%u_sndbuf_tuned=%ld\n", i, tuned);
+        printf("worker%u_sndbuf_avg_kb=%lld\n", i,
+               tuned ? atomic_load_explicit(&h->sndbuf_bytes, memory_order_relaxed) / tuned / 1024 : 0);
+        printf("worker%u_sndbuf_rtt_avg_us=%lld\n", i,
+               tuned ? atomic_load_explicit(&h->sndbuf_rtt_us, memory_order_relaxed) / tuned : 0);
+        // Spin time against the time spent serving requests
+        printf("worker%u_spin_ms=%lld\n", i, atomic_load_explicit(&h->spin.spin_us, memory_order_relaxed) / 1000);
+        printf("worker%u_spin_hits=%ld\n", i, atomic_load_explicit(&h->spin.spin_hits, memory_order_relaxed));
+        printf("worker%u_spin_misses=%ld\n", i, atomic_load_explicit(&h->spin.spin_misses, memory_order_relaxed));
+        printf("worker%u_request_ms=%ld\n", i,
+               atomic_load_explicit(&shm_stats_slot(shm, i)->total_response_time_ms, memory_order_relaxed));
+        // CPU locality of the connections (SO_INCOMING_CPU against the CPU that took them)
+        printf("worker%u_cpu=%d\n", i, atomic_load_explicit(&h->cpu, memory_order_relaxed));
+        printf("worker%u_conn_local=%ld\n", i, atomic_load_explicit(&h->conn_local, memory_order_relaxed));
+        printf("worker%u_conn_remote=%ld\n", i, atomic_load_explicit(&h->conn_remote, memory_order_relaxed));
+        printf("worker%u_cache_bytes=%lld\n", i, atomic_load_explicit(&h->cache_bytes, memory_order_relaxed));
+        printf("worker%u_last_error=%d\n", i, atomic_load_explicit(&h->last_error, memory_order_relaxed));
+    }
     
     // Clean up
-    munmap(shm, sizeof(shared_data_t));
+    munmap(shm, map_size);
     close(shm_fd);
     
     return 0;
@@ -0,0 +1,141 @@
+#define _GNU_SOURCE // sched_setaffinity, sched_getcpu, CPU_SET
+#include "steering.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // strcasecmp
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/filter.h> // struct sock_filter, SKF_AD_CPU, SKF_AD_RXHASH
+
+// Parse "auto" or a CPU list into cpus (ascending order of appearance). Returns the count, or -1.
+static int parse_cpu_list(const char* spec, int* cpus, int max) {
+    int n = 0;
+    if (strcasecmp(spec, "auto") == 0) {
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+            return -1;
+        }
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+            if (CPU_ISSET(c, &set)) {
+                cpus[n++] = c;
+            }
+        }
+        return n;
+    }
+
+    const char* p = spec;
+    while (*p) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        long hi = lo;
+        if (end == p) {
+            return -1;
+        }
+        if (*end == '-') {
+            const char* q = end + 1;
+            hi = strtol(q, &end, 10);
+            if (end == q) {
+                return -1;
+            }
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        for (long c = lo; c <= hi && n < max; c++) {
+            cpus[n++] = (int)c;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+int steering_assign_cpus(const char* spec, int num_workers, int* worker_cpu) {
+    int cpus[CPU_SETSIZE];
+    int n = parse_cpu_list(spec, cpus, CPU_SETSIZE);
+    if (n <= 0) {
+        fprintf(stderr, "MASTER: Invalid CPU_AFFINITY '%s' (auto, or a list such as 0-3,8)\n", spec);
+        return -1;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        // One CPU each while they last; beyond that contiguous blocks of workers per CPU
+        worker_cpu[i] = (num_workers <= n) ? cpus[i] : cpus[(long)i * n / num_workers];
+    }
+    return 0;
+}
+
+// Emit the choice of one of n reuseport indices by A (0 .. n-1): a JEQ/RET pair per index, the last one unconditional
+static void emit_choice(struct sock_filter* code, size_t* len, const int* index, int n) {
+    for (int j = 0; j < n - 1; j++) {
+        code[(*len)++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned)j, 0, 1);
+        code[(*len)++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (unsigned)index[j]);
+    }
+    code[(*len)++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (unsigned)index[n - 1]);
+}
+
+int steering_attach(int fd, const int* worker_cpu, const int* targets, int num_workers) {
+    int* chosen = calloc((size_t)num_workers, sizeof(int)); // Targets, in worker order
+    int nchosen = 0;
+    for (int w = 0; chosen && w < num_workers; w++) {
+        if (!targets || targets[w]) {
+            chosen[nchosen++] = w;
+        }
+    }
+    // Per CPU: a JEQ, a JA over its block, the flow hash (2) and 2 per target; plus the load and the fallback
+    size_t max_len = 2 + 7 * (size_t)num_workers;
+    struct sock_filter* code = calloc(max_len, sizeof(*code));
+    if (!chosen || !code || nchosen == 0) {
+        free(chosen);
+        free(code);
+        errno = chosen && code ? EINVAL : ENOMEM;
+        return -1;
+    }
+
+    size_t len = 0;
+    code[len++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU); // A = CPU
+    for (int c = 0; c < nchosen;) {
+        int k = 1; // Targets chosen[c .. c + k) share this CPU (assigned contiguously)
+        while (c + k < nchosen && worker_cpu[chosen[c + k]] == worker_cpu[chosen[c]]) {
+            k++;
+        }
+        code[len++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned)worker_cpu[chosen[c]], 1, 0);
+        size_t skip = len++; // JA past the block (A still holds the CPU), patched below
+        if (k > 1) {
+            code[len++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_RXHASH);
+            code[len++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (unsigned)k);
+        }
+        emit_choice(code, &len, &chosen[c], k);
+        code[skip] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JA, (unsigned)(len - skip - 1), 0, 0);
+        c += k;
+    }
+    // A CPU without a target (A still holds the CPU)
+    if (nchosen > 1) {
+        code[len++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (unsigned)nchosen);
+    }
+    emit_choice(code, &len, chosen, nchosen);
+
+    struct sock_fprog prog = { .len = (unsigned short)len, .filter = code };
+    int rc = setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    int err = errno;
+    free(chosen);
+    free(code);
+    errno = err;
+    return rc;
+}
+
+int steering_pin(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+int steering_incoming_local(int fd) {
+    int incoming = -1;
+    socklen_t len = sizeof(incoming);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming, &len) != 0 || incoming < 0) {
+        return -1;
+    }
+    return incoming == sched_getcpu();
+}
@@ -0,0 +1,36 @@
+#ifndef STEERING_H
+#define STEERING_H
+
+// ###################################################################################################################
+// CPU-affine connection steering (CPU_AFFINITY=auto | <cpu list> in server.conf)
+//
+// Each worker is pinned to one CPU and accepts on its own member of an SO_REUSEPORT group per TCP listener.
+// A classic BPF program attached to the group (SO_ATTACH_REUSEPORT_CBPF) picks the member by the CPU that
+// processed the SYN, so a connection is accepted and served on the CPU that already has its socket state in
+// cache. With a multi-queue NIC that CPU follows the RSS / IRQ affinity of the receive queue; on loopback it is
+// the CPU the client sent from.
+//
+// Workers get CPUs from the list in order. With more workers than CPUs each CPU gets a contiguous block of
+// workers and the program spreads that CPU's connections over the block by flow hash; connections arriving on a
+// CPU without a worker go to the (cpu % n)-th of the n workers taking connections. The master keeps every member
+// open, so a group's indices stay in worker order when a worker exits, and reattaches the program without the
+// workers it would not dispatch to.
+// ###################################################################################################################
+
+// Maps workers to CPUs: spec is "auto" (the CPUs this process may run on) or a list such as "0-3,8,10".
+// Fills worker_cpu[0 .. num_workers-1]. Returns 0, or -1 (reason on stderr) for an invalid or empty list.
+int steering_assign_cpus(const char* spec, int num_workers, int* worker_cpu);
+
+// Attaches (or replaces) the steering program of the reuseport group of fd, whose members were created in worker
+// order. Only workers with targets[w] != 0 get connections (targets NULL: all of them; none: EINVAL).
+// Returns 0, or -1 with errno set.
+int steering_attach(int fd, const int* worker_cpu, const int* targets, int num_workers);
+
+// Pins the calling process (and the threads it creates afterwards) to cpu. Returns 0, or -1 with errno set.
+int steering_pin(int cpu);
+
+// 1 when the packets of connection fd are processed on the calling thread's CPU (SO_INCOMING_CPU),
+// 0 when on another CPU, -1 when unknown (not TCP, or no packet seen yet)
+int steering_incoming_local(int fd);
+
+#endif // STEERING_H
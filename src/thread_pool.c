@@ -1,19 +1,22 @@
+#define _GNU_SOURCE // gettid
 #include "thread_pool.h"
 #include "stats.h"
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <strings.h>   // strcasecmp
 #include <stdio.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <sys/socket.h>
 #include <errno.h>     // Required for EWOULDBLOCK/EAGAIN
+#include <arpa/inet.h> // inet_ntop
+#include <sys/un.h>    // AF_UNIX peers
 #include "worker.h"    // worker_get_cache(), worker_get_document_root()
 #include "cache.h"     // file_cache_t (Feature 4: cache per worker)
+#include "shcache.h"   // shcache_t (SHARED_CACHE_MB: one cache for all workers)
 #include "logger.h"    // logger_write (Feature 5: thread-safe/process-safe logging)
 #include "http_parser.h" // Shared definition of http_request_t
-#include "http_builder.h" // send_http_partial_response
+#include "http_builder.h" // send_content, mime_type_from_path, send_error_response
 
 // ----------------------------------------------------------------------------------------
 // Forward declarations
@@ -26,105 +29,303 @@
 // void send_http_response(...) // Now in header
 
 // ----------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------
-// Helper: Determine MIME type based on file extension for HTTP responses
-// ----------------------------------------------------------------------------------------
-static const char* mime_type_from_path(const char* path) {
-    const char* ext = strrchr(path, '.');
-    if (!ext) return "application/octet-stream";
-    ext++;
-    if (!strcasecmp(ext, "html")) return "text/html";
-    if (!strcasecmp(ext, "htm")) return "text/html";
-    if (!strcasecmp(ext, "css")) return "text/css";
-    if (!strcasecmp(ext, "js")) return "application/javascript";
-    if (!strcasecmp(ext, "png")) return "image/png";
-    if (!strcasecmp(ext, "jpg")) return "image/jpeg";
-    if (!strcasecmp(ext, "jpeg")) return "image/jpeg";
-    if (!strcasecmp(ext, "gif")) return "image/gif";
-    if (!strcasecmp(ext, "svg")) return "image/svg+xml";
-    if (!strcasecmp(ext, "json")) return "application/json";
-    return "application/octet-stream";
-}
-
 // Helper: Validate path to prevent directory traversal attacks
 static int is_path_safe(const char* path) {
     if (strstr(path, "..") != NULL) return 0;
     return 1;
 }
 
-// Helper: Handle sending content (full or partial)
-static void send_content(int client_fd, const char* content_type, const char* data, size_t total_size, 
-                         http_request_t* req, int keep_alive, int is_head_request, 
-                         int* status_code, int* bytes_sent) {
-    
-    long start = 0;
-    long end = total_size - 1;
-    int is_partial = 0;
-
-    // Parse Range header if present
-    if (req->range[0] != '\0') {
-        if (strncasecmp(req->range, "bytes=", 6) == 0) {
-            char* range_val = req->range + 6;
-            char* dash = strchr(range_val, '-');
-            if (dash) {
-                *dash = '\0';
-                const char* start_str = range_val;
-                const char* end_str = dash + 1;
-                
-                long req_start = -1, req_end = -1;
-                if (*start_str) req_start = atol(start_str);
-                if (*end_str) req_end = atol(end_str);
-                
-                // Restore dash for logging/debugging if needed
-                *dash = '-';
-
-                if (req_start != -1 && req_end != -1) {
-                    start = req_start;
-                    end = req_end;
-                } else if (req_start != -1) {
-                    start = req_start;
-                    end = total_size - 1;
-                } else if (req_end != -1) {
-                    start = total_size - req_end;
-                    end = total_size - 1;
-                }
-                is_partial = 1;
-            }
-        }
+// ###################################################################################################################
+// Request accounting: statistics and access log entry of one connection
+// ###################################################################################################################
+
+// Timing and cache outcome of the request being handled
+typedef struct {
+    const conn_info_t* conn; // Peer address and accept time from the master
+    long long start_us; // get_time_us() when this thread picked the connection up
+    int cache; // LOG_CACHE_* outcome of the file lookup
+} request_ctx_t;
+
+// Kernel thread id of the calling thread (cached)
+static int current_tid(void) {
+    static __thread int tid = 0;
+    if (tid == 0) {
+        tid = (int)gettid();
     }
+    return tid;
+}
 
-    // Validate range
-    if (is_partial && (start < 0 || end >= (long)total_size || start > end)) {
-        send_error_response(client_fd, 416, "Range Not Satisfiable", keep_alive);
-        *status_code = 416;
-        *bytes_sent = 0;
-        return;
+// Text form of the peer address captured at accept
+static void format_peer(const conn_info_t* conn, char* out, size_t cap) {
+    const struct sockaddr* sa = (const struct sockaddr*)&conn->peer;
+    if (conn->peer_len == 0) {
+        snprintf(out, cap, "-");
+    } else if (sa->sa_family == AF_INET) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in*)sa)->sin_addr, out, (socklen_t)cap);
+    } else if (sa->sa_family == AF_INET6) {
+        inet_ntop(AF_INET6, &((const struct sockaddr_in6*)sa)->sin6_addr, out, (socklen_t)cap);
+    } else if (sa->sa_family == AF_UNIX) {
+        snprintf(out, cap, "unix");
+    } else {
+        snprintf(out, cap, "-");
     }
+}
 
-    if (is_partial) {
-        size_t chunk_len = end - start + 1;
-        if (!is_head_request) {
-            send_http_partial_response(client_fd, content_type, data + start, chunk_len, start, end, total_size, keep_alive);
-        } else {
-            // For HEAD partial, we still send 206 headers but no body
-            send_http_partial_response(client_fd, content_type, NULL, chunk_len, start, end, total_size, keep_alive);
-        }
-        *status_code = 206;
-        *bytes_sent = chunk_len;
+// Update the shared statistics and queue the access log entry
+static void finish_request(const request_ctx_t* ctx, shared_data_t* shm,
+                           const char* method, const char* path, int status_code, int bytes_sent) {
+    long long end_us = get_time_us();
+    long duration_ms = (long)((end_us - ctx->start_us) / 1000);
+
+    update_stats(shm, status_code, bytes_sent, duration_ms);
+
+    // Times relative to accept; without an accept time they start when this thread took over
+    long long origin = ctx->conn->accept_us ? ctx->conn->accept_us : ctx->start_us;
+    long long first_byte = http_response_first_byte_us();
+
+    log_ext_t ext;
+    ext.total_us = end_us - origin;
+    ext.wait_us = ctx->start_us - origin;
+    ext.ttfb_us = first_byte ? first_byte - origin : 0;
+    ext.wire_bytes = http_response_wire_bytes();
+    ext.worker_id = worker_get_id();
+    ext.tid = current_tid();
+    ext.cache = ctx->cache;
+
+    char ip[INET6_ADDRSTRLEN];
+    format_peer(ctx->conn, ip, sizeof(ip));
+
+    logger_write_ext(ip, method, path, status_code, (size_t)bytes_sent, duration_ms, &ext);
+
+    // Send buffer sized for this response (SNDBUF_MAX_KB)
+    long rtt_us;
+    int sndbuf = http_response_sndbuf(&rtt_us);
+    worker_health_t* health = worker_get_health();
+    if (sndbuf > 0 && health) {
+        atomic_fetch_add_explicit(&health->sndbuf_tuned, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&health->sndbuf_bytes, sndbuf, memory_order_relaxed);
+        atomic_fetch_add_explicit(&health->sndbuf_rtt_us, rtt_us, memory_order_relaxed);
+    }
+}
+
+// Append the worker health table (JSON objects, comma separated) at json + len; returns the new length
+static int append_workers_json(char* json, size_t cap, int len, shared_data_t* shm) {
+    long long now = get_time_us();
+    for (unsigned int i = 0; i < shm->config.num_workers && len < (int)cap; i++) {
+        worker_health_t* h = shm_health(shm, i);
+        long long beat = atomic_load_explicit(&h->heartbeat_us, memory_order_relaxed);
+        long tuned = atomic_load_explicit(&h->sndbuf_tuned, memory_order_relaxed);
+        len += snprintf(json + len, cap - (size_t)len,
+            "%s{\"id\":%u,\"pid\":%d,\"state\":\"%s\",\"heartbeat_age_ms\":%lld,"
+            "\"inflight\":%d,\"pool_queued\":%d,\"disk_queued\":%d,\"disk_inline\":%ld,"
+            "\"disk_deferred\":%ld,\"disk_rejected\":%ld,\"sndbuf_tuned\":%ld,\"sndbuf_avg_kb\":%lld,"
+            "\"sndbuf_rtt_avg_us\":%lld,\"spin_ms\":%lld,\"spin_hits\":%ld,\"spin_misses\":%ld,\"request_ms\":%ld,"
+            "\"cpu\":%d,\"conn_local\":%ld,\"conn_remote\":%ld,\"cache_bytes\":%lld,\"last_error\":%d}",
+            i ? "," : "", i,
+            atomic_load_explicit(&h->pid, memory_order_relaxed),
+            worker_health_name(worker_health_state(h, now)),
+            beat ? (now - beat) / 1000 : -1,
+            atomic_load_explicit(&h->inflight, memory_order_relaxed),
+            atomic_load_explicit(&h->pool_queued, memory_order_relaxed),
+            atomic_load_explicit(&h->disk_queued, memory_order_relaxed),
+            atomic_load_explicit(&h->disk_inline, memory_order_relaxed),
+            atomic_load_explicit(&h->disk_deferred, memory_order_relaxed),
+            atomic_load_explicit(&h->disk_rejected, memory_order_relaxed),
+            tuned,
+            tuned ? atomic_load_explicit(&h->sndbuf_bytes, memory_order_relaxed) / tuned / 1024 : 0,
+            tuned ? atomic_load_explicit(&h->sndbuf_rtt_us, memory_order_relaxed) / tuned : 0,
+            atomic_load_explicit(&h->spin.spin_us, memory_order_relaxed) / 1000,
+            atomic_load_explicit(&h->spin.spin_hits, memory_order_relaxed),
+            atomic_load_explicit(&h->spin.spin_misses, memory_order_relaxed),
+            atomic_load_explicit(&shm_stats_slot(shm, i)->total_response_time_ms, memory_order_relaxed),
+            atomic_load_explicit(&h->cpu, memory_order_relaxed),
+            atomic_load_explicit(&h->conn_local, memory_order_relaxed),
+            atomic_load_explicit(&h->conn_remote, memory_order_relaxed),
+            atomic_load_explicit(&h->cache_bytes, memory_order_relaxed),
+            atomic_load_explicit(&h->last_error, memory_order_relaxed));
+    }
+    return len;
+}
+
+// ###################################################################################################################
+// File cache: the worker's own LRU cache, or the cache shared by all workers (SHARED_CACHE_MB)
+// ###################################################################################################################
+
+static bool cached_acquire(const char* key, cache_handle_t* h) {
+    shcache_t* shared = worker_get_shared_cache();
+    return shared ? shcache_acquire(shared, key, h) : cache_acquire(worker_get_cache(), key, h);
+}
+
+static int cached_load_nowait(const char* key, const char* abs_path, cache_handle_t* h) {
+    shcache_t* shared = worker_get_shared_cache();
+    return shared ? shcache_load_file_nowait(shared, key, abs_path, h)
+                  : cache_load_file_nowait(worker_get_cache(), key, abs_path, h);
+}
+
+static bool cached_load(const char* key, const char* abs_path, cache_handle_t* h) {
+    shcache_t* shared = worker_get_shared_cache();
+    return shared ? shcache_load_file(shared, key, abs_path, h) : cache_load_file(worker_get_cache(), key, abs_path, h);
+}
+
+static void cached_release(cache_handle_t* h) {
+    if (h->fd >= 0) {
+        shcache_release(worker_get_shared_cache(), h);
     } else {
-        send_http_response_with_body_flag(client_fd, 200, "OK", content_type, data, total_size, !is_head_request, keep_alive);
+        cache_release(worker_get_cache(), h);
+    }
+}
+
+// Unpin a cache handle (http_response_finish() calls it once the kernel no longer reads the body)
+static void release_handle(void* pin) {
+    cached_release((cache_handle_t*)pin);
+}
+
+// Send a cached file: whole files from the shared cache go out with sendfile(), everything else from memory
+static void send_cached(int fd, const cache_handle_t* h, const char* relpath, const http_request_t* req,
+                        int is_head, int* status_code, int* bytes_sent) {
+    const char* content_type = mime_type_from_path(relpath);
+    if (h->fd >= 0 && req->range[0] == '\0') {
+        send_file_response(fd, content_type, h->fd, h->offset, h->size, 0, is_head);
         *status_code = 200;
-        *bytes_sent = total_size;
+        *bytes_sent = (int)h->size;
+    } else {
+        send_content(fd, content_type, (const char*)h->data, h->size, req, 0, is_head, status_code, bytes_sent);
     }
 }
 
+// ###################################################################################################################
+// Cache misses: read from the page cache on the request thread, from the disk on the disk I/O pool
+// ###################################################################################################################
+
+// Outcome of load_file()
+enum { LOAD_CACHED, LOAD_BUFFER, LOAD_NOT_FOUND, LOAD_FORBIDDEN, LOAD_ERROR };
+
+// A request whose file missed the cache. Filled by the request thread that parsed it, read by load_file()
+// (on a disk I/O thread, or inline without a disk pool), answered by send_loaded_file() on a request thread.
+typedef struct file_load {
+    disk_job_t job; // First member: queued by the disk I/O pool
+    thread_pool_t* pool; // Request threads that send the response
+    int client_fd;
+    conn_info_t conn;
+    long long start_us; // When a request thread first took the connection
+    http_request_t req;
+    int is_head;
+    char relpath[512]; // Cache key
+    char abs_path[1024];
+
+    int result; // LOAD_*
+    cache_handle_t h; // LOAD_CACHED: pinned cache entry
+    char* buf; // LOAD_BUFFER: file too large for the cache (malloc'd)
+    size_t size;
+} file_load_t;
+
+static void thread_pool_resume(thread_pool_t* pool, file_load_t* load);
+static void thread_pool_enqueue(thread_pool_t* pool, job_t* job);
+
+// Read the file into the cache, or into a private buffer when it is too large to cache. May block on the disk.
+static void load_file(file_load_t* load) {
+    load->buf = NULL;
+    if (cached_load(load->relpath, load->abs_path, &load->h)) {
+        load->result = LOAD_CACHED;
+        return;
+    }
+    if (access(load->abs_path, F_OK) != 0) {
+        load->result = LOAD_NOT_FOUND;
+        return;
+    }
+
+    load->result = LOAD_ERROR;
+    struct stat st;
+    if (stat(load->abs_path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    FILE* f = fopen(load->abs_path, "rb");
+    if (!f) {
+        // Permission denied - 403 Forbidden; other errors - 500
+        load->result = (errno == EACCES) ? LOAD_FORBIDDEN : LOAD_ERROR;
+        return;
+    }
+    size_t file_size = (size_t)st.st_size;
+    char* buf = malloc(file_size ? file_size : 1);
+    if (buf && fread(buf, 1, file_size, f) == file_size) {
+        load->buf = buf;
+        load->size = file_size;
+        load->result = LOAD_BUFFER;
+    } else {
+        free(buf);
+    }
+    fclose(f);
+}
+
+// Unpin or free the body of a file_load_t and free it; pin points at the load pointer (http_response_finish())
+static void release_load(void* pin) {
+    file_load_t* load = *(file_load_t**)pin;
+    if (load->result == LOAD_CACHED) {
+        cached_release(&load->h);
+    }
+    free(load->buf);
+    free(load);
+}
+
+// Send the response for a finished load_file(), account for it and close the connection. Frees load (once the
+// body was sent).
+static void send_loaded_file(file_load_t* load, shared_data_t* shm) {
+    request_ctx_t ctx = { .conn = &load->conn, .start_us = load->start_us, .cache = LOG_CACHE_NONE };
+    int fd = load->client_fd;
+    int status_code = 500;
+    int bytes_sent = 0;
+    const char* content_type = mime_type_from_path(load->relpath);
+
+    switch (load->result) {
+    case LOAD_CACHED:
+        ctx.cache = LOG_CACHE_MISS;
+        send_cached(fd, &load->h, load->relpath, &load->req, load->is_head, &status_code, &bytes_sent);
+        break;
+    case LOAD_BUFFER:
+        ctx.cache = LOG_CACHE_BYPASS;
+        send_content(fd, content_type, load->buf, load->size, &load->req, 0, load->is_head,
+                     &status_code, &bytes_sent);
+        break;
+    case LOAD_NOT_FOUND:
+        send_error_response(fd, 404, "Not Found", 0);
+        status_code = 404;
+        break;
+    case LOAD_FORBIDDEN:
+        send_error_response(fd, 403, "Forbidden", 0);
+        status_code = 403;
+        break;
+    default:
+        send_error_response(fd, 500, "Internal Server Error", 0);
+        status_code = 500;
+        break;
+    }
+
+    finish_request(&ctx, shm, load->req.method, load->req.path, status_code, bytes_sent);
+    http_response_finish(fd, release_load, &load, sizeof(load));
+}
+
+// Disk I/O thread: read the file, then hand the request back to the request threads (no socket I/O here)
+static void run_file_load(disk_job_t* job) {
+    file_load_t* load = (file_load_t*)job;
+    load_file(load);
+    thread_pool_resume(load->pool, load);
+}
+
+// Drop a load that will never be sent (shutdown)
+static void discard_file_load(file_load_t* load) {
+    close(load->client_fd);
+    release_load(&load);
+}
+
 // ###################################################################################################################
 // FEATURE 2 + 4 + 5 + Keep-Alive: HTTP Handler with LRU Cache and Logging
 // ###################################################################################################################
 
-void handle_client_request(int client_fd, shared_data_t* shm, semaphores_t* sems){
-    
-    long start_time = get_time_ms(); 
+void handle_client_request(thread_pool_t* pool, int client_fd, const conn_info_t* conn){
+    shared_data_t* shm = pool->shm;
+    request_ctx_t ctx = { .conn = conn, .start_us = get_time_us(), .cache = LOG_CACHE_NONE };
+    http_response_begin();
+    http_tune_connection(client_fd); // TCP_NODELAY, TCP_NOTSENT_LOWAT
 
     char buffer[8192]; 
     int bytes_sent = 0; 
@@ -168,9 +369,7 @@ void handle_client_request(int client_fd, shared_data_t* shm, semaphores_t* sems
         send_error_response(client_fd, 400, "Bad Request", 0);
         status_code = 400;
         bytes_sent = 0;
-        long end_time = get_time_ms(); 
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time); 
-        logger_write("127.0.0.1", "?", "?", status_code, (size_t)bytes_sent, end_time - start_time);
+        finish_request(&ctx, shm, "?", "?", status_code, bytes_sent);
         close(client_fd);
         return;
     }
@@ -180,40 +379,43 @@ void handle_client_request(int client_fd, shared_data_t* shm, semaphores_t* sems
         send_error_response(client_fd, 405, "Method Not Allowed", 0);
         status_code = 405;
         bytes_sent = 0;
-        long end_time = get_time_ms(); 
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time); 
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
+        finish_request(&ctx, shm, req.method, req.path, status_code, bytes_sent);
         close(client_fd);
         return;
     }
 
     // BONUS FEATURE: Real-time Dashboard API endpoint
     if (strcmp(req.path, "/api/stats") == 0) {
-        // Read stats from shared memory (thread-safe)
-        sem_wait(sems->stats_mutex);
-        long total_reqs = shm->stats.total_requests;
-        long bytes_trans = shm->stats.bytes_transferred;
-        long s200 = shm->stats.status_200;
-        long s404 = shm->stats.status_404;
-        long s500 = shm->stats.status_500;
-        long total_time = shm->stats.total_response_time_ms;
-        int active = shm->stats.active_connections;
-        sem_post(sems->stats_mutex);
+        // Sum the per-worker stats slots in shared memory
+        server_stats_t stats;
+        stats_snapshot(shm, &stats);
+        long total_reqs = stats.total_requests;
+        long bytes_trans = stats.bytes_transferred;
+        long s200 = stats.status_200;
+        long s404 = stats.status_404;
+        long s500 = stats.status_500;
+        long total_time = stats.total_response_time_ms;
+        int active = stats.active_connections;
         
         // Calculate average response time
         double avg_time = (total_reqs > 0) ? (double)total_time / total_reqs : 0.0;
         
         // Get cache stats
         file_cache_t* cache = worker_get_cache();
+        shcache_t* shared = worker_get_shared_cache();
         size_t cache_items = 0, cache_bytes = 0, cache_capacity = 0;
         size_t cache_hits = 0, cache_misses = 0, cache_evictions = 0;
-        if (cache) {
+        if (shared) {
+            // One cache for the whole server
+            shcache_stats(shared, &cache_items, &cache_bytes, &cache_capacity,
+                          &cache_hits, &cache_misses, &cache_evictions);
+        } else if (cache) {
             cache_stats(cache, &cache_items, &cache_bytes, &cache_capacity, 
                        &cache_hits, &cache_misses, &cache_evictions);
         }
         
         // Build JSON response
-        char json[2048];
+        char json[8192];
         int json_len = snprintf(json, sizeof(json),
             "{"
             "\"total_requests\":%ld,"
@@ -234,22 +436,30 @@ void handle_client_request(int client_fd, shared_data_t* shm, semaphores_t* sems
                 "\"evictions\":%zu,"
                 "\"hit_rate\":%.2f"
             "},"
-            "\"uptime_info\":\"Running\""
-            "}",
+            "\"master_spin\":{\"spin_ms\":%lld,\"spin_hits\":%ld,\"spin_misses\":%ld},"
+            "\"workers\":[",
             total_reqs, bytes_trans, active, avg_time,
             s200, s404, s500,
             cache_items, cache_bytes, cache_capacity,
             cache_hits, cache_misses, cache_evictions,
             (cache_hits + cache_misses > 0) ? 
-                (double)cache_hits / (cache_hits + cache_misses) * 100.0 : 0.0
+                (double)cache_hits / (cache_hits + cache_misses) * 100.0 : 0.0,
+            atomic_load_explicit(&shm->master_spin.spin_us, memory_order_relaxed) / 1000,
+            atomic_load_explicit(&shm->master_spin.spin_hits, memory_order_relaxed),
+            atomic_load_explicit(&shm->master_spin.spin_misses, memory_order_relaxed)
         );
+        json_len = append_workers_json(json, sizeof(json), json_len, shm);
+        if (json_len < (int)sizeof(json)) {
+            json_len += snprintf(json + json_len, sizeof(json) - (size_t)json_len, "],\"uptime_info\":\"Running\"}");
+        }
+        if (json_len >= (int)sizeof(json)) {
+            json_len = (int)sizeof(json) - 1; // Truncated (too many workers for the buffer)
+        }
         
         send_http_response(client_fd, 200, "OK", "application/json", json, json_len, 0);
         status_code = 200;
         bytes_sent = json_len;
-        long end_time = get_time_ms();
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time);
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
+        finish_request(&ctx, shm, req.method, req.path, status_code, bytes_sent);
         close(client_fd);
         return;
     }
@@ -261,93 +471,102 @@ void handle_client_request(int client_fd, shared_data_t* shm, semaphores_t* sems
         send_error_response(client_fd, 403, "Forbidden", 0);
         status_code = 403;
         bytes_sent = 0;
-        long end_time = get_time_ms();
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time);
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
+        finish_request(&ctx, shm, req.method, req.path, status_code, bytes_sent);
         close(client_fd);
         return;
     }
 
-    char abs_path[1024];
-    snprintf(abs_path, sizeof(abs_path), "%s%s", docroot, relpath);
+    // DOCPACK: the bundle is the document root; no file system access, no cache
+    const docpack_t* pack = worker_get_docpack();
+    if (pack) {
+        docpack_file_t pf;
+        if (docpack_lookup(pack, relpath, req.accept_gzip && req.range[0] == '\0', &pf)) {
+            ctx.cache = LOG_CACHE_PACK;
+            send_packed_file(client_fd, &pf, &req, 0, is_head_request, &status_code, &bytes_sent);
+        } else {
+            send_error_response(client_fd, 404, "Not Found", 0);
+            status_code = 404;
+            bytes_sent = 0;
+        }
+        finish_request(&ctx, shm, req.method, req.path, status_code, bytes_sent);
+        http_response_finish(client_fd, NULL, NULL, 0); // The bundle is mapped for the life of the worker
+        return;
+    }
 
-    file_cache_t* cache = worker_get_cache();
     cache_handle_t h;
 
-    if (cache_acquire(cache, relpath, &h)){
-        const char* content_type = mime_type_from_path(relpath);
-        
-        // Use helper to handle range/full content
-        send_content(client_fd, content_type, (const char*)h.data, h.size, &req, 0, is_head_request, &status_code, &bytes_sent);
+    if (cached_acquire(relpath, &h)){
+        ctx.cache = LOG_CACHE_HIT;
 
-        cache_release(cache, &h);
+        // Use helper to handle range/full content
+        send_cached(client_fd, &h, relpath, &req, is_head_request, &status_code, &bytes_sent);
 
-        long end_time = get_time_ms(); 
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time); 
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
+        finish_request(&ctx, shm, req.method, req.path, status_code, bytes_sent);
+        http_response_finish(client_fd, release_handle, &h, sizeof(h)); // Unpins once the body was sent
+        return;
     }
-    else if (access(abs_path, F_OK) != 0){
-        send_error_response(client_fd, 404, "Not Found", 0);
-        status_code = 404;
-        bytes_sent = 0;
-        long end_time = get_time_ms(); 
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time); 
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
-    }
-    else if (!cache_load_file(cache, relpath, abs_path, &h)){
-        struct stat st;
-        if (stat(abs_path, &st) == 0 && S_ISREG(st.st_mode)) {
-            size_t file_size = st.st_size;
-            const char* content_type = mime_type_from_path(relpath);
-            
-            FILE *f = fopen(abs_path, "rb");
-            if (f) {
-                char *tmp_buf = malloc(file_size);
-                if (tmp_buf && fread(tmp_buf, 1, file_size, f) == file_size) {
-                    // Use helper to handle range/full content
-                    send_content(client_fd, content_type, tmp_buf, file_size, &req, 0, is_head_request, &status_code, &bytes_sent);
-                } else {
-                    send_error_response(client_fd, 500, "Internal Server Error", 0);
-                    status_code = 500;
-                }
-                if(tmp_buf) free(tmp_buf);
-                fclose(f);
-            } else {
-                // Check errno to determine the type of error
-                if (errno == EACCES) {
-                    // Permission denied - return 403 Forbidden
-                    send_error_response(client_fd, 403, "Forbidden", 0);
-                    status_code = 403;
-                    bytes_sent = 0;
-                } else {
-                    // Other errors (e.g., memory allocation failure) - return 500
-                    send_error_response(client_fd, 500, "Internal Server Error", 0);
-                    status_code = 500;
-                    bytes_sent = 0;
-                }
-            }
-        } else {
-            send_error_response(client_fd, 500, "Internal Server Error", 0);
-            status_code = 500;
+
+    char abs_path[1024];
+    snprintf(abs_path, sizeof(abs_path), "%s%s", docroot, relpath);
+
+    // Miss: read it here only if the whole file is in the page cache, so this thread never waits for the disk
+    int rc = cached_load_nowait(relpath, abs_path, &h);
+    int err = errno;
+    worker_health_t* health = pool->health;
+    if (rc == 1) {
+        ctx.cache = LOG_CACHE_MISS;
+        send_cached(client_fd, &h, relpath, &req, is_head_request, &status_code, &bytes_sent);
+        if (health) {
+            atomic_fetch_add_explicit(&health->disk_inline, 1, memory_order_relaxed);
         }
-        long end_time = get_time_ms(); 
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time); 
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
+        finish_request(&ctx, shm, req.method, req.path, status_code, bytes_sent);
+        http_response_finish(client_fd, release_handle, &h, sizeof(h));
+        return;
     }
-    else {
-        const char* content_type = mime_type_from_path(relpath);
-        
-        // Use helper to handle range/full content
-        send_content(client_fd, content_type, (const char*)h.data, h.size, &req, 0, is_head_request, &status_code, &bytes_sent);
-
-        cache_release(cache, &h);
 
-        long end_time = get_time_ms(); 
-        update_stats(shm, sems, status_code, bytes_sent, end_time - start_time); 
-        logger_write("127.0.0.1", req.method, req.path, status_code, (size_t)bytes_sent, end_time - start_time);
+    // Not in memory (or too large to cache): load_file() + send_loaded_file(), on the disk I/O pool when
+    // there is one. Missing files are answered here: that costs no disk read.
+    file_load_t* load = malloc(sizeof(*load));
+    if (!load) {
+        send_error_response(client_fd, 500, "Internal Server Error", 0);
+        finish_request(&ctx, shm, req.method, req.path, 500, 0);
+        close(client_fd);
+        return;
+    }
+    load->job.run = run_file_load;
+    load->pool = pool;
+    load->client_fd = client_fd;
+    load->conn = *conn;
+    load->start_us = ctx.start_us;
+    load->req = req;
+    load->is_head = is_head_request;
+    snprintf(load->relpath, sizeof(load->relpath), "%s", relpath);
+    snprintf(load->abs_path, sizeof(load->abs_path), "%s", abs_path);
+
+    if (pool->disk && !(rc == 0 && err == ENOENT)) {
+        int queued = disk_pool_submit(pool->disk, &load->job);
+        if (queued == 0) {
+            if (health) {
+                atomic_fetch_add_explicit(&health->disk_deferred, 1, memory_order_relaxed);
+            }
+            return; // The disk thread passes it back; the connection stays open until then
+        }
+        if (queued == -1) {
+            // Disk queue full: shed the request rather than pile up blocked reads
+            free(load);
+            if (health) {
+                atomic_fetch_add_explicit(&health->disk_rejected, 1, memory_order_relaxed);
+            }
+            send_error_response(client_fd, 503, "Service Unavailable", 0);
+            finish_request(&ctx, shm, req.method, req.path, 503, 0);
+            close(client_fd);
+            return;
+        }
+        // Disk pool stopping (shutdown): read it here
     }
 
-    close(client_fd); 
+    load_file(load);
+    send_loaded_file(load, shm);
 }
 
 
@@ -370,6 +589,8 @@ thread_pool_t* create_thread_pool(int num_threads, int max_queue_size, shared_da
     // Initialize shared memory and semaphores pointers for worker threads to use
     pool->shm = shm;
     pool->sems = sems;
+    pool->health = worker_get_health();
+    pool->disk = NULL;                      // Attached by the caller (worker_main)
 
     // Allocate memory for array of thread identifiers
     pool->threads = malloc(sizeof(pthread_t) * num_threads);
@@ -382,6 +603,10 @@ thread_pool_t* create_thread_pool(int num_threads, int max_queue_size, shared_da
     pool->job_count = 0;                    // Initialize job counter (no jobs)
     pool->max_queue_size = max_queue_size;  // Store maximum queue size
 
+    if (pool->health) {
+        atomic_store_explicit(&pool->health->pool_capacity, max_queue_size, memory_order_relaxed);
+    }
+
     // Initialize the mutex for protecting shared pool state
     // The mutex ensures only one thread can access pool->job_count, head, tail at a time
     pthread_mutex_init(&pool->mutex, NULL);
@@ -449,6 +674,10 @@ void* worker_thread(void* arg) {
             
             // Decrement remaining job count
             pool->job_count--;
+
+            if (pool->health) {
+                atomic_store_explicit(&pool->health->pool_queued, pool->job_count, memory_order_relaxed);
+            }
         }
 
         // Release lock to allow other threads to access queue
@@ -458,7 +687,18 @@ void* worker_thread(void* arg) {
         if(job){
             // Handle the HTTP client request (includes parsing, caching, and response)
             // Supports Keep-Alive internally
-            handle_client_request(job->client_fd, pool->shm, pool->sems);
+            if (pool->health) {
+                atomic_fetch_add_explicit(&pool->health->inflight, 1, memory_order_relaxed);
+            }
+            if (job->resume) {
+                http_response_begin();
+                send_loaded_file(job->resume, pool->shm); // Frees it
+            } else {
+                handle_client_request(pool, job->client_fd, &job->conn);
+            }
+            if (pool->health) {
+                atomic_fetch_sub_explicit(&pool->health->inflight, 1, memory_order_relaxed);
+            }
             
             // Free the job structure after processing
             free(job);
@@ -475,15 +715,38 @@ void* worker_thread(void* arg) {
 // Arguments:
 // pool - Pointer to the thread pool structure
 // client_fd - File descriptor of accepted client socket connection
+// conn - Connection metadata received with the descriptor
 
-void thread_pool_submit (thread_pool_t* pool, int client_fd){
+void thread_pool_submit (thread_pool_t* pool, int client_fd, const conn_info_t* conn){
     // Allocate memory for new job structure
     job_t* job = malloc (sizeof (job_t));
 
     // Initialize job with client file descriptor
     job->client_fd = client_fd;     // Store client socket descriptor
+    job->conn = *conn;              // Peer address and accept time
+    job->resume = NULL;             // New connection
     job->next = NULL;               // Clear next pointer (will be set when enqueued)
 
+    thread_pool_enqueue(pool, job);
+}
+
+// Disk I/O completion: queue the response of a finished load_file() for a request thread.
+// Like new connections it is not bounded by max_queue_size (the disk queue already is).
+static void thread_pool_resume(thread_pool_t* pool, file_load_t* load) {
+    job_t* job = malloc(sizeof(job_t));
+    if (!job) {
+        discard_file_load(load);
+        return;
+    }
+    job->client_fd = load->client_fd;
+    job->conn = load->conn;
+    job->resume = load;
+    job->next = NULL;
+    thread_pool_enqueue(pool, job);
+}
+
+// Append a job to the queue and wake a request thread
+static void thread_pool_enqueue(thread_pool_t* pool, job_t* job) {
     // Acquire lock before modifying shared job queue
     pthread_mutex_lock(&pool->mutex);
 
@@ -501,6 +764,10 @@ void thread_pool_submit (thread_pool_t* pool, int client_fd){
     // Increment counter of pending jobs
     pool->job_count++;
 
+    if (pool->health) {
+        atomic_store_explicit(&pool->health->pool_queued, pool->job_count, memory_order_relaxed);
+    }
+
     // Signal condition variable to wake up a waiting worker thread
     // Unlock must follow signal to avoid race conditions
     pthread_cond_signal(&pool->cond);
@@ -537,7 +804,11 @@ void destroy_thread_pool(thread_pool_t* pool){
     job_t* current = pool->head;
     while (current) {
         job_t* next = current->next;        // Save next job before freeing current
-        close(current->client_fd);          // Close associated client socket
+        if (current->resume) {
+            discard_file_load(current->resume); // Releases the file and closes the socket
+        } else {
+            close(current->client_fd);      // Close associated client socket
+        }
         free(current);                      // Free job structure
         current = next;
     }
@@ -3,14 +3,20 @@
 #include <pthread.h>
 #include "shared_mem.h"
 #include "semaphores.h"
+#include "worker.h" // conn_info_t
+#include "disk_io.h" // disk_pool_t
 
 // ###################################################################################################################
 // FEATURE 2: Thread Pool Management
 // ###################################################################################################################
 
+struct file_load; // Cache miss read by a disk I/O thread (thread_pool.c)
+
 // Structure to represent a job in the thread pool
 typedef struct job {
     int client_fd; // Client file descriptor to process
+    conn_info_t conn; // Peer address and accept time
+    struct file_load* resume; // Finished disk read whose response is still to be sent (NULL = new connection)
     struct job* next; // Pointer to the next job in the queue
 } job_t;
 
@@ -30,13 +36,15 @@ typedef struct {
 
     shared_data_t* shm; // Pointer to shared memory for statistics
     semaphores_t* sems; // Pointer to semaphores for synchronization
+    worker_health_t* health; // Health slot of the owning worker (NULL = none): inflight / queued counts
+    disk_pool_t* disk; // Disk I/O pool for cache misses that would block (NULL = read on the request thread)
 } thread_pool_t;
 
 thread_pool_t* create_thread_pool(int num_threads, int max_queue_size, shared_data_t* shm, semaphores_t* sems); // Create a new thread pool
 
 void destroy_thread_pool(thread_pool_t* pool); // Destroy the thread pool   
-void thread_pool_submit(thread_pool_t* pool, int client_fd); // Submit a job to the thread pool
-void handle_client_request(int client_fd, shared_data_t* shm, semaphores_t* sems); // Handle client request
+void thread_pool_submit(thread_pool_t* pool, int client_fd, const conn_info_t* conn); // Submit a job to the thread pool
+void handle_client_request(thread_pool_t* pool, int client_fd, const conn_info_t* conn); // Handle client request
 
 void add_job(thread_pool_t* pool, int client_fd); // Add a job to the thread pool
 
@@ -5,6 +5,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <errno.h>
 #include <string.h>
 #include <time.h>
@@ -16,19 +17,26 @@
 #include "config.h"
 #include "cache.h"     // Cache interface (Feature 4)
 #include "logger.h"    // Thread-safe logging (Feature 5)
+#include "stats.h"     // stats_set_slot(), get_time_us()
+#include "profiler.h"  // Sampling profiler (make profile)
+#include "http_builder.h" // http_set_zerocopy_min(), http_zerocopy_stop(), http_set_tcp_tuning(), send_error_response()
+#include "steering.h"  // steering_pin(), steering_incoming_local() (CPU_AFFINITY)
 
 // ###################################################################################################################
 // Sending file descriptors over UNIX sockets
 // ###################################################################################################################
 // Reference: https://gist.github.com/domfarolino/4293951bd95082125f2b9931cab1de40
 
+static int spin_until_readable(int fd); // Busy-poll mode (below)
+
 /**
  * Receives a file descriptor sent over a Unix domain socket.
  * Uses select() with timeout to allow periodic shutdown checks.
  * @param socket The Unix domain socket file descriptor.
+ * @param info Receives the connection metadata sent with the descriptor.
  * @return The received file descriptor, or -1 on error, or -2 on timeout.
  */
-static int recv_fd(int socket) {
+static int recv_fd(int socket, conn_info_t* info) {
     // Use select() with timeout to allow periodic shutdown checks
     fd_set read_fds;
     struct timeval tv;
@@ -40,13 +48,14 @@ static int recv_fd(int socket) {
     tv.tv_sec = 1;
     tv.tv_usec = 0;
     
-    int ret = select(socket + 1, &read_fds, NULL, NULL, &tv);
+    // Busy-poll mode: the descriptor usually follows the queue item within microseconds
+    int ret = spin_until_readable(socket) ? 1 : select(socket + 1, &read_fds, NULL, NULL, &tv);
     
     if (ret < 0) {
         if (errno == EINTR) {
             return -1; // Interrupted, caller should check worker_running
         }
-        perror("select in recv_fd");
+        LOG_DIAG(LOG_LEVEL_ERROR, "select in recv_fd: %m");
         return -1;
     }
     
@@ -56,8 +65,7 @@ static int recv_fd(int socket) {
     }
 
     struct msghdr msg = {0};
-    char buf[1];
-    struct iovec io = { .iov_base = buf, .iov_len = 1 };
+    struct iovec io = { .iov_base = info, .iov_len = sizeof(*info) };
 
     // Union for control message buffer (ancillary data)
     union {
@@ -71,13 +79,19 @@ static int recv_fd(int socket) {
     msg.msg_controllen = sizeof(u.buf); // Control message length
 
     // Receive the message (including ancillary data)
-    if (recvmsg(socket, &msg, 0) < 0) {
+    ssize_t len = recvmsg(socket, &msg, 0);
+    if (len < 0) {
         // EINTR is common during shutdown; the caller will check worker_running.
         if (errno != EINTR) {
-            perror("Failed to receive fd");
+            LOG_DIAG(LOG_LEVEL_ERROR, "Failed to receive fd: %m");
         }
         return -1;
     }
+    if (len != (ssize_t)sizeof(*info)) {
+        // Short payload: keep the descriptor, forget the metadata
+        info->peer_len = 0;
+        info->accept_us = 0;
+    }
 
     struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); // First control message
 
@@ -103,9 +117,34 @@ static volatile int worker_running = 1;
 // Per-worker file cache (Feature 4: Thread-Safe File Cache)
 static file_cache_t* g_cache = NULL;
 
+// Cache shared by all workers, created by the master before fork (NULL = g_cache per worker)
+static shcache_t* g_shared = NULL;
+
+// Docroot bundle mapped by the master before fork (shared, read-only; NULL = serve files)
+static const docpack_t* g_pack = NULL;
+
+// Disk I/O pool size for cache misses (copied from config at startup; 0 threads = no pool)
+static int g_disk_io_threads = 0;
+static int g_disk_io_queue = 0;
+
+// Spin budget before blocking (BUSY_POLL_US, 0 = block at once)
+static int g_busy_poll_us = 0;
+
+// CPU_AFFINITY: CPU this worker is pinned to (-1 = not pinned) and its own listening sockets
+static int g_cpu = -1;
+static int g_listen_fds[MAX_LISTENERS];
+static int g_num_listen_fds = 0;
+
 // Per-worker document root (copied from config at startup)
 static char g_docroot[256];
 
+// Logical ID of this worker (set by worker_main)
+static int g_worker_id = -1;
+
+// Health slot of this worker in shared memory (set by worker_main)
+static worker_health_t* g_health = NULL;
+static long long g_cache_sample_us = 0; // When cache_bytes was last refreshed
+
 // ###################################################################################################################
 // SIGNAL HANDLER
 // ###################################################################################################################
@@ -126,17 +165,44 @@ void worker_signal_handler(int signum) {
 /**
  * Initializes worker resources that depend on configuration (e.g., cache, document root).
  * cfg -> Pointer to loaded configuration (uses cache_size_mb and num_workers).
+ * sems -> Shared synchronization primitives (log file locks).
+ * pack -> Docroot bundle inherited from the master (NULL = none).
+ * shared -> Cache shared by all workers, inherited from the master (NULL = create a cache per worker).
  */
-void worker_init_resources(const server_config_t* cfg) {
+void worker_init_resources(const server_config_t* cfg, semaphores_t* sems, const docpack_t* pack, shcache_t* shared) {
     // Copy DOCUMENT_ROOT to local worker memory (null-terminated string)
     size_t len = strlen(cfg->document_root);
     if (len > sizeof(g_docroot) - 1) len = sizeof(g_docroot) - 1;
     memcpy(g_docroot, cfg->document_root, len);
     g_docroot[len] = '\0'; // Ensure null-termination
 
+    // Large bodies go out with MSG_ZEROCOPY (http_builder)
+    http_set_zerocopy_min(cfg->zerocopy_min_kb > 0 ? (size_t)cfg->zerocopy_min_kb * 1024 : 0);
+    http_set_tcp_tuning(cfg->notsent_lowat_kb > 0 ? (size_t)cfg->notsent_lowat_kb * 1024 : 0,
+                        cfg->sndbuf_max_kb > 0 ? (size_t)cfg->sndbuf_max_kb * 1024 : 0);
+    g_busy_poll_us = cfg->busy_poll_us > 0 ? cfg->busy_poll_us : 0;
+
     // Initialize thread-safe/process-safe logger (Feature 5)
-    // (each worker reopens the same log file with global semaphore)
-    logger_init(cfg->log_file);
+    // (each worker reopens the same log file, serialized by the shared log mutex)
+    logger_init(cfg, sems);
+
+    // A bundle replaces the file cache: every worker serves from the same mapping
+    g_pack = pack;
+    if (g_pack) {
+        fprintf(stderr, "Worker: Serving %zu files from %s\n", docpack_count(g_pack), cfg->docpack);
+        return;
+    }
+
+    // Files are read through the cache: misses that wait for the disk go to the disk I/O pool
+    g_disk_io_threads = cfg->disk_io_threads;
+    g_disk_io_queue = cfg->disk_io_queue > 0 ? cfg->disk_io_queue : 1;
+
+    // The shared cache replaces the per-worker cache
+    g_shared = shared;
+    if (g_shared) {
+        fprintf(stderr, "Worker: Using the shared cache. DOCROOT=%s\n", g_docroot);
+        return;
+    }
 
     // Total desired capacity in bytes (config gives in megabytes)
     size_t cap = (size_t)cfg->cache_size_mb * 1024ULL * 1024ULL;
@@ -168,6 +234,20 @@ file_cache_t* worker_get_cache(void) {
     return g_cache;
 }
 
+/**
+ * Returns the cache shared by all workers (NULL when each worker has its own).
+ */
+shcache_t* worker_get_shared_cache(void) {
+    return g_shared;
+}
+
+/**
+ * Returns the docroot bundle (NULL when serving files).
+ */
+const docpack_t* worker_get_docpack(void) {
+    return g_pack;
+}
+
 /**
  * Returns the worker's document root (internal string; do not modify).
  */
@@ -175,6 +255,103 @@ const char* worker_get_document_root(void) {
     return g_docroot;
 }
 
+/**
+ * Returns the logical ID of this worker.
+ */
+int worker_get_id(void) {
+    return g_worker_id;
+}
+
+/**
+ * Returns the health slot of this worker.
+ */
+worker_health_t* worker_get_health(void) {
+    return g_health;
+}
+
+/**
+ * Records the last error of this worker.
+ */
+void worker_note_error(int err) {
+    if (g_health) {
+        atomic_store_explicit(&g_health->last_error, err, memory_order_relaxed);
+        atomic_store_explicit(&g_health->last_error_us, get_time_us(), memory_order_relaxed);
+    }
+}
+
+void socket_set_busy_poll(int fd, int busy_poll_us) {
+    if (busy_poll_us <= 0) {
+        return;
+    }
+    // Raising it above net.core.busy_read needs CAP_NET_ADMIN
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) != 0) {
+        LOG_DIAG(LOG_LEVEL_WARN, "setsockopt(SO_BUSY_POLL): %m");
+    }
+#ifdef SO_PREFER_BUSY_POLL
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one)); // Linux 5.11+; older kernels ignore it
+#endif
+}
+
+void worker_set_steering(int cpu, const int* listen_fds, int count) {
+    if (steering_pin(cpu) != 0) {
+        fprintf(stderr, "Worker: Cannot pin to CPU %d: %s\n", cpu, strerror(errno));
+    } else {
+        g_cpu = cpu;
+    }
+    for (int i = 0; i < count && i < MAX_LISTENERS; i++) {
+        g_listen_fds[i] = listen_fds[i];
+    }
+    g_num_listen_fds = count < MAX_LISTENERS ? count : MAX_LISTENERS;
+}
+
+// Count whether the packets of a new connection are processed on the CPU that took it
+static void note_locality(int fd) {
+    int local = steering_incoming_local(fd);
+    if (local >= 0) {
+        atomic_fetch_add_explicit(local ? &g_health->conn_local : &g_health->conn_remote, 1, memory_order_relaxed);
+    }
+}
+
+// Account one busy-poll spin of the dispatch loop: spun_us spent, and whether it found work
+static void note_spin(long long spun_us, int found) {
+    atomic_fetch_add_explicit(&g_health->spin.spin_us, spun_us, memory_order_relaxed);
+    atomic_fetch_add_explicit(found ? &g_health->spin.spin_hits : &g_health->spin.spin_misses, 1,
+                              memory_order_relaxed);
+}
+
+// Busy-poll mode: poll fd without blocking for up to BUSY_POLL_US. Returns 1 once it is readable, 0 when
+// the budget ran out (or the mode is off) and the caller should block.
+static int spin_until_readable(int fd) {
+    if (g_busy_poll_us <= 0) {
+        return 0;
+    }
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    long long start = get_time_us(), now;
+    do {
+        if (poll(&p, 1, 0) > 0) {
+            note_spin(get_time_us() - start, 1);
+            return 1;
+        }
+        now = get_time_us();
+    } while (worker_running && now - start < g_busy_poll_us);
+    note_spin(now - start, 0);
+    return 0;
+}
+
+// Refresh the heartbeat (and, once per WORKER_HEARTBEAT_MS, the cache size) in the health slot
+static void worker_heartbeat(void) {
+    long long now = get_time_us();
+    atomic_store_explicit(&g_health->heartbeat_us, now, memory_order_relaxed);
+
+    if (g_cache && now - g_cache_sample_us >= WORKER_HEARTBEAT_MS * 1000LL) {
+        size_t items, bytes, capacity, hits, misses, evictions;
+        cache_stats(g_cache, &items, &bytes, &capacity, &hits, &misses, &evictions);
+        atomic_store_explicit(&g_health->cache_bytes, (long long)bytes, memory_order_relaxed);
+        g_cache_sample_us = now;
+    }
+}
+
 /**
  * Cleans up and destroys worker-specific resources (cache, logger, etc.).
  */
@@ -190,165 +367,185 @@ void worker_shutdown_resources(void) {
 // FEATURE 1: Connection Queue Consumer
 // ###################################################################################################################
 
-// Dequeue a connection from the shared queue
-// Returns the connection_item_t if successful, or {-1, -1} on error
-static connection_item_t dequeue_connection(shared_data_t* shm, semaphores_t* sems) {
+// Dequeue the oldest connection from this worker's ring.
+// Sleeps on the worker's own queue event until one arrives or the master shuts down, waking up every
+// WORKER_HEARTBEAT_MS to show the master it is still alive. In busy-poll mode it first spins on the
+// event for up to BUSY_POLL_US.
+// Returns the connection_item_t if successful, or {-1, -1} on shutdown/error
+static connection_item_t dequeue_connection(shared_data_t* shm, semaphores_t* sems, int worker_id) {
     connection_item_t item = {-1, -1};
+    connection_queue_t* q = shm_queue(shm, (unsigned int)worker_id);
 
-    // Wait for an available item with timeout to allow periodic shutdown checks
-    struct timespec ts;
-    while (1) {
-        // Check shutdown before waiting
-        if (!worker_running) {
-            return item;
-        }
-        
-        // Set timeout to 1 second from now
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 1;
-
-        int ret = sem_timedwait(sems->filled_slots, &ts);
-        if (ret == 0) {
-            // Successfully acquired semaphore
-            break;
-        }
-
-        if (errno == ETIMEDOUT) {
-            // Timeout - check if we should shutdown
-            if (!worker_running) {
-                return item; // Return error to signal shutdown
-            }
-            // Otherwise, retry
-            continue;
-        }
-
-        if (errno == EINTR) {
-            // Interrupted by signal - check if we should shutdown
-            if (!worker_running) {
-                return item; // Return error to signal shutdown
-            }
-            // Otherwise, retry
-            continue;
-        }
-
-        // Other error
-        perror("sem_timedwait(filled_slots)");
+    int rc = sync_lock(&sems->queue_mutex);
+    if (rc < 0) {
+        perror("sync_lock(queue_mutex)");
         return item;
     }
 
-    // Critical section for queue access - also needs timeout
+    long spin_left = g_busy_poll_us; // Busy-poll budget left for this wait
     while (1) {
-        if (!worker_running) {
-            // Restore the filled slot before exiting
-            sem_post(sems->filled_slots);
+        if (rc == 1) {
+            queue_repair(shm);
+        }
+        if (!worker_running || sems->shutdown) {
+            sync_unlock(&sems->queue_mutex);
             return item;
         }
-        
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 1;
-        
-        int ret = sem_timedwait(sems->queue_mutex, &ts);
-        if (ret == 0) {
+        if (queue_count(q) > 0) {
+            if (spin_left < g_busy_poll_us) {
+                note_spin(g_busy_poll_us - (spin_left > 0 ? spin_left : 0), spin_left > 0);
+            }
             break;
         }
-        
-        if (errno == ETIMEDOUT || errno == EINTR) {
-            if (!worker_running) {
-                sem_post(sems->filled_slots);
+        if (spin_left > 0) {
+            long long start = get_time_us();
+            rc = sync_event_spin(&g_health->queue_event, &sems->queue_mutex, spin_left);
+            spin_left = (rc == 2) ? 0 : spin_left - (long)(get_time_us() - start);
+            if (rc < 0) {
+                perror("sync_event_spin(queue_event)");
                 return item;
             }
             continue;
         }
-        
-        perror("sem_timedwait(queue_mutex)");
-        sem_post(sems->filled_slots);
-        return item;
+        rc = sync_event_wait(&g_health->queue_event, &sems->queue_mutex, WORKER_HEARTBEAT_MS);
+        if (rc < 0) {
+            perror("sync_event_wait(queue_event)");
+            return item;
+        }
+        if (rc == 2) {
+            worker_heartbeat(); // Idle, but alive
+        }
     }
 
-    // Remove from front
-    if (shm->queue.count > 0) {
-        item = shm->queue.items[shm->queue.front];
-        shm->queue.front = (shm->queue.front + 1) % MAX_QUEUE_SIZE;
-        shm->queue.count--;
-    }
+    // Take the head
+    item = *queue_at(q, 0);
+    q->head++;
+    shm->queue_pending--;
 
     // Release critical section
-    sem_post(sems->queue_mutex);
-
-    // Signal free slot
-    sem_post(sems->empty_slots);
+    sync_unlock(&sems->queue_mutex);
 
     return item;
 }
 
-// Re-enqueue a connection item (used when dequeued item is not for this worker)
-static int re_enqueue_connection(shared_data_t* shm, semaphores_t* sems, connection_item_t item) {
-    struct timespec ts;
-    
-    // Wait for a free slot with timeout
-    while (1) {
-        if (!worker_running) {
-            return -1;
-        }
-        
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 1;
-        
-        int ret = sem_timedwait(sems->empty_slots, &ts);
-        if (ret == 0) {
-            break;
-        }
-        
-        if (errno == ETIMEDOUT || errno == EINTR) {
-            if (!worker_running) {
-                return -1;
-            }
-            continue;
-        }
-        
-        perror("sem_timedwait(empty_slots)");
-        return -1;
+// Take the next connection the master dispatched to this worker (queue item, then the descriptor) and submit it
+// to the thread pool. Returns 0 to keep going (connection served, timeout or transient error), -1 on shutdown.
+static int serve_dispatched(shared_data_t* shm, semaphores_t* sems, int worker_id, int channel_fd,
+                            thread_pool_t* pool) {
+    // First, dequeue the next connection item from this worker's ring
+    connection_item_t item = dequeue_connection(shm, sems, worker_id);
+
+    // Check if dequeue was successful
+    if (item.worker_id == -1) {
+        return (!worker_running || sems->shutdown) ? -1 : 0; // shutdown, or error: try again
     }
 
-    // Critical section for queue access with timeout
-    while (1) {
-        if (!worker_running) {
-            sem_post(sems->empty_slots);
-            return -1;
-        }
-        
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 1;
-        
-        int ret = sem_timedwait(sems->queue_mutex, &ts);
-        if (ret == 0) {
-            break;
+    // Check if we should shutdown before trying to receive FD
+    if (!worker_running) return -1;
+
+    // This connection is for this worker, now receive the FD via UNIX socket
+    conn_info_t info;
+    errno = 0;
+    int client_fd = recv_fd(channel_fd, &info);
+
+    // Handle return values from recv_fd:
+    // -2 = timeout (continue loop to check worker_running)
+    // -1 = error or signal (check worker_running)
+    // >= 0 = valid fd
+    if (client_fd == -2) {
+        // Timeout - continue to check worker_running
+        return 0;
+    }
+    if (client_fd < 0) {
+        if (!worker_running) return -1; // shutdown: exit gracefully
+        // On error (but not shutdown), continue trying
+        if (errno != EINTR) {
+            worker_note_error(errno ? errno : EPROTO); // EPROTO: message without a descriptor
         }
-        
-        if (errno == ETIMEDOUT || errno == EINTR) {
-            if (!worker_running) {
-                sem_post(sems->empty_slots);
-                return -1;
+        return 0;
+    }
+
+
+    // Process the client request
+    // Submit the client request to the thread pool
+    // The handler will:
+    //   1) Parse the HTTP request
+    //   2) Use the cache via worker_get_cache()
+    //   3) Get the document root via worker_get_document_root()
+    //   4) Send the response
+    //   5) Close the socket when done
+    note_locality(client_fd);
+    socket_set_busy_poll(client_fd, g_busy_poll_us); // The request is read with a blocking read()
+    thread_pool_submit(pool, client_fd, &info);
+    return 0;
+}
+
+// Connections accepted per readable listener before the loop polls again (keeps the heartbeat and the
+// master's channel going under a connection flood)
+#define STEERED_ACCEPT_BATCH 64
+
+// CPU_AFFINITY: accept the connections the kernel steered to this worker's socket and submit them to the
+// thread pool. They wait for a pool thread instead of in the master's queue, so its admission applies here:
+// with MAX_QUEUE_SIZE of them waiting, or the pool overloaded, a connection is answered 503.
+static void accept_steered(shared_data_t* shm, int listen_fd, thread_pool_t* pool) {
+    for (int n = 0; n < STEERED_ACCEPT_BATCH; n++) {
+        conn_info_t info;
+        info.peer_len = sizeof(info.peer);
+        int client_fd = accept(listen_fd, (struct sockaddr*)&info.peer, &info.peer_len);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+                worker_note_error(errno);
             }
+            return;
+        }
+        info.accept_us = get_time_us();
+
+        unsigned int queued = (unsigned int)atomic_load_explicit(&g_health->pool_queued, memory_order_relaxed);
+        if (queued >= shm->queue_limit || worker_health_state(g_health, info.accept_us) == WORKER_OVERLOADED) {
+            send_error_response(client_fd, 503, "Service Unavailable", 0);
+            close(client_fd);
             continue;
         }
-        
-        perror("sem_timedwait(queue_mutex)");
-        sem_post(sems->empty_slots);
-        return -1;
+        note_locality(client_fd);
+        socket_set_busy_poll(client_fd, g_busy_poll_us);
+        thread_pool_submit(pool, client_fd, &info);
     }
+}
 
-    // Insert at position rear (front + count) % MAX_QUEUE_SIZE
-    int pos = (shm->queue.front + shm->queue.count) % MAX_QUEUE_SIZE;
-    shm->queue.items[pos] = item;
-    shm->queue.count++;
-
-    // Release critical section
-    sem_post(sems->queue_mutex);
-
-    // Signal available item
-    sem_post(sems->filled_slots);
+// CPU_AFFINITY: wait up to WORKER_HEARTBEAT_MS for this worker's listening sockets and for the master's channel
+// (connections from Unix-domain listeners, which the master still accepts), then serve whichever is ready.
+// Returns 0 to keep going, -1 on shutdown.
+static int serve_steered(shared_data_t* shm, semaphores_t* sems, int worker_id, int channel_fd,
+                         thread_pool_t* pool) {
+    struct pollfd pfds[MAX_LISTENERS + 1];
+    int n = g_num_listen_fds;
+    for (int i = 0; i < n; i++) {
+        pfds[i].fd = g_listen_fds[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+    }
+    pfds[n].fd = channel_fd;
+    pfds[n].events = POLLIN;
+    pfds[n].revents = 0;
 
+    if (poll(pfds, (nfds_t)n + 1, WORKER_HEARTBEAT_MS) < 0) {
+        if (errno != EINTR) {
+            worker_note_error(errno);
+        }
+        return worker_running ? 0 : -1;
+    }
+    if (!worker_running || sems->shutdown) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (pfds[i].revents & POLLIN) {
+            accept_steered(shm, pfds[i].fd, pool);
+        }
+    }
+    // A descriptor from the master (its queue item is already there), or the master closed the channel
+    if (pfds[n].revents & (POLLIN | POLLHUP)) {
+        return serve_dispatched(shm, sems, worker_id, channel_fd, pool);
+    }
     return 0;
 }
 
@@ -364,7 +561,7 @@ static int re_enqueue_connection(shared_data_t* shm, semaphores_t* sems, connect
  */
 void worker_main(shared_data_t* shm, semaphores_t* sems, int worker_id, int channel_fd) {
     // Register signal handler using sigaction WITHOUT SA_RESTART
-    // This ensures sem_timedwait returns EINTR when signal is received
+    // (interrupts the blocking recv; queue waits are released by the master's shutdown broadcast)
     struct sigaction sa;
     sa.sa_handler = worker_signal_handler;
     sigemptyset(&sa.sa_mask);
@@ -372,77 +569,73 @@ void worker_main(shared_data_t* shm, semaphores_t* sems, int worker_id, int chan
     sigaction(SIGTERM, &sa, NULL);
     sigaction(SIGINT, &sa, NULL);
 
+    g_worker_id = worker_id;
+    profiler_start("worker", worker_id); // make profile builds only
+    stats_set_slot(worker_id); // Request threads count into this worker's stats slot
+
+    // Announce this worker in its health slot before the master starts dispatching to it
+    g_health = shm_health(shm, (unsigned int)worker_id);
+    atomic_store_explicit(&g_health->last_error, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->inflight, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->pool_queued, 0, memory_order_relaxed);
+    worker_heartbeat();
+    atomic_store_explicit(&g_health->pid, (int)getpid(), memory_order_relaxed);
+
     // Create a thread pool with 10 threads and a bounded queue of 2000 jobs
     // Note: the thread pool will typically call the logic that serves requests (HTTP) and,
     //       in that logic, should use the cache via worker_get_cache() and DOCROOT via worker_get_document_root().
     // Max queue size of 2000 prevents memory exhaustion while handling extreme load
     thread_pool_t* pool = create_thread_pool(10, 2000, shm, sems);
 
+    // Cache misses that would wait for the disk are read by a separate, bounded pool
+    atomic_store_explicit(&g_health->disk_queued, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->disk_inline, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->disk_deferred, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->disk_rejected, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->spin.spin_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->spin.spin_hits, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->spin.spin_misses, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->cpu, g_cpu, memory_order_relaxed);
+    atomic_store_explicit(&g_health->conn_local, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_health->conn_remote, 0, memory_order_relaxed);
+    if (pool && g_disk_io_threads > 0) {
+        pool->disk = disk_pool_create(g_disk_io_threads, g_disk_io_queue, g_health);
+        if (!pool->disk) {
+            fprintf(stderr, "Worker %d: No disk I/O pool, cache misses are read by the request threads\n", worker_id);
+        }
+    }
+
     printf("Worker %d: Starting main loop.\n", worker_id);
     fflush(stdout);
 
     while (worker_running) {
-        // First, dequeue a connection item from the shared queue
-        connection_item_t item = dequeue_connection(shm, sems);
-
-        // Check if dequeue was successful
-        if (item.worker_id == -1) {
-            if (!worker_running) break; // shutdown
-            continue; // error, try again
-        }
-
-
-        // Check if this connection is for this worker
-        if (item.worker_id != worker_id) {
-            // Not for this worker, re-enqueue
-            if (re_enqueue_connection(shm, sems, item) != 0) {
-            }
-            continue;
-        }
-
-        // Check if we should shutdown before trying to receive FD
-        if (!worker_running) break;
-
-        // This connection is for this worker, now receive the FD via UNIX socket
-        int client_fd = recv_fd(channel_fd);
-
-        // Handle return values from recv_fd:
-        // -2 = timeout (continue loop to check worker_running)
-        // -1 = error or signal (check worker_running)
-        // >= 0 = valid fd
-        if (client_fd == -2) {
-            // Timeout - continue to check worker_running
-            continue;
-        }
-        if (client_fd < 0) {
-            if (!worker_running) break; // shutdown: exit gracefully
-            // On error (but not shutdown), continue trying
-            continue;
-        }
-
-
-        // Process the client request
-        // Submit the client request to the thread pool
-        // The handler will:
-        //   1) Parse the HTTP request
-        //   2) Use the cache via worker_get_cache()
-        //   3) Get the document root via worker_get_document_root()
-        //   4) Send the response
-        //   5) Close the socket when done
-        thread_pool_submit(pool, client_fd);
+        worker_heartbeat();
+        int rc = (g_num_listen_fds > 0) ? serve_steered(shm, sems, worker_id, channel_fd, pool)
+                                        : serve_dispatched(shm, sems, worker_id, channel_fd, pool);
+        if (rc < 0) break; // shutdown
     }
 
     // Cleanup: destroy the thread pool before exiting
     printf("Worker %d: Shutting down thread pool.\n", worker_id);
+    // Disk reads still queued finish first and hand their responses to the request threads
+    disk_pool_t* disk = pool ? pool->disk : NULL;
+    disk_pool_stop(disk);
     destroy_thread_pool(pool);
+    disk_pool_destroy(disk);
+    http_zerocopy_stop(); // Bodies still being sent zero-copy are released before the caches go away
 
     // Destroy worker-specific resources (cache, logger, etc.)
     worker_shutdown_resources();
 
-    // Close inherited semaphores (do not unlink - master will do that)
-    close_semaphores(sems);
+    // No longer a dispatch target
+    atomic_store_explicit(&g_health->pid, 0, memory_order_relaxed);
 
-    // Close the channel file descriptor
+    // Close the channel file descriptor (and this worker's listening sockets; the master's copies stay in the groups)
     close(channel_fd);
+    for (int i = 0; i < g_num_listen_fds; i++) {
+        close(g_listen_fds[i]);
+    }
+
+    profiler_stop();
 }
 
@@ -3,15 +3,32 @@
 
 #include "config.h"     // server_config_t
 #include "cache.h"      // file_cache_t (per-worker cache)
+#include "docpack.h"    // docpack_t (docroot bundle)
+#include "shcache.h"    // shcache_t (cache shared by all workers)
 #include "shared_mem.h" // Shared memory structures (connection queue, stats)
 #include "semaphores.h" // Semaphores for queue synchronization
+#include <sys/socket.h> // struct sockaddr_storage
+
+// ###################################################################################################################
+// Connection handoff
+// ###################################################################################################################
+
+// Metadata the master sends with each client descriptor (the SCM_RIGHTS payload), so the peer address and
+// accept time are captured once, at accept.
+typedef struct {
+    struct sockaddr_storage peer; // Client address as returned by accept()
+    socklen_t peer_len; // Length of peer (0 = unknown)
+    long long accept_us; // get_time_us() right after accept() (0 = unknown)
+} conn_info_t;
 
 // ###################################################################################################################
 // Worker Lifecycle API
 // ###################################################################################################################
 
 // Initializes worker-specific resources. Called in the child process after master forks.
-void worker_init_resources(const server_config_t* cfg);
+// pack is the docroot bundle the master mapped (NULL = serve files from the document root).
+// shared is the cache the master created for all workers (NULL = each worker has its own).
+void worker_init_resources(const server_config_t* cfg, semaphores_t* sems, const docpack_t* pack, shcache_t* shared);
 
 // Releases worker-specific resources (e.g., cache).
 void worker_shutdown_resources(void);
@@ -19,9 +36,42 @@ void worker_shutdown_resources(void);
 // Returns a pointer to the worker's thread-safe LRU cache.
 file_cache_t* worker_get_cache(void);
 
+// Returns the cache shared by all workers (NULL when each worker has its own).
+shcache_t* worker_get_shared_cache(void);
+
+// Returns the docroot bundle (NULL when files are served from the document root).
+const docpack_t* worker_get_docpack(void);
+
 // Returns the worker's document root path.
 const char* worker_get_document_root(void);
 
+// Returns the logical ID of this worker (-1 outside a worker process).
+int worker_get_id(void);
+
+// Returns this worker's health slot in shared memory (NULL outside a worker process).
+worker_health_t* worker_get_health(void);
+
+// Records err (an errno value) as the worker's last error in its health slot.
+void worker_note_error(int err);
+
+// ###################################################################################################################
+// Busy polling (BUSY_POLL_US)
+// ###################################################################################################################
+
+// Sets SO_BUSY_POLL (busy_poll_us) and SO_PREFER_BUSY_POLL on a socket, so blocking receives on it poll the
+// device queue instead of sleeping until the interrupt. No-op for busy_poll_us <= 0. Used by the master for
+// its listening sockets and by the workers for client connections.
+void socket_set_busy_poll(int fd, int busy_poll_us);
+
+// ###################################################################################################################
+// CPU-affine connection steering (CPU_AFFINITY)
+// ###################################################################################################################
+
+// Pins this worker to cpu and makes it accept on listen_fds (its members of the steered SO_REUSEPORT groups,
+// non-blocking) besides taking connections from the master. Called in the child before worker_init_resources(),
+// so every thread the worker starts inherits the pinning.
+void worker_set_steering(int cpu, const int* listen_fds, int count);
+
 // ###################################################################################################################
 // Worker Main Loop
 // ###################################################################################################################
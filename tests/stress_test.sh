@@ -20,9 +20,12 @@ WWW_DIR="www"
 echo -e "${BOLD}Extended Stress Test (5+ minutes continuous load)${NC}"
 echo "============================================================================="
 
-# Check if Apache Bench is available
-if ! command -v ab &> /dev/null; then
-    echo -e "${RED}Error: Apache Bench (ab) not found. Please install apache2-utils.${NC}"
+# The built-in load generator (bench/loadgen.c) replaces Apache Bench
+if [ ! -x ./bin/loadgen ]; then
+    make > /dev/null 2>&1
+fi
+if [ ! -x ./bin/loadgen ]; then
+    echo -e "${RED}Error: ./bin/loadgen could not be built.${NC}"
     exit 1
 fi
 
@@ -57,54 +60,31 @@ fi
 
 echo ""
 echo "Running 5-minute continuous load test..."
-echo "Parameters: ab -t 300 -c 50 (300 seconds, 50 concurrent connections)"
+echo "Parameters: loadgen -d 300 -c 50 (300 seconds, 50 concurrent connections)"
 echo "This will take approximately 5 minutes. Please wait..."
 echo ""
 
-START_TIME=$(date +%s)
-DURATION=300
-END_TIME=$((START_TIME + DURATION))
-
-TOTAL_COMPLETE=0
-TOTAL_FAILED=0
+DURATION=${DURATION:-300}
+RESULT_JSON=$(mktemp)
 
 echo "Stress test started at $(date)"
 echo "Target duration: ${DURATION} seconds"
 
-while [ $(date +%s) -lt $END_TIME ]; do
-    CURRENT_TIME=$(date +%s)
-    REMAINING=$((END_TIME - CURRENT_TIME))
-    
-    # Safety check
-    if [ $REMAINING -le 0 ]; then break; fi
-    
-    echo "Running load batch... (~$REMAINING seconds remaining)"
-    
-    # Run ab with remaining time.
-    # Set -n very high (50 million) so -t (time) is the likely limiting factor.
-    # Even if it finishes early (high throughput), the loop will restart it.
-    OUTPUT=$(ab -t $REMAINING -n 50000000 -c 50 -r -k "$BASE_URL/index.html" 2>&1)
-    
-    BATCH_COMPLETE=$(echo "$OUTPUT" | grep "Complete requests:" | awk '{print $3}')
-    BATCH_FAILED=$(echo "$OUTPUT" | grep "Failed requests:" | awk '{print $3}')
-    
-    BATCH_COMPLETE=${BATCH_COMPLETE:-0}
-    BATCH_FAILED=${BATCH_FAILED:-0}
-    
-    TOTAL_COMPLETE=$((TOTAL_COMPLETE + BATCH_COMPLETE))
-    TOTAL_FAILED=$((TOTAL_FAILED + BATCH_FAILED))
-    
-    # Brief pause to let system breathe and prevent tight loop if ab fails instantly
-    sleep 0.2
-done
-
+START_TIME=$(date +%s)
+./bin/loadgen -p $PORT -t 4 -c 50 -d $DURATION -u /index.html -j "$RESULT_JSON"
 ACTUAL_DURATION=$(( $(date +%s) - START_TIME ))
 if [ $ACTUAL_DURATION -le 0 ]; then ACTUAL_DURATION=1; fi
 
+# Failed = transport errors + 5xx responses (connections the server closed early are resent, not failed)
+json_num() { grep -o "\"$1\": [0-9.]*" "$RESULT_JSON" | head -1 | awk '{print $2}'; }
+TOTAL_COMPLETE=$(json_num requests)
+TOTAL_FAILED=$(( $(json_num connect) + $(json_num io) + $(json_num parse) + $(json_num 5xx) ))
+REQUESTS_PER_SEC=$(json_num throughput_rps)
+P99_US=$(json_num p99)
+rm -f "$RESULT_JSON"
+
 FAILED_REQS=$TOTAL_FAILED
 COMPLETE_REQS=$TOTAL_COMPLETE
-# Calculate average RPS using awk
-REQUESTS_PER_SEC=$(awk -v c=$TOTAL_COMPLETE -v t=$ACTUAL_DURATION 'BEGIN {printf "%.2f", c/t}')
 
 echo ""
 echo "============================================================================="
@@ -112,10 +92,11 @@ echo -e "${BOLD}Results (Total Duration: ${ACTUAL_DURATION}s):${NC}"
 echo "  Completed requests: $TOTAL_COMPLETE"
 echo "  Failed requests:    $TOTAL_FAILED"
 echo "  Requests/second:    $REQUESTS_PER_SEC (avg)"
+echo "  p99 latency:        ${P99_US} us"
 
 # Calculate failure rate
 if [ "$COMPLETE_REQS" -gt 0 ]; then
-    FAILURE_RATE=$(echo "scale=4; $FAILED_REQS * 100 / $COMPLETE_REQS" | bc)
+    FAILURE_RATE=$(awk -v f=$FAILED_REQS -v c=$COMPLETE_REQS 'BEGIN {printf "%.4f", f * 100 / c}')
 else
     FAILURE_RATE=100
 fi
@@ -124,7 +105,7 @@ fi
 if [ "$FAILED_REQS" -eq 0 ]; then
     echo -e "${GREEN}[PASS] Extended stress test passed with 0 failures${NC}"
     RESULT=0
-elif [ $(echo "$FAILURE_RATE < 1" | bc) -eq 1 ]; then
+elif awk -v r=$FAILURE_RATE 'BEGIN {exit !(r < 1)}'; then
     echo -e "${GREEN}[PASS] Extended stress test passed (failure rate: ${FAILURE_RATE}% < 1%)${NC}"
     RESULT=0
 else